@@ -79,11 +79,9 @@ string fullHelpMessage(void) {
 }
 
 
-AtomicGroup calcAverage(const vector<AtomicGroup>& ensemble, const uint size) {
+AtomicGroup calcAverage(const CoordinateEnsemble& ensemble, const uint size) {
 
-  vector<AtomicGroup> subsample(size);
-  for (uint i=0; i<size; ++i)
-    subsample[i] = ensemble[i];
+  CoordinateEnsemble subsample = ensemble.slice(0, size);
 
   if (locally_optimal)
     (void)iterativeAlignment(subsample);
@@ -130,7 +128,7 @@ int main(int argc, char *argv[]) {
   
   AtomicGroup subset = selectAtoms(model, sel);
   cout << boost::format("# Subset has %d atoms\n") % subset.size();
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   readTrajectory(ensemble, subset, traj);
   cout << boost::format("# Trajectory has %d frames\n") % ensemble.size();
 
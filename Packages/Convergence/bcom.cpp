@@ -44,7 +44,6 @@ namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
 
 
-typedef vector<AtomicGroup>                               vGroup;
 typedef boost::tuple<RealMatrix, RealMatrix, RealMatrix>  SVDResult;
 
 
@@ -191,27 +190,17 @@ struct Datum {
 
 
 
-vGroup subgroup(const vGroup& A, const uint a, const uint b) {
-  vGroup B;
-
-  for (uint i=a; i<b; ++i)
-    B.push_back(A[i]);
-
-  return(B);
-}
-
-
 // Breaks the ensemble up into blocks and computes the PCA for each
 // block and the statistics for the covariance overlaps...
 
 template<class ExtractPolicy>
-Datum blocker(const RealMatrix& Ua, const RealMatrix sa, vGroup& ensemble, const uint blocksize, ExtractPolicy& policy) {
+Datum blocker(const RealMatrix& Ua, const RealMatrix sa, CoordinateEnsemble& ensemble, const uint blocksize, ExtractPolicy& policy) {
 
 
   TimeSeries<double> coverlaps;
 
   for (uint i=0; i<ensemble.size() - blocksize; i += blocksize) {
-    vGroup subset = subgroup(ensemble, i, i+blocksize);
+    CoordinateEnsemble subset = ensemble.slice(i, i+blocksize);
     boost::tuple<RealMatrix, RealMatrix> pca_result = pca(subset, policy);
     RealMatrix s = boost::get<0>(pca_result);
     RealMatrix U = boost::get<1>(pca_result);
@@ -275,7 +264,7 @@ int main(int argc, char *argv[]) {
 
   AtomicGroup subset = selectAtoms(model, sopts->selection);
 
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   readTrajectory(ensemble, subset, traj);
  
   // First, align the input trajectory...
@@ -302,7 +291,7 @@ int main(int argc, char *argv[]) {
   } else {
     // Must read in another trajectory, process it, and get the PCA
     pTraj gold = createTrajectory(gold_standard_trajectory_name, model);
-    vector<AtomicGroup> gold_ensemble;
+    CoordinateEnsemble gold_ensemble;
     readTrajectory(gold_ensemble, subset, gold);
     boost::tuple<vector<XForm>, greal, int> bres = iterativeAlignment(gold_ensemble);
     cout << "# Gold Alignment converged to " << boost::get<1>(bres) << " in " << boost::get<2>(bres) << " iterations\n";
@@ -88,10 +88,10 @@ namespace Convergence {
   /*
    * Various policies that determine how blocks are extracted and
    * averaged/aligned.  The idea is that they are really functors
-   * which, given a vector<AtomicGroup> ensemble, will extract a
-   * RealMatrix of coordinates where each AtomicGroup is a column
-   * vector.  The appropriate processing (i.e. average subtraction) is
-   * also performed by the functor.
+   * which, given a vector<AtomicGroup> or CoordinateEnsemble ensemble,
+   * will extract a RealMatrix of coordinates where each structure is a
+   * column vector.  The appropriate processing (i.e. average
+   * subtraction) is also performed by the functor.
    *
    * local_average, when set, means that the average of the ensemble
    * is used rather than the average passed to the constructor
@@ -118,6 +118,24 @@ namespace Convergence {
       return(M);
     }
 
+    loos::RealMatrix operator()(loos::CoordinateEnsemble& ensemble) {
+      loos::AtomicGroup frame = ensemble.model().copy();
+      for (uint i=0; i<ensemble.size(); ++i) {
+        ensemble.copyFrame(i, frame);
+        frame.alignOnto(target);
+        ensemble.setFrame(i, frame);
+      }
+
+      loos::RealMatrix M = loos::extractCoords(ensemble);
+      if (local_average) {
+        loos::AtomicGroup avg = loos::averageStructure(ensemble);
+        subtractStructure(M, avg);
+      } else
+        subtractStructure(M, target);
+
+      return(M);
+    }
+
     loos::AtomicGroup target;
     bool local_average;
   };
@@ -140,6 +158,17 @@ namespace Convergence {
       return(M);
     }
 
+    loos::RealMatrix operator()(loos::CoordinateEnsemble& ensemble) {
+
+      loos::RealMatrix M = loos::extractCoords(ensemble);
+      if (local_average) {
+        loos::AtomicGroup lavg = loos::averageStructure(ensemble);
+        subtractStructure(M, lavg);
+      } else
+        subtractStructure(M, avg);
+      return(M);
+    }
+
     loos::AtomicGroup avg;
     bool local_average;
   };
@@ -148,12 +177,13 @@ namespace Convergence {
 
 
 
-  // Compute the PCA of an ensemble using the specified coordinate
-  // extraction policy...
+  // Compute the PCA of an ensemble (either a vector<AtomicGroup> or a
+  // CoordinateEnsemble) using the specified coordinate extraction
+  // policy...
   //
 
-  template<class ExtractPolicy>
-  boost::tuple<loos::RealMatrix, loos::RealMatrix> pca(std::vector<loos::AtomicGroup>& ensemble, ExtractPolicy& extractor) {
+  template<class Ensemble, class ExtractPolicy>
+  boost::tuple<loos::RealMatrix, loos::RealMatrix> pca(Ensemble& ensemble, ExtractPolicy& extractor) {
 
     loos::RealMatrix M = extractor(ensemble);
     loos::RealMatrix C = loos::Math::MMMultiply(M, M, false, true);
@@ -198,8 +228,8 @@ namespace Convergence {
   // given an extraction policy...
   //
 
-  template<class ExtractPolicy>
-  loos::RealMatrix rsv(std::vector<loos::AtomicGroup>& ensemble, ExtractPolicy& extractor) {
+  template<class Ensemble, class ExtractPolicy>
+  loos::RealMatrix rsv(Ensemble& ensemble, ExtractPolicy& extractor) {
 
     loos::RealMatrix M = extractor(ensemble);
     loos::RealMatrix C = loos::Math::MMMultiply(M, M, false, true);
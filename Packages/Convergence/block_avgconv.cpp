@@ -46,24 +46,6 @@ const uint default_starting_number_of_blocks = 500;
 const double default_fraction_of_trajectory = 0.25;    
 
 
-AtomicGroup averageSelectedSubset(const vector<AtomicGroup>& ensemble, const vector<uint>& indices) {
-  AtomicGroup avg = ensemble[0].copy();
-  for (AtomicGroup::iterator i = avg.begin(); i != avg.end(); ++i)
-    (*i)->coords() = GCoord(0,0,0);
-
-  uint n = avg.size();
-  for (vector<uint>::const_iterator j = indices.begin(); j != indices.end(); ++j)
-    for (uint i=0; i<n; ++i)
-      avg[i]->coords() += ensemble[*j][i]->coords();
-
-  for (AtomicGroup::iterator i = avg.begin(); i != avg.end(); ++i)
-    (*i)->coords() /= indices.size();
-
-  return(avg);
-}
-
-
-
 string fullHelpMessage(void) {
   string msg =
     "\n"
@@ -131,7 +113,7 @@ int main(int argc, char *argv[]) {
   cout << "# " << hdr << endl;
   cout << "# n\tavg\tvar\tblocks\tstderr\n";
 
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   cerr << "Reading trajectory...\n";
   readTrajectory(ensemble, subset, traj);
 
@@ -149,14 +131,8 @@ int main(int argc, char *argv[]) {
     uint blocksize = sizes[block];
 
     vector<AtomicGroup> averages;
-    for (uint i=0; i<ensemble.size() - blocksize; i += blocksize) {
-
-      vector<uint> indices(blocksize);
-      for (uint j=0; j<blocksize; ++j)
-        indices[j] = i+j;
-      
-      averages.push_back(averageSelectedSubset(ensemble, indices));
-    }
+    for (uint i=0; i<ensemble.size() - blocksize; i += blocksize)
+      averages.push_back(averageStructure(ensemble.slice(i, i+blocksize)));
     
     TimeSeries<double> rmsds;
     for (uint j=0; j<averages.size() - 1; ++j)
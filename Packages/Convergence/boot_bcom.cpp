@@ -43,7 +43,6 @@ namespace po = boost::program_options;
 const bool debug = false;
 
 
-typedef vector<AtomicGroup>                               vGroup;
 typedef boost::tuple<RealMatrix, RealMatrix, RealMatrix>  SVDResult;
 
 
@@ -215,23 +214,11 @@ void dumpPicks(const vector<uint>& picks) {
 }
 
 
-// Extract a subgroup of the vector<AtomicGroup> given the indices in picks...
-vGroup subgroup(const vGroup& A, const vector<uint>& picks) {
-  vGroup B;
-  
-  for (vector<uint>::const_iterator ci = picks.begin(); ci != picks.end(); ++ci)
-    B.push_back(A[*ci]);
-
-  return(B);
-}
-
-
-
 // Breaks the ensemble up into blocks and computes the PCA for each
 // block and the statistics for the covariance overlaps...
 
 template<class ExtractPolicy>
-Datum blocker(const RealMatrix& Ua, const RealMatrix sa, const vGroup& ensemble, const uint blocksize, uint repeats, ExtractPolicy& policy) {
+Datum blocker(const RealMatrix& Ua, const RealMatrix sa, const CoordinateEnsemble& ensemble, const uint blocksize, uint repeats, ExtractPolicy& policy) {
 
 
   
@@ -245,7 +232,7 @@ Datum blocker(const RealMatrix& Ua, const RealMatrix sa, const vGroup& ensemble,
       dumpPicks(picks);
     }
     
-    vGroup subset = subgroup(ensemble, picks);
+    CoordinateEnsemble subset = ensemble.select(picks);
     boost::tuple<RealMatrix, RealMatrix> pca_result = pca(subset, policy);
     RealMatrix s = boost::get<0>(pca_result);
     RealMatrix U = boost::get<1>(pca_result);
@@ -303,7 +290,7 @@ int main(int argc, char *argv[]) {
   AtomicGroup subset = selectAtoms(model, sopts->selection);
 
 
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   readTrajectory(ensemble, subset, traj);
 
   // First, align the input trajectory...
@@ -330,7 +317,7 @@ int main(int argc, char *argv[]) {
   } else {
     // Must read in another trajectory, process it, and get the PCA
     pTraj gold = createTrajectory(gold_standard_trajectory_name, model);
-    vector<AtomicGroup> gold_ensemble;
+    CoordinateEnsemble gold_ensemble;
     readTrajectory(gold_ensemble, subset, gold);
     boost::tuple<vector<XForm>, greal, int> bres = iterativeAlignment(gold_ensemble);
     cout << "# Gold Alignment converged to " << boost::get<1>(bres) << " in " << boost::get<2>(bres) << " iterations\n";
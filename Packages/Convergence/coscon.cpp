@@ -47,7 +47,6 @@ namespace po = loos::OptionsFramework::po;
 
 // @cond TOOLS_INTERNAL
 
-typedef vector<AtomicGroup>                               vGroup;
 
 
 
@@ -197,28 +196,18 @@ public:
 
 
 
-vGroup subgroup(const vGroup& A, const uint a, const uint b) {
-  vGroup B;
-
-  for (uint i=a; i<b; ++i)
-    B.push_back(A[i]);
-
-  return(B);
-}
-
-
 
 // Breaks the ensemble up into blocks and computes the RSV for each
 // block and the statistics for the cosine content...
 
 template<class ExtractPolicy>
-Datum blocker(const uint pc, vGroup& ensemble, const uint blocksize, ExtractPolicy& policy) {
+Datum blocker(const uint pc, CoordinateEnsemble& ensemble, const uint blocksize, ExtractPolicy& policy) {
 
 
   TimeSeries<double> cosines;
 
   for (uint i=0; i<ensemble.size() - blocksize; i += blocksize) {
-    vGroup subset = subgroup(ensemble, i, i+blocksize);
+    CoordinateEnsemble subset = ensemble.slice(i, i+blocksize);
     RealMatrix V = rsv(subset, policy);
 
     double val = cosineContent(V, pc);
@@ -266,7 +255,7 @@ int main(int argc, char *argv[]) {
   AtomicGroup subset = selectAtoms(model, sopts->selection);
 
 
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   readTrajectory(ensemble, subset, traj);
  
   // First, read in and align trajectory
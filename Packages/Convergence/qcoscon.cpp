@@ -138,7 +138,7 @@ int main(int argc, char *argv[]) {
     cerr << "Warning: --skip option ignored\n";
 
   AtomicGroup subset = selectAtoms(model, sopts->selection);
-  vector<AtomicGroup> ensemble;
+  CoordinateEnsemble ensemble;
   readTrajectory(ensemble, subset, traj);
  
   // Read in and align...
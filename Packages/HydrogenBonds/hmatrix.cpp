@@ -47,6 +47,7 @@ namespace opts = loos::OptionsFramework;
 double length_low, length_high;
 double max_angle;
 bool use_periodicity;
+bool binary_output;
 string donor_selection, acceptor_selection;
 string model_name;
 string traj_name;
@@ -88,6 +89,9 @@ string fullHelpMessage(void) {
     "to greater than or equal to 2.0 angstroms and less than or equal to 4.0 angstroms, with\n"
     "an angle of less than or equal to 25.0 degrees.\n"
     "\n"
+    "\tWith --binary 1, the matrix is written in LOOS' binary matrix format, which\n"
+    "is much smaller for long trajectories and is read by the same LOOS functions.\n"
+    "\n"
     "SEE ALSO\n"
     "\thbonds, hcorrelation\n";
 
@@ -104,7 +108,8 @@ public:
       ("blow", po::value<double>(&length_low)->default_value(1.5), "Low cutoff for bond length")
       ("bhi", po::value<double>(&length_high)->default_value(3.0), "High cutoff for bond length")
       ("angle", po::value<double>(&max_angle)->default_value(30.0), "Max bond angle deviation from linear")
-      ("periodic", po::value<bool>(&use_periodicity)->default_value(false), "Use periodic boundary");
+      ("periodic", po::value<bool>(&use_periodicity)->default_value(false), "Use periodic boundary")
+      ("binary", po::value<bool>(&binary_output)->default_value(false), "Write the matrix in binary format");
   }
 
   void addHidden(po::options_description& o) {
@@ -126,11 +131,12 @@ public:
 
   string print() const {
     ostringstream oss;
-    oss << boost::format("blow=%f,bhi=%f,angle=%f,periodic=%d,acceptor=\"%s\",donor=\"%s\"")
+    oss << boost::format("blow=%f,bhi=%f,angle=%f,periodic=%d,binary=%d,acceptor=\"%s\",donor=\"%s\"")
       % length_low
       % length_high
       % max_angle
       % use_periodicity
+      % binary_output
       % acceptor_selection
       % donor_selection;
 
@@ -182,6 +188,9 @@ int main(int argc, char *argv[]) {
 
   SAGroup acceptors = SimpleAtom::processSelection(acceptor_selection, model, use_periodicity);
   BondMatrix bonds = donors[0].findHydrogenBondsMatrix(acceptors, traj, model);
-  writeAsciiMatrix(cout, bonds, hdr);
+  if (binary_output)
+    writeBinaryMatrix(cout, bonds, hdr);
+  else
+    writeAsciiMatrix(cout, bonds, hdr);
 }
 
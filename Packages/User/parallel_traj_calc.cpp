@@ -0,0 +1,177 @@
+/*
+  parallel_traj_calc.cpp
+
+  (c) 2011 Tod D. Romo, Grossfield Lab
+           Department of Biochemistry
+           University of Rochster School of Medicine and Dentistry
+
+
+  C++ template for writing a tool that performs a calculation on a
+  trajectory, spreading the frames over several threads
+*/
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2011 Tod D. Romo
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+
+namespace opts = loos::OptionsFramework;
+namespace po = loos::OptionsFramework::po;
+
+
+
+// ----------------------------------------------------------------
+// ***EDIT***
+// The following code is for implementing tool-specific
+// options if the tool requires them.  If not, this section can be
+// deleted, except for the --threads option.
+
+double option1;
+int option2;
+unsigned int nthreads;
+
+
+// The following conditional prevents this class from appearing in the
+// Doxygen documentation for LOOS:
+//
+// @cond TOOLS_INTERNAL
+class ToolOptions : public opts::OptionsPackage {
+public:
+
+  // Change these options to reflect what your tool needs
+  void addGeneric(po::options_description& o) {
+    o.add_options()
+      ("option1", po::value<double>(&option1)->default_value(0.0), "Tool Option #1")
+      ("option2", po::value<int>(&option2)->default_value(42), "Tool option #2")
+      ("threads", po::value<unsigned int>(&nthreads)->default_value(0), "Number of threads to use (0 = one per core)");
+  }
+
+  // The print() function returns a string that describes what all the
+  // options are set to (for logging purposes)
+  string print() const {
+    ostringstream oss;
+    oss << boost::format("option1=%f, option2=%d, threads=%d") % option1 % option2 % nthreads;
+    return(oss.str());
+  }
+
+};
+// @endcond
+// ----------------------------------------------------------------
+
+
+// ***EDIT***
+// The calculation is written as a kernel.  Each thread gets its own
+// copy of the kernel and is handed a contiguous chunk of frames.
+// When all threads are done, the copies are merged back together in
+// frame order.  Anything the kernel accumulates (sums, histograms,
+// time series) must be stored in the kernel itself and combined in
+// merge().
+//
+// @cond TOOLS_INTERNAL
+struct Calculation : public FrameKernel {
+
+  // ***EDIT***
+  // Called for each frame, after the coordinates of the selected atoms
+  // have been updated...
+  void operator()(AtomicGroup& structure, const uint frame) {
+    values.push_back(structure.centroid().x());
+  }
+
+  // ***EDIT***
+  // Fold the results from the next chunk of frames into this one...
+  void merge(const Calculation& other) {
+    values.insert(values.end(), other.values.begin(), other.values.end());
+  }
+
+  vector<double> values;
+};
+// @endcond
+
+
+
+
+int main(int argc, char *argv[]) {
+  
+  // Store the invocation information for logging later
+  string header = invocationHeader(argc, argv);
+  
+  // Build up the command-line options for this tool by instantiating
+  // the appropriate OptionsPackage objects...
+
+  // Basic options should be used by all tools.  It provides help,
+  // verbosity, and the ability to read options from a config file
+  opts::BasicOptions* bopts = new opts::BasicOptions;
+
+  // This tool can operate on a subset of atoms.  The BasicSelection
+  // object provides the "--selection" option.
+  opts::BasicSelection* sopts = new opts::BasicSelection;
+
+  // The TrajectoryWithFrameIndices object handles specifying a
+  // trajectory along with the "--skip", "--stride", and "--range"
+  // options that pick which frames to use.
+  opts::TrajectoryWithFrameIndices* tropts = new opts::TrajectoryWithFrameIndices;
+
+  // ***EDIT***
+  // Tool-specific options can be included here...
+  ToolOptions* topts = new ToolOptions;
+
+  // ***EDIT***
+  // All of the OptionsPackages are combined via the AggregateOptions
+  // object.  First instantiate it, then add the desired
+  // OptionsPackage objects.  The order is important.  We recommend
+  // you progress from general (Basic and Selection) to more specific
+  // (model) and finally the tool options.
+  opts::AggregateOptions options;
+  options.add(bopts).add(sopts).add(tropts).add(topts);
+
+  // Parse the command-line.  If an error occurred, help will already
+  // be displayed and it will return a FALSE value.
+  if (!options.parse(argc, argv))
+    exit(-1);
+
+  // Pull the model from the options object (it will include coordinates)
+  AtomicGroup model = tropts->model;
+  
+  // Select the desired atoms to operate over...
+  AtomicGroup subset = selectAtoms(model, sopts->selection);
+
+  // Each thread opens its own copy of the trajectory, so we pass along
+  // how to open it rather than the trajectory itself (the one already
+  // opened is handed over so an XTC is not scanned again)...
+  TrajectoryOpener opener(tropts->traj_name, tropts->traj_type, model, tropts->trajectory);
+
+  // Run the calculation over the requested frames.  On return, calc
+  // holds the merged results from all threads.
+  Calculation calc;
+  frameMapReduce(opener, subset, tropts->frameList(), calc, nthreads);
+
+  // ***EDIT***
+  // Output results...
+  cout << "# " << header << endl;
+  for (uint i=0; i<calc.values.size(); ++i)
+    cout << i << "\t" << calc.values[i] << endl;
+}
@@ -0,0 +1,138 @@
+/*
+  Writes an Amber NetCDF trajectory (with velocities and a periodic
+  box), appends to it, and checks that reading it back gives the same
+  coordinates, velocities, box, and times.
+*/
+
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <loos.hpp>
+#include <cstdio>
+
+using namespace std;
+using namespace loos;
+
+
+const uint natoms = 250;
+const uint nframes = 6;
+
+// Coordinates and velocities are stored as floats
+const double tolerance = 1e-4;
+
+
+AtomicGroup makeModel() {
+  AtomicGroup model;
+  for (uint i=0; i<natoms; ++i) {
+    pAtom atom(new Atom(i+1, "CA", GCoord()));
+    atom->index(i);
+    model.append(atom);
+  }
+  return(model);
+}
+
+
+void makeFrame(AtomicGroup& model, const uint frame) {
+  for (uint i=0; i<model.size(); ++i) {
+    model[i]->coords(GCoord(i * 0.25 + frame, -1.0 * i + 0.5 * frame, 10.0 - frame * 0.125));
+    model[i]->velocities(GCoord(sin(i + frame) * 3.0, cos(0.5 * i + frame) * 2.0, 0.1 * frame - 1.0));
+  }
+  model.periodicBox(GCoord(60.0 + 0.5 * frame, 61.0, 62.0));
+}
+
+
+int main(int argc, char *argv[]) {
+  string fname = "amber_netcdf_roundtrip.nc";
+  AtomicGroup model = makeModel();
+
+  {
+    AmberNetcdfWriter out(fname);
+    for (uint i=0; i<nframes/2; ++i) {
+      makeFrame(model, i);
+      out.writeFrame(model, i, 2.0 * i);
+    }
+  }
+
+  {
+    AmberNetcdfWriter out(fname, true);
+    out.bufferOutput();
+    for (uint i=nframes/2; i<nframes; ++i) {
+      makeFrame(model, i);
+      out.writeFrame(model, i, 2.0 * i);
+    }
+  }
+
+  AtomicGroup expected = makeModel();
+  AtomicGroup frame = makeModel();
+  AmberNetcdf traj(fname, natoms);
+
+  int failures = 0;
+  if (traj.nframes() != nframes) {
+    cerr << "Expected " << nframes << " frames but found " << traj.nframes() << endl;
+    ++failures;
+  }
+  if (!traj.hasVelocities() || !traj.hasPeriodicBox()) {
+    cerr << "Velocities or periodic box are missing" << endl;
+    ++failures;
+  }
+
+  uint n = 0;
+  while (traj.readFrame()) {
+    makeFrame(expected, n);
+    traj.updateGroupCoords(frame);
+    traj.updateGroupVelocities(frame);
+
+    vector<GCoord> velocities = traj.velocities();
+    for (uint i=0; i<natoms; ++i) {
+      const Atom& a = *(frame[i]);
+      const Atom& b = *(expected[i]);
+      if (a.coords().distance(b.coords()) > tolerance
+          || a.velocities().distance(b.velocities()) > tolerance
+          || velocities[i].distance(b.velocities()) > tolerance) {
+        cerr << "Frame " << n << ", atom " << i << ": read " << a.coords() << " " << a.velocities()
+             << " but expected " << b.coords() << " " << b.velocities() << endl;
+        ++failures;
+        break;
+      }
+    }
+
+    if (frame.periodicBox().distance(expected.periodicBox()) > tolerance) {
+      cerr << "Frame " << n << ": box is " << frame.periodicBox() << " but expected " << expected.periodicBox() << endl;
+      ++failures;
+    }
+    ++n;
+  }
+
+  if (n != nframes) {
+    cerr << "Read " << n << " frames but expected " << nframes << endl;
+    ++failures;
+  }
+
+  remove(fname.c_str());
+  if (failures) {
+    cerr << "FAILED" << endl;
+    return(-1);
+  }
+  cout << "Passed" << endl;
+  return(0);
+}
@@ -0,0 +1,161 @@
+/*
+  Checks NeighborGrid-based within(), contactWith(), and pairsWithin()
+  against all-pairs searches, including targets that are narrower
+  than the cutoff.
+*/
+
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+
+
+typedef vector< pair<uint, uint> >   Pairs;
+
+
+AtomicGroup makeGroup(const vector<GCoord>& coords) {
+  AtomicGroup g;
+  for (uint i=0; i<coords.size(); ++i) {
+    pAtom atom(new Atom(i+1, "CA", coords[i]));
+    g.append(atom);
+  }
+  return(g);
+}
+
+
+// All-pairs versions of the grid queries to check against
+
+Pairs bruteForcePairs(const AtomicGroup& a, const AtomicGroup& b, const double cutoff) {
+  Pairs pairs;
+  for (uint i=0; i<a.size(); ++i)
+    for (uint j=0; j<b.size(); ++j)
+      if (a[i]->coords().distance2(b[j]->coords()) <= cutoff * cutoff)
+        pairs.push_back(pair<uint, uint>(i, j));
+  return(pairs);
+}
+
+Pairs bruteForceSelfPairs(const AtomicGroup& a, const double cutoff) {
+  Pairs pairs;
+  for (uint i=0; i<a.size(); ++i)
+    for (uint j=i+1; j<a.size(); ++j)
+      if (a[i]->coords().distance2(a[j]->coords()) <= cutoff * cutoff)
+        pairs.push_back(pair<uint, uint>(i, j));
+  return(pairs);
+}
+
+
+int check(const string& label, const AtomicGroup& probes, AtomicGroup& target, const double cutoff) {
+  int failures = 0;
+
+  Pairs expected = bruteForcePairs(probes, target, cutoff);
+  Pairs found = probes.pairsWithin(cutoff, target);
+  if (found != expected) {
+    cerr << label << ": pairsWithin(" << cutoff << ") found " << found.size() << " pairs but expected " << expected.size() << endl;
+    ++failures;
+  }
+
+  uint nclose = 0;
+  for (uint i=0; i<probes.size(); ++i)
+    for (uint j=0; j<target.size(); ++j)
+      if (probes[i]->coords().distance2(target[j]->coords()) <= cutoff * cutoff) {
+        ++nclose;
+        break;
+      }
+
+  AtomicGroup close = probes.within(cutoff, target);
+  if (close.size() != nclose) {
+    cerr << label << ": within(" << cutoff << ") found " << close.size() << " atoms but expected " << nclose << endl;
+    ++failures;
+  }
+
+  if (probes.contactWith(cutoff, target) != (nclose != 0)) {
+    cerr << label << ": contactWith(" << cutoff << ") is wrong" << endl;
+    ++failures;
+  }
+
+  AtomicGroup both;
+  both += probes;
+  both += target;
+  Pairs self_expected = bruteForceSelfPairs(both, cutoff);
+  Pairs self_found = both.pairsWithin(cutoff);
+  if (self_found != self_expected) {
+    cerr << label << ": self pairsWithin(" << cutoff << ") found " << self_found.size() << " pairs but expected " << self_expected.size() << endl;
+    ++failures;
+  }
+
+  return(failures);
+}
+
+
+int main(int argc, char *argv[]) {
+  int failures = 0;
+
+  // A single-atom target has no extent along any axis
+  vector<GCoord> c;
+  c.push_back(GCoord(0, 0, 0));
+  AtomicGroup single = makeGroup(c);
+
+  c.clear();
+  c.push_back(GCoord(3.0, 0, 0));
+  c.push_back(GCoord(0, -4.5, 0));
+  c.push_back(GCoord(5.5, 0, 0));
+  AtomicGroup probes = makeGroup(c);
+  failures += check("single atom", probes, single, 5.0);
+
+  // A target that is much shorter than the cutoff
+  c.clear();
+  c.push_back(GCoord(0, 0, 0));
+  c.push_back(GCoord(1.0, 0, 0));
+  AtomicGroup shortgrp = makeGroup(c);
+
+  c.clear();
+  c.push_back(GCoord(8.5, 0, 0));
+  c.push_back(GCoord(-7.5, 0, 0));
+  c.push_back(GCoord(0.5, 7.9, 0));
+  c.push_back(GCoord(0.5, 0, -9.0));
+  probes = makeGroup(c);
+  failures += check("short target", probes, shortgrp, 8.0);
+
+  // A larger, spread-out target around a cloud of probes
+  c.clear();
+  for (uint i=0; i<200; ++i)
+    c.push_back(GCoord(fmod(i * 7.31, 40.0), fmod(i * 3.17, 25.0), fmod(i * 1.93, 3.0)));
+  AtomicGroup slab = makeGroup(c);
+
+  c.clear();
+  for (uint i=0; i<100; ++i)
+    c.push_back(GCoord(fmod(i * 5.71, 60.0) - 10.0, fmod(i * 2.39, 45.0) - 10.0, fmod(i * 4.11, 20.0) - 8.0));
+  probes = makeGroup(c);
+  failures += check("slab", probes, slab, 4.0);
+  failures += check("slab", probes, slab, 12.0);
+
+  if (failures) {
+    cerr << "FAILED" << endl;
+    return(-1);
+  }
+  cout << "Passed" << endl;
+  return(0);
+}
@@ -0,0 +1,110 @@
+/*
+  Checks the spatial selection operators (within, around, same residue
+  as, same molecule as) on a small system with known distances.
+*/
+
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <loos.hpp>
+
+using namespace std;
+using namespace loos;
+
+
+pAtom makeAtom(const int id, const string& name, const int resid, const string& resname,
+               const string& segid, const GCoord& c) {
+  pAtom atom(new Atom(id, name, c));
+  atom->resid(resid);
+  atom->resname(resname);
+  atom->segid(segid);
+  return(atom);
+}
+
+
+// A two-atom "protein" residue at the origin followed by three waters
+// along the x-axis.  The waters are 4, 5.2, and 20 A from the CA.
+AtomicGroup makeModel() {
+  AtomicGroup model;
+
+  model.append(makeAtom(1, "CA", 1, "ALA", "PROT", GCoord(0, 0, 0)));
+  model.append(makeAtom(2, "CB", 1, "ALA", "PROT", GCoord(-1, 0, 0)));
+
+  const double x[3] = { 4.0, 5.2, 20.0 };
+  for (uint i=0; i<3; ++i) {
+    model.append(makeAtom(3 + 2*i, "OH2", 2 + i, "WAT", "BULK", GCoord(x[i], 0, 0)));
+    model.append(makeAtom(4 + 2*i, "H1", 2 + i, "WAT", "BULK", GCoord(x[i] + 0.9, 0, 0)));
+  }
+
+  for (uint i=0; i<model.size(); i += 2) {
+    model[i]->addBond(model[i+1]);
+    model[i+1]->addBond(model[i]);
+  }
+
+  return(model);
+}
+
+
+int check(AtomicGroup& model, const string& selection, const uint expected) {
+  uint n = 0;
+  try {
+    n = selectAtoms(model, selection).size();
+  }
+  catch (exception& e) {
+    cerr << "'" << selection << "' failed: " << e.what() << endl;
+    return(1);
+  }
+
+  if (n != expected) {
+    cerr << "'" << selection << "' selected " << n << " atoms but expected " << expected << endl;
+    return(1);
+  }
+  return(0);
+}
+
+
+int main(int argc, char *argv[]) {
+  AtomicGroup model = makeModel();
+  int failures = 0;
+
+  failures += check(model, "within 5 of name == 'CA'", 4);
+  failures += check(model, "within 5.5 of name == 'CA'", 5);
+  failures += check(model, "within .5 of name == 'CA'", 1);
+  failures += check(model, "around 5 of name == 'CA'", 3);
+  failures += check(model, "around 6.5 of segid == 'PROT'", 4);
+  failures += check(model, "same residue as name == 'H1'", 6);
+  failures += check(model, "same residue as (within 4.2 of name == 'CA')", 4);
+  failures += check(model, "same residue as (within 4.2 of segid == 'PROT') && segid == 'BULK'", 2);
+  failures += check(model, "same molecule as resid == 3", 2);
+  failures += check(model, "!(same molecule as resid == 3) && name == 'OH2'", 2);
+
+  // The new words are reserved, but can still be used as quoted strings
+  failures += check(model, "resname == 'as' || name == 'CA'", 1);
+
+  if (failures) {
+    cerr << "FAILED" << endl;
+    return(-1);
+  }
+  cout << "Passed" << endl;
+  return(0);
+}
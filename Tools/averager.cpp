@@ -138,6 +138,7 @@ int main(int argc, char *argv[]) {
 
   // First, align...
   vector<XForm> xforms;
+  boost::shared_ptr<SubsetCache> cache;
   if (sopts->selection.empty()) {
 
     cerr << "Skipping alignment...\n";
@@ -149,16 +150,21 @@ int main(int argc, char *argv[]) {
     AtomicGroup align_subset = selectAtoms(model, sopts->selection);
     cerr << "Aligning with " << align_subset.size() << " atoms.\n";
 
-    boost::tuple<vector<XForm>, greal, int> result = iterativeAlignment(align_subset, traj, indices);
+    cache = boost::shared_ptr<SubsetCache>(new SubsetCache(align_subset, traj, indices));
+    boost::tuple<vector<XForm>, greal, int> result = iterativeAlignment(*cache);
     xforms = boost::get<0>(result);
     double rmsd = boost::get<1>(result);
     int niters = boost::get<2>(result);
     cerr << boost::format("Aligned in %d iterations with final error of %g.\n") % niters % rmsd;
   }
 
-  // Now re-read the average subset
+  // Now re-read the average subset (unless it is what was cached for aligning)
   cerr << "Averaging...\n";
-  AtomicGroup avg = averageStructure(avg_subset, xforms, traj, indices);
+  AtomicGroup avg;
+  if (cache && cache->matches(avg_subset))
+    avg = averageStructure(avg_subset, xforms, *cache);
+  else
+    avg = averageStructure(avg_subset, xforms, traj, indices);
   PDB avgpdb = PDB::fromAtomicGroup(avg);
   avgpdb.pruneBonds();
   avgpdb.remarks().add(header);
@@ -60,6 +60,14 @@ string fullHelpMessage(void) {
     "that big-svd cannot align the trajectory prior to computing the SVD.  It assumes that\n"
     "the input trajectory is already aligned.\n"
     "\n"
+    "\tThe trajectory is read twice: once to accumulate the covariance of the\n"
+    "selection one frame at a time, and once to project each frame onto the\n"
+    "modes.  Only the covariance (3N x 3N) and the right singular vectors are\n"
+    "held in memory, never the trajectory itself.  The covariance is kept in\n"
+    "double precision.  With --float 1, it is kept in single precision instead,\n"
+    "which halves the memory needed at the cost of an extra pass through the\n"
+    "trajectory (to find the average first) and of some precision.\n"
+    "\n"
     "EXAMPLES\n"
     "\n"
     "\tbig-svd --prefix b2ar b2ar.pdb b2ar.dcd\n"
@@ -75,6 +83,10 @@ string fullHelpMessage(void) {
     "Computes an SVD using all non-hydrogen atoms.  The source matrix (trajectory)\n"
     "is written as b2ar_A.asc"
     "\n"
+    "\tbig-svd --prefix b2ar --binary 1 b2ar.pdb b2ar.dcd\n"
+    "As the first example, but the matrices are written in LOOS' binary matrix\n"
+    "format (b2ar_U.bin, etc), which is much faster to write and read back.\n"
+    "\n"
     "\n"
     "SEE ALSO\n"
     "\tsvd, kurskew, phase-pdb\n";
@@ -86,9 +98,9 @@ string fullHelpMessage(void) {
 struct TrackStorage {
   TrackStorage() : storage(0) { }
   
-  void allocate(ulong n) {
+  void allocate(ulong n, const ulong size = sizeof(float)) {
 
-    n *= sizeof(float);
+    n *= size;
     storage += n;
     cerr << boost::format("Allocated %s for a total of %s memory\n")
       % memory(n)
@@ -128,29 +140,48 @@ struct TrackStorage {
 
 class ToolOptions : public opts::OptionsPackage {
 public:
-  ToolOptions() : write_source_matrix(false) { }
+  ToolOptions() : write_source_matrix(false), binary(false), single(false) { }
 
   void addGeneric(po::options_description& o) {
     o.add_options()
       ("source", po::value<bool>(&write_source_matrix)->default_value(write_source_matrix), "Write out source matrix")
-      ("rsv", po::value<uint>(&subset_rsv)->default_value(0), "Only write out n-columns or RSV (0 = all)");
+      ("rsv", po::value<uint>(&subset_rsv)->default_value(0), "Only write out n-columns or RSV (0 = all)")
+      ("binary", po::value<bool>(&binary)->default_value(binary), "Write matrices in binary format")
+      ("float", po::value<bool>(&single)->default_value(single), "Use a single precision covariance (half the memory)");
   }
 
   string print() const {
     ostringstream oss;
-    oss << boost::format("source=%d") % write_source_matrix;
+    oss << boost::format("source=%d,binary=%d,float=%d") % write_source_matrix % binary % single;
     return(oss.str());
   }
 
   bool write_source_matrix;
   uint subset_rsv;
-  
+  bool binary;
+  bool single;
 };
+
+
+template<class M>
+void writeMatrix(const string& name, const M& A, const string& hdr, const bool binary, const bool trans = false) {
+  if (binary)
+    writeBinaryMatrix(name + ".bin", A, hdr, trans);
+  else
+    writeAsciiMatrix(name + ".asc", A, hdr, trans);
+}
+
 // @endcond
 
 
 
 
+void readFrame(pTraj& traj, const uint frame) {
+  if (!traj->readFrame(frame)) {
+    cerr << "Could not read frame " << frame << " from trajectory " << traj->filename() << endl;
+    exit(-2);
+  }
+}
 
 
 
@@ -162,7 +193,7 @@ RealMatrix extractCoordinates(pTraj& traj, AtomicGroup& grp, const vector<uint>&
   vector<double> avg(m, 0.0);
 
   for (uint i=0; i<n; ++i) {
-    traj->readFrame(indices[i]);
+    readFrame(traj, indices[i]);
     traj->updateGroupCoords(grp);
     for (uint j=0; j<static_cast<uint>(grp.size()); ++j) {
       GCoord c = grp[j]->coords();
@@ -207,64 +238,79 @@ void writeMap(const string& fname, const AtomicGroup& grp) {
 }
 
 
-void normalizeRows(RealMatrix& A) {
-  for (uint j=0; j<A.rows(); ++j) {
-    double sum = 0.0;
-    for (uint i=0; i<A.cols(); ++i)
-      sum += A(j, i) * A(j, i);
-
-    sum = sqrt(sum);
-    for (uint i=0; i<A.cols(); ++i)
-      A(j, i) /= sum;
+// Copies the coordinates of the given frames, less the average, into
+// the first columns of X
+
+template<class M>
+void centeredBlock(pTraj& traj, AtomicGroup& grp, const CoordinatePlan& plan, const vector<uint>& frames,
+                   const vector<double>& avg, M& X) {
+  for (uint c=0; c<frames.size(); ++c) {
+    readFrame(traj, frames[c]);
+    traj->updateGroupCoords(grp, plan);
+    for (uint j=0; j<grp.size(); ++j) {
+      GCoord x = grp[j]->coords();
+      X(3*j, c) = x.x() - avg[3*j];
+      X(3*j+1, c) = x.y() - avg[3*j+1];
+      X(3*j+2, c) = x.z() - avg[3*j+2];
+    }
   }
 }
 
 
-int main(int argc, char *argv[]) {
+// Single precision AA', found without ever holding A: the average
+// is found first, then the centered frames are folded in a block at a
+// time
 
-  string hdr = invocationHeader(argc, argv);
-  
-  opts::BasicOptions* bopts = new opts::BasicOptions(fullHelpMessage());
-  opts::BasicSelection* sopts = new opts::BasicSelection("name == 'CA'");
-  opts::OutputPrefix* popts = new opts::OutputPrefix;
-  opts::TrajectoryWithFrameIndices* tropts = new opts::TrajectoryWithFrameIndices;
-  ToolOptions* topts = new ToolOptions;
-
-  opts::AggregateOptions options;
-  options.add(bopts).add(sopts).add(popts).add(tropts).add(topts);
-  if (!options.parse(argc, argv))
-    exit(-1);
-
-  TrackStorage store;
-
-  AtomicGroup model = tropts->model;
-  AtomicGroup subset = selectAtoms(model, sopts->selection);
-  pTraj traj = tropts->trajectory;
-
-  string prefix = popts->prefix;
-  vector<uint> indices = tropts->frameList();
-
-  writeMap(prefix + ".map", subset);
+RealMatrix singleCovariance(pTraj& traj, AtomicGroup& grp, const CoordinatePlan& plan, const vector<uint>& indices,
+                            vector<double>& avg) {
+  f77int m = grp.size() * 3;
+  uint n = indices.size();
 
-  // Build AA'
+  avg.assign(m, 0.0);
+  for (uint i=0; i<n; ++i) {
+    readFrame(traj, indices[i]);
+    traj->updateGroupCoords(grp, plan);
+    for (uint j=0; j<grp.size(); ++j) {
+      GCoord x = grp[j]->coords();
+      avg[3*j] += x.x();
+      avg[3*j+1] += x.y();
+      avg[3*j+2] += x.z();
+    }
+  }
+  for (f77int j=0; j<m; ++j)
+    avg[j] /= n;
 
-  RealMatrix A = extractCoordinates(traj, subset, indices);
-  cerr << boost::format("Coordinate matrix is %d x %d\n") % A.rows() % A.cols();
-  store.allocate(A.rows() * A.cols());
-  if (topts->write_source_matrix)
-    writeAsciiMatrix(prefix + "_A.asc", A, hdr);
+  RealMatrix C(m, m);
+  const uint block = 256;
+  RealMatrix X(m, block);
+  for (uint first = 0; first < n; first += block) {
+    f77int nb = min(block, n - first);
+    vector<uint> frames(indices.begin() + first, indices.begin() + first + nb);
+    centeredBlock(traj, grp, plan, frames, avg, X);
+
+    // C += X * X'
+    float alpha = 1.0;
+    float beta = 1.0;
+#if defined(__linux__) || defined(__CYGWIN__) || defined(__FreeBSD__)
+    char ta = 'N';
+    char tb = 'T';
+    sgemm_(&ta, &tb, &m, &m, &nb, &alpha, X.get(), &m, X.get(), &m, &beta, C.get(), &m);
+#else
+    cblas_sgemm(CblasColMajor, CblasNoTrans, CblasTrans, m, m, nb, alpha, X.get(), m, X.get(), m, beta, C.get(), m);
+#endif
+  }
 
+  return(C);
+}
 
-  store.allocate(A.rows() * A.rows());
-  cerr << "Multiplying transpose...\n";
-  RealMatrix C = MMMultiply(A, A, false, true);
-  cerr << "Done!\n";
 
-  // Compute [U,D] = eig(C)
+// In-place eigendecomposition of the single precision AA' (the
+// eigenvectors replace C), returning the singular values of A
 
+RealMatrix singleEigenDecomp(RealMatrix& C, TrackStorage& store) {
   char jobz = 'V';
   char uplo = 'L';
-  f77int n = A.rows();
+  f77int n = C.rows();
   f77int lda = n;
   float dummy;
   RealMatrix W(n, 1);
@@ -278,7 +324,7 @@ int main(int argc, char *argv[]) {
       cerr << boost::format("ssyev failed with info = %d\n") % info;
       exit(-10);
   }
-   
+
   lwork = static_cast<f77int>(dummy);
   store.allocate(lwork);
   float *work = new float[lwork+1];
@@ -289,46 +335,181 @@ int main(int argc, char *argv[]) {
       cerr << boost::format("ssyev failed with info = %d\n") % info;
       exit(-10);
   }
-  cerr << "Finished!\n";
-  
+  delete[] work;
+  store.free(lwork);
+
   reverseColumns(C);
-  cerr << "Writing LSVs...";
-  writeAsciiMatrix(prefix + "_U.asc", C, hdr);
-  cerr << "done.\n";
+  reverseRows(W);
 
   // D = sqrt(D);  Scale eigenvalues...
   for (uint j=0; j<W.rows(); ++j)
     W[j] = W[j] < 0 ? 0.0 : sqrt(W[j]);
 
-  reverseRows(W);
-  writeAsciiMatrix(prefix + "_s.asc", W, hdr);
+  return(W);
+}
+
+
+// V' = inv(D) * U' * A, a block of frames at a time (this is another
+// pass through the trajectory).  Only the first k singular vectors
+// are found.
 
-  // Multiply eigenvectors by inverse eigenvalues
-  for (uint i=0; i<C.cols(); ++i) {
+template<class M>
+RealMatrix projectFrames(pTraj& traj, AtomicGroup& grp, const CoordinatePlan& plan, const vector<uint>& indices,
+                         const vector<double>& avg, const M& U, const M& W, const uint k) {
+  uint m = U.rows();
+  uint n = indices.size();
+
+  M Us(m, k);
+  for (uint i=0; i<k; ++i) {
     double konst = (W[i] > 0.0) ? (1.0/W[i]) : 0.0;
+    for (uint j=0; j<m; ++j)
+      Us(j, i) = U(j, i) * konst;
+  }
 
-    for (uint j=0; j<C.rows(); ++j)
-      C(j, i) *= konst;
+  RealMatrix Vt(k, n);
+  const uint block = 256;
+  M X(m, block);
+  for (uint first = 0; first < n; first += block) {
+    uint nb = min(block, n - first);
+    vector<uint> frames(indices.begin() + first, indices.begin() + first + nb);
+    centeredBlock(traj, grp, plan, frames, avg, X);
+
+    M Z = MMMultiply(Us, X, true, false);
+    for (uint c=0; c<nb; ++c)
+      for (uint i=0; i<k; ++i)
+        Vt(i, first + c) = Z(i, c);
   }
 
-  W.reset();
-  store.free(W.rows() * W.cols());
+  return(Vt);
+}
 
-  store.allocate(A.cols() * A.rows());
-  cerr << "Multiplying to get RSVs...\n";
-  RealMatrix Vt = MMMultiply(C, A, true, false);
-  cerr << "Done!\n";
-  C.reset();
-  A.reset();
 
-  cerr << "Writing RSVs...";
-  if (topts->subset_rsv) {
-    RealMatrix Vts = submatrix(Vt, loos::Math::Range(0, topts->subset_rsv), loos::Math::Range(0, Vt.cols()));
-    Vt=Vts;
+
+void normalizeRows(RealMatrix& A) {
+  for (uint j=0; j<A.rows(); ++j) {
+    double sum = 0.0;
+    for (uint i=0; i<A.cols(); ++i)
+      sum += A(j, i) * A(j, i);
+
+    sum = sqrt(sum);
+    for (uint i=0; i<A.cols(); ++i)
+      A(j, i) /= sum;
   }
+}
+
+
+int main(int argc, char *argv[]) {
+
+  string hdr = invocationHeader(argc, argv);
   
-  writeAsciiMatrix(prefix + "_V.asc", Vt, hdr, true);
-  cerr << "done.\n";
-  
+  opts::BasicOptions* bopts = new opts::BasicOptions(fullHelpMessage());
+  opts::BasicSelection* sopts = new opts::BasicSelection("name == 'CA'");
+  opts::OutputPrefix* popts = new opts::OutputPrefix;
+  opts::TrajectoryWithFrameIndices* tropts = new opts::TrajectoryWithFrameIndices;
+  ToolOptions* topts = new ToolOptions;
 
+  opts::AggregateOptions options;
+  options.add(bopts).add(sopts).add(popts).add(tropts).add(topts);
+  if (!options.parse(argc, argv))
+    exit(-1);
+
+  TrackStorage store;
+
+  AtomicGroup model = tropts->model;
+  AtomicGroup subset = selectAtoms(model, sopts->selection);
+  pTraj traj = tropts->trajectory;
+
+  string prefix = popts->prefix;
+  vector<uint> indices = tropts->frameList();
+
+  writeMap(prefix + ".map", subset);
+
+  // Accumulate AA' a frame at a time, so A itself is never held
+  // (unless it is to be written out)
+
+  uint m = subset.size() * 3;
+  uint n = indices.size();
+  cerr << boost::format("Coordinate matrix is %d x %d\n") % m % n;
+
+  if (topts->write_source_matrix) {
+    store.allocate(static_cast<ulong>(m) * n);
+    RealMatrix A = extractCoordinates(traj, subset, indices);
+    writeMatrix(prefix + "_A", A, hdr, topts->binary);
+    store.free(static_cast<ulong>(m) * n);
+  }
+
+  uint k = m;
+  if (topts->subset_rsv && topts->subset_rsv < m)
+    k = topts->subset_rsv;
+
+  CoordinatePlan plan(subset);
+  RealMatrix Vt;
+
+  if (topts->single) {
+
+    store.allocate(static_cast<ulong>(m) * m);
+    cerr << "Accumulating covariance...\n";
+    vector<double> avg;
+    RealMatrix C = singleCovariance(traj, subset, plan, indices, avg);
+    cerr << "Done!\n";
+
+    RealMatrix W = singleEigenDecomp(C, store);
+    cerr << "Finished!\n";
+
+    cerr << "Writing LSVs...";
+    writeMatrix(prefix + "_U", C, hdr, topts->binary);
+    cerr << "done.\n";
+    writeMatrix(prefix + "_s", W, hdr, topts->binary);
+
+    store.allocate(static_cast<ulong>(k) * n);
+    cerr << "Projecting frames to get RSVs...\n";
+    Vt = projectFrames(traj, subset, plan, indices, avg, C, W, k);
+    cerr << "Done!\n";
+
+  } else {
+
+    // The eigendecomposition reuses the accumulator's covariance, so
+    // only one 3N x 3N matrix is held.  The accumulator goes away
+    // before projecting, keeping just the mean.
+    store.allocate(static_cast<ulong>(m) * m, sizeof(double));
+    vector<double> avg;
+    DoubleMatrix W, C;
+    {
+      CovarianceAccumulator acc(subset.size(), true);
+      cerr << "Accumulating covariance...\n";
+      for (vector<uint>::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+        readFrame(traj, *i);
+        traj->updateGroupCoords(subset, plan);
+        acc.add(subset);
+      }
+      cerr << "Done!\n";
+
+      // Compute [U,D] = eig(C).  The accumulator's covariance is AA'/n,
+      // so the singular values of A are sqrt(n * D)
+
+      avg = acc.mean();
+      cerr << "Calculating eigendecomposition...\n";
+      boost::tuple<DoubleMatrix, DoubleMatrix> eig = acc.releaseEigenDecomp();
+      W = boost::get<0>(eig);
+      C = boost::get<1>(eig);
+      cerr << "Finished!\n";
+    }
+
+    cerr << "Writing LSVs...";
+    writeMatrix(prefix + "_U", C, hdr, topts->binary);
+    cerr << "done.\n";
+
+    for (uint j=0; j<W.rows(); ++j)
+      W[j] = sqrt(W[j] * n);
+    writeMatrix(prefix + "_s", W, hdr, topts->binary);
+
+    store.allocate(static_cast<ulong>(k) * n);
+    cerr << "Projecting frames to get RSVs...\n";
+    Vt = projectFrames(traj, subset, plan, indices, avg, C, W, k);
+    cerr << "Done!\n";
+  }
+
+  cerr << "Writing RSVs...";
+  writeMatrix(prefix + "_V", Vt, hdr, topts->binary, true);
+  cerr << "done.\n";
 }
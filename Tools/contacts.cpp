@@ -67,6 +67,9 @@ string fullHelpMessage(void)
    "In this case, that means that since there's 1 protein, the second and \n"
    "third columns will be the same, while the fourth column will be the \n"
    "second column divided by the number of lipids selected.\n"
+   "\n"
+   "An optional sixth argument splits the frames over that many threads\n"
+   "(the default is 1, and 0 means one per core).\n"
    "\n"
         ;
     return(s);
@@ -74,9 +77,66 @@ string fullHelpMessage(void)
 
 
 
+// Number of contacts in each frame, filled by frameMapReduce().  Each
+// worker splits its own copy of the model into groups in setup().
+struct ContactCounter : public FrameKernel
+    {
+    ContactCounter(const string& sel1, const string& sel2, const double max)
+        : selection1(sel1), selection2(sel2), max2(max*max)
+        {
+        }
+
+    void setup(AtomicGroup& model)
+        {
+        group1 = selectAtoms(model, selection1).splitByUniqueSegid();
+        group2 = selectAtoms(model, selection2).splitByUniqueSegid();
+        }
+
+    void operator()(AtomicGroup& model, const uint)
+        {
+        int count = 0;
+
+        // compute the number of contacts between group1 center of mass 
+        // and group2 center of mass
+        vector<AtomicGroup>::iterator first;
+        for (first=group1.begin(); first!=group1.end(); first++)
+            {
+            GCoord com1 = first->centerOfMass();
+
+            vector<AtomicGroup>::iterator second;
+            for (second=group2.begin(); second!=group2.end(); second++)
+                {
+                // exclude self pairs 
+                if (*first == *second)
+                    continue;
+
+                GCoord com2 = second->centerOfMass();
+
+                double d2 = com1.distance2(com2, model.periodicBox());
+                if ( (d2 <= max2) )
+                    {
+                    count++;
+                    }
+                }
+            }
+        counts.push_back(count);
+        }
+
+    void merge(const ContactCounter& other)
+        {
+        counts.insert(counts.end(), other.counts.begin(), other.counts.end());
+        }
+
+    string selection1, selection2;
+    double max2;
+    vector<AtomicGroup> group1, group2;
+    vector<int> counts;
+    };
+
+
 void Usage()
     {
-    cerr << "Usage: contacts model trajectory selection1 selection_2 max" 
+    cerr << "Usage: contacts model trajectory selection1 selection_2 max [threads]" 
          << endl;
     }
 
@@ -109,69 +169,42 @@ if (argc < 6)
   string selection1(argv[3]);
   string selection2(argv[4]);
   double max = strtod(argv[5], 0);
-  double max2 = max*max;
+  uint nthreads = 1;
+  if (argc >= 7)
+    nthreads = atoi(argv[6]);
 
   AtomicGroup model = createSystem(model_filename);
   pTraj traj = createTrajectory(traj_filename, model);
 
-
   // The assumption here is that selection1 will specify a bunch of molecules,
-  // eg, all lipid headgroups of type foo.  g1 will be the group containing all
-  // of those atoms.  However, what we'll actually want to do is work with the 
-  // individual molecules' centers of mass, so we'll split g1 into a vector of
-  // individual segids (corresponding to individual lipids) called group1
-  AtomicGroup g1 = selectAtoms(model, selection1);
-  vector<AtomicGroup> group1 = g1.splitByUniqueSegid();
-
-  // g2 / group2 works the same way
-  AtomicGroup g2 = selectAtoms(model, selection2);
-  vector<AtomicGroup> group2 = g2.splitByUniqueSegid();
-
-
+  // eg, all lipid headgroups of type foo.  Each worker selects these from its
+  // own copy of the model.  However, what we'll actually want to do is work
+  // with the individual molecules' centers of mass, so the selection is
+  // split into individual segids (corresponding to individual lipids).
+  // selection2 works the same way.
+  vector<uint> frames;
+  for (uint i=0; i<traj->nframes(); ++i)
+    frames.push_back(i);
+
+  ContactCounter contacts(selection1, selection2, max);
+  frameMapReduce(TrajectoryOpener(traj_filename, model, traj), model, frames, contacts, nthreads);
+
+  // The group counts are the same for every worker
+  uint ngroup1 = selectAtoms(model, selection1).splitByUniqueSegid().size();
+  uint ngroup2 = selectAtoms(model, selection2).splitByUniqueSegid().size();
 
   cout << "#Frame\tPairs\tPerGroup1\tPerGroup2" << endl;
 
-  // loop over the frames of the dcd file
-  int frame = 0;
-  while (traj->readFrame())
+  for (uint frame=0; frame<contacts.counts.size(); ++frame)
     {
-      // get the new coordinates
-      traj->updateGroupCoords(model);
-      int count = 0;
-
-      // compute the number of contacts between group1 center of mass 
-      // and group2 center of mass
-      vector<AtomicGroup>::iterator first;
-      for (first=group1.begin(); first!=group1.end(); first++)
-        {
-      GCoord com1 = first->centerOfMass();
+      int count = contacts.counts[frame];
 
-      vector<AtomicGroup>::iterator second;
-      for (second=group2.begin(); second!=group2.end(); second++)
-            {
-          // exclude self pairs 
-          if (*first == *second)
-                continue;
-
-          GCoord com2 = second->centerOfMass();
-
-          double d2 = com1.distance2(com2, model.periodicBox());
-          if ( (d2 <= max2) )
-                {
-                count++;
-                }
-            }
-        }
-    
       // Output the results
-      double per_g1_atom = (double)count / group1.size();
-      double per_g2_atom = (double)count / group2.size();
+      double per_g1_atom = (double)count / ngroup1;
+      double per_g2_atom = (double)count / ngroup2;
       cout << frame << "\t" 
        << count << "\t"
        << per_g1_atom << "\t"
        << per_g2_atom << endl;
-
-      frame++;
     }
 }
-
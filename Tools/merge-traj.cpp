@@ -453,12 +453,18 @@ int main(int argc, char *argv[])
       }
 
     pTrajectoryWriter output = createOutputTrajectory(output_traj, true);
+    output->bufferOutput();
+    output->useThreads();
+    output = pTrajectoryWriter(new AsyncTrajectoryWriter(output));
 
     pTrajectoryWriter output_downsample;
     bool do_downsample = (output_traj_downsample.length() > 0);
     if (do_downsample)
         {
         output_downsample = createOutputTrajectory(output_traj_downsample, true);
+        output_downsample->bufferOutput();
+        output_downsample->useThreads();
+        output_downsample = pTrajectoryWriter(new AsyncTrajectoryWriter(output_downsample));
         }
 
     // Set up to do the recentering
@@ -31,15 +31,12 @@
 
 #include <loos.hpp>
 #include <unistd.h>
-#include <boost/thread/thread.hpp>
 
 
 using namespace std;
 using namespace loos;
 
 
-typedef boost::thread*   Thread;
-
 namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
 
@@ -150,168 +147,6 @@ typedef vector<vecDouble>   vMatrix;
 
 // --------------------------------------------------------------------------------------
 
-// Parcels out work to the compute threads...  Work is given to the threads
-// one row at a time.
-
-class Master {
-public:
-
-  Master(const uint nr, const bool tr, const bool b) : _toprow(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
-                                                       _verbose(b), _start_time(time(0))
-  {
-    if (_triangle)
-      _total = _maxrow*(_maxrow-1) / 2;
-    else
-      _total = _maxrow;
-  }
-
-  // Checks whether there are any columns left to work on
-  // and places the column index into the passed pointer.
-
-  bool workAvailable(uint* ip) 
-  {
-
-    _mtx.lock();
-    if (_toprow >= _maxrow) {
-      _mtx.unlock();
-      return(false);
-    }
-    *ip = _toprow++;
-
-    if (_verbose)
-      if (_toprow % _updatefreq == 0)
-        updateStatus();
-    
-    _mtx.unlock();
-    return(true);
-  }
-
-
-  void updateStatus() {
-    time_t dt = elapsedTime();
-    uint work_done = _triangle ? (_toprow * (_toprow-1) / 2) : (_toprow);
-    uint work_left = _total - work_done;
-    uint d = work_left * dt / work_done;    // rate = work_done / dt;  d = work_left / rate;
-    
-    uint hrs = d / 3600;
-    uint remain = d % 3600;
-    uint mins = remain / 60;
-    uint secs = remain % 60;
-    
-    cerr << boost::format("Row %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
-      % _toprow % _maxrow % dt % hrs % mins % secs;
-  }
-
-
-  
-  time_t elapsedTime() const 
-  {
-    return (time(0) - _start_time);
-  }
-
-
-private:
-  uint _toprow, _maxrow;
-  uint _updatefreq;
-  bool _triangle;
-  bool _verbose;
-  time_t _start_time;
-  uint _total;
-  boost::mutex _mtx;
-
-};
-
-
-
-
-
-
-/*
-  Worker thread processes a column of the all-to-all matrix.  Gets which
-  column to work on from the associated Master object.
-*/
-
-
-// Worker for self all-to-all
-
-class SingleWorker 
-{
-public:
-  SingleWorker(RealMatrix* R, vMatrix* T, Master* M) : _R(R), _T(T), _M(M) { }
-
-
-  SingleWorker(const SingleWorker& w) 
-  {
-    _R = w._R;
-    _T = w._T;
-    _M = w._M;
-  }
-  
-
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<i; ++j) {
-      double d = loos::alignment::centeredRMSD((*_T)[i], (*_T)[j]);
-      (*_R)(j, i) = (*_R)(i, j) = d;
-    }
-  }
-
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
-  }
-  
-
-private:
-  RealMatrix* _R;
-  vMatrix* _T;
-  Master* _M;
-};
-
-
-
-// Top level object/interface.  Will create np Worker threads, cloned from the
-// one passed into the constructor.
-
-template<class W>
-class Threader 
-{
-public:
-  Threader(W* wrkr, const uint np) :
-    worker(wrkr),
-    threads(vector<Thread>(np))
-  {
-
-    for (uint i=0; i<np; ++i) {
-      W w(*worker);
-      threads[i] = new boost::thread(w);
-    }
-    
-  }
-
-
-  void join() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      threads[i]->join();
-  }
-  
-
-  ~Threader() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      delete threads[i];
-  }
-
-  W* worker;
-  vector<Thread> threads;
-};
-
-
-// --------------------------------------------------------------------------------------
 
 
 void showStatsHalf(const RealMatrix& R) {
@@ -331,13 +166,6 @@ void showStatsHalf(const RealMatrix& R) {
 }
 
 
-void centerTrajectory(alignment::vecMatrix& U) {
-  for (uint i=0; i<U.size(); ++i)
-    alignment::centerAtOrigin(U[i]);
-}
-
-
-
 void checkMemoryUsage(long mem) {
   if (!mem)
     return;
@@ -382,27 +210,22 @@ int main(int argc, char *argv[]) {
   vector<uint> indices = mtopts->frameList();
 
   long mem = availableMemory();
-  uint nthreads = topts->nthreads ? topts->nthreads : boost::thread::hardware_concurrency();
-
-  if (verbosity > 1)
-    cerr << "Using " << nthreads << " threads\n";
 
   vMatrix T = readCoords(subset, traj, indices, verbosity > 1);
   used_memory += T.size() * T[0].size() * sizeof(vMatrix::value_type::value_type);   // Coords matrix
   used_memory += T.size() * T.size() * sizeof(RealMatrix::element_type);             // RMSDS matrix
   checkMemoryUsage(mem);
-  centerTrajectory(T);
-
-  RealMatrix M;
-  if (verbosity > 1)
-    cerr << "Calculating RMSD...\n";
-  M = RealMatrix(T.size(), T.size());
-  Master master(T.size(), true, verbosity);
-  SingleWorker worker(&M, &T, &master);
-  Threader<SingleWorker> threads(&worker, nthreads);
-  threads.join();
-  if (verbosity)
-    master.updateStatus();
+
+  PairwiseRMSD engine(T);
+  vMatrix().swap(T);
+  engine.threads(topts->nthreads);
+  engine.verbose(verbosity);
+
+  if (verbosity > 1) {
+    cerr << "Using " << engine.threads() << " threads\n";
+    cerr << "Calculating RMSD (" << PairwiseRMSD::simdName(engine.simd()) << ")...\n";
+  }
+  RealMatrix M = engine.compute();
 
   if (verbosity || topts->noop || topts->stats)
     showStatsHalf(M);
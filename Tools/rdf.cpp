@@ -216,6 +216,7 @@ uint doSplit(const AtomicGroup &system, const string selection,
         }
 
     Parser parser(selection);
+    parser.kernel().prepare(system);
     KernelSelector parsed_sel(parser.kernel());
 
     vector<AtomicGroup>::iterator t;
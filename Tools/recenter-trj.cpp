@@ -113,6 +113,8 @@ else if ( (flag == "XY") || (flag == "xy"))
 
 pTrajectoryWriter traj_out = createOutputTrajectory(argv[5]);
 traj_out->setComments(invocationHeader(argc, argv));
+traj_out->bufferOutput();
+traj_out = pTrajectoryWriter(new AsyncTrajectoryWriter(traj_out));
 
 if (!model.hasBonds())
     {
@@ -75,6 +75,10 @@ string fullHelpMessage(void) {
     "This example defines a contact when the centers of mass between two residues is less than\n"
     "or equal two 6.5 Angstroms.  Only the first 100 residues are used.\n"
     "\n"
+    "\tresidue-contact-map --binary 1 model.pdb simulation.dcd 4.0 >contacts.bin\n"
+    "Writes the contact map in LOOS' binary matrix format.  Since the map is\n"
+    "symmetric, only the lower triangle is stored.\n"
+    "\n"
     "SEE ALSO\n"
     "\trmsds\n";
 
@@ -86,22 +90,25 @@ string fullHelpMessage(void) {
 class ToolOptions : public opts::OptionsPackage {
 public:
   ToolOptions() :
-    use_centers(false)
+    use_centers(false),
+    binary(false)
   { }
 
   void addGeneric(po::options_description& o) {
     o.add_options()
-      ("centers", po::value<bool>(&use_centers)->default_value(false), "Use center of mass of residues for distance");
+      ("centers", po::value<bool>(&use_centers)->default_value(false), "Use center of mass of residues for distance")
+      ("binary", po::value<bool>(&binary)->default_value(false), "Write the matrix in binary format");
   }
 
   string print() const {
     ostringstream oss;
 
-    oss << "centers=" << use_centers;
+    oss << "centers=" << use_centers << ",binary=" << binary;
     return(oss.str());
   }
 
   bool use_centers;
+  bool binary;
 };
 // @endcond
 
@@ -187,5 +194,8 @@ int main(int argc, char *argv[]) {
   for (ulong i=0; i<residues.size() * residues.size(); ++i)
     M[i] /= indices.size();
 
-  writeAsciiMatrix(cout, M, hdr);
+  if (topts->binary)
+    writeBinarySymmetricMatrix(cout, M, hdr);
+  else
+    writeAsciiMatrix(cout, M, hdr);
 }
@@ -37,9 +37,11 @@ using namespace loos;
 string fullHelpMessage()
     {
 string s =
-    "Usage: rgyr SystemFile Trajectory selection min max num_bins skip [by-molecule]\n" 
+    "Usage: rgyr SystemFile Trajectory selection min max num_bins skip [by-molecule [threads]]\n" 
     "\tby-molecule should be one if you want the selection\n"
     "\tbroken up based on connectivity, and 0 or absent otherwise.\n"
+    "\tthreads is the number of threads to split the frames over\n"
+    "\t(default is 1, 0 means one per core).\n"
     "\n"
     "\n"
     "SYNOPSIS\n"
@@ -78,6 +80,81 @@ string s =
 return(s);
     }
 
+
+// Histogram of the radii of gyration, filled by frameMapReduce().
+// Each worker makes its own selections from its own copy of the
+// system in setup().
+struct RgyrHistogram : public FrameKernel
+{
+RgyrHistogram(const string& sel, const bool split, const greal lo, const greal hi, const int nbins)
+    : selection(sel), split_by_molecule(split), hist_min(lo), hist_max(hi),
+      bin_width((hi - lo)/nbins), hist(nbins, 0.0), count(0)
+    {
+    }
+
+void setup(AtomicGroup& system)
+    {
+    vector<AtomicGroup> molecules;
+    if (split_by_molecule)
+        {
+        molecules = system.splitByMolecule();
+        }
+    else
+        {
+        molecules.push_back(system);
+        }
+
+    // Set up the selector to define the selected group
+    Parser parser(selection);
+    parser.kernel().prepare(system);
+    KernelSelector parsed_sel(parser.kernel());
+
+    // Loop over the molecules and add them to selection
+    molecule_groups.clear();
+    vector<AtomicGroup>::iterator m;
+    for (m=molecules.begin(); m!=molecules.end(); m++)
+        {
+        AtomicGroup tmp = m->select(parsed_sel);
+        if (tmp.size() > 0)
+            {
+            molecule_groups.push_back(tmp);
+            }
+        }
+    }
+
+void operator()(AtomicGroup&, const uint)
+    {
+    vector<AtomicGroup>::iterator m;
+    for (m=molecule_groups.begin(); m!=molecule_groups.end(); m++)
+        {
+        greal rad = m->radiusOfGyration();
+        if ( (rad >=hist_min) && (rad <hist_max) )
+            {
+            int bin = int((rad-hist_min)/bin_width);
+            hist[bin]++;
+            count++;
+            }
+        }
+    }
+
+void merge(const RgyrHistogram& other)
+    {
+    for (uint i=0; i<hist.size(); i++)
+        {
+        hist[i] += other.hist[i];
+        }
+    count += other.count;
+    }
+
+string selection;
+bool split_by_molecule;
+greal hist_min, hist_max, bin_width;
+vector<AtomicGroup> molecule_groups;
+vector<greal> hist;
+int count;
+};
+
+
 int main (int argc, char *argv[])
 {
 if ( (argc <= 1) || 
@@ -112,74 +189,29 @@ if (argc >= 9)
     split_by_molecule = atoi(argv[8]);
     }
 
-greal bin_width = (hist_max - hist_min)/num_bins;
-
-
-
-vector<AtomicGroup> molecules;
-if (split_by_molecule)
-    {
-    molecules = system.splitByMolecule();
-    }
-else
+uint nthreads = 1;
+if (argc >= 10)
     {
-    molecules.push_back(system);
+    nthreads = atoi(argv[9]);
     }
 
-// Set up the selector to define the selected group
-Parser parser(selection);
-KernelSelector parsed_sel(parser.kernel());
-
-
-// Loop over the molecules and add them to selection
-vector<AtomicGroup> molecule_groups;
-vector<AtomicGroup>::iterator m;
-for (m=molecules.begin(); m!=molecules.end(); m++)
-    {
-    AtomicGroup tmp = m->select(parsed_sel);
-    if (tmp.size() > 0)
-        {
-        molecule_groups.push_back(tmp);
-        }
-    }
+greal bin_width = (hist_max - hist_min)/num_bins;
 
 
 // Skip the initial frames as equilibration
-if (skip > 0)
-{
-  traj->readFrame(skip - 1); 
-}
-
-// read the initial coordinates into the system
-traj->updateGroupCoords(system);
-
-// Create the histogram and zero it out
-vector<greal> hist;
-hist.reserve(num_bins);
-hist.insert(hist.begin(), num_bins, 0.0);
-
-// loop over the frames of the trajectory
-int frame = 0;
-int count = 0;
-while (traj->readFrame())
+vector<uint> frames;
+for (uint i=skip; i<traj->nframes(); i++)
     {
-    // update coordinates and periodic box
-    traj->updateGroupCoords(system);
-
-    vector<AtomicGroup>::iterator m;
-    for (m=molecule_groups.begin(); m!=molecule_groups.end(); m++)
-        {
-        greal rad = m->radiusOfGyration();
-        if ( (rad >=hist_min) && (rad <hist_max) )
-            {
-            int bin = int((rad-hist_min)/bin_width);
-            hist[bin]++;
-            count++;
-            }
-        }
-    frame++;
+    frames.push_back(i);
     }
 
+// Each thread reads its own copy of the trajectory and histograms its
+// own chunk of frames; the histograms are summed at the end
+RgyrHistogram rgyr(selection, split_by_molecule, hist_min, hist_max, num_bins);
+frameMapReduce(TrajectoryOpener(argv[2], system, traj), system, frames, rgyr, nthreads);
+vector<greal>& hist = rgyr.hist;
+int count = rgyr.count;
+
 
 // Output the results
 cout << "# Rgyr\tProb\tCum" << endl;
@@ -390,7 +390,7 @@ public:
   void calc(const uint i) 
   {
     for (uint j=0; j<_R->cols(); ++j) 
-      (*_R)(i, j) = loos::alignment::centeredRMSD((*_TA)[i], (*_TB)[j]);
+      (*_R)(i, j) = loos::alignment::qcpCenteredRMSD((*_TA)[i], (*_TB)[j]);
   }
 
   void operator()() 
@@ -185,6 +185,7 @@ int main(int argc, char *argv[]) {
 
 
   vector<XForm> transforms;
+  boost::shared_ptr<SubsetCache> cache;
     
 
 
@@ -199,7 +200,9 @@ int main(int argc, char *argv[]) {
     if (topts->target_name.empty()) {
       cerr << boost::format("Aligning using %d atoms from \"%s\".\n") % align_subset.size() % topts->alignment;
       
-      boost::tuple<vector<XForm>, greal, int> res = iterativeAlignment(align_subset, ptraj, indices, topts->tol);
+      // Keep the aligned coordinates around in case the RMSD is over the same atoms
+      cache = boost::shared_ptr<SubsetCache>(new SubsetCache(align_subset, ptraj, indices));
+      boost::tuple<vector<XForm>, greal, int> res = iterativeAlignment(*cache, topts->tol);
       transforms = boost::get<0>(res);
 
     } else {   // A target was provided and aligning was requested...
@@ -221,9 +224,13 @@ int main(int argc, char *argv[]) {
 
   // If no external reference structure was specified, set the target
   // to the average of the trajectory...
+  bool use_cache = (cache && cache->matches(subset));
   if (topts->target_name.empty()) {
     cerr << "Computing using average structure...\n";
-    target = averageStructure(subset, transforms, ptraj, indices);
+    if (use_cache)
+      target = averageStructure(subset, transforms, *cache);
+    else
+      target = averageStructure(subset, transforms, ptraj, indices);
   } else
     target = target_subset;
 
@@ -236,8 +243,12 @@ int main(int argc, char *argv[]) {
   }
 
   for (uint i=0; i<indices.size(); i++) {
-      ptraj->readFrame(indices[i]);
-      ptraj->updateGroupCoords(subset);
+      if (use_cache)
+        cache->copyFrame(i, subset);
+      else {
+        ptraj->readFrame(indices[i]);
+        ptraj->updateGroupCoords(subset);
+      }
       subset.applyTransform(transforms[i]);
       double d = target.rmsd(subset);
       rmsds.push_back(d);
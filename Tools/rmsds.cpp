@@ -31,15 +31,13 @@
 
 #include <loos.hpp>
 #include <unistd.h>
-#include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
 
 
 using namespace std;
 using namespace loos;
 
 
-typedef boost::thread*   Thread;
-
 namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
 
@@ -91,6 +89,10 @@ string fullHelpMessage(void) {
     "then some care should be taken in how many threads are used for this tool, though it is unlikely\n"
     "that there will be a conflict.\n"
     "\n"
+    "\tFor very large matrices, the --stream option writes the matrix out a block of rows at\n"
+    "a time as it is computed, so the whole matrix is never held in memory.  For a single\n"
+    "trajectory, this takes about twice as long since the matrix can no longer be mirrored.\n"
+    "\n"
     "EXAMPLES\n"
     "\n"
     "\trmsds model.pdb simulation.dcd >rmsd.asc\n"
@@ -118,6 +120,12 @@ string fullHelpMessage(void) {
     "and in the sequence of atoms (i.e. the first atom in the --sel2 selection is\n" 
     "matched with the first atom in the --sel2 selection.)\n"
     "\n"
+    "\tThe --binary option writes the matrix in LOOS' binary matrix format instead of ASCII.\n"
+    "This is much smaller and faster to read and write (it is mapped into memory directly\n"
+    "when read back).  LOOS tools that read matrices accept either format.  For a single\n"
+    "trajectory, only the lower triangle of the (symmetric) matrix is stored, with or\n"
+    "without --stream.\n"
+    "\n"
     "SEE ALSO\n"
     "\trmsd2ref\n"
     "\n";
@@ -135,6 +143,8 @@ public:
     o.add_options()
       ("noout,N", po::value<bool>(&noop)->default_value(false), "Do not output the matrix (i.e. only calc pair-wise RMSD stats)")
       ("threads", po::value<uint>(&nthreads)->default_value(1), "Number of threads to use (0=all available)")
+      ("stream", po::value<bool>(&stream)->default_value(false), "Write the matrix as it is computed rather than holding it in memory")
+      ("binary", po::value<bool>(&binary)->default_value(false), "Write the matrix in binary (see NOTES)")
       ("sel1", po::value<string>(&sel1)->default_value("name == 'CA'"), "Atom selection for first system")
       ("skip1", po::value<uint>(&skip1)->default_value(0), "Skip n-frames of first trajectory")
       ("range1", po::value<string>(&range1), "Matlab-style range of frames to use from first trajectory")
@@ -173,10 +183,12 @@ public:
 
   string print() const {
     ostringstream oss;
-    oss << boost::format("stats=%d,noout=%d,nthreads=%d,sel1='%s',skip1=%d,range1='%s',sel2='%s',skip2=%d,range2='%s',model1='%s',traj1='%s',model2='%s',traj2='%s'")
+    oss << boost::format("stats=%d,noout=%d,nthreads=%d,stream=%d,binary=%d,sel1='%s',skip1=%d,range1='%s',sel2='%s',skip2=%d,range2='%s',model1='%s',traj1='%s',model2='%s',traj2='%s'")
       % stats
       % noop
       % nthreads
+      % stream
+      % binary
       % sel1
       % skip1
       % range1
@@ -194,6 +206,8 @@ public:
 
   bool stats;
   bool noop;
+  bool stream;
+  bool binary;
   uint skip1, skip2;
   uint nthreads;
   string range1, range2;
@@ -210,215 +224,55 @@ typedef vector<vecDouble>   vMatrix;
 
 // --------------------------------------------------------------------------------------
 
-// Parcels out work to the compute threads...  Work is given to the threads
-// one row at a time.
-
-class Master {
-public:
-
-  Master(const uint nr, const bool tr, const bool b) : _toprow(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
-                                                       _verbose(b), _start_time(time(0))
-  {
-    if (_triangle)
-      _total = _maxrow*(_maxrow-1) / 2;
-    else
-      _total = _maxrow;
-  }
-
-  // Checks whether there are any columns left to work on
-  // and places the column index into the passed pointer.
-
-  bool workAvailable(uint* ip) 
-  {
-
-    _mtx.lock();
-    if (_toprow >= _maxrow) {
-      _mtx.unlock();
-      return(false);
-    }
-    *ip = _toprow++;
-
-    if (_verbose)
-      if (_toprow % _updatefreq == 0)
-        updateStatus();
-    
-    _mtx.unlock();
-    return(true);
-  }
-
-
-  void updateStatus() {
-    time_t dt = elapsedTime();
-    uint work_done = _triangle ? (_toprow * (_toprow-1) / 2) : (_toprow);
-    uint work_left = _total - work_done;
-    uint d = work_left * dt / work_done;    // rate = work_done / dt;  d = work_left / rate;
-    
-    uint hrs = d / 3600;
-    uint remain = d % 3600;
-    uint mins = remain / 60;
-    uint secs = remain % 60;
-    
-    cerr << boost::format("Row %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
-      % _toprow % _maxrow % dt % hrs % mins % secs;
-  }
-
-
-  
-  time_t elapsedTime() const 
-  {
-    return (time(0) - _start_time);
-  }
-
 
-private:
-  uint _toprow, _maxrow;
-  uint _updatefreq;
-  bool _triangle;
-  bool _verbose;
-  time_t _start_time;
-  uint _total;
-  boost::mutex _mtx;
-
-};
-
-
-
-
-
-
-/*
-  Worker thread processes a column of the all-to-all matrix.  Gets which
-  column to work on from the associated Master object.
-*/
-
-
-// Worker for two different trajectories
+// Passes the matrix on to another writer (if any) as it streams in,
+// keeping track of the stats that showStatsHalf() and showStatsWhole()
+// would report
 
-class DualWorker 
-{
+class StatsWriter : public PairwiseRMSDWriter {
 public:
-  DualWorker(RealMatrix* R, vMatrix* T1, vMatrix* T2, Master* M) : _R(R), _T1(T1), _T2(T2), _M(M), _maxcol(T2->size()) { }
+  StatsWriter(PairwiseRMSDWriter* out, const bool half)
+    : _out(out), _half(half), _n(0), _avg(0.0), _max(0.0) { }
 
-
-  DualWorker(const DualWorker& w) 
-  {
-    _R = w._R;
-    _T1 = w._T1;
-    _T2 = w._T2;
-    _M = w._M;
-    _maxcol = w._maxcol;
+  void begin(const uint rows, const uint cols) {
+    if (_out)
+      _out->begin(rows, cols);
   }
-  
 
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<_maxcol; ++j) {
-      double d = loos::alignment::centeredRMSD((*_T1)[i], (*_T2)[j]);
-      (*_R)(i, j) = d;
+  void rows(const uint first, const uint n, const uint cols, const double* values) {
+    for (uint j=0; j<n; ++j) {
+      uint end = _half ? first + j : cols;
+      for (uint i=0; i<end; ++i) {
+        double d = static_cast<RealMatrix::element_type>(values[j * cols + i]);
+        _avg += d;
+        if (d > _max)
+          _max = d;
+        ++_n;
+      }
     }
-  }
 
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
+    if (_out)
+      _out->rows(first, n, cols, values);
   }
-  
-
-private:
-  RealMatrix* _R;
-  vMatrix* _T1;
-  vMatrix* _T2;
-  Master* _M;
-  uint _maxcol;
-};
-
 
-
-// Worker for self all-to-all
-
-class SingleWorker 
-{
-public:
-  SingleWorker(RealMatrix* R, vMatrix* T, Master* M) : _R(R), _T(T), _M(M) { }
-
-
-  SingleWorker(const SingleWorker& w) 
-  {
-    _R = w._R;
-    _T = w._T;
-    _M = w._M;
+  void end() {
+    if (_out)
+      _out->end();
   }
-  
 
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<i; ++j) {
-      double d = loos::alignment::centeredRMSD((*_T)[i], (*_T)[j]);
-      (*_R)(j, i) = (*_R)(i, j) = d;
-    }
+  void showStats() const {
+    cerr << boost::format("Max rmsd = %.4f, avg rmsd = %.4f\n") % _max % (_avg / _n);
   }
 
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
-  }
-  
-
 private:
-  RealMatrix* _R;
-  vMatrix* _T;
-  Master* _M;
+  PairwiseRMSDWriter* _out;
+  bool _half;
+  ulong _n;
+  double _avg, _max;
 };
 
 
 
-// Top level object/interface.  Will create np Worker threads, cloned from the
-// one passed into the constructor.
-
-template<class W>
-class Threader 
-{
-public:
-  Threader(W* wrkr, const uint np) :
-    worker(wrkr),
-    threads(vector<Thread>(np))
-  {
-
-    for (uint i=0; i<np; ++i) {
-      W w(*worker);
-      threads[i] = new boost::thread(w);
-    }
-    
-  }
-
-
-  void join() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      threads[i]->join();
-  }
-  
-
-  ~Threader() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      delete threads[i];
-  }
-
-  W* worker;
-  vector<Thread> threads;
-};
-
-
-// --------------------------------------------------------------------------------------
-
-
 void showStatsHalf(const RealMatrix& R) {
   uint total = (R.rows() * (R.rows()-1)) / 2; 
 
@@ -454,13 +308,6 @@ void showStatsWhole(const RealMatrix& R) {
 
 
 
-void centerTrajectory(alignment::vecMatrix& U) {
-  for (uint i=0; i<U.size(); ++i)
-    alignment::centerAtOrigin(U[i]);
-}
-
-
-
 void checkMemoryUsage(long mem) {
   if (!mem)
     return;
@@ -503,35 +350,17 @@ int main(int argc, char *argv[]) {
   vector<uint> indices = assignTrajectoryFrames(traj, topts->range1, topts->skip1);
 
   long mem = availableMemory();
-  uint nthreads = topts->nthreads ? topts->nthreads : boost::thread::hardware_concurrency();
   
-  if (verbosity > 1) {
-    cerr << "Using " << nthreads << " threads\n";
+  if (verbosity > 1)
     cerr << "Reading trajectory - " << topts->traj1 << endl;
-  }
   vMatrix T = readCoords(subset, traj, indices, verbosity > 1);
   used_memory += T.size() * T[0].size() * sizeof(vMatrix::value_type::value_type);   // Coords matrix
-  used_memory += T.size() * T.size() * sizeof(RealMatrix::element_type);             // RMSDS matrix
-  checkMemoryUsage(mem);
-  centerTrajectory(T);
-
-  RealMatrix M;
-  if (topts->model2.empty()) {
+  if (!topts->stream)
+    used_memory += T.size() * T.size() * sizeof(RealMatrix::element_type);           // RMSDS matrix
 
-    if (verbosity > 1)
-      cerr << "Calculating RMSD...\n";
-    M = RealMatrix(T.size(), T.size());
-    Master master(T.size(), true, verbosity);
-    SingleWorker worker(&M, &T, &master);
-    Threader<SingleWorker> threads(&worker, nthreads);
-    threads.join();
-    if (verbosity) 
-      master.updateStatus();
-    
-    if (verbosity || topts->noop || topts->stats)
-      showStatsHalf(M);
-    
-  } else {
+  vMatrix T2;
+  bool half = topts->model2.empty();
+  if (!half) {
     AtomicGroup model2 = createSystem(topts->model2);
     pTraj traj2 = createTrajectory(topts->traj2, model2);
     AtomicGroup subset2 = selectAtoms(model2, topts->sel2);
@@ -539,29 +368,61 @@ int main(int argc, char *argv[]) {
 
     if (verbosity > 1)
       cerr << "Reading trajectory - " << topts->traj2 << endl;
-    vMatrix T2 = readCoords(subset2, traj2, indices2, verbosity > 1);
+    T2 = readCoords(subset2, traj2, indices2, verbosity > 1);
     used_memory += T2.size() * T2[0].size() * sizeof(double);
-    checkMemoryUsage(mem);
-    centerTrajectory(T2);
+  }
+  checkMemoryUsage(mem);
 
-    if (verbosity > 1)
-      cerr << "Calculating RMSD...\n";
-    M = RealMatrix(T.size(), T2.size());
-    Master master(T.size(), false, verbosity);
-    DualWorker worker(&M, &T, &T2, &master);
-    Threader<DualWorker> threads(&worker, nthreads);
-    threads.join();
+  // The engine keeps its own packed copy of the coordinates
+  boost::scoped_ptr<PairwiseRMSD> engine(half ? new PairwiseRMSD(T) : new PairwiseRMSD(T, T2));
+  vMatrix().swap(T);
+  vMatrix().swap(T2);
+  engine->threads(topts->nthreads);
+  engine->verbose(verbosity);
+
+  if (verbosity > 1) {
+    cerr << "Using " << engine->threads() << " threads\n";
+    cerr << "Calculating RMSD (" << PairwiseRMSD::simdName(engine->simd()) << ")...\n";
+  }
 
-    if (verbosity)
-      master.updateStatus();
+  bool show_stats = (verbosity || topts->noop || topts->stats);
+
+  if (topts->stream) {
+    boost::scoped_ptr<PairwiseRMSDWriter> out;
+    if (!topts->noop) {
+      if (topts->binary)
+        out.reset(new BinaryPairwiseRMSDWriter(cout, header, half));
+      else {
+        cout << "# " << header << endl;
+        cout << setprecision(matrix_precision);
+        out.reset(new AsciiPairwiseRMSDWriter(cout));
+      }
+    }
+    StatsWriter writer(out.get(), half);
+    engine->compute(writer);
+    if (show_stats)
+      writer.showStats();
+    return(0);
+  }
 
-    if (verbosity || topts->noop || topts->stats)
+  RealMatrix M = engine->compute();
+  if (show_stats) {
+    if (half)
+      showStatsHalf(M);
+    else
       showStatsWhole(M);
   }
 
   if (!topts->noop) {
-    cout << "# " << header << endl;
-    cout << setprecision(matrix_precision) << M;
+    if (topts->binary) {
+      if (half)
+        writeBinarySymmetricMatrix(cout, M, header);
+      else
+        writeBinaryMatrix(cout, M, header);
+    } else {
+      cout << "# " << header << endl;
+      cout << setprecision(matrix_precision) << M;
+    }
   }
 
 }
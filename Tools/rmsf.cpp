@@ -92,28 +92,28 @@ int main(int argc, char *argv[]) {
   AtomicGroup subset = selectAtoms(model, sopts->selection);
   vector<uint> indices = tropts->frameList();
 
+  // Only the subset is ever read, so a DCD can skip the other atoms
+  boost::shared_ptr<DCD> dcd = boost::dynamic_pointer_cast<DCD>(traj);
+  if (dcd)
+    dcd->setSparseIndices(subset);
 
-  vector<AtomicGroup> frames;
+
+  // Only the per-coordinate variances are needed, so the frames are
+  // accumulated as they are read rather than held
+  CovarianceAccumulator acc(subset.size(), false);
+  CoordinatePlan plan(subset);
   for (vector<uint>::iterator i = indices.begin(); i != indices.end(); ++i) {
-    traj->readFrame(*i);
-    traj->updateGroupCoords(subset);
-    AtomicGroup frame = subset.copy();
-    frames.push_back(frame);
+    if (!traj->readFrame(*i)) {
+      cerr << "Could not read frame " << *i << " from trajectory " << traj->filename() << endl;
+      exit(-2);
+    }
+    traj->updateGroupCoords(subset, plan);
+    acc.add(subset);
   }
 
-  AtomicGroup avg = averageStructure(frames);
+  AtomicGroup avg = acc.average(subset);
+  vector<double> rmsf = acc.fluctuations();
   uint n = avg.size();
-  uint m = frames.size();
-
-  vector<double> rmsf(n, 0.0);
-  for (uint i = 0; i < m; i++)
-    for (uint j = 0; j < n; j++) {
-      double d = frames[i][j]->coords().distance2(avg[j]->coords());
-      rmsf[j] += d;
-    }
-
-  for (uint i = 0; i < n; i++)
-    rmsf[i] = sqrt(rmsf[i] / m);
 
   cout << "# atomid\tresid\tRMSF\n";
   for (uint i = 0; i < n; i++)
@@ -216,6 +216,7 @@ int main(int argc, char *argv[]) {
 
   pTrajectoryWriter outtraj = otopts->createTrajectory(prefopts->prefix);
   outtraj->setComments(hdr);
+  outtraj = pTrajectoryWriter(new AsyncTrajectoryWriter(outtraj));
 
   AtomicGroup frame = subset.copy();
 
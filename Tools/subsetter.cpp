@@ -542,6 +542,13 @@ int main(int argc, char *argv[]) {
   if (trajout->hasComments())
     trajout->setComments(hdr);
 
+  // Write frames in large blocks (the header is finished when trajout
+  // goes away), compress them on all cores if the format is
+  // compressed, and do the writing on a background thread
+  trajout->bufferOutput();
+  trajout->useThreads();
+  trajout = pTrajectoryWriter(new AsyncTrajectoryWriter(trajout));
+
   bool first = true;  // Flag to pick off the first frame for a
                       // reference structure
 
@@ -31,6 +31,7 @@
 
 #include <loos.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 
 using namespace std;
 using namespace loos;
@@ -57,6 +58,7 @@ typedef Math::Matrix<svdreal, Math::ColMajor> Matrix;
 // Globals
 string header("NO HEADER SPECIFIED");
 string prefix("output");
+bool binary_output = false;
 
 
 // @cond TOOLS_INTERNAL
@@ -71,7 +73,12 @@ public:
     alignment_tol(1e-6),
     splitv(true),
     autoname(true),
-    terms(0)
+    binary(false),
+    terms(0),
+    randomized(false),
+    oversample(10),
+    power(2),
+    seed(0)
   { }
 
 
@@ -84,13 +91,30 @@ public:
       ("source", po::value<bool>(&include_source)->default_value(include_source), "Write out source conformation matrix")
       ("splitv", po::value<bool>(&splitv)->default_value(splitv), "Automatically split V matrix (when using multiple trajectories)")
       ("autoname", po::value<bool>(&autoname)->default_value(autoname), "Automatically name V files based on traj filename")
-      ("terms", po::value<uint>(&terms), "# of terms of the SVD to output");
+      ("binary", po::value<bool>(&binary)->default_value(binary), "Write matrices in binary (.bin) rather than ASCII (.asc)")
+      ("terms", po::value<uint>(&terms), "# of terms of the SVD to output")
+      ("randomized", po::value<bool>(&randomized)->default_value(randomized), "Use the streaming randomized SVD (requires --terms)")
+      ("oversample", po::value<uint>(&oversample)->default_value(oversample), "Extra random vectors for --randomized")
+      ("power", po::value<uint>(&power)->default_value(power), "Power iterations for --randomized")
+      ("seed", po::value<uint>(&seed)->default_value(seed), "Random number seed for --randomized (0 = auto)");
   }
 
 
   bool postConditions(po::variables_map& vm) {
     if (autoname)
       splitv = true;
+    binary_output = binary;
+
+    if (randomized) {
+      if (terms == 0) {
+        cerr << "Error- --randomized requires --terms\n";
+        return(false);
+      }
+      if (seed == 0)
+        seed = randomSeedRNG();
+      else
+        rng_singleton().seed(seed);
+    }
 
     return(true);
   }
@@ -100,7 +124,7 @@ public:
   string print() const {
     ostringstream oss;
 
-    oss << boost::format("align='%s', svd='%s', tolerance=%f, noalign=%d, source=%d, splitv=%d, autoname=%d, terms=%d")
+    oss << boost::format("align='%s', svd='%s', tolerance=%f, noalign=%d, source=%d, splitv=%d, autoname=%d, binary=%d, terms=%d, randomized=%d, oversample=%d, power=%d, seed=%d")
       % alignment_string
       % svd_string
       % noalign
@@ -108,7 +132,12 @@ public:
       % alignment_tol
       % splitv
       % autoname
-      % terms;
+      % binary
+      % terms
+      % randomized
+      % oversample
+      % power
+      % seed;
     return(oss.str());
   }
 
@@ -117,7 +146,10 @@ public:
   bool noalign, include_source;
   double alignment_tol;
   bool splitv, autoname;
+  bool binary;
   uint terms;
+  bool randomized;
+  uint oversample, power, seed;
 };
 
 // @endcond
@@ -157,6 +189,17 @@ string s =
   "\t                    projected onto the PC with the same index\n" 
   "\toutput.map     - mapping of selection onto rows of output matrices\n"
   "\toutput_avg.pdb - average structure across the trajectory\n"
+  "With --binary, the matrices are written in LOOS' binary matrix format\n"
+  "(output_s.bin, etc) instead.  These are much smaller and faster to\n"
+  "read, and LOOS tools that read matrices accept either format.\n"
+  "\n"
+  "svd --randomized 1 --terms 20 model.pdb traj.dcd\n"
+  "\tFinds only the first 20 PCs using a randomized SVD.  Instead of\n"
+  "\tbuilding the full coordinate matrix, this makes a few passes over\n"
+  "\tthe trajectory (--power + 2, plus one more for the RSVs), holding\n"
+  "\tonly a handful of vectors per atom.  Use this for trajectories that\n"
+  "\tare too big for the full SVD.  --power controls the number of power\n"
+  "\titerations (more is more accurate for slowly decaying spectra).\n"
   "\n"
   "\n"
   "UNITS AND PCA COMPARISON\n"
@@ -235,14 +278,14 @@ string s =
 
 
 
-vector<XForm> doAlign(const AtomicGroup& subset, pTraj traj, const vector<uint>& indices, const double tol) {
+vector<XForm> doAlign(const SubsetCache& subset, const double tol) {
 
-  boost::tuple<vector<XForm>, greal, int> res = iterativeAlignment(subset, traj, indices, tol, 100);
+  boost::tuple<vector<XForm>, greal, int> res = iterativeAlignment(subset, tol, 100);
   vector<XForm> xforms = boost::get<0>(res);
   greal rmsd = boost::get<1>(res);
   int iters = boost::get<2>(res);
 
-  cerr << "Subset alignment with " << subset.size()
+  cerr << "Subset alignment with " << subset.natoms()
        << " atoms converged to " << rmsd << " rmsd after "
        << iters << " iterations.\n";
 
@@ -265,10 +308,13 @@ void writeAverage(const AtomicGroup& avg) {
 
 // Calculates the transformed avg structure, then extracts the
 // transformed coords from the DCD with the avg subtraced out...
+// If the subset was already cached for the alignment, the coords
+// come from the cache instead.
 
-Matrix extractCoords(const AtomicGroup& subset, const vector<XForm>& xforms, pTraj traj, const vector<uint>& indices) {
+Matrix extractCoords(const AtomicGroup& subset, const vector<XForm>& xforms, pTraj traj, const vector<uint>& indices, const SubsetCache* cache) {
 
-  AtomicGroup avg = averageStructure(subset, xforms, traj, indices);
+  bool use_cache = (cache && cache->matches(subset));
+  AtomicGroup avg = use_cache ? averageStructure(subset, xforms, *cache) : averageStructure(subset, xforms, traj, indices);
   writeAverage(avg);
 
   uint natoms = subset.size();
@@ -278,8 +324,12 @@ Matrix extractCoords(const AtomicGroup& subset, const vector<XForm>& xforms, pTr
   Matrix M(m, n);
 
   for (uint i=0; i<n; ++i) {
-    traj->readFrame(indices[i]);
-    traj->updateGroupCoords(frame);
+    if (use_cache)
+      cache->copyFrame(i, frame);
+    else {
+      traj->readFrame(indices[i]);
+      traj->updateGroupCoords(frame);
+    }
     frame.applyTransform(xforms[i]);
 
     for (uint j=0; j<natoms; j++) {
@@ -312,23 +362,105 @@ void write_map(const string& fname, const AtomicGroup& grp) {
 }
 
 
-void writeMatrixChunk(opts::OutputPrefix* popts, opts::MultiTrajOptions* tropts, ToolOptions* topts, const Matrix& Vt, const Math::Range& start, const Math::Range& end, const string& header, const uint index) {
+// Writes \a name with either a .asc or .bin extension, depending on --binary
+
+string matrixFilename(const string& name) {
+  return(name + (binary_output ? ".bin" : ".asc"));
+}
+
+
+template<class M>
+void writeMatrix(const string& name, const M& A, const Math::Range& start, const Math::Range& end, const bool trans = false) {
+  if (binary_output)
+    writeBinaryMatrix(matrixFilename(name), A, header, start, end, trans);
+  else
+    writeAsciiMatrix(matrixFilename(name), A, header, start, end, trans);
+}
+
+
+template<class M>
+void writeMatrix(const string& name, const M& A) {
+  if (binary_output)
+    writeBinaryMatrix(matrixFilename(name), A, header);
+  else
+    writeAsciiMatrix(matrixFilename(name), A, header);
+}
+
+
+
+void writeMatrixChunk(opts::OutputPrefix* popts, opts::MultiTrajOptions* tropts, ToolOptions* topts, const Matrix& Vt, const Math::Range& start, const Math::Range& end, const string& header, const uint index, const bool trans = true) {
   string filename;
 
   if (topts->autoname) {
     boost::filesystem::path p(tropts->mtraj[index]->filename());
 #if BOOST_FILESYSTEM_VERSION >= 3
-    filename = p.stem().string() + "_V.asc";
+    filename = p.stem().string() + "_V";
 #else
-    filename = p.stem() + "_V.asc";
+    filename = p.stem() + "_V";
 #endif
   } else {
     ostringstream oss;
-    oss << boost::format("%s_V_%04d.asc") % popts->prefix % index;
+    oss << boost::format("%s_V_%04d") % popts->prefix % index;
     filename = oss.str();
   }
 
-  writeAsciiMatrix(filename, Vt, header, start, end, true);
+  writeMatrix(filename, Vt, start, end, trans);
+}
+
+
+
+// Only the top --terms modes are found, a few passes over the
+// trajectory at a time, so the coordinate matrix is never built.
+// V comes back as frames x terms (not transposed as from dgesvd).
+
+void randomizedSVD(const string& progname, const AtomicGroup& svdsub, const vector<XForm>& xforms, pTraj traj,
+                   const vector<uint>& indices, const SubsetCache* cache, opts::BasicOptions* bhopts,
+                   opts::OutputPrefix* popts, opts::MultiTrajOptions* tropts, ToolOptions* topts) {
+
+  boost::scoped_ptr<RandomizedSVD> engine;
+  if (cache && cache->matches(svdsub))
+    engine.reset(new RandomizedSVD(*cache, topts->terms));
+  else
+    engine.reset(new RandomizedSVD(svdsub, traj, indices, topts->terms));
+
+  engine->transforms(xforms);
+  engine->oversampling(topts->oversample);
+  engine->powerIterations(topts->power);
+  engine->verbose(bhopts->verbosity > 0);
+
+  cerr << boost::format("%s: Randomized SVD for %d terms in %d passes\n") % progname % topts->terms % engine->passes();
+  Timer<WallTimer> timer;
+  timer.start();
+  engine->compute();
+  Matrix V = engine->V();
+  timer.stop();
+  cerr << progname << ": Done!  Calculation took " << timeAsString(timer.elapsed()) << endl;
+
+  writeAverage(engine->average());
+
+  cerr << progname << ": Writing results...\n";
+  writeMatrix(prefix + "_U", engine->U());
+  writeMatrix(prefix + "_s", engine->S());
+
+  uint n = V.rows();
+  uint terms = V.cols();
+  if (topts->splitv && tropts->mtraj.size() > 1) {
+    uint a = 0;
+    uint curtraj = 0;
+
+    for (uint i=0; i<n; ++i) {
+      MultiTrajectory::Location loc = tropts->mtraj.frameIndexToLocation(i);
+      if (loc.first != curtraj) {
+        writeMatrixChunk(popts, tropts, topts, V, Math::Range(a, 0), Math::Range(i, terms), header, curtraj, false);
+        a = i;
+        curtraj = loc.first;
+      }
+    }
+
+    writeMatrixChunk(popts, tropts, topts, V, Math::Range(a, 0), Math::Range(n, terms), header, curtraj, false);
+
+  } else
+    writeMatrix(prefix + "_V", V);
 }
 
 
@@ -359,6 +491,7 @@ int main(int argc, char *argv[]) {
   write_map(prefix + ".map", svdsub);
 
   vector<XForm> xforms;
+  boost::shared_ptr<SubsetCache> cache;
   if (topts->noalign) {
     // Make noop xforms to prevent doing any alignment...
     cerr << argv[0] << ": SKIPPING ALIGNMENT\n";
@@ -367,18 +500,27 @@ int main(int argc, char *argv[]) {
   } else {
     AtomicGroup alignsub = selectAtoms(model, topts->alignment_string);
     cerr << argv[0] << ": Aligning...\n";
-    xforms = doAlign(alignsub, ptraj, indices, topts->alignment_tol);   // Honors indices
+    cache = boost::shared_ptr<SubsetCache>(new SubsetCache(alignsub, ptraj, indices));   // Honors indices
+    xforms = doAlign(*cache, topts->alignment_tol);
+  }
+
+  if (topts->randomized) {
+    if (topts->include_source)
+      cerr << argv[0] << ": The source matrix is not written with --randomized\n";
+    randomizedSVD(argv[0], svdsub, xforms, ptraj, indices, cache.get(), bhopts, popts, tropts, topts);
+    cerr << argv[0] << ": done!\n";
+    return(0);
   }
 
   cerr << argv[0] << ": Extracting coordinates...\n";
-  Matrix A = extractCoords(svdsub, xforms, ptraj, indices);   // Honors indices
+  Matrix A = extractCoords(svdsub, xforms, ptraj, indices, cache.get());   // Honors indices
   f77int m = A.rows();
   f77int n = A.cols();
   f77int sn = m<n ? m : n;
 
 
   if (topts->include_source)
-    writeAsciiMatrix(prefix + "_A.asc", A, header);
+    writeMatrix(prefix + "_A", A);
 
   double estimate = static_cast<double>(m)*m*sizeof(svdreal) + static_cast<double>(n)*n*sizeof(svdreal) + static_cast<double>(m)*n*sizeof(svdreal) + sn*sizeof(svdreal);
   cerr << boost::format("%s: Allocating estimated %.3f GB for %d x %d SVD\n")
@@ -440,8 +582,8 @@ int main(int argc, char *argv[]) {
   }
 
   cerr << argv[0] << ": Writing results...\n";
-  writeAsciiMatrix(prefix + "_U.asc", U, header, orig, Usize);
-  writeAsciiMatrix(prefix + "_s.asc", S, header, orig, Ssize);
+  writeMatrix(prefix + "_U", U, orig, Usize);
+  writeMatrix(prefix + "_s", S, orig, Ssize);
 
   if (topts->splitv && tropts->mtraj.size() > 1) {
     // Need to reconstruct what row-ranges correspond to the input trajectories...
@@ -461,7 +603,7 @@ int main(int argc, char *argv[]) {
     writeMatrixChunk(popts, tropts, topts, Vt, Math::Range(0, a), Math::Range(terms, n), header, curtraj);
     
   } else
-    writeAsciiMatrix(prefix + "_V.asc", Vt, header, orig, Vsize, true);
+    writeMatrix(prefix + "_V", Vt, orig, Vsize, true);
   
   cerr << argv[0] << ": done!\n";
 
@@ -32,7 +32,6 @@
 #include <loos.hpp>
 #include <unistd.h>
 #include <boost/tuple/tuple.hpp>
-#include <boost/thread/thread.hpp>
 #include <boost/algorithm/string.hpp>
 
 
@@ -40,8 +39,6 @@ using namespace std;
 using namespace loos;
 
 
-typedef boost::thread*   Thread;
-
 namespace opts = loos::OptionsFramework;
 namespace po = loos::OptionsFramework::po;
 
@@ -200,168 +197,6 @@ typedef vector<vecDouble>   vMatrix;
 
 // --------------------------------------------------------------------------------------
 
-// Parcels out work to the compute threads...  Work is given to the threads
-// one row at a time.
-
-class Master {
-public:
-
-  Master(const uint nr, const bool tr, const bool b) : _toprow(0), _maxrow(nr), _updatefreq(500), _triangle(tr),
-                                                       _verbose(b), _start_time(time(0))
-  {
-    if (_triangle)
-      _total = _maxrow*(_maxrow-1) / 2;
-    else
-      _total = _maxrow;
-  }
-
-  // Checks whether there are any columns left to work on
-  // and places the column index into the passed pointer.
-
-  bool workAvailable(uint* ip) 
-  {
-
-    _mtx.lock();
-    if (_toprow >= _maxrow) {
-      _mtx.unlock();
-      return(false);
-    }
-    *ip = _toprow++;
-
-    if (_verbose)
-      if (_toprow % _updatefreq == 0)
-        updateStatus();
-    
-    _mtx.unlock();
-    return(true);
-  }
-
-
-  void updateStatus() {
-    time_t dt = elapsedTime();
-    uint work_done = _triangle ? (_toprow * (_toprow-1) / 2) : (_toprow);
-    uint work_left = _total - work_done;
-    uint d = work_left * dt / work_done;    // rate = work_done / dt;  d = work_left / rate;
-    
-    uint hrs = d / 3600;
-    uint remain = d % 3600;
-    uint mins = remain / 60;
-    uint secs = remain % 60;
-    
-    cerr << boost::format("Row %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
-      % _toprow % _maxrow % dt % hrs % mins % secs;
-  }
-
-
-  
-  time_t elapsedTime() const 
-  {
-    return (time(0) - _start_time);
-  }
-
-
-private:
-  uint _toprow, _maxrow;
-  uint _updatefreq;
-  bool _triangle;
-  bool _verbose;
-  time_t _start_time;
-  uint _total;
-  boost::mutex _mtx;
-
-};
-
-
-
-
-
-
-/*
-  Worker thread processes a column of the all-to-all matrix.  Gets which
-  column to work on from the associated Master object.
-*/
-
-
-// Worker for self all-to-all
-
-class SingleWorker 
-{
-public:
-  SingleWorker(RealMatrix* R, vMatrix* TA, vMatrix* TB, Master* M) : _R(R), _TA(TA), _TB(TB), _M(M) { }
-
-
-  SingleWorker(const SingleWorker& w) 
-  {
-    _R = w._R;
-    _TA = w._TA;
-    _TB = w._TB;
-    _M = w._M;
-  }
-  
-
-  void calc(const uint i) 
-  {
-    for (uint j=0; j<_R->cols(); ++j) 
-      (*_R)(i, j) = loos::alignment::centeredRMSD((*_TA)[i], (*_TB)[j]);
-  }
-
-  void operator()() 
-  {
-    uint i;
-    
-    while (_M->workAvailable(&i))
-      calc(i);
-  }
-  
-
-private:
-  RealMatrix* _R;
-  vMatrix* _TA;
-  vMatrix* _TB;
-  Master* _M;
-};
-
-
-
-// Top level object/interface.  Will create np Worker threads, cloned from the
-// one passed into the constructor.
-
-template<class W>
-class Threader 
-{
-public:
-  Threader(W* wrkr, const uint np) :
-    worker(wrkr),
-    threads(vector<Thread>(np))
-  {
-
-    for (uint i=0; i<np; ++i) {
-      W w(*worker);
-      threads[i] = new boost::thread(w);
-    }
-    
-  }
-
-
-  void join() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      threads[i]->join();
-  }
-  
-
-  ~Threader() 
-  {
-    for (uint i=0; i<threads.size(); ++i)
-      delete threads[i];
-  }
-
-  W* worker;
-  vector<Thread> threads;
-};
-
-
-// --------------------------------------------------------------------------------------
 
 // just get max elt and avg like multi-rmsds.
 void showStats(const RealMatrix& R) {
@@ -418,13 +253,6 @@ void showFractionalStats(const RealMatrix& R, const float cutoff) {
 }
 
 
-void centerTrajectory(alignment::vecMatrix& U) {
-  for (uint i=0; i<U.size(); ++i)
-    alignment::centerAtOrigin(U[i]);
-}
-
-
-
 void checkMemoryUsage(long mem) {
   if (!mem)
     return;
@@ -468,10 +296,6 @@ int main(int argc, char *argv[]) {
   vector<uint> indices_B = topts->frameList(topts->trajectory_B);
 
   long mem = availableMemory();
-  uint nthreads = topts->nthreads ? topts->nthreads : boost::thread::hardware_concurrency();
-  
-  if (verbosity > 1)
-    cerr << "Using " << nthreads << " threads\n";
   
   // read in system A
   vMatrix TA = readCoords(subset, topts->trajectory_A, indices_A, verbosity > 1);
@@ -483,20 +307,18 @@ int main(int argc, char *argv[]) {
   used_memory += TA.size() * TB.size() * sizeof(RealMatrix::element_type);             // RMSDS matrix
   
   checkMemoryUsage(mem);
-  centerTrajectory(TA);
-  centerTrajectory(TB);
-
-  RealMatrix M;
-  if (verbosity > 1)
-    cerr << "Calculating RMSD...\n";
-  M = RealMatrix(TA.size(), TB.size());
-  // note the 'false' here causes master to do full matrix, not just triangle.
-  Master master(TA.size(), false, verbosity); 
-  SingleWorker worker(&M, &TA, &TB, &master);
-  Threader<SingleWorker> threads(&worker, nthreads);
-  threads.join();
-  if (verbosity)
-    master.updateStatus();
+
+  PairwiseRMSD engine(TA, TB);
+  vMatrix().swap(TA);
+  vMatrix().swap(TB);
+  engine.threads(topts->nthreads);
+  engine.verbose(verbosity);
+
+  if (verbosity > 1) {
+    cerr << "Using " << engine.threads() << " threads\n";
+    cerr << "Calculating RMSD (" << PairwiseRMSD::simdName(engine.simd()) << ")...\n";
+  }
+  RealMatrix M = engine.compute();
 
   if (verbosity || topts->noop || topts->stats || topts->cutoff > 0){
     if (topts->cutoff > 0)
@@ -0,0 +1,235 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <AsyncTrajectoryWriter.hpp>
+#include <exceptions.hpp>
+
+#include <algorithm>
+
+
+namespace loos {
+
+
+  AsyncTrajectoryWriter::AsyncTrajectoryWriter(const pTrajectoryWriter& writer, const uint depth)
+    : TrajectoryWriter(static_cast<std::iostream*>(0), writer->isAppending()),
+      _writer(writer), _frames(writer->framesWritten()),
+      _head(0), _queued(0), _busy(false), _shutdown(false), _reported(false), _thread(0)
+  {
+    if (depth == 0)
+      throw(LOOSError("AsyncTrajectoryWriter must be able to hold at least one frame"));
+
+    _slots.resize(depth);
+    _thread = new boost::thread(&AsyncTrajectoryWriter::writeBehind, this);
+  }
+
+
+  // Any frames still queued are written before the thread exits
+  AsyncTrajectoryWriter::~AsyncTrajectoryWriter() {
+    {
+      boost::lock_guard<boost::mutex> lock(_mutex);
+      _shutdown = true;
+    }
+    _cond.notify_all();
+
+    _thread->join();
+    delete _thread;
+
+    try {
+      _writer->flush();
+    }
+    catch (std::exception& e) {
+      if (_error.empty())
+        _error = e.what();
+    }
+
+    if (!_error.empty() && !_reported)
+      std::cerr << "Warning- error while writing trajectory: " << _error << std::endl;
+  }
+
+
+  // Must be called with the mutex held
+  void AsyncTrajectoryWriter::rethrow() {
+    if (!_error.empty()) {
+      _reported = true;
+      throw(LOOSError("Error while writing trajectory: " + _error));
+    }
+  }
+
+
+  // Waits until the writer thread has nothing to do, so the wrapped
+  // writer can be used from this thread while the lock is held
+  void AsyncTrajectoryWriter::waitForIdle(boost::unique_lock<boost::mutex>& lock) {
+    while (_queued > 0 || _busy)
+      _cond.wait(lock);
+  }
+
+
+  void AsyncTrajectoryWriter::setComments(const std::vector<std::string>& comments) {
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    waitForIdle(lock);
+    rethrow();
+    _writer->setComments(comments);
+  }
+
+
+  void AsyncTrajectoryWriter::bufferOutput(const size_t nbytes) {
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    waitForIdle(lock);
+    rethrow();
+    _writer->bufferOutput(nbytes);
+  }
+
+
+  void AsyncTrajectoryWriter::useThreads(const uint nthreads) {
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    waitForIdle(lock);
+    rethrow();
+    _writer->useThreads(nthreads);
+  }
+
+
+  void AsyncTrajectoryWriter::flush() {
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    waitForIdle(lock);
+    rethrow();
+    _writer->flush();
+  }
+
+
+  void AsyncTrajectoryWriter::writeFrame(const AtomicGroup& model) {
+    enqueue(model, false, 0, 0.0);
+  }
+
+
+  void AsyncTrajectoryWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
+    enqueue(model, true, step, time);
+  }
+
+
+  void AsyncTrajectoryWriter::enqueue(const AtomicGroup& model, const bool has_step, const uint step, const double time) {
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    while (_queued == _slots.size() && _error.empty())
+      _cond.wait(lock);
+    rethrow();
+
+    // The slot isn't queued, so the writer thread won't look at it
+    // until it is handed over below
+    Slot& slot = _slots[_head];
+    lock.unlock();
+
+    // The writer's copy is only reused when the group has the same
+    // atoms (in the same order) as the one it was made from
+    if (model.size() != _atoms.size() || !std::equal(_atoms.begin(), _atoms.end(), model.begin())) {
+      slot.model = pAtomicGroup(new AtomicGroup(model.copy()));
+      _atoms.assign(model.begin(), model.end());
+    } else
+      slot.model.reset();
+
+    slot.coords.resize(model.size());
+    for (uint i=0; i<model.size(); ++i)
+      slot.coords[i] = model[i]->coords();
+
+    // Only formats like TRR use velocities, and the group only has
+    // them if they were read or set
+    slot.has_velocities = !model.empty() && model.allHaveProperty(Atom::velbit);
+    if (slot.has_velocities) {
+      slot.velocities.resize(model.size());
+      for (uint i=0; i<model.size(); ++i) {
+        const Atom& atom = *(model[i]);
+        slot.velocities[i] = atom.velocities();
+      }
+    }
+
+    slot.has_box = model.isPeriodic();
+    if (slot.has_box)
+      slot.box = model.periodicBox();
+
+    slot.has_step = has_step;
+    slot.step = step;
+    slot.time = time;
+
+    lock.lock();
+    _head = (_head + 1) % _slots.size();
+    ++_queued;
+    ++_frames;
+    _cond.notify_all();
+  }
+
+
+  void AsyncTrajectoryWriter::writeBehind() {
+    pAtomicGroup model;
+    uint tail = 0;
+
+    boost::unique_lock<boost::mutex> lock(_mutex);
+    while (true) {
+      if (_queued == 0) {
+        if (_shutdown)
+          break;
+        _cond.wait(lock);
+        continue;
+      }
+
+      Slot& slot = _slots[tail];
+      bool failed = !_error.empty();
+      _busy = true;
+      lock.unlock();
+
+      // Once the writer has failed, the remaining frames are dropped
+      std::string error;
+      if (!failed) {
+        try {
+          if (slot.model) {
+            model = slot.model;
+            slot.model.reset();
+          }
+
+          for (uint i=0; i<slot.coords.size(); ++i)
+            (*model)[i]->coords(slot.coords[i]);
+          if (slot.has_velocities)
+            for (uint i=0; i<slot.velocities.size(); ++i)
+              (*model)[i]->velocities(slot.velocities[i]);
+          if (slot.has_box)
+            model->periodicBox(slot.box);
+          else if (model->isPeriodic())
+            model->removePeriodicBox();
+
+          if (slot.has_step)
+            _writer->writeFrame(*model, slot.step, slot.time);
+          else
+            _writer->writeFrame(*model);
+        }
+        catch (std::exception& e) {
+          error = e.what();
+        }
+      }
+
+      lock.lock();
+      if (!error.empty() && _error.empty())
+        _error = error;
+      tail = (tail + 1) % _slots.size();
+      --_queued;
+      _busy = false;
+      _cond.notify_all();
+    }
+  }
+
+}
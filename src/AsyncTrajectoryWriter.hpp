@@ -0,0 +1,145 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_ASYNCTRAJECTORYWRITER_HPP)
+#define LOOS_ASYNCTRAJECTORYWRITER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <trajwriter.hpp>
+
+
+namespace loos {
+
+
+  //! Writes frames to another trajectory writer on a background thread
+  /**
+   * Wraps an existing pTrajectoryWriter so that formatting,
+   * compressing, and writing a frame overlaps with whatever the caller
+   * does next.  writeFrame() copies the group's coordinates and
+   * periodic box into one of \a depth reused buffers and returns.  A
+   * background thread then writes the buffered frames, in order, to
+   * the wrapped writer.  If all the buffers are waiting to be written,
+   * writeFrame() blocks until one is free.
+   * \code
+   * pTrajectoryWriter out(new AsyncTrajectoryWriter(createOutputTrajectory("out.xtc")));
+   * while (traj->readFrame()) {
+   *   traj->updateGroupCoords(model);
+   *   ...
+   *   out->writeFrame(model);
+   * }
+   * \endcode
+   *
+   * The wrapped writer is given a copy of the first group written,
+   * whose coordinates, box, and velocities are updated for each frame.
+   * Only the coordinates, periodic box, and velocities (if every atom
+   * has them) are taken from later frames written with the same
+   * atoms.  When a frame is written from a group with different atoms
+   * (even if it has the same number of them), a new copy is made.
+   *
+   * Errors from the wrapped writer are rethrown by the next call to
+   * writeFrame() or flush().  Destroying the AsyncTrajectoryWriter
+   * writes any frames still waiting.  The wrapped writer belongs to
+   * the background thread, so it must not be used directly while the
+   * AsyncTrajectoryWriter exists.
+   */
+  class AsyncTrajectoryWriter : public TrajectoryWriter, public boost::noncopyable {
+  public:
+    explicit AsyncTrajectoryWriter(const pTrajectoryWriter& writer, const uint depth = 4);
+
+    virtual ~AsyncTrajectoryWriter();
+
+    virtual void setComments(const std::vector<std::string>& comments);
+
+    virtual void writeFrame(const AtomicGroup& model);
+    virtual void writeFrame(const AtomicGroup& model, const uint step, const double time);
+
+    virtual bool hasFrameStep() const { return(_writer->hasFrameStep()); }
+    virtual bool hasFrameTime() const { return(_writer->hasFrameTime()); }
+    virtual bool hasComments() const { return(_writer->hasComments()); }
+
+    //! Frames given to the writer, including those not yet written
+    virtual uint framesWritten() const { return(_frames); }
+
+    virtual void bufferOutput(const size_t nbytes = 64 * 1024 * 1024);
+    virtual void useThreads(const uint nthreads = 0);
+
+    //! Waits for all frames to be written, then flushes the wrapped writer
+    virtual void flush();
+
+    //! Number of frames that may be waiting to be written
+    uint depth() const { return(_slots.size()); }
+
+    //! The writer being written to
+    pTrajectoryWriter writer() const { return(_writer); }
+
+  private:
+    struct Slot {
+      Slot() : has_velocities(false), has_box(false), has_step(false), step(0), time(0.0) { }
+
+      std::vector<GCoord> coords;
+      bool has_velocities;
+      std::vector<GCoord> velocities;
+      bool has_box;
+      GCoord box;
+      bool has_step;
+      uint step;
+      double time;
+      pAtomicGroup model;    // Set when the writer needs a new copy of the group
+    };
+
+    void enqueue(const AtomicGroup& model, const bool has_step, const uint step, const double time);
+    void waitForIdle(boost::unique_lock<boost::mutex>& lock);
+    void rethrow();
+    void writeBehind();
+
+  private:
+    pTrajectoryWriter _writer;
+    uint _frames;
+    std::vector<pAtom> _atoms; // Atoms of the group the writer was last given a copy of
+
+    std::vector<Slot> _slots;
+    uint _head;                // Next slot to fill
+    uint _queued;              // Slots waiting to be written
+    bool _busy;                // Writer thread is writing a frame
+    bool _shutdown;
+    std::string _error;        // First error from the writer thread
+    bool _reported;            // The error has been thrown to the caller
+
+    boost::thread* _thread;
+    boost::mutex _mutex;
+    boost::condition_variable _cond;
+  };
+
+}
+
+
+#endif
@@ -50,26 +50,26 @@ namespace loos {
     setPropertyBit(anumbit);
   }
 
-  std::string Atom::name(void) const { return(_name); }
-  void Atom::name(const std::string s) { _name = s; }
+  std::string Atom::name(void) const { return(_name.str()); }
+  void Atom::name(const std::string s) { _name = InternedString(s); }
 
-  std::string Atom::altLoc(void) const { return(_altloc); }
-  void Atom::altLoc(const std::string s) { _altloc = s; }
+  std::string Atom::altLoc(void) const { return(_altloc.str()); }
+  void Atom::altLoc(const std::string s) { _altloc = InternedString(s); }
 
-  std::string Atom::chainId(void) const { return(_chainid); }
-  void Atom::chainId(const std::string s) { _chainid = s; }
+  std::string Atom::chainId(void) const { return(_chainid.str()); }
+  void Atom::chainId(const std::string s) { _chainid = InternedString(s); }
 
-  std::string Atom::resname(void) const { return(_resname); }
-  void Atom::resname(const std::string s) { _resname = s; }
+  std::string Atom::resname(void) const { return(_resname.str()); }
+  void Atom::resname(const std::string s) { _resname = InternedString(s); }
 
-  std::string Atom::segid(void) const { return(_segid); }
-  void Atom::segid(const std::string s) { _segid = s; }
+  std::string Atom::segid(void) const { return(_segid.str()); }
+  void Atom::segid(const std::string s) { _segid = InternedString(s); }
 
-  std::string Atom::iCode(void) const { return(_icode); }
-  void Atom::iCode(const std::string s) { _icode = s; }
+  std::string Atom::iCode(void) const { return(_icode.str()); }
+  void Atom::iCode(const std::string s) { _icode = InternedString(s); }
 
-  std::string Atom::PDBelement(void) const { return(_pdbelement); }
-  void Atom::PDBelement(const std::string s) { _pdbelement = s; }
+  std::string Atom::PDBelement(void) const { return(_pdbelement.str()); }
+  void Atom::PDBelement(const std::string s) { _pdbelement = InternedString(s); }
 
   const GCoord& Atom::coords(void) const { return(_coords); }
   GCoord& Atom::coords(void) { setPropertyBit(coordsbit); return(_coords); }
@@ -102,8 +102,8 @@ namespace loos {
     //! Recordname imported from the PDB for this Atom
     //! This is mainly for atoms that come from a PDB, i.e. whether or
     //! not they were an ATOM or a HETATM
-  std::string Atom::recordName(void) const { return(_record); }
-  void Atom::recordName(const std::string s) { _record = s; }
+  std::string Atom::recordName(void) const { return(_record.str()); }
+  void Atom::recordName(const std::string s) { _record = InternedString(s); }
 
     //! Clear all stored bonds
   void Atom::clearBonds(void) { bonds.clear(); clearPropertyBit(bondsbit); }
@@ -186,6 +186,22 @@ namespace loos {
   }
 
 
+  namespace {
+
+    // Handles for the default strings, so new atoms don't need to look them up
+    struct AtomDefaults {
+      AtomDefaults() : name("    "), altloc(" "), resname("   "), chainid(" "), segid("    "), record("ATOM") { }
+      InternedString name, altloc, resname, chainid, segid, record;
+    };
+
+    const AtomDefaults& defaults(void) {
+      static AtomDefaults d;
+      return(d);
+    }
+
+  }
+
+
   void Atom::init() {
     _id = 1;
     _index = 0;
@@ -195,13 +211,15 @@ namespace loos {
     _q = 1.0;
     _charge = 0.0;
     _mass = 1.0;
-    _name = "    ";
-    _altloc = " ";
-    _resname = "   ";
-    _chainid = " ";
-    _segid = "    ";
-    _pdbelement = "";
-    _record = "ATOM";
+    const AtomDefaults& d = defaults();
+    _name = d.name;
+    _altloc = d.altloc;
+    _resname = d.resname;
+    _chainid = d.chainid;
+    _segid = d.segid;
+    _icode = InternedString();
+    _pdbelement = InternedString();
+    _record = d.record;
     _atom_type = -1;
     mask = nullbit;   // Nullbit means nothing was set...
   }
@@ -233,19 +251,19 @@ namespace loos {
 
 
   bool AtomEquals::operator()(const pAtom& a, const pAtom& b) const {
-    return(a->name() == b->name()
+    return(a->internedName() == b->internedName()
            && a->id() == b->id()
-           && a->resname() == b->resname()
+           && a->internedResname() == b->internedResname()
            && a->resid() == b->resid()
-           && a->segid() == b->segid());
+           && a->internedSegid() == b->internedSegid());
   }
 
   bool AtomCoordsEquals::operator()(const pAtom& a, const pAtom& b) const {
-    bool bb = (a->name() == b->name()
+    bool bb = (a->internedName() == b->internedName()
                && a->id() == b->id()
-               && a->resname() == b->resname()
+               && a->internedResname() == b->internedResname()
                && a->resid() == b->resid()
-               && a->segid() == b->segid());
+               && a->internedSegid() == b->internedSegid());
     if (!bb)
       return(false);
 
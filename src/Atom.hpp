@@ -32,6 +32,7 @@
 #include <loos_defs.hpp>
 #include <exceptions.hpp>
 #include <Coord.hpp>
+#include <InternedString.hpp>
 
 namespace loos {
 
@@ -44,6 +45,10 @@ namespace loos {
    * Most properties are derived from the PDB file specification.
    * Exceptions are noted below.  Accessors for each property are
    * provided and should be self-explanatory...
+   *
+   * The string properties are stored as InternedString handles, so
+   * an Atom holds no strings of its own.  The handles can be used to
+   * compare these properties between atoms without comparing strings.
    */
 
   
@@ -91,7 +96,7 @@ namespace loos {
       init();
       _index = 0;
       _id = i;
-      _name = s;
+      _name = InternedString(s);
       _coords = c;
     }
 
@@ -132,6 +137,24 @@ namespace loos {
     std::string PDBelement(void) const;
     void PDBelement(const std::string);
 
+#if !defined(SWIG)
+    //! Interned handles for the string properties used to identify an atom
+    InternedString internedName(void) const { return(_name); }
+    InternedString internedResname(void) const { return(_resname); }
+    InternedString internedSegid(void) const { return(_segid); }
+    InternedString internedChainId(void) const { return(_chainid); }
+
+    //! Set string properties from handles (used by the file parsers)
+    void recordName(const InternedString& s) { _record = s; }
+    void name(const InternedString& s) { _name = s; }
+    void altLoc(const InternedString& s) { _altloc = s; }
+    void chainId(const InternedString& s) { _chainid = s; }
+    void resname(const InternedString& s) { _resname = s; }
+    void segid(const InternedString& s) { _segid = s; }
+    void iCode(const InternedString& s) { _icode = s; }
+    void PDBelement(const InternedString& s) { _pdbelement = s; }
+#endif
+
 
 #if !defined(SWIG)
     //! Returns a const ref to internally stored coordinates.
@@ -265,12 +288,11 @@ namespace loos {
   private:
     int _id;
     uint _index;
-    std::string _record, _name, _altloc, _resname, _chainid;
+    InternedString _record, _name, _altloc, _resname, _chainid;
+    InternedString _icode, _segid, _pdbelement;
     int _resid;
     int _atomic_number;
-    std::string _icode;
     double _b, _q, _charge, _mass;
-    std::string _segid, _pdbelement;
     int _atom_type;
     GCoord _coords;
     GCoord _velocities;
@@ -0,0 +1,121 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <AtomColumns.hpp>
+#include <Atom.hpp>
+
+
+namespace loos {
+
+
+  // Atoms already hold interned handles, so each distinct handle just
+  // needs a local id the first time it's seen...
+
+  uint AtomColumns::intern(const InternedString& s) const {
+    if (s.id() >= _local.size())
+      _local.resize(InternedString::tableSize(), 0);
+
+    uint& k = _local[s.id()];
+    if (k == 0) {
+      _strings.push_back(s.str());
+      k = _strings.size();
+    }
+    return(k - 1);
+  }
+
+
+  AtomColumns::pStringColumn AtomColumns::buildStrings(const StringProperty prop) const {
+    boost::shared_ptr<StringColumn> col(new StringColumn(_group.size()));
+
+    for (uint i=0; i<_group.size(); ++i) {
+      const pAtom& pa = _group[i];
+      InternedString s;
+      switch(prop) {
+      case NAME:    s = pa->internedName(); break;
+      case RESNAME: s = pa->internedResname(); break;
+      case SEGID:   s = pa->internedSegid(); break;
+      case CHAINID: s = pa->internedChainId(); break;
+      }
+      (*col)[i] = intern(s);
+    }
+
+    return(col);
+  }
+
+
+  AtomColumns::pStringColumn AtomColumns::names() const {
+    if (!_names)
+      _names = buildStrings(NAME);
+    return(_names);
+  }
+
+  AtomColumns::pStringColumn AtomColumns::resnames() const {
+    if (!_resnames)
+      _resnames = buildStrings(RESNAME);
+    return(_resnames);
+  }
+
+  AtomColumns::pStringColumn AtomColumns::segids() const {
+    if (!_segids)
+      _segids = buildStrings(SEGID);
+    return(_segids);
+  }
+
+  AtomColumns::pStringColumn AtomColumns::chainIds() const {
+    if (!_chainids)
+      _chainids = buildStrings(CHAINID);
+    return(_chainids);
+  }
+
+
+  AtomColumns::pIntColumn AtomColumns::ids() const {
+    if (!_ids) {
+      boost::shared_ptr<IntColumn> col(new IntColumn(_group.size()));
+      for (uint i=0; i<_group.size(); ++i)
+        (*col)[i] = _group[i]->id();
+      _ids = col;
+    }
+    return(_ids);
+  }
+
+  AtomColumns::pIntColumn AtomColumns::resids() const {
+    if (!_resids) {
+      boost::shared_ptr<IntColumn> col(new IntColumn(_group.size()));
+      for (uint i=0; i<_group.size(); ++i)
+        (*col)[i] = _group[i]->resid();
+      _resids = col;
+    }
+    return(_resids);
+  }
+
+  AtomColumns::pIntColumn AtomColumns::indices() const {
+    if (!_indices) {
+      boost::shared_ptr<IntColumn> col(new IntColumn(_group.size()));
+      for (uint i=0; i<_group.size(); ++i)
+        (*col)[i] = static_cast<long>(_group[i]->index());
+      _indices = col;
+    }
+    return(_indices);
+  }
+
+
+}
@@ -0,0 +1,117 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_ATOMCOLUMNS_HPP)
+#define LOOS_ATOMCOLUMNS_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <InternedString.hpp>
+
+
+namespace loos {
+
+
+  //! The atom properties used by selections, stored as one array per property
+  /**
+   * Kernel::select() evaluates a selection over every atom of a group
+   * at once, one command at a time, using these arrays rather than
+   * asking each Atom for its properties.  The string properties
+   * (name, resname, segid, and chain ID) share a single table of the
+   * distinct strings found in the group, and each string column holds
+   * indices into that table.  String comparisons and regular
+   * expressions can then be evaluated once per distinct string
+   * instead of once per atom.
+   *
+   * Columns are only built the first time they are needed.  If many
+   * selections are made from the same group, make one AtomColumns
+   * and pass it to each selectAtoms() call so the columns are only
+   * built once:
+   * \code
+   * AtomColumns columns(model);
+   * AtomicGroup backbone = selectAtoms(columns, "backbone");
+   * AtomicGroup waters = selectAtoms(columns, "resname == 'TIP3'");
+   * \endcode
+   *
+   * The columns are a snapshot of the atoms' properties, so if these
+   * change (or atoms are added or removed) a new AtomColumns is
+   * needed.  Coordinates are not cached.  Since the columns are built
+   * on demand, an AtomColumns should not be shared between threads.
+   */
+  class AtomColumns {
+  public:
+    typedef std::vector<uint>      StringColumn;
+    typedef std::vector<long>      IntColumn;
+
+    typedef boost::shared_ptr<const StringColumn>  pStringColumn;
+    typedef boost::shared_ptr<const IntColumn>     pIntColumn;
+
+    explicit AtomColumns(const AtomicGroup& g) : _group(g) { }
+
+    //! Number of atoms
+    uint size() const { return(_group.size()); }
+
+    //! The group the columns were made from
+    const AtomicGroup& group() const { return(_group); }
+
+    pStringColumn names() const;
+    pStringColumn resnames() const;
+    pStringColumn segids() const;
+    pStringColumn chainIds() const;
+
+    pIntColumn ids() const;
+    pIntColumn resids() const;
+    pIntColumn indices() const;
+
+    //! Number of distinct strings interned so far
+    uint nstrings() const { return(_strings.size()); }
+
+    //! The interned string \a i
+    const std::string& string(const uint i) const { return(_strings[i]); }
+
+  private:
+    enum StringProperty { NAME, RESNAME, SEGID, CHAINID };
+
+    pStringColumn buildStrings(const StringProperty) const;
+    uint intern(const InternedString&) const;
+
+    AtomicGroup _group;
+
+    mutable pStringColumn _names, _resnames, _segids, _chainids;
+    mutable pIntColumn _ids, _resids, _indices;
+
+    mutable std::vector<std::string> _strings;
+    mutable std::vector<uint> _local;
+  };
+
+
+}
+
+
+#endif
@@ -33,6 +33,7 @@
 #include <boost/random.hpp>
 
 #include <AtomicGroup.hpp>
+#include <NeighborGrid.hpp>
 #include <AtomicNumberDeducer.hpp>
 #include <Selectors.hpp>
 
@@ -44,6 +45,10 @@ namespace loos {
   typedef boost::unordered_map<int,int>    IMap;
 
 
+  // Source of membership stamps (zero is never handed out)
+  static boost::atomic<unsigned long> next_generation(0);
+
+
 
   const double AtomicGroup::superposition_zero_singular_value  =  1e-10;
 
@@ -108,6 +113,7 @@ namespace loos {
 
     atoms.erase(iter);
     _sorted = false;
+    _generation = 0;
   }
 
 
@@ -119,6 +125,7 @@ namespace loos {
       atoms.push_back(*i);
 
     _sorted = false;
+    _generation = 0;
     return(*this);
   }
 
@@ -131,6 +138,7 @@ namespace loos {
       addAtom(*i);
 
     _sorted = false;
+    _generation = 0;
     return(*this);
   }
 
@@ -143,6 +151,7 @@ namespace loos {
       deleteAtom(*i);
 
     _sorted = false;
+    _generation = 0;
     return(*this);
   }
 
@@ -151,15 +160,17 @@ namespace loos {
   AtomicGroup& AtomicGroup::remove(const AtomicGroup& grp) {
 
 
-    if (&grp == this)
+    if (&grp == this) {
       atoms.clear();      // Assume caller meant to clean out AtomicGroup
-    else {
+      _generation = 0;
+    } else {
       std::vector<pAtom>::const_iterator i;
 
       for (i=grp.atoms.begin(); i != grp.atoms.end(); i++)
         deleteAtom(*i);
 
       _sorted = false;
+      _generation = 0;
       return(*this);
     }
 
@@ -176,6 +187,7 @@ namespace loos {
   AtomicGroup& AtomicGroup::operator+=(const pAtom& rhs) {
     atoms.push_back(rhs);
     _sorted = false;
+    _generation = 0;
     return(*this);
   }
 
@@ -238,11 +250,26 @@ namespace loos {
   }
 
 
+  // A new stamp is only taken when one is asked for, so building a
+  // group atom by atom doesn't touch the shared counter...
+  unsigned long AtomicGroup::generation() const {
+    unsigned long current = _generation.load();
+    if (current == 0) {
+      unsigned long fresh = ++next_generation;
+      if (_generation.compare_exchange_strong(current, fresh))
+        current = fresh;
+    }
+    return(current);
+  }
+
+
   void AtomicGroup::sort(void) {
     CmpById comp;
 
-    if (! _sorted)
+    if (! _sorted) {
       std::sort(atoms.begin(), atoms.end(), comp);
+      _generation = 0;
+    }
 
     _sorted = true;
   }
@@ -293,6 +320,7 @@ namespace loos {
     atoms.erase(boost::get<0>(iters), boost::get<1>(iters));
 
     _sorted = false;
+    _generation = 0;
 
     res.box = box;
     return(res);
@@ -314,6 +342,20 @@ namespace loos {
   }
 
 
+  AtomicGroup AtomicGroup::select(const std::vector<char>& mask) const {
+    if (mask.size() != atoms.size())
+      throw(LOOSError("Selection mask does not match the size of the AtomicGroup"));
+
+    AtomicGroup res;
+    for (uint i=0; i<atoms.size(); ++i)
+      if (mask[i])
+        res.addAtom(atoms[i]);
+
+    res.box = box;
+    return(res);
+  }
+
+
   // Split up a group into a vector of groups based on unique segids...
   std::vector<AtomicGroup> AtomicGroup::splitByUniqueSegid(void) const {
     const_iterator i;
@@ -853,6 +895,79 @@ namespace loos {
 
 
 
+  AtomicGroup AtomicGroup::within(const double dist, AtomicGroup& grp) const {
+    return(withinImpl(NeighborGrid(grp, dist)));
+  }
+
+  AtomicGroup AtomicGroup::within(const double dist, AtomicGroup& grp, const GCoord& box) const {
+    return(withinImpl(NeighborGrid(grp, dist, box)));
+  }
+
+  AtomicGroup AtomicGroup::withinImpl(const NeighborGrid& grid) const {
+    AtomicGroup res;
+    res.box = box;
+
+    for (const_iterator a = atoms.begin(); a != atoms.end(); ++a)
+      if (grid.hasNeighbor((*a)->coords()))
+        res.addAtom(*a);
+
+    return(res);
+  }
+
+
+  bool AtomicGroup::contactWith(const double dist, const AtomicGroup& grp, const uint min) const {
+    return(contactWithImpl(NeighborGrid(grp, dist), min));
+  }
+
+  bool AtomicGroup::contactWith(const double dist, const AtomicGroup& grp, const GCoord& box, const uint min) const {
+    return(contactWithImpl(NeighborGrid(grp, dist, box), min));
+  }
+
+  // Contacts are counted over all pairs, stopping once enough are
+  // found.  At least one contact is always required.
+  bool AtomicGroup::contactWithImpl(const NeighborGrid& grid, const uint min_contacts) const {
+    const uint needed = std::max(min_contacts, 1u);
+    uint ncontacts = 0;
+
+    for (const_iterator a = atoms.begin(); a != atoms.end(); ++a) {
+      ncontacts += grid.countNeighbors((*a)->coords(), needed - ncontacts);
+      if (ncontacts >= needed)
+        return(true);
+    }
+    return(false);
+  }
+
+
+  std::vector< std::pair<uint, uint> > AtomicGroup::pairsWithin(const double dist, const AtomicGroup& grp) const {
+    return(pairsWithinImpl(NeighborGrid(grp, dist)));
+  }
+
+  std::vector< std::pair<uint, uint> > AtomicGroup::pairsWithin(const double dist, const AtomicGroup& grp, const GCoord& box) const {
+    return(pairsWithinImpl(NeighborGrid(grp, dist, box)));
+  }
+
+  std::vector< std::pair<uint, uint> > AtomicGroup::pairsWithinImpl(const NeighborGrid& grid) const {
+    std::vector< std::pair<uint, uint> > pairs;
+
+    for (uint i=0; i<atoms.size(); ++i) {
+      std::vector<uint> found = grid.neighbors(atoms[i]->coords());
+      for (std::vector<uint>::const_iterator j = found.begin(); j != found.end(); ++j)
+        pairs.push_back(std::pair<uint, uint>(i, *j));
+    }
+
+    return(pairs);
+  }
+
+  std::vector< std::pair<uint, uint> > AtomicGroup::pairsWithin(const double dist) const {
+    return(NeighborGrid(*this, dist).pairs());
+  }
+
+  std::vector< std::pair<uint, uint> > AtomicGroup::pairsWithin(const double dist, const GCoord& box) const {
+    return(NeighborGrid(*this, dist, box).pairs());
+  }
+
+
+
 
 
 
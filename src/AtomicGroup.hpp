@@ -34,6 +34,7 @@
 #include <algorithm>
 
 #include <boost/unordered_set.hpp>
+#include <boost/atomic.hpp>
 
 
 #include <loos_defs.hpp>
@@ -65,6 +66,8 @@ namespace loos {
   class AtomicGroup;
   typedef boost::shared_ptr<AtomicGroup> pAtomicGroup;
 
+  class NeighborGrid;
+
 
   //! Class for handling groups of Atoms (pAtoms, actually)
   /** This class contains a collection of shared pointers to Atoms
@@ -95,13 +98,13 @@ namespace loos {
     static const double superposition_zero_singular_value;
 
   public:
-    AtomicGroup() : _sorted(false) { }
+    AtomicGroup() : _sorted(false), _generation(0) { }
 
     //! Creates a new AtomicGroup with \a n un-initialized atoms.
     /** The atoms will all have ascending atomid's beginning with 1, but
      *  otherwise no other properties will be set.
      */
-    AtomicGroup(const int n) : _sorted(true) {
+    AtomicGroup(const int n) : _sorted(true), _generation(0) {
       assert(n >= 1 && "Invalid size in AtomicGroup(n)");
       for (int i=1; i<=n; i++) {
         pAtom pa(new Atom);
@@ -113,10 +116,20 @@ namespace loos {
     //! Copy constructor (atoms and box shared)
     AtomicGroup(const AtomicGroup& g) :
       _sorted(g._sorted),
+      _generation(g.generation()),
       atoms(g.atoms),
       box(g.box)
       { }
 
+    //! Assignment (atoms and box shared)
+    AtomicGroup& operator=(const AtomicGroup& g) {
+      _sorted = g._sorted;
+      _generation = g.generation();
+      atoms = g.atoms;
+      box = g.box;
+      return(*this);
+    }
+
 
     virtual ~AtomicGroup() { }
 
@@ -152,7 +165,7 @@ namespace loos {
 #endif
 
     //! Append the atom onto the group
-    AtomicGroup& append(pAtom pa) { atoms.push_back(pa); _sorted = false; return(*this); }
+    AtomicGroup& append(pAtom pa) { atoms.push_back(pa); _sorted = false; _generation = 0; return(*this); }
     //! Append a vector of atoms
     AtomicGroup& append(std::vector<pAtom> pas);
     //! Append an entire AtomicGroup onto this one (concatenation)
@@ -310,6 +323,14 @@ namespace loos {
     //! Return a group consisting of atoms for which sel predicate returns true...
     AtomicGroup select(const AtomSelector& sel) const;
 
+#if !defined(SWIG)
+    //! Return a group consisting of atoms whose entry in \a mask is nonzero
+    /**
+     * The mask must have one entry per atom (e.g. from Kernel::evaluate())
+     */
+    AtomicGroup select(const std::vector<char>& mask) const;
+#endif
+
     //! Returns a vector of AtomicGroups split from the current group based on segid
     /**
      * The groups that are returned will be in the same order that the segids appear
@@ -410,6 +431,18 @@ namespace loos {
      */
     bool sorted(void) const { return(_sorted); }
 
+    //! Stamp identifying the group's current membership
+    /**
+     * The stamp changes whenever atoms are added to, removed from, or
+     * reordered in the group, and copies share the stamp of the group
+     * they were copied from.  Two groups with the same stamp have the
+     * same atoms in the same order, so this is a cheap way to tell
+     * whether something built from a group (e.g. a CoordinatePlan)
+     * still applies to it.  As with sorted(), replacing an atom via
+     * operator[] or an iterator is not tracked.
+     */
+    unsigned long generation() const;
+
     //! Sort based on atomid
     void sort(void);
 
@@ -446,16 +479,14 @@ namespace loos {
     void mergeImage();
 
     //! Find atoms in the current group that are within \a dist angstroms of any atom in \a grp
-    AtomicGroup within(const double dist, AtomicGroup& grp) const {
-      Distance2WithoutPeriodicity op;
-      return(within_private(dist, grp, op));
-    }
+    /**
+     * Uses a NeighborGrid built from \a grp, so the cost scales with
+     * the number of atoms rather than the number of pairs.
+     */
+    AtomicGroup within(const double dist, AtomicGroup& grp) const;
 
     //! Find atoms in \a grp that are within \a dist angstroms of atoms in the current group, considering periodicity
-    AtomicGroup within(const double dist, AtomicGroup& grp, const GCoord& box) const {
-      Distance2WithPeriodicity op(box);
-      return(within_private(dist, grp, op));
-    }
+    AtomicGroup within(const double dist, AtomicGroup& grp, const GCoord& box) const;
 
 
     //! Returns true if any atom of current group is within \a dist angstroms of \a grp
@@ -463,20 +494,32 @@ namespace loos {
      * \a min is the minimum number of pair-wise contacts required to be considered
      * in contact
      */
-    bool contactWith(const double dist, const AtomicGroup& grp, const uint min=1) const {
-      Distance2WithoutPeriodicity op;
-      return(contactwith_private(dist, grp, min, op));
-    }
+    bool contactWith(const double dist, const AtomicGroup& grp, const uint min=1) const;
 
     //! Returns true if any atom of current group is within \a dist angstroms of \a grp
     /**
      * \a min is the minimum number of pair-wise contacts required to be considered
      * in contact
      */
-    bool contactWith(const double dist, const AtomicGroup& grp, const GCoord& box, const uint min=1) const {
-      Distance2WithPeriodicity op(box);
-      return(contactwith_private(dist, grp, min, op));
-    }
+    bool contactWith(const double dist, const AtomicGroup& grp, const GCoord& box, const uint min=1) const;
+
+
+    //! Pairs of atoms, one from the current group and one from \a grp, within \a dist angstroms of each other
+    /**
+     * Each pair holds the index of the atom in the current group
+     * followed by the index of the atom in \a grp.  Pairs are sorted
+     * by the first index, then the second.
+     */
+    std::vector< std::pair<uint, uint> > pairsWithin(const double dist, const AtomicGroup& grp) const;
+
+    //! Pairs of atoms between the current group and \a grp within \a dist angstroms, considering periodicity
+    std::vector< std::pair<uint, uint> > pairsWithin(const double dist, const AtomicGroup& grp, const GCoord& box) const;
+
+    //! Pairs (i, j) with i < j of atoms in the current group within \a dist angstroms of each other
+    std::vector< std::pair<uint, uint> > pairsWithin(const double dist) const;
+
+    //! Pairs of atoms in the current group within \a dist angstroms, considering periodicity
+    std::vector< std::pair<uint, uint> > pairsWithin(const double dist, const GCoord& box) const;
 
 
     //! Distance-based search for bonds
@@ -783,7 +826,7 @@ namespace loos {
 	// These are functors for calculating distance between two coords
     // without and with periodicity.  These can be passed to functions
     // that need to support both ways of calculating distances, such
-    // was within_private() below...
+    // as findBondsImpl() below...
     struct Distance2WithoutPeriodicity {
       double operator()(const GCoord& a, const GCoord& b) const {
         return(a.distance2(b));
@@ -802,55 +845,11 @@ namespace loos {
 
 
 
-    // Find all atoms in the current group that are within dist
-    // angstroms of any atom in the passed group.  The distance
-    // calculation is determined by the passed functor so that the
-    // same code can be used for both periodic and non-periodic
-    // coordinates.
-
-    template <typename DistanceCalc>
-    AtomicGroup within_private(const double dist, AtomicGroup& grp, const DistanceCalc& distance_functor) const {
-
-      AtomicGroup res;
-      res.box = box;
-
-      double dist2 = dist * dist;
-      std::vector<uint> indices;
-
-      for (uint j=0; j<size(); j++) {
-        GCoord c = atoms[j]->coords();
-        for (uint i=0; i<grp.size(); i++) {
-          if (distance_functor(c, grp.atoms[i]->coords()) <= dist2) {
-            indices.push_back(j);
-            break;
-          }
-        }
-      }
-
-      if (indices.size() == 0)
-        return(res);
-
-      for (std::vector<uint>::const_iterator ci = indices.begin(); ci != indices.end(); ++ci)
-        res.addAtom(atoms[*ci]);
-
-      return(res);
-    }
-
-
-    template<typename DistanceCalc>
-    bool contactwith_private(const double dist, const AtomicGroup& grp, const uint min_contacts, const DistanceCalc& distance_function) const {
-      double dist2 = dist * dist;
-      uint ncontacts = 0;
-
-      for (uint j = 0; j<size(); ++j) {
-	GCoord c = atoms[j]->coords();
-	for (uint i = 0; i<grp.size(); ++i)
-	  if (distance_function(c, grp.atoms[i]->coords()) <= dist2)
-	    if (++ncontacts >= min_contacts)
-	      return(true);
-      }
-      return(false);
-    }
+    // Grid-based implementations of within(), contactWith(), and
+    // pairsWithin().  The grid holds the other group's atoms.
+    AtomicGroup withinImpl(const NeighborGrid& grid) const;
+    bool contactWithImpl(const NeighborGrid& grid, const uint min_contacts) const;
+    std::vector< std::pair<uint, uint> > pairsWithinImpl(const NeighborGrid& grid) const;
 
 
 	  //! Internal implementation of find bonds.
@@ -890,7 +889,7 @@ namespace loos {
 
     int rangeCheck(int) const;
 
-    void addAtom(pAtom pa) { atoms.push_back(pa); _sorted = false; }
+    void addAtom(pAtom pa) { atoms.push_back(pa); _sorted = false; _generation = 0; }
     void deleteAtom(pAtom pa);
 
     boost::tuple<iterator, iterator> calcSubsetIterators(const int offset, const int len = 0);
@@ -920,6 +919,10 @@ namespace loos {
 
     bool _sorted;
 
+    // Membership stamp (see generation()).  Zero means the membership
+    // has changed and a new stamp is handed out on demand.
+    mutable boost::atomic<unsigned long> _generation;
+
 
   protected:
 
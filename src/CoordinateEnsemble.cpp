@@ -0,0 +1,241 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+
+#include <CoordinateEnsemble.hpp>
+
+
+namespace loos {
+
+
+  CoordinateEnsemble::CoordinateEnsemble(const AtomicGroup& model)
+    : _model(model.copy()), _natoms(model.size()), _nframes(0), _periodic(model.isPeriodic()),
+      _mapped_data(0)
+  { }
+
+
+  CoordinateEnsemble::CoordinateEnsemble(const std::vector<AtomicGroup>& ensemble)
+    : _natoms(0), _nframes(0), _periodic(false), _mapped_data(0)
+  {
+    if (ensemble.empty())
+      return;
+
+    _model = ensemble[0].copy();
+    _natoms = _model.size();
+    _periodic = _model.isPeriodic();
+
+    reserve(ensemble.size());
+    for (std::vector<AtomicGroup>::const_iterator i = ensemble.begin(); i != ensemble.end(); ++i)
+      append(*i);
+  }
+
+
+  CoordinateEnsemble::CoordinateEnsemble(const AtomicGroup& model, const uint nframes, std::vector<float>& coords,
+                                         const pMappedFile& file, std::vector<GCoord>& boxes)
+    : _model(model.copy()), _natoms(model.size()), _nframes(nframes), _periodic(!boxes.empty()),
+      _mapped(file), _mapped_data(file ? reinterpret_cast<const float*>(file->data()) : 0)
+  {
+    _coords.swap(coords);
+    _boxes.swap(boxes);
+  }
+
+
+  void CoordinateEnsemble::unmap() {
+    if (!_mapped_data)
+      return;
+
+    _coords.assign(_mapped_data, _mapped_data + static_cast<size_t>(_nframes) * _natoms * 3);
+    _mapped.reset();
+    _mapped_data = 0;
+  }
+
+
+  void CoordinateEnsemble::checkFrame(const uint i) const {
+    if (i >= _nframes)
+      throw(LOOSError("Frame index exceeds the size of the CoordinateEnsemble"));
+  }
+
+
+  void CoordinateEnsemble::checkGroup(const AtomicGroup& g) const {
+    if (static_cast<uint>(g.size()) != _natoms)
+      throw(LOOSError("AtomicGroup does not match the size of the CoordinateEnsemble"));
+  }
+
+
+  GCoord CoordinateEnsemble::periodicBox(const uint i) const {
+    checkFrame(i);
+    if (!_periodic)
+      throw(LOOSError("CoordinateEnsemble is not periodic"));
+    return(_boxes[i]);
+  }
+
+
+  void CoordinateEnsemble::append(const AtomicGroup& g) {
+    if (_model.empty() && _nframes == 0) {
+      _model = g.copy();
+      _natoms = g.size();
+      _periodic = g.isPeriodic();
+    }
+    checkGroup(g);
+    unmap();
+
+    _coords.resize(_coords.size() + static_cast<size_t>(_natoms) * 3);
+    ++_nframes;
+    float* p = frame(_nframes - 1);
+    for (AtomicGroup::const_iterator i = g.begin(); i != g.end(); ++i) {
+      const GCoord& c = (*i)->coords();
+      *p++ = c.x();
+      *p++ = c.y();
+      *p++ = c.z();
+    }
+
+    if (_periodic)
+      _boxes.push_back(g.isPeriodic() ? g.periodicBox() : _model.periodicBox());
+  }
+
+
+  void CoordinateEnsemble::reserve(const uint n) {
+    unmap();
+    _coords.reserve(static_cast<size_t>(n) * _natoms * 3);
+    if (_periodic)
+      _boxes.reserve(n);
+  }
+
+
+  void CoordinateEnsemble::resize(const uint n) {
+    unmap();
+    _coords.resize(static_cast<size_t>(n) * _natoms * 3, 0.0f);
+    if (_periodic)
+      _boxes.resize(n, _model.periodicBox());
+    _nframes = n;
+  }
+
+
+  void CoordinateEnsemble::clear() {
+    _mapped.reset();
+    _mapped_data = 0;
+    _coords.clear();
+    _boxes.clear();
+    _nframes = 0;
+  }
+
+
+  void CoordinateEnsemble::copyFrame(const uint i, AtomicGroup& g) const {
+    checkFrame(i);
+    checkGroup(g);
+
+    const float* p = frame(i);
+    for (uint j=0; j<_natoms; ++j, p += 3)
+      g[j]->coords(GCoord(p[0], p[1], p[2]));
+    if (_periodic)
+      g.periodicBox(_boxes[i]);
+  }
+
+
+  void CoordinateEnsemble::copyFrame(const uint i, std::vector<double>& v) const {
+    checkFrame(i);
+
+    const uint n = _natoms * 3;
+    v.resize(n);
+    const float* p = frame(i);
+    for (uint j=0; j<n; ++j)
+      v[j] = p[j];
+  }
+
+
+  AtomicGroup CoordinateEnsemble::frameAsGroup(const uint i) const {
+    AtomicGroup g = _model.copy();
+    copyFrame(i, g);
+    return(g);
+  }
+
+
+  void CoordinateEnsemble::setFrame(const uint i, const AtomicGroup& g) {
+    checkFrame(i);
+    checkGroup(g);
+
+    float* p = frame(i);
+    for (AtomicGroup::const_iterator j = g.begin(); j != g.end(); ++j) {
+      const GCoord& c = (*j)->coords();
+      *p++ = c.x();
+      *p++ = c.y();
+      *p++ = c.z();
+    }
+    if (_periodic && g.isPeriodic())
+      _boxes[i] = g.periodicBox();
+  }
+
+
+  void CoordinateEnsemble::applyTransform(const uint i, const XForm& W) {
+    checkFrame(i);
+
+    GMatrix M = W.current();
+    float* p = frame(i);
+    for (uint j=0; j<_natoms; ++j, p += 3) {
+      GCoord c = M * GCoord(p[0], p[1], p[2]);
+      p[0] = c.x();
+      p[1] = c.y();
+      p[2] = c.z();
+    }
+  }
+
+
+  CoordinateEnsemble CoordinateEnsemble::emptyCopy() const {
+    CoordinateEnsemble e;
+    e._model = _model;
+    e._natoms = _natoms;
+    e._periodic = _periodic;
+    return(e);
+  }
+
+
+  CoordinateEnsemble CoordinateEnsemble::slice(const uint begin, const uint end) const {
+    if (begin > end || end > _nframes)
+      throw(LOOSError("Bad range for CoordinateEnsemble::slice()"));
+
+    CoordinateEnsemble e = emptyCopy();
+    e._nframes = end - begin;
+    e._coords.assign(data() + static_cast<size_t>(begin) * _natoms * 3,
+                     data() + static_cast<size_t>(end) * _natoms * 3);
+    if (_periodic)
+      e._boxes.assign(_boxes.begin() + begin, _boxes.begin() + end);
+    return(e);
+  }
+
+
+  CoordinateEnsemble CoordinateEnsemble::select(const std::vector<uint>& indices) const {
+    CoordinateEnsemble e = emptyCopy();
+    e.resize(indices.size());
+
+    const size_t n = static_cast<size_t>(_natoms) * 3;
+    for (uint i=0; i<indices.size(); ++i) {
+      checkFrame(indices[i]);
+      std::copy(frame(indices[i]), frame(indices[i]) + n, e.frame(i));
+      if (_periodic)
+        e._boxes[i] = _boxes[indices[i]];
+    }
+    return(e);
+  }
+
+
+}
@@ -0,0 +1,164 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_COORDINATEENSEMBLE_HPP)
+#define LOOS_COORDINATEENSEMBLE_HPP
+
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <MappedFile.hpp>
+#include <XForm.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! A set of structures that share one topology, stored as a block of coordinates
+  /**
+   * A std::vector<AtomicGroup> ensemble holds a complete copy of every
+   * atom for every frame.  A CoordinateEnsemble instead keeps a single
+   * copy of the atoms (the model) and one contiguous block of floats
+   * (x, y, z interleaved, one frame after another), so a frame costs
+   * 12 bytes per atom.  If the frames are periodic, their boxes are
+   * kept as well.
+   * \code
+   * CoordinateEnsemble ensemble;
+   * readTrajectory(ensemble, subset, traj);
+   * iterativeAlignment(ensemble);
+   * AtomicGroup avg = averageStructure(ensemble);
+   * \endcode
+   *
+   * Copies (and slices) share the model but not the coordinates.
+   * Frames can be turned back into AtomicGroups with copyFrame() or
+   * frameAsGroup() when a tool needs one.
+   *
+   * A SubsetCache keeps its frames in a CoordinateEnsemble.  When the
+   * cache is spilled to disk, the ensemble reads its coordinates from
+   * the mapped file, and copies share the mapping until one of them
+   * modifies its frames (which first copies them into memory).
+   */
+  class CoordinateEnsemble {
+  public:
+    CoordinateEnsemble() : _natoms(0), _nframes(0), _periodic(false), _mapped_data(0) { }
+
+    //! An empty ensemble of structures with the atoms of \a model
+    explicit CoordinateEnsemble(const AtomicGroup& model);
+
+    //! Packs an existing ensemble
+    explicit CoordinateEnsemble(const std::vector<AtomicGroup>& ensemble);
+
+    //! Number of frames
+    uint size() const { return(_nframes); }
+    bool empty() const { return(_nframes == 0); }
+
+    uint natoms() const { return(_natoms); }
+
+    //! The shared topology (its coordinates are those of whatever structure it was made from)
+    const AtomicGroup& model() const { return(_model); }
+
+    //! Size of the coordinates in bytes
+    size_t bytes() const { return(static_cast<size_t>(_nframes) * _natoms * 3 * sizeof(float)); }
+
+    //! True if the coordinates are read from a mapped file rather than held in memory
+    bool mapped() const { return(_mapped_data != 0); }
+
+    //! Copies mapped coordinates into memory
+    /**
+     * This happens automatically before any frame is modified, but it
+     * is not thread-safe, so call it first when several threads will
+     * modify frames of a mapped ensemble.
+     */
+    void unmap();
+
+    //! Interleaved coordinates for frame \a i (3 * natoms() floats)
+    float* frame(const uint i) { unmap(); return(&_coords[static_cast<size_t>(i) * _natoms * 3]); }
+    const float* frame(const uint i) const { return(data() + static_cast<size_t>(i) * _natoms * 3); }
+
+    //! True if the frames carry periodic boxes
+    bool isPeriodic() const { return(_periodic); }
+    GCoord periodicBox(const uint i) const;
+
+    //! Adds a frame with the current coordinates of \a g
+    void append(const AtomicGroup& g);
+
+    void reserve(const uint n);
+
+    //! Changes the number of frames (new frames are zeroed)
+    void resize(const uint n);
+
+    //! Removes all frames (the model is kept)
+    void clear();
+
+    //! Copies frame \a i into the atoms of \a g (and its box, if periodic)
+    void copyFrame(const uint i, AtomicGroup& g) const;
+
+    //! Copies frame \a i into \a v (as with AtomicGroup::coordsAsVector())
+    void copyFrame(const uint i, std::vector<double>& v) const;
+
+    //! A new AtomicGroup (a deep copy of the model) holding frame \a i
+    AtomicGroup frameAsGroup(const uint i) const;
+
+    //! Replaces frame \a i with the coordinates of \a g
+    void setFrame(const uint i, const AtomicGroup& g);
+
+    //! Applies \a W to every atom in frame \a i
+    void applyTransform(const uint i, const XForm& W);
+
+    //! The frames [begin, end)
+    CoordinateEnsemble slice(const uint begin, const uint end) const;
+
+    //! The listed frames, in the order given (frames may repeat)
+    CoordinateEnsemble select(const std::vector<uint>& indices) const;
+
+  private:
+    friend class SubsetCache;
+
+    // Takes over \a coords (or, if \a file is set, reads the frames
+    // from it) along with \a boxes, which is either empty or holds one
+    // box per frame
+    CoordinateEnsemble(const AtomicGroup& model, const uint nframes, std::vector<float>& coords,
+                       const pMappedFile& file, std::vector<GCoord>& boxes);
+
+    const float* data() const { return(_mapped_data ? _mapped_data : _coords.data()); }
+
+    void checkFrame(const uint i) const;
+    void checkGroup(const AtomicGroup& g) const;
+    CoordinateEnsemble emptyCopy() const;
+
+    AtomicGroup _model;
+    uint _natoms, _nframes;
+    bool _periodic;
+    std::vector<float> _coords;
+    std::vector<GCoord> _boxes;
+    pMappedFile _mapped;
+    const float* _mapped_data;
+  };
+
+
+}
+
+
+#endif
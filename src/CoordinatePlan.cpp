@@ -0,0 +1,66 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+
+#include <CoordinatePlan.hpp>
+
+
+namespace loos {
+
+
+  CoordinatePlan::CoordinatePlan(const AtomicGroup& g) : _generation(g.generation()), _max_index(0) {
+    _indices.reserve(g.size());
+
+    for (AtomicGroup::const_iterator i = g.begin(); i != g.end(); ++i) {
+      if (!(*i)->checkProperty(Atom::indexbit))
+        throw(LOOSError(**i, "Cannot build a CoordinatePlan from an atom without an index"));
+      uint idx = (*i)->index();
+      _indices.push_back(idx);
+      if (idx > _max_index)
+        _max_index = idx;
+    }
+
+    _unique = _indices;
+    std::sort(_unique.begin(), _unique.end());
+    _unique.erase(std::unique(_unique.begin(), _unique.end()), _unique.end());
+
+    // Coalesce atoms whose frame indices follow one after the other
+    for (uint i=0; i<_indices.size(); ) {
+      uint j = i + 1;
+      while (j < _indices.size() && _indices[j] == _indices[j-1] + 1)
+        ++j;
+      _runs.push_back(Run(_indices[i], i, j - i));
+      i = j;
+    }
+  }
+
+
+  void CoordinatePlan::scatter(AtomicGroup& g, const std::vector<GCoord>& frame) const {
+    AtomicGroup::iterator a = g.begin();
+    for (std::vector<Run>::const_iterator r = _runs.begin(); r != _runs.end(); ++r)
+      for (uint i = r->frame_start; i < r->frame_start + r->length; ++i, ++a)
+        (*a)->coords(frame[i]);
+  }
+
+
+}
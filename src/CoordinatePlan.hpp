@@ -0,0 +1,154 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_COORDINATEPLAN_HPP)
+#define LOOS_COORDINATEPLAN_HPP
+
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Precomputed mapping from a trajectory frame into an AtomicGroup
+  /**
+   * Trajectory::updateGroupCoords() has to look up each atom's index
+   * (through its shared pointer) and bounds-check it on every frame.
+   * When the same selection is read over many frames, that work can
+   * be done once by building a CoordinatePlan from the group and
+   * passing it along:
+   * \code
+   * AtomicGroup subset = selectAtoms(model, "name == 'CA'");
+   * CoordinatePlan plan(subset);
+   * while (traj->readFrame()) {
+   *   traj->updateGroupCoords(subset, plan);
+   *   ...
+   * }
+   * \endcode
+   *
+   * The plan records the frame index for each atom (in group order),
+   * the set of frame indices that are needed (sorted and without
+   * duplicates), and the runs of atoms whose frame indices are
+   * consecutive.  The scatter functions walk the runs, so the frame
+   * is read in order without going back to the per-atom indices.  The
+   * coordinates still have to be set atom by atom, since that is where
+   * an AtomicGroup keeps them.
+   *
+   * A plan is tied to the atoms of the group it was built from, in
+   * the same order (a light copy of the group works, a deep copy does
+   * not).  The plan records the group's membership stamp (see
+   * AtomicGroup::generation()), and Trajectory::updateGroupCoords()
+   * compares it with the group's on each call, throwing if they
+   * differ.  The scatter functions do not check, so callers using
+   * them directly should call matches() first.
+   * If the group changes, build a new plan.  Changing an atom's index
+   * after the plan is built is not detected.
+   */
+  class CoordinatePlan {
+  public:
+
+    //! A run of consecutive frame indices mapping onto consecutive group atoms
+    struct Run {
+      Run(const uint f, const uint g, const uint n) : frame_start(f), group_start(g), length(n) { }
+
+      uint frame_start;
+      uint group_start;
+      uint length;
+    };
+
+    CoordinatePlan() : _generation(0), _max_index(0) { }
+
+    //! Build a plan from the atom indices in \a g
+    explicit CoordinatePlan(const AtomicGroup& g);
+
+    //! Number of atoms in the group the plan was built from
+    uint size() const { return(_indices.size()); }
+    bool empty() const { return(_indices.empty()); }
+
+    //! Frame index for each atom, in group order
+    const std::vector<uint>& indices() const { return(_indices); }
+
+    //! Sorted, unique frame indices needed by the group
+    const std::vector<uint>& uniqueIndices() const { return(_unique); }
+
+    //! Runs of consecutive frame indices, in group order
+    const std::vector<Run>& runs() const { return(_runs); }
+
+    //! Largest frame index used by the group
+    uint maxIndex() const { return(_max_index); }
+
+    //! True if the group maps onto a single contiguous block of the frame
+    bool contiguous() const { return(_runs.size() <= 1); }
+
+    //! Does \a g have the same atoms, in the same order, as the group the plan was built from?
+    bool matches(const AtomicGroup& g) const {
+      return(g.generation() == _generation);
+    }
+
+    //! Throws if the plan needs atoms beyond a frame of \a natoms
+    void validate(const uint natoms) const {
+      if (!_indices.empty() && _max_index >= natoms)
+        throw(LOOSError("Atom index in CoordinatePlan is out of bounds for the trajectory frame"));
+    }
+
+
+    //! Copy coordinates from separate x, y, and z arrays (e.g. DCD) into \a g
+    template<typename T>
+    void scatter(AtomicGroup& g, const T* x, const T* y, const T* z) const {
+      AtomicGroup::iterator a = g.begin();
+      for (std::vector<Run>::const_iterator r = _runs.begin(); r != _runs.end(); ++r)
+        for (uint i = r->frame_start; i < r->frame_start + r->length; ++i, ++a)
+          (*a)->coords(GCoord(x[i], y[i], z[i]));
+    }
+
+    //! Copy coordinates from an interleaved (xyzxyz...) array into \a g
+    template<typename T>
+    void scatterInterleaved(AtomicGroup& g, const T* xyz) const {
+      AtomicGroup::iterator a = g.begin();
+      for (std::vector<Run>::const_iterator r = _runs.begin(); r != _runs.end(); ++r) {
+        const T* p = xyz + 3 * r->frame_start;
+        for (uint k=0; k<r->length; ++k, ++a, p += 3)
+          (*a)->coords(GCoord(p[0], p[1], p[2]));
+      }
+    }
+
+    //! Copy coordinates from a frame of GCoords into \a g
+    void scatter(AtomicGroup& g, const std::vector<GCoord>& frame) const;
+
+  private:
+    unsigned long _generation;
+    std::vector<uint> _indices;
+    std::vector<uint> _unique;
+    std::vector<Run> _runs;
+    uint _max_index;
+  };
+
+
+}
+
+
+#endif
@@ -0,0 +1,335 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include <algorithm>
+
+#include <CovarianceAccumulator.hpp>
+
+
+namespace loos {
+
+
+  namespace {
+
+    // Owns the vector holding a released covariance, so the matrix
+    // that wraps its data can free it
+    struct VectorDeleter {
+      VectorDeleter(std::vector<double>* v) : vec(v) { }
+      void operator()(double*) { delete vec; }
+      std::vector<double>* vec;
+    };
+
+
+    // Eigendecomposition of C in place, sorted largest first
+    boost::tuple<DoubleMatrix, DoubleMatrix> sortedEigenDecomp(DoubleMatrix& C) {
+      DoubleMatrix W = Math::eigenDecomp(C);
+
+      Math::reverseColumns(C);
+      Math::reverseRows(W);
+      for (uint i=0; i<W.rows(); ++i)
+        if (W[i] < 0.0)
+          W[i] = 0.0;
+
+      return(boost::tuple<DoubleMatrix, DoubleMatrix>(W, C));
+    }
+
+  }
+
+
+  CovarianceAccumulator::CovarianceAccumulator(const bool full)
+    : _full(full), _m(0), _block(64), _n(0), _pending(0)
+  { }
+
+
+  CovarianceAccumulator::CovarianceAccumulator(const uint natoms, const bool full)
+    : _full(full), _m(0), _block(64), _n(0), _pending(0)
+  {
+    resize(natoms);
+  }
+
+
+  void CovarianceAccumulator::resize(const uint natoms) {
+    if (natoms == 0)
+      throw(LOOSError("CovarianceAccumulator needs at least one atom"));
+
+    _m = natoms * 3;
+    _mean.assign(_m, 0.0);
+    _m2.assign(_full ? static_cast<ulong>(_m) * _m : _m, 0.0);
+    _buffer.assign(static_cast<ulong>(_m) * _block, 0.0);
+  }
+
+
+  void CovarianceAccumulator::blockSize(const uint b) {
+    flush();
+    _block = b > 0 ? b : 1;
+    if (_m)
+      _buffer.assign(static_cast<ulong>(_m) * _block, 0.0);
+  }
+
+
+  void CovarianceAccumulator::clear() {
+    _n = 0;
+    _pending = 0;
+    std::fill(_mean.begin(), _mean.end(), 0.0);
+    std::fill(_m2.begin(), _m2.end(), 0.0);
+  }
+
+
+  double* CovarianceAccumulator::nextColumn(const uint natoms) {
+    if (_m == 0)
+      resize(natoms);
+    else if (natoms * 3 != _m)
+      throw(LOOSError("Structure added to CovarianceAccumulator has the wrong number of atoms"));
+
+    return(&_buffer[static_cast<ulong>(_pending) * _m]);
+  }
+
+
+  void CovarianceAccumulator::columnAdded() {
+    if (++_pending == _block)
+      flush();
+  }
+
+
+  void CovarianceAccumulator::add(const AtomicGroup& frame) {
+    double* p = nextColumn(frame.size());
+    for (AtomicGroup::const_iterator i = frame.begin(); i != frame.end(); ++i) {
+      const GCoord& c = (*i)->coords();
+      *p++ = c.x();
+      *p++ = c.y();
+      *p++ = c.z();
+    }
+    columnAdded();
+  }
+
+
+  void CovarianceAccumulator::add(const double* xyz) {
+    if (_m == 0)
+      throw(LOOSError("The size of a CovarianceAccumulator must be set before adding raw coordinates"));
+    std::copy(xyz, xyz + _m, nextColumn(_m / 3));
+    columnAdded();
+  }
+
+
+  void CovarianceAccumulator::add(const float* xyz) {
+    if (_m == 0)
+      throw(LOOSError("The size of a CovarianceAccumulator must be set before adding raw coordinates"));
+    std::copy(xyz, xyz + _m, nextColumn(_m / 3));
+    columnAdded();
+  }
+
+
+  // Folds nb frames with mean mean_b and squared deviations m2_b into
+  // the totals.  If m2_b is null, the block's deviations have already
+  // been added to _m2.
+
+  void CovarianceAccumulator::combine(const ulong nb, const double* mean_b, const double* m2_b) const {
+    if (nb == 0)
+      return;
+
+    const ulong size = _m2.size();
+    if (m2_b)
+      for (ulong i=0; i<size; ++i)
+        _m2[i] += m2_b[i];
+
+    const ulong n = _n + nb;
+    const double f = static_cast<double>(_n) * nb / n;
+    const double g = static_cast<double>(nb) / n;
+
+    std::vector<double> delta(_m);
+    for (uint i=0; i<_m; ++i)
+      delta[i] = mean_b[i] - _mean[i];
+
+    if (_n > 0) {
+      if (_full) {
+        for (uint j=0; j<_m; ++j) {
+          double* col = &_m2[static_cast<ulong>(j) * _m];
+          const double d = f * delta[j];
+          for (uint i=0; i<_m; ++i)
+            col[i] += d * delta[i];
+        }
+      } else
+        for (uint i=0; i<_m; ++i)
+          _m2[i] += f * delta[i] * delta[i];
+    }
+
+    for (uint i=0; i<_m; ++i)
+      _mean[i] += g * delta[i];
+    _n = n;
+  }
+
+
+  void CovarianceAccumulator::flush() const {
+    if (_pending == 0)
+      return;
+
+    f77int m = _m;
+    f77int nb = _pending;
+    double* X = &_buffer[0];
+
+    std::vector<double> mb(_m, 0.0);
+    for (f77int c=0; c<nb; ++c)
+      for (f77int r=0; r<m; ++r)
+        mb[r] += X[c * m + r];
+    for (f77int r=0; r<m; ++r)
+      mb[r] /= nb;
+    for (f77int c=0; c<nb; ++c)
+      for (f77int r=0; r<m; ++r)
+        X[c * m + r] -= mb[r];
+
+    if (_full) {
+      // _m2 += X * X'
+      double alpha = 1.0;
+      double beta = 1.0;
+#if defined(__linux__) || defined(__CYGWIN__) || defined(__FreeBSD__)
+      char ta = 'N';
+      char tb = 'T';
+      dgemm_(&ta, &tb, &m, &m, &nb, &alpha, X, &m, X, &m, &beta, &_m2[0], &m);
+#else
+      cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, m, m, nb, alpha, X, m, X, m, beta, &_m2[0], m);
+#endif
+    } else
+      for (f77int c=0; c<nb; ++c)
+        for (f77int r=0; r<m; ++r)
+          _m2[r] += X[c * m + r] * X[c * m + r];
+
+    _pending = 0;
+    combine(nb, &mb[0], 0);
+  }
+
+
+  void CovarianceAccumulator::merge(const CovarianceAccumulator& other) {
+    if (other._m == 0)
+      return;
+    if (_m == 0)
+      resize(other._m / 3);
+    if (other._m != _m)
+      throw(LOOSError("Cannot merge CovarianceAccumulators of different sizes"));
+    if (_full && !other._full)
+      throw(LOOSError("Cannot merge a diagonal CovarianceAccumulator into a full one"));
+
+    other.flush();
+    flush();
+
+    if (_full == other._full)
+      combine(other._n, &other._mean[0], &other._m2[0]);
+    else {
+      std::vector<double> diag(_m);
+      for (uint i=0; i<_m; ++i)
+        diag[i] = other._m2[static_cast<ulong>(i) * _m + i];
+      combine(other._n, &other._mean[0], &diag[0]);
+    }
+  }
+
+
+  std::vector<double> CovarianceAccumulator::mean() const {
+    if (count() == 0)
+      throw(LOOSError("No structures have been added to the CovarianceAccumulator"));
+    flush();
+    return(_mean);
+  }
+
+
+  AtomicGroup CovarianceAccumulator::average(const AtomicGroup& model) const {
+    if (static_cast<uint>(model.size()) * 3 != _m)
+      throw(LOOSError("Model passed to CovarianceAccumulator::average() has the wrong number of atoms"));
+
+    std::vector<double> mu = mean();
+    AtomicGroup avg = model.copy();
+    for (uint i=0; i<avg.size(); ++i)
+      avg[i]->coords(GCoord(mu[3*i], mu[3*i+1], mu[3*i+2]));
+    return(avg);
+  }
+
+
+  DoubleMatrix CovarianceAccumulator::covariance() const {
+    if (!_full)
+      throw(LOOSError("CovarianceAccumulator was not built to keep the full covariance"));
+    if (count() == 0)
+      throw(LOOSError("No structures have been added to the CovarianceAccumulator"));
+    flush();
+
+    DoubleMatrix C(_m, _m);
+    const ulong size = _m2.size();
+    for (ulong i=0; i<size; ++i)
+      C[i] = _m2[i] / _n;
+    return(C);
+  }
+
+
+  DoubleMatrix CovarianceAccumulator::variances() const {
+    if (count() == 0)
+      throw(LOOSError("No structures have been added to the CovarianceAccumulator"));
+    flush();
+
+    DoubleMatrix V(_m, 1);
+    for (uint i=0; i<_m; ++i)
+      V[i] = (_full ? _m2[static_cast<ulong>(i) * _m + i] : _m2[i]) / _n;
+    return(V);
+  }
+
+
+  std::vector<double> CovarianceAccumulator::fluctuations() const {
+    DoubleMatrix V = variances();
+    std::vector<double> rmsf(_m / 3);
+    for (uint i=0; i<rmsf.size(); ++i)
+      rmsf[i] = sqrt(V[3*i] + V[3*i+1] + V[3*i+2]);
+    return(rmsf);
+  }
+
+
+  boost::tuple<DoubleMatrix, DoubleMatrix> CovarianceAccumulator::eigenDecomp() const {
+    DoubleMatrix C = covariance();
+    return(sortedEigenDecomp(C));
+  }
+
+
+  // The covariance is scaled in place and its storage handed over to
+  // the matrix that is decomposed
+
+  boost::tuple<DoubleMatrix, DoubleMatrix> CovarianceAccumulator::releaseEigenDecomp() {
+    if (!_full)
+      throw(LOOSError("CovarianceAccumulator was not built to keep the full covariance"));
+    if (count() == 0)
+      throw(LOOSError("No structures have been added to the CovarianceAccumulator"));
+    flush();
+
+    std::vector<double>* m2 = new std::vector<double>;
+    m2->swap(_m2);
+    const ulong size = m2->size();
+    for (ulong i=0; i<size; ++i)
+      (*m2)[i] /= _n;
+
+    DoubleMatrix C(boost::shared_array<double>(&(*m2)[0], VectorDeleter(m2)), _m, _m);
+
+    _m = 0;
+    _n = 0;
+    _pending = 0;
+    std::vector<double>().swap(_mean);
+    std::vector<double>().swap(_buffer);
+
+    return(sortedEigenDecomp(C));
+  }
+
+
+}
@@ -0,0 +1,173 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_COVARIANCEACCUMULATOR_HPP)
+#define LOOS_COVARIANCEACCUMULATOR_HPP
+
+#include <vector>
+
+#include <boost/tuple/tuple.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <MatrixOps.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Running mean and covariance of a set of structures, one frame at a time
+  /**
+   * Frames (already aligned, if that matters) are added one at a
+   * time, so the ensemble never has to be held in memory:
+   * \code
+   * CovarianceAccumulator acc;
+   * while (traj->readFrame()) {
+   *   traj->updateGroupCoords(subset);
+   *   subset.alignOnto(target);
+   *   acc.add(subset);
+   * }
+   * AtomicGroup avg = acc.average(subset);
+   * boost::tuple<DoubleMatrix, DoubleMatrix> eig = acc.eigenDecomp();
+   * \endcode
+   *
+   * Frames are collected into small blocks.  Each block is centered
+   * on its own mean, its scatter matrix is formed with one BLAS call,
+   * and it is folded into the running totals with the pairwise update
+   * of Chan, Golub, and LeVeque (the blocked form of Welford's
+   * algorithm), so the result does not suffer from the cancellation
+   * of a naive sum-of-squares.  The same update combines two
+   * accumulators with merge(), so separate threads or trajectory
+   * chunks can each fill their own and merge them at the end.
+   *
+   * Frames still waiting in a partial block are folded in the first
+   * time a result is asked for, so the const accessors (mean(),
+   * covariance(), eigenDecomp(), and so on) and merge() (on \a other)
+   * may modify the accumulator's internal state.  An accumulator is
+   * therefore not safe to use from more than one thread at a time,
+   * even if every thread only calls const methods.
+   *
+   * A full accumulator keeps the 3N x 3N covariance.  When only the
+   * per-coordinate variances are needed (for example, for RMSFs),
+   * construct it with \a full set to false and the memory used is
+   * linear in the number of atoms.
+   *
+   * The covariance is normalized by the number of frames (not n-1),
+   * so its eigenvalues are the squares of the singular values from
+   * svd divided by the number of frames.
+   */
+  class CovarianceAccumulator {
+  public:
+
+    //! Size is set by the first frame added
+    explicit CovarianceAccumulator(const bool full = true);
+
+    //! Accumulator for structures with \a natoms atoms
+    CovarianceAccumulator(const uint natoms, const bool full);
+
+    //! Adds a structure (the atoms' current coordinates)
+    void add(const AtomicGroup& frame);
+
+    //! Adds a structure given as interleaved coordinates (xyzxyz...)
+    void add(const double* xyz);
+    void add(const float* xyz);
+
+    //! Folds \a other into this accumulator
+    void merge(const CovarianceAccumulator& other);
+
+    //! Forget everything that has been added (the size is kept)
+    void clear();
+
+    //! Number of frames added (including merged ones)
+    ulong count() const { return(_n + _pending); }
+
+    uint natoms() const { return(_m / 3); }
+
+    //! True if the full covariance (rather than just its diagonal) is kept
+    bool full() const { return(_full); }
+
+    //! Number of frames collected before folding them in (default is 64)
+    void blockSize(const uint b);
+    uint blockSize() const { return(_block); }
+
+    //! The mean coordinates, interleaved (xyzxyz...)
+    std::vector<double> mean() const;
+
+    //! A copy of \a model with the mean coordinates
+    AtomicGroup average(const AtomicGroup& model) const;
+
+    //! The 3N x 3N coordinate covariance (only for a full accumulator)
+    DoubleMatrix covariance() const;
+
+    //! The variance of each coordinate (3N x 1)
+    DoubleMatrix variances() const;
+
+    //! Root mean square fluctuation of each atom
+    std::vector<double> fluctuations() const;
+
+    //! Eigendecomposition of the covariance
+    /**
+     * Returns the eigenvalues (largest first, with any negative
+     * round-off set to zero) and the eigenvectors (as columns, in the
+     * same order).
+     */
+    boost::tuple<DoubleMatrix, DoubleMatrix> eigenDecomp() const;
+
+    //! Eigendecomposition of the covariance, reusing the accumulator's storage
+    /**
+     * Like eigenDecomp(), but the eigenvectors are computed in the
+     * memory that holds the covariance rather than in a copy of it,
+     * so only one 3N x 3N matrix is ever allocated.  The accumulator
+     * is left empty, as if it had just been constructed, so get the
+     * mean() first if it is needed.
+     */
+    boost::tuple<DoubleMatrix, DoubleMatrix> releaseEigenDecomp();
+
+  private:
+    void resize(const uint natoms);
+    double* nextColumn(const uint natoms);
+    void columnAdded();
+    // Folds any pending frames into the totals (see the class notes)
+    void flush() const;
+    void combine(const ulong nb, const double* mean_b, const double* m2_b) const;
+
+    bool _full;
+    uint _m, _block;
+
+    // Folded-in frames: count, mean, and the sum of squared deviations
+    // (the whole matrix, column-major, or just the diagonal)
+    mutable ulong _n;
+    mutable std::vector<double> _mean;
+    mutable std::vector<double> _m2;
+
+    // Frames waiting to be folded in, one per column
+    mutable uint _pending;
+    mutable std::vector<double> _buffer;
+  };
+
+
+}
+
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <FrameMapReduce.hpp>
+#include <sfactories.hpp>
+#include <xtc.hpp>
+
+
+namespace loos {
+
+
+  void TrajectoryOpener::init(pTraj traj) {
+    if (!traj)
+      traj = open();
+
+    boost::shared_ptr<XTC> xtc = boost::dynamic_pointer_cast<XTC>(traj);
+    if (xtc)
+      _xtc_index = boost::shared_ptr<TrajectoryIndex>(new TrajectoryIndex(xtc->index()));
+  }
+
+
+  pTraj TrajectoryOpener::open() const {
+    if (_type.empty())
+      return(createTrajectory(_name, _model));
+    return(createTrajectory(_name, _type, _model));
+  }
+
+
+  pTraj TrajectoryOpener::operator()() const {
+    if (_xtc_index)
+      return(pTraj(new XTC(_name, *_xtc_index)));
+    return(open());
+  }
+
+
+  namespace internal {
+
+    std::vector< std::pair<uint, uint> > frameChunks(const uint n, const uint nchunks) {
+      std::vector< std::pair<uint, uint> > chunks;
+      uint begin = 0;
+      for (uint i=0; i<nchunks; ++i) {
+        uint end = static_cast<uint>((static_cast<unsigned long>(n) * (i+1)) / nchunks);
+        chunks.push_back(std::pair<uint, uint>(begin, end));
+        begin = end;
+      }
+      return(chunks);
+    }
+
+
+    void readFrameFrom(pTraj& traj, const uint frame, long& last) {
+      bool ok;
+      if (last >= 0 && frame == static_cast<uint>(last + 1))
+        ok = traj->readFrame();
+      else
+        ok = traj->readFrame(frame);
+
+      if (!ok)
+        throw(LOOSError("Unable to read frame from trajectory " + traj->filename()));
+      last = frame;
+    }
+
+
+    uint threadsFor(const uint n, uint nthreads, const uint grain) {
+      if (nthreads == 0)
+        nthreads = boost::thread::hardware_concurrency();
+      if (nthreads == 0)
+        nthreads = 1;
+
+      uint most = grain > 0 ? n / grain : n;
+      if (nthreads > most)
+        nthreads = most;
+      return(nthreads > 0 ? nthreads : 1);
+    }
+
+  }
+
+}
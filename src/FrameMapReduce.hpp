@@ -0,0 +1,265 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_FRAMEMAPREDUCE_HPP)
+#define LOOS_FRAMEMAPREDUCE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <CoordinatePlan.hpp>
+#include <Trajectory.hpp>
+#include <TrajectoryIndex.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Opens a new handle on a trajectory for each worker in frameMapReduce()
+  /**
+   * Trajectories keep their file position as state, so worker threads
+   * cannot share one.  A TrajectoryOpener remembers how the trajectory
+   * was named on the command line and opens a fresh copy on request.
+   * An empty type lets createTrajectory() pick the format from the
+   * filename's extension, as the OptionsFramework does.
+   *
+   * The trajectory is opened once when the TrajectoryOpener is made
+   * (or the already opened \a traj is used).  If it is an XTC, the
+   * frames found then are handed to every copy opened later, so the
+   * workers do not each scan the file.
+   */
+  class TrajectoryOpener {
+  public:
+    TrajectoryOpener(const std::string& name, const AtomicGroup& model, const pTraj& traj = pTraj())
+      : _name(name), _model(model) { init(traj); }
+
+    TrajectoryOpener(const std::string& name, const std::string& type, const AtomicGroup& model,
+                     const pTraj& traj = pTraj())
+      : _name(name), _type(type), _model(model) { init(traj); }
+
+    pTraj operator()() const;
+
+  private:
+    void init(pTraj traj);
+    pTraj open() const;
+
+    std::string _name, _type;
+    AtomicGroup _model;
+    boost::shared_ptr<TrajectoryIndex> _xtc_index;
+  };
+
+
+  //! Convenience base class for frameMapReduce() kernels
+  /**
+   * Supplies a setup() that does nothing, for kernels that only need
+   * the group they are handed.
+   */
+  struct FrameKernel {
+    void setup(AtomicGroup&) { }
+  };
+
+
+  namespace internal {
+
+    //! Splits \a n frames into \a nchunks contiguous [begin, end) ranges
+    std::vector< std::pair<uint, uint> > frameChunks(const uint n, const uint nchunks);
+
+    //! Reads a frame, staying sequential when possible
+    /**
+     * Consecutive frames are read with readFrame() so formats that
+     * must scan (XTC, Amber) do not seek.  \a last is the last frame
+     * read, or -1 if nothing has been read yet.
+     */
+    void readFrameFrom(pTraj& traj, const uint frame, long& last);
+
+
+    //! Number of threads to split \a n items over
+    /**
+     * A request for 0 threads means one per core.  Each thread is
+     * given at least \a grain items, so small jobs stay on the
+     * calling thread.
+     */
+    uint threadsFor(const uint n, uint nthreads, const uint grain = 1);
+
+
+    template<class Func>
+    class ChunkWorker {
+    public:
+      ChunkWorker(Func& f, const uint chunk, const uint begin, const uint end)
+        : _f(f), _chunk(chunk), _begin(begin), _end(end), _failed(false) { }
+
+      void operator()() {
+        try {
+          _f(_chunk, _begin, _end);
+        }
+        catch (std::exception& e) {
+          _failed = true;
+          _message = e.what();
+        }
+      }
+
+      bool failed() const { return(_failed); }
+      std::string message() const { return(_message); }
+
+    private:
+      Func& _f;
+      uint _chunk, _begin, _end;
+      bool _failed;
+      std::string _message;
+    };
+
+
+    //! Calls f(chunk, begin, end) for \a nchunks contiguous pieces of [0, n), one thread per piece
+    /**
+     * All threads share \a f, so it must only write to state that
+     * belongs to its own chunk (e.g. indexed by \a chunk, or the items
+     * in [begin, end)).  If any call fails, a LOOSError is thrown
+     * after all threads have stopped.
+     */
+    template<class Func>
+    void parallelChunks(const uint n, const uint nchunks, Func& f) {
+      typedef ChunkWorker<Func> Worker;
+
+      std::vector< std::pair<uint, uint> > chunks = frameChunks(n, nchunks);
+      std::vector<Worker> workers;
+      workers.reserve(nchunks);
+      for (uint i=0; i<nchunks; ++i)
+        workers.push_back(Worker(f, i, chunks[i].first, chunks[i].second));
+
+      if (nchunks == 1)
+        workers[0]();
+      else {
+        std::vector<boost::thread*> threads(nchunks);
+        for (uint i=0; i<nchunks; ++i)
+          threads[i] = new boost::thread(boost::ref(workers[i]));
+        for (uint i=0; i<nchunks; ++i) {
+          threads[i]->join();
+          delete threads[i];
+        }
+      }
+
+      for (uint i=0; i<nchunks; ++i)
+        if (workers[i].failed())
+          throw(LOOSError("Error in parallel worker: " + workers[i].message()));
+    }
+
+
+    //! Chunk function for parallelChunks() that runs one kernel per chunk of frames
+    template<class Kernel, class Opener>
+    class FrameMapReduceWorker {
+    public:
+      FrameMapReduceWorker(const Opener& opener, const AtomicGroup& group,
+                           const std::vector<uint>& frames, std::vector<Kernel>& kernels)
+        : _opener(opener), _group(group), _frames(frames), _kernels(kernels) { }
+
+      void operator()(const uint chunk, const uint begin, const uint end) {
+        Kernel& kernel = _kernels[chunk];
+        pTraj traj = _opener();
+        AtomicGroup g = _group.copy();
+        kernel.setup(g);
+        CoordinatePlan plan(g);
+
+        long last = -1;
+        for (uint i=begin; i<end; ++i) {
+          readFrameFrom(traj, _frames[i], last);
+          traj->updateGroupCoords(g, plan);
+          kernel(g, _frames[i]);
+        }
+      }
+
+    private:
+      const Opener& _opener;
+      const AtomicGroup& _group;
+      const std::vector<uint>& _frames;
+      std::vector<Kernel>& _kernels;
+    };
+
+  }
+
+
+  //! Runs a per-frame kernel over a trajectory on several threads and merges the results
+  /**
+   * The frames are split into \a nthreads contiguous chunks.  Each
+   * worker gets its own trajectory (from \a opener), its own deep copy
+   * of \a group, and its own copy of \a kernel.  Once all workers are
+   * done, their kernels are merged in frame order and the result is
+   * assigned back to \a kernel.
+   *
+   * The Kernel must be copyable and provide:
+   * \code
+   * void setup(AtomicGroup& g);                     // once per worker, before any frames
+   * void operator()(AtomicGroup& g, const uint frame);   // for each frame
+   * void merge(const Kernel& other);                // fold in a later chunk's results
+   * \endcode
+   * setup() is where the kernel makes any selections it needs from
+   * the worker's copy of the group (deriving from FrameKernel supplies
+   * an empty one).  Atoms selected from \a g share coordinates with
+   * it, so they are updated along with it every frame.  Since merge()
+   * is always handed the chunk that follows, appending time series is
+   * enough to keep them in frame order.
+   *
+   * The Opener is any functor that returns a new pTraj, typically a
+   * TrajectoryOpener.
+   *
+   * If \a nthreads is 0, one thread per core is used.  If any worker
+   * fails, a LOOSError is thrown after all workers have stopped.
+   *
+   * A sketch of a radius of gyration time series:
+   * \code
+   * struct Rgyr : public FrameKernel {
+   *   std::vector<double> values;
+   *   void operator()(AtomicGroup& g, const uint) { values.push_back(g.radiusOfGyration()); }
+   *   void merge(const Rgyr& o) { values.insert(values.end(), o.values.begin(), o.values.end()); }
+   * };
+   *
+   * Rgyr rgyr;
+   * frameMapReduce(TrajectoryOpener(traj_name, traj_type, model), subset, frames, rgyr);
+   * \endcode
+   */
+  template<class Kernel, class Opener>
+  void frameMapReduce(const Opener& opener, const AtomicGroup& group,
+                      const std::vector<uint>& frames, Kernel& kernel, uint nthreads = 0) {
+    if (frames.empty())
+      return;
+    nthreads = internal::threadsFor(frames.size(), nthreads);
+
+    std::vector<Kernel> kernels(nthreads, kernel);
+    internal::FrameMapReduceWorker<Kernel, Opener> worker(opener, group, frames, kernels);
+    internal::parallelChunks(frames.size(), nthreads, worker);
+
+    kernel = kernels[0];
+    for (uint i=1; i<nthreads; ++i)
+      kernel.merge(kernels[i]);
+  }
+
+
+}
+
+
+#endif
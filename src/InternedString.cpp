@@ -0,0 +1,140 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <InternedString.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+  namespace {
+
+    // Strings are stored in fixed-size chunks that are never moved,
+    // so looking one up needs no lock while another thread is adding
+    // to the table.
+
+    const uint chunk_bits = 12;
+    const uint chunk_size = 1u << chunk_bits;
+    const uint max_chunks = 1u << 14;
+
+
+    // Lets the table be searched with a pointer and length without
+    // first copying the characters into a std::string...
+
+    struct CharRange {
+      CharRange(const char* p, const uint n) : begin(p), end(p + n) { }
+      const char* begin;
+      const char* end;
+    };
+
+    struct RangeHash {
+      std::size_t operator()(const std::string& s) const { return(boost::hash_range(s.begin(), s.end())); }
+      std::size_t operator()(const CharRange& r) const { return(boost::hash_range(r.begin, r.end)); }
+    };
+
+    struct RangeEqual {
+      bool operator()(const std::string& a, const std::string& b) const { return(a == b); }
+      bool operator()(const CharRange& r, const std::string& s) const {
+        return(static_cast<std::size_t>(r.end - r.begin) == s.size() && std::equal(r.begin, r.end, s.begin()));
+      }
+    };
+
+    typedef boost::unordered_map<std::string, uint, RangeHash, RangeEqual>   IdMap;
+
+
+    class StringTable {
+    public:
+      StringTable() : _size(0) {
+        std::fill(_chunks, _chunks + max_chunks, static_cast<std::string*>(0));
+        add("");
+      }
+
+      uint intern(const char* s, const uint n) {
+        boost::mutex::scoped_lock lock(_mutex);
+
+        IdMap::const_iterator i = _ids.find(CharRange(s, n), RangeHash(), RangeEqual());
+        if (i != _ids.end())
+          return(i->second);
+        return(add(std::string(s, n)));
+      }
+
+      const std::string& lookup(const uint id) const {
+        return(_chunks[id >> chunk_bits][id & (chunk_size - 1)]);
+      }
+
+      uint size(void) {
+        boost::mutex::scoped_lock lock(_mutex);
+        return(_size);
+      }
+
+    private:
+      uint add(const std::string& s) {
+        uint id = _size;
+        uint chunk = id >> chunk_bits;
+        if (chunk >= max_chunks)
+          throw(LOOSError("Too many distinct strings for the InternedString table"));
+        if (_chunks[chunk] == 0)
+          _chunks[chunk] = new std::string[chunk_size];
+
+        _chunks[chunk][id & (chunk_size - 1)] = s;
+        _ids[s] = id;
+        ++_size;
+        return(id);
+      }
+
+      boost::mutex _mutex;
+      IdMap _ids;
+      std::string* _chunks[max_chunks];
+      uint _size;
+    };
+
+
+    // The table is never destroyed, so atoms in static objects can
+    // still use it during program exit...
+    StringTable& table(void) {
+      static StringTable* t = new StringTable;
+      return(*t);
+    }
+
+  }
+
+
+  uint InternedString::intern(const char* s, const uint n) {
+    return(table().intern(s, n));
+  }
+
+  const std::string& InternedString::lookup(const uint id) {
+    return(table().lookup(id));
+  }
+
+  uint InternedString::tableSize(void) {
+    return(table().size());
+  }
+
+
+}
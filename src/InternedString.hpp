@@ -0,0 +1,86 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_INTERNEDSTRING_HPP)
+#define LOOS_INTERNEDSTRING_HPP
+
+#include <iostream>
+#include <string>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+
+  //! Handle to a string stored once in a table shared by the whole program
+  /**
+   * Atoms have many string properties (name, resname, segid, ...)
+   * but a system only has a few distinct values for each of them.
+   * An InternedString stores a 4-byte index into a global table of
+   * distinct strings in place of the string itself.  Two handles are
+   * equal exactly when their strings are, so comparing them is an
+   * integer comparison.
+   *
+   * Strings are never removed from the table, and the table may be
+   * added to from any thread.  The default handle is the empty
+   * string.  The ordering of handles is not the ordering of their
+   * strings.
+   */
+  class InternedString {
+  public:
+    InternedString() : _id(0) { }
+    explicit InternedString(const std::string& s) : _id(intern(s.data(), s.size())) { }
+
+    //! Interns the \a n characters starting at \a s
+    InternedString(const char* s, const uint n) : _id(intern(s, n)) { }
+
+    //! The string this refers to
+    const std::string& str(void) const { return(lookup(_id)); }
+
+    //! Index of the string in the table
+    uint id(void) const { return(_id); }
+
+    bool operator==(const InternedString& s) const { return(_id == s._id); }
+    bool operator!=(const InternedString& s) const { return(_id != s._id); }
+
+    //! Number of distinct strings interned so far (ids are less than this)
+    static uint tableSize(void);
+
+    friend std::ostream& operator<<(std::ostream& os, const InternedString& s) {
+      return(os << s.str());
+    }
+
+  private:
+    static uint intern(const char*, const uint);
+    static const std::string& lookup(const uint);
+
+    uint _id;
+  };
+
+
+}
+
+
+#endif
@@ -22,6 +22,8 @@
 
 #include <Kernel.hpp>
 #include <Atom.hpp>
+#include <AtomicGroup.hpp>
+#include <AtomColumns.hpp>
 
 namespace loos {
 
@@ -60,6 +62,66 @@ namespace loos {
     
   }
 
+
+
+  std::vector<char> Kernel::evaluate(const AtomColumns& columns) {
+    if (columns.size() == 0)
+      return(std::vector<char>());
+
+    prepare(columns);
+
+    std::vector<internal::Action*>::iterator i;
+    for (i=actions.begin(); i != actions.end(); i++) {
+      try {
+        (*i)->evaluate(col_stack, columns);
+      }
+      catch (LOOSError& e) {
+        col_stack.clear();
+        throw(e);
+      }
+    }
+
+    if (col_stack.size() != 1) {
+      col_stack.clear();
+      throw(LOOSError("Execution error - unexpected values on stack"));
+    }
+
+    internal::Column result = col_stack.pop();
+    return(*(result.asFlags(columns.size(), "Execution error - unexpected value on top of stack")));
+  }
+
+
+  AtomicGroup Kernel::select(const AtomColumns& columns) {
+    return(columns.group().select(evaluate(columns)));
+  }
+
+
+
+  boost::shared_ptr<Kernel> Kernel::split(const uint start) {
+    if (start > actions.size())
+      throw(LOOSError("Attempting to split a Kernel past its last command"));
+
+    boost::shared_ptr<Kernel> k(new Kernel);
+    for (uint i=start; i<actions.size(); ++i)
+      k->push(actions[i]);
+    actions.erase(actions.begin() + start, actions.end());
+
+    return(k);
+  }
+
+
+  void Kernel::prepare(const AtomicGroup& g) {
+    AtomColumns columns(g);
+    prepare(columns);
+  }
+
+
+  void Kernel::prepare(const AtomColumns& columns) {
+    std::vector<internal::Action*>::iterator i;
+    for (i=actions.begin(); i != actions.end(); i++)
+      (*i)->prepare(columns);
+  }
+
     
   void Kernel::clearActions(void) { actions.clear(); }
 
@@ -34,14 +34,29 @@
 #include "KernelValue.hpp"
 #include "KernelStack.hpp"
 #include "KernelActions.hpp"
+#include "KernelColumns.hpp"
 
 namespace loos {
 
+  class AtomicGroup;
+  class AtomColumns;
+
   //!The Kernel (virtual machine) for compiling and executing user-defined atom selections
+  /**
+   * A Kernel can be run in two ways.  execute() runs every command
+   * for a single atom (as KernelSelector does).  evaluate() and
+   * select() instead run each command once over all of the atoms in
+   * a group, working on whole columns of atom properties (see
+   * AtomColumns).  This avoids the per-atom overhead of the virtual
+   * machine, and string tests and regular expressions are only
+   * evaluated once per distinct string, so it is much faster for
+   * large groups.  Both give the same selection.
+   */
 
   class Kernel {
     std::vector<internal::Action*> actions;    //! Commands
     internal::ValueStack val_stack;       //! The data stack...
+    internal::ColumnStack col_stack;      //! The data stack for column-wise evaluation
 
   public:
     
@@ -53,6 +68,28 @@ namespace loos {
 
     void pop(void);
 
+    //! Number of commands stored
+    uint size(void) const { return(actions.size()); }
+
+    //! Move the commands from \a start onwards into a new Kernel
+    /**
+     * Used by the parser to compile a subselection (e.g. for "within")
+     * into its own Kernel.
+     */
+    boost::shared_ptr<Kernel> split(const uint start);
+
+    //! Prepare commands that depend on the group being selected from
+    /**
+     * Some commands (e.g. "within") need to look at the whole group
+     * being selected from, not just the current atom.  This must be
+     * called with that group before executing the Kernel over its
+     * atoms.  selectAtoms() does this for you.
+     */
+    void prepare(const AtomicGroup& g);
+
+    //! Prepare commands using existing columns for the group
+    void prepare(const AtomColumns& columns);
+
     //! Execute the stored commands for a specific atom.
     /**
      * If an exception occurs during processing, then the value stack
@@ -64,6 +101,17 @@ namespace loos {
      */
     
     void execute(pAtom pa = pAtom());
+
+    //! Execute the stored commands for every atom in \a columns at once
+    /**
+     * The Kernel is prepared with the group first.  Returns one flag
+     * per atom, set if the atom is selected.  Errors are handled as
+     * with execute().
+     */
+    std::vector<char> evaluate(const AtomColumns& columns);
+
+    //! Select atoms from the group in \a columns (see evaluate())
+    AtomicGroup select(const AtomColumns& columns);
     
     void clearActions(void);
 
@@ -23,6 +23,9 @@
 #include <Atom.hpp>
 #include <sstream>
 #include <Selectors.hpp>
+#include <Kernel.hpp>
+#include <NeighborGrid.hpp>
+#include <AtomColumns.hpp>
 
 
 namespace loos {
@@ -63,6 +66,96 @@ namespace loos {
     }
     
 
+    // Functors for evaluating string commands once per distinct string...
+
+    namespace {
+
+      class RegexTest {
+      public:
+        explicit RegexTest(const boost::regex& re) : _re(re) { }
+        char operator()(const std::string& s) { return(boost::regex_search(s, _re)); }
+      private:
+        const boost::regex& _re;
+      };
+
+      class NumberExtractor {
+      public:
+        explicit NumberExtractor(const boost::regex& re) : _re(re) { }
+        long operator()(const std::string& s);
+      private:
+        const boost::regex& _re;
+      };
+
+      class FirstLetterTest {
+      public:
+        explicit FirstLetterTest(const char c) : _c(c) { }
+        char operator()(const std::string& s) { return(s[0] == _c); }
+      private:
+        char _c;
+      };
+
+      class BackboneNameTest {
+      public:
+        explicit BackboneNameTest(const bool residue) : _residue(residue) { }
+        char operator()(const std::string& s) {
+          return(_residue ? BackboneSelector::isBackboneResidue(s) : BackboneSelector::isBackboneAtom(s));
+        }
+      private:
+        bool _residue;
+      };
+
+
+      // The first capture that converts to an integer, or -1
+      long NumberExtractor::operator()(const std::string& s) {
+        boost::smatch what;
+
+        if (boost::regex_search(s, what, _re)) {
+          unsigned i;
+          int val;
+          for (i=0; i<what.size(); i++) {
+            if ((std::stringstream(what[i]) >> val))
+              return(val);
+          }
+        }
+
+        return(-1);
+      }
+
+
+      Column matchColumn(const Column& col, const boost::regex& re, const AtomColumns& table) {
+        RegexTest test(re);
+        if (col.type == Column::CONSTANT)
+          return(Column(Value(test(col.constant.getString()))));
+        if (col.type != Column::STRINGS)
+          throw(LOOSError("Expected a string value..."));
+
+        return(Column(pFlags(mapStrings<char>(*(col.strings), table, test))));
+      }
+
+
+      Column logicalColumns(const Column& x, const Column& y, const uint n, const bool conjunction, const std::string& msg) {
+        if (x.valueType() != Value::INT || y.valueType() != Value::INT)
+          throw(LOOSError(msg));
+
+        if (x.type == Column::CONSTANT && y.type == Column::CONSTANT)
+          return(Column(Value(conjunction ? (x.constant.itg && y.constant.itg) : (x.constant.itg || y.constant.itg))));
+
+        pFlags a = x.asFlags(n, msg);
+        pFlags b = y.asFlags(n, msg);
+        boost::shared_ptr<Flags> f(new Flags(n));
+        if (conjunction)
+          for (uint i=0; i<n; ++i)
+            (*f)[i] = (*a)[i] && (*b)[i];
+        else
+          for (uint i=0; i<n; ++i)
+            (*f)[i] = (*a)[i] || (*b)[i];
+
+        return(Column(pFlags(f)));
+      }
+
+    }
+
+
     void Action::setStack(ValueStack* ptr) { stack=ptr; }
     void Action::setAtom(pAtom& pa) { atom = pa; }
 
@@ -72,6 +165,7 @@ namespace loos {
 
 
     void pushString::execute(void) { stack->push(val); }
+    void pushString::evaluate(ColumnStack& cols, const AtomColumns&) { cols.push(Column(val)); }
     std::string pushString::name(void) const {
       std::stringstream s;
       s << my_name << "(" << val << ")";
@@ -79,6 +173,7 @@ namespace loos {
     }
 
     void pushInt::execute(void) { stack->push(val); }
+    void pushInt::evaluate(ColumnStack& cols, const AtomColumns&) { cols.push(Column(val)); }
     std::string pushInt::name(void) const {
       std::stringstream s;
       s << my_name << "(" << val << ")";
@@ -86,6 +181,7 @@ namespace loos {
     }
 
     void pushFloat::execute(void) { stack->push(val); }
+    void pushFloat::evaluate(ColumnStack& cols, const AtomColumns&) { cols.push(Column(val)); }
     std::string pushFloat::name(void) const {
       std::stringstream s;
       s << my_name << "(" << val << ")";
@@ -94,14 +190,22 @@ namespace loos {
 
 
     void drop::execute(void) { stack->drop(); }
+    void drop::evaluate(ColumnStack& cols, const AtomColumns&) { cols.drop(); }
 
     void dup::execute(void) { stack->dup(); }
+    void dup::evaluate(ColumnStack& cols, const AtomColumns&) { cols.dup(); }
 
     void equals::execute(void) {
       Value v(binComp() == 0);
       stack->push(v);
     }
 
+    void equals::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column y = cols.pop();
+      Column x = cols.pop();
+      cols.push(compareColumns(x, y, table, EQUAL, false));
+    }
+
     void lessThan::execute(void) {
       if (negativeOperand())
         binaryFalseResult();
@@ -111,6 +215,12 @@ namespace loos {
       }
     }
 
+    void lessThan::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column y = cols.pop();
+      Column x = cols.pop();
+      cols.push(compareColumns(x, y, table, LESS, true));
+    }
+
     void lessThanEquals::execute(void) {
       if (negativeOperand())
         binaryFalseResult();
@@ -120,17 +230,35 @@ namespace loos {
       }
     }
 
+    void lessThanEquals::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column y = cols.pop();
+      Column x = cols.pop();
+      cols.push(compareColumns(x, y, table, LESS_EQUAL, true));
+    }
+
 
     void greaterThan::execute(void) {
       Value v(binComp() > 0);
       stack->push(v);
     }
 
+    void greaterThan::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column y = cols.pop();
+      Column x = cols.pop();
+      cols.push(compareColumns(x, y, table, GREATER, false));
+    }
+
     void greaterThanEquals::execute(void) {
       Value v(binComp() >= 0);
       stack->push(v);
     }
 
+    void greaterThanEquals::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column y = cols.pop();
+      Column x = cols.pop();
+      cols.push(compareColumns(x, y, table, GREATER_EQUAL, false));
+    }
+
     void matchRegex::execute(void) { 
       Value v = stack->pop();
       Value r(0);
@@ -140,6 +268,11 @@ namespace loos {
       stack->push(r);
     }
 
+    void matchRegex::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v = cols.pop();
+      cols.push(matchColumn(v, regexp, table));
+    }
+
     std::string matchRegex::name(void) const {
       return(my_name + "(" + pattern + ")");
     }
@@ -158,25 +291,55 @@ namespace loos {
       stack->push(r);
     }
   
+    // The pattern may differ for each atom, so each distinct pattern
+    // is compiled once as it is needed...
+    void matchStringAsRegex::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v = cols.pop();
+      Column u = cols.pop();
+
+      if (v.type == Column::CONSTANT) {
+        boost::regex re(v.constant.getString(), boost::regex::perl|boost::regex::icase);
+        cols.push(matchColumn(u, re, table));
+        return;
+      }
+
+      if (v.type != Column::STRINGS || (u.type != Column::STRINGS && u.valueType() != Value::STRING))
+        throw(LOOSError("Expected a string value..."));
+
+      uint n = table.size();
+      std::vector< boost::shared_ptr<boost::regex> > patterns(table.nstrings());
+      boost::shared_ptr<Flags> f(new Flags(n));
+      for (uint i=0; i<n; ++i) {
+        uint p = (*(v.strings))[i];
+        if (!patterns[p])
+          patterns[p] = boost::shared_ptr<boost::regex>(new boost::regex(table.string(p), boost::regex::perl|boost::regex::icase));
+        const std::string& subject = (u.type == Column::STRINGS) ? table.string((*(u.strings))[i]) : *(u.constant.str);
+        (*f)[i] = boost::regex_search(subject, *(patterns[p]));
+      }
+
+      cols.push(Column(pFlags(f)));
+    }
+  
     void extractNumber::execute(void) {
       Value v = stack->pop();
-      Value r(-1);
-      boost::smatch what;
-      
-      if (boost::regex_search(v.getString(), what, regexp)) {
-        unsigned i;
-        int val;
-        for (i=0; i<what.size(); i++) {
-          if ((std::stringstream(what[i]) >> val)) {
-            r.setInt(val);
-            break;
-          }
-        }
-      }
-      
+      NumberExtractor extractor(regexp);
+      Value r(extractor(v.getString()));
+
       stack->push(r);
     }
 
+    void extractNumber::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v = cols.pop();
+      NumberExtractor extractor(regexp);
+
+      if (v.type == Column::CONSTANT)
+        cols.push(Column(Value(extractor(v.constant.getString()))));
+      else if (v.type == Column::STRINGS)
+        cols.push(Column(AtomColumns::pIntColumn(mapStrings<long>(*(v.strings), table, extractor))));
+      else
+        throw(LOOSError("Expected a string value..."));
+    }
+
     std::string extractNumber::name(void) const {
       return(my_name + "(" + pattern + ")");
     }
@@ -188,12 +351,20 @@ namespace loos {
       stack->push(v);
     }
 
+    void pushAtomName::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.names()));
+    }
+
     void pushAtomId::execute(void) {
       requireAtom();
       Value v(atom->id());
       stack->push(v);
     }
 
+    void pushAtomId::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.ids()));
+    }
+
     // Beware of overflows here!!!
     void pushAtomIndex::execute(void) {
       requireAtom();
@@ -201,18 +372,30 @@ namespace loos {
       stack->push(v);
     }
 
+    void pushAtomIndex::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.indices()));
+    }
+
     void pushAtomResname::execute(void) {
       requireAtom();
       Value v(atom->resname());
       stack->push(v);
     }
 
+    void pushAtomResname::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.resnames()));
+    }
+
     void pushAtomResid::execute(void) {
       requireAtom();
       Value v(atom->resid());
       stack->push(v);
     }
 
+    void pushAtomResid::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.resids()));
+    }
+
 
     void pushAtomSegid::execute(void) {
       requireAtom();
@@ -220,12 +403,26 @@ namespace loos {
       stack->push(v);
     }
 
+    void pushAtomSegid::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.segids()));
+    }
+
     void pushAtomChainId::execute(void) {
       requireAtom();
       Value v(atom->chainId());
       stack->push(v);
     }
 
+    void pushAtomChainId::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      cols.push(Column(table.chainIds()));
+    }
+
+
+    void logicalAnd::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v2 = cols.pop();
+      Column v1 = cols.pop();
+      cols.push(logicalColumns(v1, v2, table.size(), true, "Invalid operands to logicalAnd"));
+    }
 
     void logicalAnd::execute(void) {
       Value v2 = stack->pop();
@@ -239,6 +436,12 @@ namespace loos {
     }
 
 
+    void logicalOr::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v2 = cols.pop();
+      Column v1 = cols.pop();
+      cols.push(logicalColumns(v1, v2, table.size(), false, "Invalid operands to logicalOr"));
+    }
+
     void logicalOr::execute(void) {
       Value v1 = stack->pop();
       Value v2 = stack->pop();
@@ -261,11 +464,34 @@ namespace loos {
       stack->push(u);
     }
 
+    void logicalNot::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      Column v1 = cols.pop();
+
+      if (v1.valueType() != Value::INT)
+        throw(LOOSError("Invalid operand to logicalNot"));
+      if (v1.type == Column::CONSTANT) {
+        cols.push(Column(Value(!v1.constant.itg)));
+        return;
+      }
+
+      uint n = table.size();
+      pFlags a = v1.asFlags(n, "Invalid operand to logicalNot");
+      boost::shared_ptr<Flags> f(new Flags(n));
+      for (uint i=0; i<n; ++i)
+        (*f)[i] = !(*a)[i];
+      cols.push(Column(pFlags(f)));
+    }
+
+
     void logicalTrue::execute(void) {
       Value v((int)1);
       stack->push(v);
     }
 
+    void logicalTrue::evaluate(ColumnStack& cols, const AtomColumns&) {
+      cols.push(Column(Value((int)1)));
+    }
+
 
     void Hydrogen::execute(void) {
       requireAtom();
@@ -282,6 +508,19 @@ namespace loos {
 
 
     
+    void Hydrogen::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      FirstLetterTest test('H');
+      boost::shared_ptr<Flags> f = mapStrings<char>(*(table.names()), table, test);
+
+      const AtomicGroup& g = table.group();
+      for (uint i=0; i<f->size(); ++i)
+        if ((*f)[i] && g[i]->checkProperty(Atom::massbit))
+          (*f)[i] = (g[i]->mass() < 1.1);
+
+      cols.push(Column(pFlags(f)));
+    }
+
+
     // Provide storage for class-level selector
     BackboneSelector Backbone::bbsel;
 
@@ -294,6 +533,139 @@ namespace loos {
     }
 
 
+    void Backbone::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      BackboneNameTest residue(true), atom(false);
+      boost::shared_ptr<Flags> f = mapStrings<char>(*(table.resnames()), table, residue);
+      boost::shared_ptr<Flags> a = mapStrings<char>(*(table.names()), table, atom);
+
+      for (uint i=0; i<f->size(); ++i)
+        (*f)[i] = (*f)[i] && (*a)[i];
+
+      cols.push(Column(pFlags(f)));
+    }
+
+
+    //-------------------------------------------------------------
+
+
+    AtomicGroup SubselectionAction::subselect(const AtomColumns& columns) {
+      submask = subkernel->evaluate(columns);
+      return(columns.group().select(submask));
+    }
+
+    void SubselectionAction::requirePrepared(void) {
+      if (!prepared)
+        throw(LOOSError(my_name + " requires Kernel::prepare() to be called with the group being selected from"));
+    }
+
+
+    void withinSelection::prepare(const AtomColumns& columns) {
+      AtomicGroup sub = subselect(columns);
+      const AtomicGroup& g = columns.group();
+
+      if (g.isPeriodic())
+        grid = boost::shared_ptr<NeighborGrid>(new NeighborGrid(sub, distance, g.periodicBox()));
+      else
+        grid = boost::shared_ptr<NeighborGrid>(new NeighborGrid(sub, distance));
+
+      subset.clear();
+      if (exclude_subset)
+        for (AtomicGroup::const_iterator i = sub.begin(); i != sub.end(); ++i)
+          subset.insert(i->get());
+
+      prepared = true;
+    }
+
+    void withinSelection::execute(void) {
+      requireAtom();
+      requirePrepared();
+
+      bool found = grid->hasNeighbor(atom->coords());
+      if (found && exclude_subset)
+        found = (subset.find(atom.get()) == subset.end());
+
+      Value v;
+      v.setInt(found);
+      stack->push(v);
+    }
+
+    void withinSelection::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      requirePrepared();
+
+      const AtomicGroup& g = table.group();
+      if (submask.size() != g.size())
+        throw(LOOSError(my_name + " was prepared with a different group"));
+
+      boost::shared_ptr<Flags> f(new Flags(g.size()));
+      for (uint i=0; i<g.size(); ++i)
+        if (!(exclude_subset && submask[i]))
+          (*f)[i] = grid->hasNeighbor(g[i]->coords());
+
+      cols.push(Column(pFlags(f)));
+    }
+
+    std::string withinSelection::name(void) const {
+      std::stringstream s;
+      s << my_name << "(" << distance << ")";
+      return(s.str());
+    }
+
+
+    void sameGroupAs::prepare(const AtomColumns& columns) {
+      AtomicGroup sub = subselect(columns);
+      const AtomicGroup& g = columns.group();
+      boost::unordered_set<const Atom*> hits;
+      for (AtomicGroup::const_iterator i = sub.begin(); i != sub.end(); ++i)
+        hits.insert(i->get());
+
+      members.clear();
+      std::vector<AtomicGroup> pieces = split(g);
+      for (std::vector<AtomicGroup>::const_iterator p = pieces.begin(); p != pieces.end(); ++p) {
+        AtomicGroup::const_iterator i;
+        for (i = p->begin(); i != p->end(); ++i)
+          if (hits.find(i->get()) != hits.end())
+            break;
+        if (i == p->end())
+          continue;
+
+        for (i = p->begin(); i != p->end(); ++i)
+          members.insert(i->get());
+      }
+
+      prepared = true;
+    }
+
+    void sameGroupAs::execute(void) {
+      requireAtom();
+      requirePrepared();
+
+      Value v;
+      v.setInt(members.find(atom.get()) != members.end());
+      stack->push(v);
+    }
+
+
+    void sameGroupAs::evaluate(ColumnStack& cols, const AtomColumns& table) {
+      requirePrepared();
+
+      const AtomicGroup& g = table.group();
+      boost::shared_ptr<Flags> f(new Flags(g.size()));
+      for (uint i=0; i<g.size(); ++i)
+        (*f)[i] = (members.find(g[i].get()) != members.end());
+
+      cols.push(Column(pFlags(f)));
+    }
+
+
+    std::vector<AtomicGroup> sameResidueAs::split(const AtomicGroup& g) const {
+      return(g.splitByResidue());
+    }
+
+    std::vector<AtomicGroup> sameMoleculeAs::split(const AtomicGroup& g) const {
+      return(g.splitByMolecule());
+    }
+
+
   }
 
 }
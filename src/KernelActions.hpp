@@ -35,17 +35,24 @@
 
 #include <loos_defs.hpp>
 #include <boost/regex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_set.hpp>
 
 #include <exceptions.hpp>
 
 #include "KernelValue.hpp"
 #include "KernelStack.hpp"
+#include "KernelColumns.hpp"
 
 
 
 namespace loos {
 
   class BackboneSelector;
+  class AtomicGroup;
+  class AtomColumns;
+  class Kernel;
+  class NeighborGrid;
 
   //! Loos esoterica.
   /** You probably don't want to look in here unless you want to
@@ -56,7 +63,9 @@ namespace loos {
 
     //! Base class for all commands...
     /** All subclasses must implement the execute() method, which will
-     *  operate on the data stack pointer.
+     *  operate on the data stack pointer for the current atom, and the
+     *  evaluate() method, which does the same for every atom in a
+     *  group at once using a stack of columns.
      *
      *  Subclasses may also override the name() method if they want to
      *  augment the command-name string (i.e. to show additional internal
@@ -93,7 +102,13 @@ namespace loos {
 
       virtual std::string name(void) const;
 
+      //! Called with the group being selected from, before any atoms are executed
+      virtual void prepare(const AtomColumns&) { }
+
       virtual void execute(void) =0;
+
+      //! Column-wise execute() over all atoms in the group
+      virtual void evaluate(ColumnStack&, const AtomColumns&) =0;
       virtual ~Action() { }
 
     };
@@ -106,6 +121,7 @@ namespace loos {
     public:
       explicit pushString(const std::string str) : Action("pushString"), val(str) { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
       std::string name(void) const;
     };
 
@@ -115,6 +131,7 @@ namespace loos {
     public:
       explicit pushInt(const long i) : Action("pushInt"), val(i) { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
       std::string name(void) const;
     };
 
@@ -124,6 +141,7 @@ namespace loos {
     public:
       explicit pushFloat(const float f) : Action("pushFloat"), val(f) { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
       std::string name(void) const;
     };
 
@@ -133,6 +151,7 @@ namespace loos {
     public:
       drop() : Action("drop") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Duplicate the top item on the stack
@@ -140,6 +159,7 @@ namespace loos {
     public:
       dup() : Action("dup") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
 
@@ -148,6 +168,7 @@ namespace loos {
     public:
       equals() : Action("==") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Relation operators...:  ARG1 ARG2 <
@@ -155,6 +176,7 @@ namespace loos {
     public:
       lessThan() : Action("<") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! ARG1 ARG2 <=
@@ -162,6 +184,7 @@ namespace loos {
     public:
       lessThanEquals() : Action("<=") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! ARG1 ARG2 >
@@ -169,6 +192,7 @@ namespace loos {
     public:
       greaterThan() : Action(">") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! ARG1 ARG2 >=
@@ -176,6 +200,7 @@ namespace loos {
     public:
       greaterThanEquals() : Action(">=") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Regular expression matching: ARG1 regexp(S)
@@ -189,6 +214,7 @@ namespace loos {
     public:
       explicit matchRegex(const std::string s) : Action("matchRegex"), regexp(s, boost::regex::perl|boost::regex::icase), pattern(s) { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
       std::string name(void) const;
     
     private:
@@ -206,6 +232,7 @@ namespace loos {
     public:
       matchStringAsRegex() : Action("matchStringAsRegex") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
   
   
@@ -223,6 +250,7 @@ namespace loos {
                                                     pattern(s) { }
 
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
       std::string name(void) const;
 
     private:
@@ -238,6 +266,7 @@ namespace loos {
     public:
       pushAtomName() : Action("pushAtomName") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom id onto the stack
@@ -245,6 +274,7 @@ namespace loos {
     public:
       pushAtomId() : Action("pushAtomId") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom index onto the stack
@@ -252,6 +282,7 @@ namespace loos {
     public:
       pushAtomIndex() : Action("pushAtomIndex") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom'ss residue name onto the stack
@@ -259,6 +290,7 @@ namespace loos {
     public:
       pushAtomResname() : Action("pushAtomResname") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom's residue id onto the stack
@@ -266,6 +298,7 @@ namespace loos {
     public:
       pushAtomResid() : Action("pushAtomResid") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom's segid onto the stack
@@ -273,6 +306,7 @@ namespace loos {
     public:
       pushAtomSegid() : Action("pushAtomSegid") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Push atom's chain ID onto the stack
@@ -280,6 +314,7 @@ namespace loos {
     public:
       pushAtomChainId() : Action("pushAtomChainId") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
 
@@ -291,6 +326,7 @@ namespace loos {
     public:
       logicalAnd() : Action("&&") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! ARG1 ARG2 ||
@@ -298,6 +334,7 @@ namespace loos {
     public:
       logicalOr() : Action("||") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
 
@@ -306,6 +343,7 @@ namespace loos {
     public:
       logicalNot() : Action("!") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Always returns true...
@@ -313,6 +351,7 @@ namespace loos {
     public:
       logicalTrue() : Action("TRUE") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
 
@@ -321,6 +360,7 @@ namespace loos {
     public:
       Hydrogen() : Action("Hydrogen") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
     };
 
     //! Shortcut for checking for backbone atoms...
@@ -329,6 +369,94 @@ namespace loos {
     public:
       Backbone() : Action("Backbone") { }
       void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
+    };
+
+
+    //! Base class for commands that select atoms relative to a subselection
+    /** The subselection is compiled into its own Kernel by the parser.
+     *  It is evaluated over the whole group being selected from when
+     *  prepare() is called, so these commands cannot be executed until
+     *  then.
+     */
+    class SubselectionAction : public Action {
+    public:
+      SubselectionAction(const std::string s, boost::shared_ptr<Kernel> k) : Action(s), subkernel(k), prepared(false) { }
+
+    protected:
+      //! Evaluate the subselection over the group in \a columns
+      /** The flags for each atom in the group are kept in submask */
+      AtomicGroup subselect(const AtomColumns& columns);
+      void requirePrepared(void);
+
+      boost::shared_ptr<Kernel> subkernel;
+      bool prepared;
+      Flags submask;
+    };
+
+
+    //! Atoms within a distance of any atom in a subselection: within D of ARG
+    /** The subselection's atoms are binned into a NeighborGrid, so
+     *  each atom tested only looks at nearby atoms.  If the group
+     *  being selected from is periodic, distances are computed using
+     *  its periodic box.  If \a exclude is true ("around"), atoms in
+     *  the subselection itself are not selected.
+     */
+    class withinSelection : public SubselectionAction {
+    public:
+      withinSelection(const double d, boost::shared_ptr<Kernel> k, const bool exclude)
+        : SubselectionAction(exclude ? "around" : "within", k), distance(d), exclude_subset(exclude) { }
+
+      void prepare(const AtomColumns&);
+      void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
+      std::string name(void) const;
+
+    private:
+      double distance;
+      bool exclude_subset;
+      boost::shared_ptr<NeighborGrid> grid;
+      boost::unordered_set<const Atom*> subset;
+    };
+
+
+    //! Atoms that share a residue or molecule with any atom in a subselection
+    /** Subclasses split the group being selected from into residues
+     *  or molecules.  Every atom of each piece containing an atom from
+     *  the subselection is selected.
+     */
+    class sameGroupAs : public SubselectionAction {
+    public:
+      sameGroupAs(const std::string s, boost::shared_ptr<Kernel> k) : SubselectionAction(s, k) { }
+
+      void prepare(const AtomColumns&);
+      void execute(void);
+      void evaluate(ColumnStack&, const AtomColumns&);
+
+    protected:
+      virtual std::vector<AtomicGroup> split(const AtomicGroup&) const =0;
+
+    private:
+      boost::unordered_set<const Atom*> members;
+    };
+
+
+    //! Atoms in the same residue as any atom in a subselection: same residue as ARG
+    class sameResidueAs : public sameGroupAs {
+    public:
+      explicit sameResidueAs(boost::shared_ptr<Kernel> k) : sameGroupAs("sameResidueAs", k) { }
+    protected:
+      std::vector<AtomicGroup> split(const AtomicGroup&) const;
+    };
+
+
+    //! Atoms in the same molecule as any atom in a subselection: same molecule as ARG
+    /** Requires connectivity (see AtomicGroup::splitByMolecule()) */
+    class sameMoleculeAs : public sameGroupAs {
+    public:
+      explicit sameMoleculeAs(boost::shared_ptr<Kernel> k) : sameGroupAs("sameMoleculeAs", k) { }
+    protected:
+      std::vector<AtomicGroup> split(const AtomicGroup&) const;
     };
   
 
@@ -0,0 +1,242 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <algorithm>
+
+#include <KernelColumns.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    Value::ValueType Column::valueType(void) const {
+      switch(type) {
+      case CONSTANT:
+        return(constant.type);
+      case STRINGS:
+        return(Value::STRING);
+      case INTS:
+      case FLAGS:
+      default:
+        return(Value::INT);
+      }
+    }
+
+
+    pFlags Column::asFlags(const uint n, const std::string& msg) const {
+      if (type == FLAGS)
+        return(flags);
+
+      if (valueType() != Value::INT)
+        throw(LOOSError(msg));
+
+      boost::shared_ptr<Flags> f(new Flags(n));
+      if (type == CONSTANT)
+        std::fill(f->begin(), f->end(), constant.itg != 0);
+      else
+        for (uint i=0; i<n; ++i)
+          (*f)[i] = ((*ints)[i] != 0);
+
+      return(f);
+    }
+
+
+    AtomColumns::pIntColumn Column::asInts(const uint n) const {
+      if (type == INTS)
+        return(ints);
+
+      if (valueType() != Value::INT)
+        throw(LOOSError("Expected an int value..."));
+
+      boost::shared_ptr<AtomColumns::IntColumn> v(new AtomColumns::IntColumn(n));
+      if (type == CONSTANT)
+        std::fill(v->begin(), v->end(), constant.itg);
+      else
+        for (uint i=0; i<n; ++i)
+          (*v)[i] = (*flags)[i];
+
+      return(v);
+    }
+
+
+    //-------------------------------------------------------------
+
+
+    void ColumnStack::requireNotEmpty(void) const {
+      if (columns.empty())
+        throw(LOOSError("Operation requested on an empty stack."));
+    }
+
+    void ColumnStack::push(const Column& col) { columns.push_back(col); }
+
+    Column ColumnStack::pop(void) {
+      requireNotEmpty();
+      Column col = columns.back();
+      columns.pop_back();
+      return(col);
+    }
+
+    void ColumnStack::dup(void) {
+      requireNotEmpty();
+      Column col = columns.back();
+      push(col);
+    }
+
+    void ColumnStack::drop(void) {
+      requireNotEmpty();
+      columns.pop_back();
+    }
+
+    unsigned int ColumnStack::size(void) const { return(columns.size()); }
+
+    void ColumnStack::clear(void) { columns.clear(); }
+
+
+    //-------------------------------------------------------------
+
+
+    namespace {
+
+      bool passes(const Comparison op, const int r) {
+        switch(op) {
+        case EQUAL:         return(r == 0);
+        case LESS:          return(r < 0);
+        case LESS_EQUAL:    return(r <= 0);
+        case GREATER:       return(r > 0);
+        case GREATER_EQUAL:
+        default:            return(r >= 0);
+        }
+      }
+
+
+      // These match compare(const Value&, const Value&)...
+      int compareStrings(const std::string& a, const std::string& b) {
+        if (a == b)
+          return(0);
+        return(a < b ? -1 : 1);
+      }
+
+      int compareInts(const long a, const long b) {
+        int e = a - b;
+        return(e);
+      }
+
+
+      // Tests a distinct string against a constant
+      class StringTest {
+      public:
+        StringTest(const std::string& s, const Comparison op, const bool column_first)
+          : _s(s), _op(op), _first(column_first) { }
+
+        char operator()(const std::string& t) {
+          return(passes(_op, _first ? compareStrings(t, _s) : compareStrings(_s, t)));
+        }
+
+      private:
+        std::string _s;
+        Comparison _op;
+        bool _first;
+      };
+
+
+      pFlags compareStringColumns(const Column& x, const Column& y, const AtomColumns& table, const Comparison op) {
+        if (x.type == Column::CONSTANT || y.type == Column::CONSTANT) {
+          bool first = (y.type == Column::CONSTANT);
+          StringTest test(first ? y.constant.getString() : x.constant.getString(), op, first);
+          return(mapStrings<char>(first ? *(x.strings) : *(y.strings), table, test));
+        }
+
+        const AtomColumns::StringColumn& a = *(x.strings);
+        const AtomColumns::StringColumn& b = *(y.strings);
+        boost::shared_ptr<Flags> f(new Flags(a.size()));
+        for (uint i=0; i<a.size(); ++i)
+          (*f)[i] = passes(op, a[i] == b[i] ? 0 : compareStrings(table.string(a[i]), table.string(b[i])));
+
+        return(f);
+      }
+
+
+      pFlags compareIntColumns(const Column& x, const Column& y, const uint n, const Comparison op, const bool negatives_false) {
+        boost::shared_ptr<Flags> f(new Flags(n));
+        Flags& out = *f;
+
+        if (y.type == Column::CONSTANT) {
+          const AtomColumns::IntColumn& a = *(x.asInts(n));
+          const long b = y.constant.itg;
+          if (negatives_false && b < 0)
+            return(f);
+          for (uint i=0; i<n; ++i)
+            out[i] = !(negatives_false && a[i] < 0) && passes(op, compareInts(a[i], b));
+
+        } else if (x.type == Column::CONSTANT) {
+          const long a = x.constant.itg;
+          const AtomColumns::IntColumn& b = *(y.asInts(n));
+          if (negatives_false && a < 0)
+            return(f);
+          for (uint i=0; i<n; ++i)
+            out[i] = !(negatives_false && b[i] < 0) && passes(op, compareInts(a, b[i]));
+
+        } else {
+          const AtomColumns::IntColumn& a = *(x.asInts(n));
+          const AtomColumns::IntColumn& b = *(y.asInts(n));
+          for (uint i=0; i<n; ++i)
+            out[i] = !(negatives_false && (a[i] < 0 || b[i] < 0)) && passes(op, compareInts(a[i], b[i]));
+        }
+
+        return(f);
+      }
+
+    }
+
+
+
+    Column compareColumns(const Column& x, const Column& y, const AtomColumns& table,
+                          const Comparison op, const bool negatives_false) {
+
+      if (x.valueType() != y.valueType())
+        throw(LOOSError("Comparing values with different types."));
+
+      // Comparing two constants gives a constant...
+      if (x.type == Column::CONSTANT && y.type == Column::CONSTANT) {
+        bool result;
+        if (negatives_false && x.constant.type == Value::INT && (x.constant.itg < 0 || y.constant.itg < 0))
+          result = false;
+        else
+          result = passes(op, compare(x.constant, y.constant));
+        return(Column(Value(result)));
+      }
+
+      switch(x.valueType()) {
+      case Value::STRING:
+        return(Column(compareStringColumns(x, y, table, op)));
+      case Value::INT:
+        return(Column(compareIntColumns(x, y, table.size(), op, negatives_false)));
+      default:
+        throw(LOOSError("Invalid comparison"));
+      }
+    }
+
+
+  }
+}
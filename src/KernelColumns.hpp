@@ -0,0 +1,140 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_KERNELCOLUMNS_HPP)
+#define LOOS_KERNELCOLUMNS_HPP
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <loos_defs.hpp>
+#include <exceptions.hpp>
+#include <AtomColumns.hpp>
+
+#include "KernelValue.hpp"
+
+
+namespace loos {
+
+  namespace internal {
+
+    typedef std::vector<char>                    Flags;
+    typedef boost::shared_ptr<const Flags>       pFlags;
+
+
+    //! Column of values for evaluating the Kernel over a whole group at once
+    /**
+     * This is the column-wise counterpart to Value.  A column either
+     * holds a single Value that applies to every atom (e.g. a string
+     * or number from the selection), or one entry per atom.  Per-atom
+     * entries are interned strings (see AtomColumns), integers, or
+     * flags (the INT results of tests and logical operations).  The
+     * per-atom data are shared, not copied, when columns are copied.
+     */
+    struct Column {
+      enum ColumnType { CONSTANT, STRINGS, INTS, FLAGS };
+
+      ColumnType type;
+      Value constant;
+      AtomColumns::pStringColumn strings;
+      AtomColumns::pIntColumn ints;
+      pFlags flags;
+
+      Column() : type(CONSTANT) { }
+      explicit Column(const Value& v) : type(CONSTANT), constant(v) { }
+      explicit Column(const AtomColumns::pStringColumn& s) : type(STRINGS), strings(s) { }
+      explicit Column(const AtomColumns::pIntColumn& i) : type(INTS), ints(i) { }
+      explicit Column(const pFlags& f) : type(FLAGS), flags(f) { }
+
+      //! The type of Value each atom would see
+      Value::ValueType valueType(void) const;
+
+      //! Per-atom flags (nonzero integers are true)
+      /**
+       * Throws a LOOSError with \a msg if the column does not hold
+       * integers
+       */
+      pFlags asFlags(const uint n, const std::string& msg) const;
+
+      //! Per-atom integers (throws if the column does not hold integers)
+      AtomColumns::pIntColumn asInts(const uint n) const;
+    };
+
+
+    //! Data stack for column-wise evaluation
+    class ColumnStack {
+      std::vector<Column> columns;
+
+      void requireNotEmpty(void) const;
+
+    public:
+      void push(const Column&);
+      Column pop(void);
+      void dup(void);
+      void drop(void);
+
+      unsigned int size(void) const;
+
+      void clear(void);
+    };
+
+
+
+    //! Tests applied by compareColumns()
+    enum Comparison { EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL };
+
+    //! Compare two columns atom by atom, giving a FLAGS column
+    /**
+     * Follows the rules of compare(const Value&, const Value&).  If
+     * \a negatives_false is set, atoms where either integer operand is
+     * negative fail the test (as with the "<" and "<=" commands).
+     * String tests are only made once per distinct string.
+     */
+    Column compareColumns(const Column& x, const Column& y, const AtomColumns& table,
+                          const Comparison op, const bool negatives_false);
+
+
+    //! Evaluate \a f once for every string interned in \a table, then look up the result for each atom
+    template<typename T, class Func>
+    boost::shared_ptr< std::vector<T> > mapStrings(const AtomColumns::StringColumn& ids, const AtomColumns& table, Func& f) {
+      std::vector<T> results(table.nstrings());
+      for (uint i=0; i<results.size(); ++i)
+        results[i] = f(table.string(i));
+
+      boost::shared_ptr< std::vector<T> > out(new std::vector<T>(ids.size()));
+      for (uint i=0; i<ids.size(); ++i)
+        (*out)[i] = results[ids[i]];
+      return(out);
+    }
+
+
+  }
+}
+
+
+#endif
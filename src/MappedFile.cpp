@@ -0,0 +1,96 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <MappedFile.hpp>
+
+
+namespace loos {
+
+
+  MappedFile::MappedFile(const std::string& fname, const bool copy_on_write)
+    : _filename(fname), _data(0), _size(0), _copy_on_write(copy_on_write)
+  {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw(FileOpenError(fname, strerror(errno), errno));
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      int err = errno;
+      close(fd);
+      throw(FileOpenError(fname, strerror(err), err));
+    }
+    if (!S_ISREG(st.st_mode)) {
+      close(fd);
+      throw(FileOpenError(fname, "Only regular files can be memory-mapped"));
+    }
+    _size = st.st_size;
+
+    // Zero-length files cannot be mapped, but are otherwise valid
+    if (_size != 0) {
+      void* p = copy_on_write ? mmap(0, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)
+        : mmap(0, _size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p == MAP_FAILED) {
+        int err = errno;
+        close(fd);
+        throw(FileOpenError(fname, std::string("Unable to memory-map file: ") + strerror(err), err));
+      }
+      _data = static_cast<const char*>(p);
+    }
+
+    // The mapping remains valid after the descriptor is closed
+    close(fd);
+  }
+
+
+  MappedFile::~MappedFile() {
+    if (_data)
+      munmap(const_cast<char*>(_data), _size);
+  }
+
+
+  char* MappedFile::writableData() const {
+    if (!_copy_on_write)
+      throw(LOOSError("Attempting to write to a read-only mapping of " + _filename));
+    return(const_cast<char*>(_data));
+  }
+
+
+  void MappedFile::adviseSequential() const {
+    if (_data)
+      madvise(const_cast<char*>(_data), _size, MADV_SEQUENTIAL);
+  }
+
+  bool MappedFile::isRegularFile(const std::string& fname) {
+    struct stat st;
+    return(stat(fname.c_str(), &st) == 0 && S_ISREG(st.st_mode));
+  }
+
+}
@@ -0,0 +1,94 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_MAPPEDFILE_HPP)
+#define LOOS_MAPPEDFILE_HPP
+
+#include <string>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <loos_defs.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Read-only memory mapping of an entire file
+  /**
+   * The file is mapped when the object is created and unmapped when it
+   * is destroyed.  Since the mapping cannot be safely copied, share it
+   * via a pMappedFile instead.
+   *
+   * A \a copy_on_write mapping is private and writable: pages that
+   * are written to are copied, and the file itself is never changed.
+   * This lets a mapped file back a structure that callers may modify
+   * (such as a Matrix read by readBinaryMatrix()).
+   *
+   * Only regular files can be mapped (a pipe or FIFO has no size to
+   * map), so readers that should also accept those check with
+   * isRegularFile() first and fall back on a stream.
+   *
+   * Throws a FileOpenError if the file cannot be opened or mapped.
+   */
+  class MappedFile : public boost::noncopyable {
+  public:
+    explicit MappedFile(const std::string& fname, const bool copy_on_write = false);
+    ~MappedFile();
+
+    //! Start of the mapped file
+    const char* data() const { return(_data); }
+
+    //! Start of a copy-on-write mapping
+    /**
+     * Throws a LOOSError if the file was mapped read-only
+     */
+    char* writableData() const;
+
+    //! Size of the mapped file in bytes
+    size_t size() const { return(_size); }
+
+    std::string filename() const { return(_filename); }
+
+    //! Hint to the kernel that the file will be read sequentially
+    void adviseSequential() const;
+
+    //! True if \a fname names a regular file (and so can be mapped)
+    static bool isRegularFile(const std::string& fname);
+
+  private:
+    std::string _filename;
+    const char* _data;
+    size_t _size;
+    bool _copy_on_write;
+  };
+
+
+  typedef boost::shared_ptr<MappedFile> pMappedFile;
+
+}
+
+
+#endif
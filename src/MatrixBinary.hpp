@@ -0,0 +1,201 @@
+/*
+  MatrixBinary.hpp
+
+  On-disk layout shared by writeBinaryMatrix() and readBinaryMatrix()
+*/
+
+
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_MATRIXBINARY_HPP)
+#define LOOS_MATRIXBINARY_HPP
+
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+#include <loos_defs.hpp>
+#include <MatrixImpl.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    // A binary matrix file is:
+    //
+    //   BinaryMatrixHeader    (64 bytes)
+    //   metadata              (metalen bytes, not NUL-terminated)
+    //   padding               (zeros, up to offset)
+    //   payload               (count elements of the given type)
+    //
+    // The payload starts on a 64-byte boundary so that a mapping of the
+    // file can be used directly as the Matrix storage.  All fields are
+    // in the writer's byte order; endian reads as 0x01020304 when that
+    // matches the reader's.  The payload is laid out as given by order,
+    // using the same indexing as the Matrix order policies (so a
+    // ColMajor payload is plain column-major, and a Triangular payload
+    // is the packed lower triangle).
+
+    const char binary_matrix_magic[8] = { 'L', 'O', 'O', 'S', 'M', 'A', 'T', '\0' };
+    const uint32_t binary_matrix_version = 1;
+    const uint32_t binary_matrix_endian = 0x01020304;
+    const uint64_t binary_matrix_alignment = 64;
+
+    struct BinaryMatrixHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t endian;
+      uint32_t type;         // BinaryMatrixType code
+      uint32_t element_size;
+      uint32_t order;        // BinaryMatrixOrder code
+      uint32_t flags;
+      uint32_t rows;
+      uint32_t cols;
+      uint64_t metalen;
+      uint64_t offset;       // Start of the payload, from the start of the file
+      uint64_t count;        // Number of elements in the payload
+    };
+
+    //! Set when a dense symmetric matrix was packed as its lower triangle
+    const uint32_t binary_matrix_symmetric = 0x01;
+
+
+    enum { BINARY_FLOAT = 1, BINARY_DOUBLE = 2, BINARY_INT32 = 3, BINARY_UINT32 = 4,
+           BINARY_INT64 = 5, BINARY_UINT64 = 6 };
+
+    template<typename T> struct BinaryMatrixType;
+    template<> struct BinaryMatrixType<float>  { static const uint32_t code = BINARY_FLOAT; };
+    template<> struct BinaryMatrixType<double> { static const uint32_t code = BINARY_DOUBLE; };
+    template<> struct BinaryMatrixType<int>    { static const uint32_t code = BINARY_INT32; };
+    template<> struct BinaryMatrixType<uint>   { static const uint32_t code = BINARY_UINT32; };
+    template<> struct BinaryMatrixType<long>   { static const uint32_t code = sizeof(long) == 8 ? BINARY_INT64 : BINARY_INT32; };
+    template<> struct BinaryMatrixType<ulong>  { static const uint32_t code = sizeof(ulong) == 8 ? BINARY_UINT64 : BINARY_UINT32; };
+
+
+    enum { BINARY_COLMAJOR = 0, BINARY_ROWMAJOR = 1, BINARY_TRIANGULAR = 2 };
+
+    template<class P> struct BinaryMatrixOrder;
+    template<> struct BinaryMatrixOrder<Math::ColMajor>   { static const uint32_t code = BINARY_COLMAJOR; };
+    template<> struct BinaryMatrixOrder<Math::RowMajor>   { static const uint32_t code = BINARY_ROWMAJOR; };
+    template<> struct BinaryMatrixOrder<Math::Triangular> { static const uint32_t code = BINARY_TRIANGULAR; };
+
+
+    inline BinaryMatrixHeader makeBinaryMatrixHeader(const uint32_t type, const uint32_t element_size,
+                                                     const uint32_t order, const uint32_t rows, const uint32_t cols,
+                                                     const uint64_t count, const std::string& meta,
+                                                     const uint32_t flags = 0) {
+      BinaryMatrixHeader h;
+      memset(&h, 0, sizeof(h));
+      memcpy(h.magic, binary_matrix_magic, sizeof(h.magic));
+      h.version = binary_matrix_version;
+      h.endian = binary_matrix_endian;
+      h.type = type;
+      h.element_size = element_size;
+      h.order = order;
+      h.flags = flags;
+      h.rows = rows;
+      h.cols = cols;
+      h.metalen = meta.size();
+      h.count = count;
+
+      uint64_t end = sizeof(h) + h.metalen;
+      h.offset = ((end + binary_matrix_alignment - 1) / binary_matrix_alignment) * binary_matrix_alignment;
+      return(h);
+    }
+
+
+    template<typename T>
+    void swapBinaryMatrixBytes(T& t) {
+      char* p = reinterpret_cast<char*>(&t);
+      std::reverse(p, p + sizeof(T));
+    }
+
+    inline void swapBinaryMatrixHeader(BinaryMatrixHeader& h) {
+      swapBinaryMatrixBytes(h.version);
+      swapBinaryMatrixBytes(h.endian);
+      swapBinaryMatrixBytes(h.type);
+      swapBinaryMatrixBytes(h.element_size);
+      swapBinaryMatrixBytes(h.order);
+      swapBinaryMatrixBytes(h.flags);
+      swapBinaryMatrixBytes(h.rows);
+      swapBinaryMatrixBytes(h.cols);
+      swapBinaryMatrixBytes(h.metalen);
+      swapBinaryMatrixBytes(h.offset);
+      swapBinaryMatrixBytes(h.count);
+    }
+
+
+    //! Index into a payload of the given order for element (y, x)
+    inline ulong binaryMatrixIndex(const uint32_t order, const uint32_t rows, const uint32_t cols,
+                                   const uint y, const uint x) {
+      switch(order) {
+      case BINARY_ROWMAJOR: return(static_cast<ulong>(y) * cols + x);
+      case BINARY_TRIANGULAR:
+        {
+          ulong b = std::max(y, x);
+          ulong a = std::min(y, x);
+          return((b * (b + 1)) / 2 + a);
+        }
+      default: return(static_cast<ulong>(x) * rows + y);
+      }
+    }
+
+
+    //! Fetches payload element \a i, converting it to a T
+    template<typename T>
+    T binaryMatrixElement(const char* payload, const uint32_t type, const ulong i, const bool swap) {
+      switch(type) {
+
+#define LOOS_BINARY_MATRIX_FETCH(code, ctype)                           \
+        case code:                                                      \
+          {                                                             \
+            ctype v;                                                    \
+            memcpy(&v, payload + i * sizeof(ctype), sizeof(ctype));     \
+            if (swap)                                                   \
+              swapBinaryMatrixBytes(v);                                 \
+            return(static_cast<T>(v));                                  \
+          }
+
+        LOOS_BINARY_MATRIX_FETCH(BINARY_FLOAT, float);
+        LOOS_BINARY_MATRIX_FETCH(BINARY_DOUBLE, double);
+        LOOS_BINARY_MATRIX_FETCH(BINARY_INT32, int32_t);
+        LOOS_BINARY_MATRIX_FETCH(BINARY_UINT32, uint32_t);
+        LOOS_BINARY_MATRIX_FETCH(BINARY_INT64, int64_t);
+        LOOS_BINARY_MATRIX_FETCH(BINARY_UINT64, uint64_t);
+
+#undef LOOS_BINARY_MATRIX_FETCH
+
+      default:
+        return(T());
+      }
+    }
+
+  }
+
+}
+
+
+#endif
@@ -43,9 +43,12 @@
 #include <utility>
 
 #include <boost/format.hpp>
+#include <boost/shared_array.hpp>
 
 #include <loos_defs.hpp>
 #include <Matrix.hpp>
+#include <MatrixBinary.hpp>
+#include <MappedFile.hpp>
 
 
 namespace loos {
@@ -60,6 +63,15 @@ namespace loos {
   template<class T, class P, template<typename> class S>
   struct MatrixReadImpl;
 
+  template<class T, class P, template<typename> class S>
+  struct MatrixBinaryReadImpl;
+
+  //! True if \a fname is a matrix written by writeBinaryMatrix()
+  inline bool isBinaryMatrix(const std::string& fname);
+
+  template<class T, class P, template<typename> class S>
+  Math::Matrix<T,P,S> readBinaryMatrix(const std::string& fname);
+
 
 
   // The following are the templated global functions.  Do not
@@ -80,8 +92,15 @@ namespace loos {
   }
 
   //! Read in a matrix from a file returning a newly created matrix
+  /**
+   * If \a fname is a binary matrix (see writeBinaryMatrix()), it is
+   * read with readBinaryMatrix() instead, so tools that read matrices
+   * by filename accept either format.
+   */
   template<class T, class P, template<typename> class S>
   Math::Matrix<T,P,S> readAsciiMatrix(const std::string& fname) {
+    if (isBinaryMatrix(fname))
+      return(readBinaryMatrix<T,P,S>(fname));
     std::ifstream ifs(fname.c_str());
     if (!ifs)
       throw(MatrixReadError("Cannot open " + fname + " for reading."));
@@ -91,12 +110,130 @@ namespace loos {
   //! Read in a matrix from a file storing it in the specified matrix
   template<class T, class P, template<typename> class S>
   void readAsciiMatrix(const std::string& fname, Math::Matrix<T,P,S>& M) {
+    if (isBinaryMatrix(fname)) {
+      M = readBinaryMatrix<T,P,S>(fname);
+      return;
+    }
     std::ifstream ifs(fname.c_str());
     if (!ifs)
       throw(MatrixReadError("Cannot open " + fname + " for reading."));
     M = MatrixReadImpl<T,P,S>::read(ifs);
   }
 
+  //! Read a binary matrix from a file returning a newly created matrix
+  /**
+   * When the file holds exactly the requested element type and
+   * layout (and is in this machine's byte order), the file is
+   * memory-mapped and the Matrix uses the mapping as its storage, so
+   * nothing is parsed or copied and pages are only read as they are
+   * used.  The mapping is private, so changes to the Matrix are never
+   * written back to the file.  Otherwise, the elements are converted
+   * into a newly allocated Matrix (e.g. reading a symmetric file into a
+   * dense Matrix, or doubles into floats).
+   *
+   * The metadata string written with the matrix is available from
+   * Matrix::metaData().
+   */
+  template<class T, class P, template<typename> class S>
+  Math::Matrix<T,P,S> readBinaryMatrix(const std::string& fname) {
+    pMappedFile file(new MappedFile(fname, true));
+    return(MatrixBinaryReadImpl<T,P,S>::read(file));
+  }
+
+  //! Read a binary matrix from a file storing it in the specified matrix
+  template<class T, class P, template<typename> class S>
+  void readBinaryMatrix(const std::string& fname, Math::Matrix<T,P,S>& M) {
+    M = readBinaryMatrix<T,P,S>(fname);
+  }
+
+
+  inline bool isBinaryMatrix(const std::string& fname) {
+    std::ifstream ifs(fname.c_str(), std::ios::in | std::ios::binary);
+    char magic[sizeof(internal::binary_matrix_magic)];
+    if (!ifs.read(magic, sizeof(magic)))
+      return(false);
+    return(memcmp(magic, internal::binary_matrix_magic, sizeof(magic)) == 0);
+  }
+
+
+  namespace internal {
+
+    // Validated header of a mapped binary matrix
+    struct BinaryMatrixInfo {
+      BinaryMatrixHeader header;
+      bool swapped;
+      std::string meta;
+      const char* payload;
+    };
+
+
+    inline BinaryMatrixInfo parseBinaryMatrix(const MappedFile& file) {
+      BinaryMatrixInfo info;
+      BinaryMatrixHeader& h = info.header;
+
+      if (file.size() < sizeof(h))
+        throw(MatrixReadError("Binary matrix " + file.filename() + " is truncated"));
+      memcpy(&h, file.data(), sizeof(h));
+      if (memcmp(h.magic, binary_matrix_magic, sizeof(h.magic)) != 0)
+        throw(MatrixReadError(file.filename() + " is not a binary matrix"));
+
+      info.swapped = (h.endian != binary_matrix_endian);
+      if (info.swapped) {
+        swapBinaryMatrixHeader(h);
+        if (h.endian != binary_matrix_endian)
+          throw(MatrixReadError("Binary matrix " + file.filename() + " has an unknown byte order"));
+      }
+
+      if (h.version != binary_matrix_version)
+        throw(MatrixReadError("Binary matrix " + file.filename() + " has an unsupported version"));
+
+      uint32_t size = 0;
+      switch(h.type) {
+      case BINARY_FLOAT: case BINARY_INT32: case BINARY_UINT32: size = 4; break;
+      case BINARY_DOUBLE: case BINARY_INT64: case BINARY_UINT64: size = 8; break;
+      default:
+        throw(MatrixReadError("Binary matrix " + file.filename() + " has an unknown element type"));
+      }
+      if (h.element_size != size)
+        throw(MatrixReadError("Binary matrix " + file.filename() + " has the wrong element size"));
+
+      ulong expected = 0;
+      switch(h.order) {
+      case BINARY_COLMAJOR: case BINARY_ROWMAJOR:
+        expected = static_cast<ulong>(h.rows) * h.cols;
+        break;
+      case BINARY_TRIANGULAR:
+        if (h.rows != h.cols)
+          throw(MatrixReadError("Binary matrix " + file.filename() + " is triangular but not square"));
+        expected = (static_cast<ulong>(h.rows) * (h.rows + 1)) / 2;
+        break;
+      default:
+        throw(MatrixReadError("Binary matrix " + file.filename() + " has an unknown layout"));
+      }
+
+      // Compared piecewise so a corrupt header cannot overflow the sums
+      if (h.count != expected
+          || h.offset < sizeof(h) || h.metalen > h.offset - sizeof(h)
+          || h.offset > file.size()
+          || h.count > (file.size() - h.offset) / h.element_size)
+        throw(MatrixReadError("Binary matrix " + file.filename() + " is truncated or corrupt"));
+
+      info.meta = std::string(file.data() + sizeof(h), h.metalen);
+      info.payload = file.data() + h.offset;
+      return(info);
+    }
+
+
+    // Keeps the mapping alive for as long as a Matrix is using it
+    struct MappedMatrixDeleter {
+      MappedMatrixDeleter(const pMappedFile& f) : file(f) { }
+      template<typename T> void operator()(T*) const { }
+      pMappedFile file;
+    };
+
+  }
+
+
   // Implementations and specializations...
 
   template<class T, class P, template<typename> class S>
@@ -190,6 +327,63 @@ namespace loos {
   };
 
 
+  namespace internal {
+
+    // Copies a binary payload into a new Matrix, converting the type,
+    // layout, and byte order as needed.  Zeros are skipped so sparse
+    // matrices only get the elements that are set.
+    template<class T, class P, template<typename> class S>
+    Math::Matrix<T,P,S> convertBinaryMatrix(const BinaryMatrixInfo& info) {
+      const BinaryMatrixHeader& h = info.header;
+      if (BinaryMatrixOrder<P>::code == BINARY_TRIANGULAR && h.rows != h.cols)
+        throw(MatrixReadError("Cannot read a non-square binary matrix into a triangular matrix"));
+
+      Math::Matrix<T,P,S> R(h.rows, h.cols);
+      for (uint x=0; x<h.cols; ++x)
+        for (uint y=0; y<h.rows; ++y) {
+          T datum = binaryMatrixElement<T>(info.payload, h.type,
+                                           binaryMatrixIndex(h.order, h.rows, h.cols, y, x),
+                                           info.swapped);
+          if (datum != T())
+            R(y, x) = datum;
+        }
+
+      R.metaData(info.meta);
+      return(R);
+    }
+
+  }
+
+
+  //! Binary matrices are converted element by element in general...
+  template<class T, class P, template<typename> class S>
+  struct MatrixBinaryReadImpl {
+    static Math::Matrix<T,P,S> read(const pMappedFile& file) {
+      return(internal::convertBinaryMatrix<T,P,S>(internal::parseBinaryMatrix(*file)));
+    }
+  };
+
+
+  //! ...but dense matrices whose type and layout match the file are mapped directly
+  template<class T, class P>
+  struct MatrixBinaryReadImpl<T,P,Math::SharedArray> {
+    static Math::Matrix<T,P,Math::SharedArray> read(const pMappedFile& file) {
+      internal::BinaryMatrixInfo info = internal::parseBinaryMatrix(*file);
+      const internal::BinaryMatrixHeader& h = info.header;
+
+      if (h.type != internal::BinaryMatrixType<T>::code || h.element_size != sizeof(T)
+          || h.order != internal::BinaryMatrixOrder<P>::code || info.swapped)
+        return(internal::convertBinaryMatrix<T,P,Math::SharedArray>(info));
+
+      T* data = reinterpret_cast<T*>(file->writableData() + h.offset);
+      boost::shared_array<T> storage(data, internal::MappedMatrixDeleter(file));
+      Math::Matrix<T,P,Math::SharedArray> R(storage, h.rows, h.cols);
+      R.metaData(info.meta);
+      return(R);
+    }
+  };
+
+
   //! Special handling for triangular matrices
   template<class T, template<typename> class S>
   struct MatrixReadImpl<T,Math::Triangular,S> {
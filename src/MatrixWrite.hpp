@@ -42,11 +42,13 @@
 #include <algorithm>
 
 #include <utility>
+#include <vector>
 #include <boost/format.hpp>
 
 #include <loos_defs.hpp>
 
 #include <Matrix.hpp>
+#include <MatrixBinary.hpp>
 
 
 namespace loos {
@@ -56,6 +58,9 @@ namespace loos {
   template<class T, class P, template<typename> class S, class F>
   struct MatrixWriteImpl;
 
+  template<class T, class P>
+  struct MatrixBinaryWriteImpl;
+
   namespace internal {
 
     // This is the default formatter for matrix elements
@@ -237,6 +242,98 @@ writeAsciiMatrix(cout, M, "Eigenvector matrix");
   }
 
 
+  //! Write a submatrix to a stream in binary format
+  /**
+   * The binary format has a short header (dimensions, element type,
+   * layout, and the \a meta string) followed by the raw elements,
+   * which readBinaryMatrix() can map straight into a Matrix without
+   * parsing or copying.  It is also much smaller than the ASCII
+   * format.  The written submatrix is always column-major.  \a start,
+   * \a end, and \a trans have the same meaning as for
+   * writeAsciiMatrix().
+   *
+   * Only dense matrices can be written in binary.  Files are in the
+   * byte order of the machine that wrote them (and are swapped when
+   * read on a machine of the other order).
+   */
+  template<class T, class P>
+  std::ostream& writeBinaryMatrix(std::ostream& os, const Math::Matrix<T,P,Math::SharedArray>& M,
+                                  const std::string& meta, const Math::Range& start,
+                                  const Math::Range& end, const bool trans = false) {
+    return(MatrixBinaryWriteImpl<T,P>::write(os, M, meta, start, end, trans));
+  }
+
+  //! Write an entire matrix to a stream in binary format
+  /**
+   * Unless \a trans is set, the matrix is written in its own layout
+   * (including packed Triangular matrices) as one block.
+   */
+  template<class T, class P>
+  std::ostream& writeBinaryMatrix(std::ostream& os, const Math::Matrix<T,P,Math::SharedArray>& M,
+                                  const std::string& meta, const bool trans = false) {
+    if (trans) {
+      Math::Range start(0,0);
+      Math::Range end(M.rows(), M.cols());
+      return(MatrixBinaryWriteImpl<T,P>::write(os, M, meta, start, end, trans));
+    }
+    return(MatrixBinaryWriteImpl<T,P>::writeRaw(os, M, meta));
+  }
+
+  //! Write a submatrix to a file in binary format
+  template<class T, class P>
+  void writeBinaryMatrix(const std::string& fname, const Math::Matrix<T,P,Math::SharedArray>& M,
+                         const std::string& meta, const Math::Range& start,
+                         const Math::Range& end, const bool trans = false) {
+    std::ofstream ofs(fname.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open())
+      throw(std::runtime_error("Cannot open " + fname + " for writing."));
+    MatrixBinaryWriteImpl<T,P>::write(ofs, M, meta, start, end, trans);
+  }
+
+  //! Write an entire matrix to a file in binary format
+  /**
+   * Example:
+\code
+RealMatrix R = engine.compute();
+writeBinaryMatrix("rmsds.bin", R, header);
+...
+RealMatrix S;
+readBinaryMatrix("rmsds.bin", S);   // Maps the file, no copy
+\endcode
+   */
+  template<class T, class P>
+  void writeBinaryMatrix(const std::string& fname, const Math::Matrix<T,P,Math::SharedArray>& M,
+                         const std::string& meta, const bool trans = false) {
+    std::ofstream ofs(fname.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open())
+      throw(std::runtime_error("Cannot open " + fname + " for writing."));
+    writeBinaryMatrix(ofs, M, meta, trans);
+  }
+
+
+  //! Write a symmetric matrix to a stream in binary format, keeping only the lower triangle
+  /**
+   * This halves the size of the file.  The matrix is expanded again
+   * when read into a dense Matrix, or can be read directly (and
+   * without copying) into a Math::Triangular Matrix.
+   */
+  template<class T, class P>
+  std::ostream& writeBinarySymmetricMatrix(std::ostream& os, const Math::Matrix<T,P,Math::SharedArray>& M,
+                                           const std::string& meta) {
+    return(MatrixBinaryWriteImpl<T,P>::writeSymmetric(os, M, meta));
+  }
+
+  //! Write a symmetric matrix to a file in binary format, keeping only the lower triangle
+  template<class T, class P>
+  void writeBinarySymmetricMatrix(const std::string& fname, const Math::Matrix<T,P,Math::SharedArray>& M,
+                                  const std::string& meta) {
+    std::ofstream ofs(fname.c_str(), std::ios::out | std::ios::binary);
+    if (!ofs.is_open())
+      throw(std::runtime_error("Cannot open " + fname + " for writing."));
+    MatrixBinaryWriteImpl<T,P>::writeSymmetric(ofs, M, meta);
+  }
+
+
   // Writing implementation and specializations...
 
   template<class T, class P, template<typename> class S, class F>
@@ -314,6 +411,81 @@ writeAsciiMatrix(cout, M, "Eigenvector matrix");
     }
   };
 
+
+  namespace internal {
+    inline void writeBinaryMatrixHeader(std::ostream& os, const BinaryMatrixHeader& h, const std::string& meta) {
+      static const char zeros[binary_matrix_alignment] = { 0 };
+
+      os.write(reinterpret_cast<const char*>(&h), sizeof(h));
+      os.write(meta.data(), meta.size());
+      os.write(zeros, h.offset - sizeof(h) - h.metalen);
+    }
+  }
+
+
+  template<class T, class P>
+  struct MatrixBinaryWriteImpl {
+    typedef Math::Matrix<T,P,Math::SharedArray>   MatrixType;
+
+    // The whole matrix, in its own layout, in one write
+    static std::ostream& writeRaw(std::ostream& os, const MatrixType& M, const std::string& meta) {
+      internal::BinaryMatrixHeader h =
+        internal::makeBinaryMatrixHeader(internal::BinaryMatrixType<T>::code, sizeof(T),
+                                         internal::BinaryMatrixOrder<P>::code,
+                                         M.rows(), M.cols(), M.size(), meta);
+      internal::writeBinaryMatrixHeader(os, h, meta);
+      os.write(reinterpret_cast<const char*>(M.get()), M.size() * sizeof(T));
+      return(os);
+    }
+
+
+    // A submatrix (optionally transposed), written a column at a time
+    static std::ostream& write(std::ostream& os, const MatrixType& M, const std::string& meta,
+                               const Math::Range& start, const Math::Range& end, const bool trans) {
+      uint m = end.first - start.first;
+      uint n = end.second - start.second;
+      if (trans)
+        std::swap(m, n);
+
+      internal::BinaryMatrixHeader h =
+        internal::makeBinaryMatrixHeader(internal::BinaryMatrixType<T>::code, sizeof(T),
+                                         internal::BINARY_COLMAJOR,
+                                         m, n, static_cast<ulong>(m) * n, meta);
+      internal::writeBinaryMatrixHeader(os, h, meta);
+
+      std::vector<T> column(m);
+      for (uint i=0; i<n; ++i) {
+        for (uint j=0; j<m; ++j)
+          column[j] = trans ? M(start.first + i, start.second + j) : M(start.first + j, start.second + i);
+        os.write(reinterpret_cast<const char*>(column.data()), m * sizeof(T));
+      }
+      return(os);
+    }
+
+
+    // Lower triangle of a square matrix, packed as for Math::Triangular
+    static std::ostream& writeSymmetric(std::ostream& os, const MatrixType& M, const std::string& meta) {
+      if (M.rows() != M.cols())
+        throw(std::runtime_error("Only square matrices can be written as symmetric"));
+
+      uint n = M.rows();
+      internal::BinaryMatrixHeader h =
+        internal::makeBinaryMatrixHeader(internal::BinaryMatrixType<T>::code, sizeof(T),
+                                         internal::BINARY_TRIANGULAR,
+                                         n, n, (static_cast<ulong>(n) * (n + 1)) / 2, meta,
+                                         internal::binary_matrix_symmetric);
+      internal::writeBinaryMatrixHeader(os, h, meta);
+
+      std::vector<T> row(n);
+      for (uint j=0; j<n; ++j) {
+        for (uint i=0; i<=j; ++i)
+          row[i] = M(j, i);
+        os.write(reinterpret_cast<const char*>(row.data()), (j + 1) * sizeof(T));
+      }
+      return(os);
+    }
+  };
+
 }
 
 
@@ -81,6 +81,11 @@ namespace loos {
 			_trajectories[_curtraj]->updateGroupCoords(g);
 	}
 
+	void MultiTrajectory::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+		if (!eof())
+			updateGroupCoordsWithCheckedPlan(*(_trajectories[_curtraj]), g, plan);
+	}
+
 	void MultiTrajectory::updateGroupVelocitiesImpl(AtomicGroup& g) {
 		if (!eof())
 			_trajectories[_curtraj]->updateGroupVelocities(g);
@@ -163,6 +163,7 @@ namespace loos {
 		virtual void seekFrameImpl(const uint i);
 		virtual bool parseFrame();
 		virtual void updateGroupCoordsImpl(AtomicGroup& g);
+		virtual void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
 		virtual void updateGroupVelocitiesImpl(AtomicGroup& g);
 
 		void findNextUsableTraj();
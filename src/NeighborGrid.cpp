@@ -0,0 +1,256 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <algorithm>
+#include <cmath>
+
+#include <NeighborGrid.hpp>
+#include <AtomicGroup.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  namespace {
+
+    // Visitors for the query functions below
+
+    struct Collector {
+      Collector(std::vector<uint>& v) : found(v) { }
+      bool operator()(const uint i, const double) { found.push_back(i); return(true); }
+      std::vector<uint>& found;
+    };
+
+    struct Finder {
+      Finder() : found(false) { }
+      bool operator()(const uint, const double) { found = true; return(false); }
+      bool found;
+    };
+
+    struct Counter {
+      Counter(const uint m) : count(0), max(m) { }
+      bool operator()(const uint, const double) { return(++count < max); }
+      uint count, max;
+    };
+
+  }
+
+
+  NeighborGrid::NeighborGrid(const AtomicGroup& g, const double cutoff)
+    : _cutoff(cutoff), _cutoff2(cutoff * cutoff), _periodic(false)
+  {
+    build(g);
+  }
+
+
+  NeighborGrid::NeighborGrid(const AtomicGroup& g, const double cutoff, const GCoord& box)
+    : _cutoff(cutoff), _cutoff2(cutoff * cutoff), _periodic(true), _box(box)
+  {
+    for (uint i=0; i<3; ++i)
+      if (!(box[i] > 0.0))
+        throw(LOOSError("NeighborGrid requires a periodic box with positive dimensions"));
+    build(g);
+  }
+
+
+  // Picks the number of cells along each axis so that cells are at
+  // least the cutoff wide, even when the group is narrower than the
+  // cutoff along an axis.  The total number of cells is capped
+  // relative to the number of atoms so that a small cutoff over a
+  // large, sparse group does not allocate a huge, mostly empty grid.
+  void NeighborGrid::sizeGrid(const GCoord& lo, const GCoord& extent, const uint natoms) {
+    const double max_cells = std::max(27.0, 2.0 * natoms);
+    // Slightly widen cells so that roundoff when binning cannot put
+    // two atoms closer than the cutoff more than one cell apart
+    const double width = _cutoff * (1.0 + 1e-6);
+
+    double n[3];
+    for (uint i=0; i<3; ++i) {
+      n[i] = 1.0;
+      if (width > 0.0 && extent[i] > 0.0)
+        n[i] = std::max(1.0, std::min(max_cells, floor(extent[i] / width)));
+    }
+
+    while (n[0] * n[1] * n[2] > max_cells) {
+      double f = cbrt(n[0] * n[1] * n[2] / max_cells);
+      for (uint i=0; i<3; ++i)
+        n[i] = std::max(1.0, floor(n[i] / f));
+    }
+
+    _origin = lo;
+    for (uint i=0; i<3; ++i) {
+      _n[i] = static_cast<int>(n[i]);
+      _width[i] = std::max(width, extent[i] / _n[i]);
+      if (!(_width[i] > 0.0))
+        _width[i] = 1.0;
+    }
+  }
+
+
+  // Cell along axis dim containing x.  For non-periodic grids, points
+  // outside the grid get indices past either end (clamped to within
+  // one cell of it).  Since cells are at least the cutoff wide, a
+  // point clamped this way has no atoms within the cutoff.
+  int NeighborGrid::cellIndex(const double x, const uint dim) const {
+    double t;
+    if (_periodic) {
+      const double l = _box[dim];
+      t = (x - l * floor(x / l)) / _width[dim];
+    } else
+      t = (x - _origin[dim]) / _width[dim];
+
+    if (t < -1.0)
+      return(-2);
+    if (t >= _n[dim] + 1.0)
+      return(_n[dim] + 1);
+    int k = static_cast<int>(floor(t));
+    if (_periodic)
+      k = std::min(std::max(k, 0), _n[dim] - 1);
+    return(k);
+  }
+
+
+  // Cells along axis dim that may hold atoms within the cutoff of x,
+  // each listed once
+  uint NeighborGrid::neighborCells(const double x, const uint dim, int* out) const {
+    const int n = _n[dim];
+    int k = cellIndex(x, dim);
+
+    if (_periodic) {
+      if (n <= 3) {
+        for (int i=0; i<n; ++i)
+          out[i] = i;
+        return(n);
+      }
+      out[0] = (k + n - 1) % n;
+      out[1] = k;
+      out[2] = (k + 1) % n;
+      return(3);
+    }
+
+    int lo = std::max(0, k - 1);
+    int hi = std::min(n - 1, k + 1);
+    uint m = 0;
+    for (int i=lo; i<=hi; ++i)
+      out[m++] = i;
+    return(m);
+  }
+
+
+  void NeighborGrid::build(const AtomicGroup& g) {
+    const uint natoms = g.size();
+
+    if (_periodic)
+      sizeGrid(GCoord(0,0,0), _box, natoms);
+    else {
+      GCoord lo(0,0,0), hi(0,0,0);
+      if (natoms) {
+        lo = hi = g[0]->coords();
+        for (uint i=1; i<natoms; ++i) {
+          const GCoord& c = g[i]->coords();
+          for (uint k=0; k<3; ++k) {
+            lo[k] = std::min(lo[k], c[k]);
+            hi[k] = std::max(hi[k], c[k]);
+          }
+        }
+      }
+      // Pad the bounding box by the cutoff so that any point within
+      // the cutoff of an atom falls inside the grid
+      GCoord pad(_cutoff, _cutoff, _cutoff);
+      lo -= pad;
+      hi += pad;
+      sizeGrid(lo, hi - lo, natoms);
+    }
+
+    // Counting sort of the atoms into cells
+    const uint ncells = _n[0] * _n[1] * _n[2];
+    std::vector<uint> cell_of(natoms);
+    _cell_start.assign(ncells + 1, 0);
+    for (uint i=0; i<natoms; ++i) {
+      const GCoord& c = g[i]->coords();
+      int k[3];
+      for (uint d=0; d<3; ++d)
+        k[d] = std::min(std::max(cellIndex(c[d], d), 0), _n[d] - 1);
+      cell_of[i] = (k[0] * _n[1] + k[1]) * _n[2] + k[2];
+      ++_cell_start[cell_of[i] + 1];
+    }
+
+    for (uint i=0; i<ncells; ++i)
+      _cell_start[i+1] += _cell_start[i];
+
+    std::vector<uint> fill(_cell_start.begin(), _cell_start.end() - 1);
+    _ids.resize(natoms);
+    _coords.resize(natoms);
+    for (uint i=0; i<natoms; ++i) {
+      uint j = fill[cell_of[i]]++;
+      _ids[j] = i;
+      _coords[j] = g[i]->coords();
+    }
+  }
+
+
+  std::vector<uint> NeighborGrid::neighbors(const GCoord& c) const {
+    std::vector<uint> found;
+    Collector collect(found);
+    visitNeighbors(c, collect);
+    std::sort(found.begin(), found.end());
+    return(found);
+  }
+
+
+  bool NeighborGrid::hasNeighbor(const GCoord& c) const {
+    Finder finder;
+    visitNeighbors(c, finder);
+    return(finder.found);
+  }
+
+
+  uint NeighborGrid::countNeighbors(const GCoord& c, const uint max) const {
+    if (max == 0)
+      return(0);
+    Counter counter(max);
+    visitNeighbors(c, counter);
+    return(counter.count);
+  }
+
+
+  std::vector<NeighborGrid::Pair> NeighborGrid::pairs() const {
+    std::vector<Pair> result;
+    std::vector<uint> found;
+
+    for (uint a=0; a<_ids.size(); ++a) {
+      found.clear();
+      Collector collect(found);
+      visitNeighbors(_coords[a], collect);
+      for (std::vector<uint>::const_iterator i = found.begin(); i != found.end(); ++i)
+        if (*i > _ids[a])
+          result.push_back(Pair(_ids[a], *i));
+    }
+
+    std::sort(result.begin(), result.end());
+    return(result);
+  }
+
+
+}
@@ -0,0 +1,148 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_NEIGHBORGRID_HPP)
+#define LOOS_NEIGHBORGRID_HPP
+
+#include <vector>
+#include <utility>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+
+
+namespace loos {
+
+  class AtomicGroup;
+
+
+  //! Cell list for finding atoms within a cutoff distance of a point
+  /**
+   * The atoms of a group are binned into a grid of cells at least
+   * \a cutoff wide, so finding the atoms near a point only means
+   * looking in the point's cell and its immediate neighbors rather
+   * than at every atom in the group.  Atoms are stored sorted by cell
+   * so each cell's coordinates are contiguous in memory.
+   *
+   * If a periodic box is given, coordinates are wrapped into the box
+   * for binning and distances use the minimum image, as with
+   * GCoord::distance2(const GCoord&, const GCoord&).  Otherwise, the
+   * grid covers the bounding box of the group.
+   *
+   * The grid holds a snapshot of the coordinates at the time it was
+   * built, so it must be rebuilt after the coordinates change (e.g.
+   * for each trajectory frame).  Atoms are reported by their index in
+   * the group the grid was built from.
+   *
+   * AtomicGroup::within(), AtomicGroup::contactWith(), and
+   * AtomicGroup::pairsWithin() all use a NeighborGrid.
+   */
+  class NeighborGrid {
+  public:
+    typedef std::pair<uint, uint>    Pair;
+
+    //! Bin the atoms in \a g without periodicity
+    NeighborGrid(const AtomicGroup& g, const double cutoff);
+
+    //! Bin the atoms in \a g using the periodic \a box
+    NeighborGrid(const AtomicGroup& g, const double cutoff, const GCoord& box);
+
+    //! Number of atoms in the grid
+    uint size() const { return(_ids.size()); }
+
+    double cutoff() const { return(_cutoff); }
+    bool periodic() const { return(_periodic); }
+
+    //! Total number of cells in the grid
+    uint cells() const { return(_cell_start.size() - 1); }
+
+
+    //! Calls \a f for each atom within the cutoff of \a c
+    /**
+     * \a f is called as f(i, d2) where \a i is the atom's index in the
+     * original group and \a d2 is its squared distance from \a c.  If
+     * \a f returns false, the search stops early.  Atoms are visited
+     * in cell order, not group order.  Returns false if the search was
+     * stopped early.
+     */
+    template<class Visitor>
+    bool visitNeighbors(const GCoord& c, Visitor& f) const {
+      int cx[3], cy[3], cz[3];
+      uint nx = neighborCells(c[0], 0, cx);
+      uint ny = neighborCells(c[1], 1, cy);
+      uint nz = neighborCells(c[2], 2, cz);
+
+      for (uint i=0; i<nx; ++i)
+        for (uint j=0; j<ny; ++j)
+          for (uint k=0; k<nz; ++k) {
+            uint cell = (cx[i] * _n[1] + cy[j]) * _n[2] + cz[k];
+            for (uint a=_cell_start[cell]; a<_cell_start[cell+1]; ++a) {
+              double d2 = _periodic ? c.distance2(_coords[a], _box) : c.distance2(_coords[a]);
+              if (d2 <= _cutoff2)
+                if (!f(_ids[a], d2))
+                  return(false);
+            }
+          }
+
+      return(true);
+    }
+
+
+    //! Indices of atoms within the cutoff of \a c, in group order
+    std::vector<uint> neighbors(const GCoord& c) const;
+
+    //! True if any atom is within the cutoff of \a c
+    bool hasNeighbor(const GCoord& c) const;
+
+    //! Number of atoms within the cutoff of \a c, counting no further than \a max
+    uint countNeighbors(const GCoord& c, const uint max) const;
+
+    //! All pairs (i, j) with i < j of atoms in the grid within the cutoff of each other
+    /**
+     * Pairs are sorted by i, then j.
+     */
+    std::vector<Pair> pairs() const;
+
+  private:
+    void build(const AtomicGroup& g);
+    void sizeGrid(const GCoord& lo, const GCoord& extent, const uint natoms);
+    int cellIndex(const double x, const uint dim) const;
+    uint neighborCells(const double x, const uint dim, int* out) const;
+
+    double _cutoff, _cutoff2;
+    bool _periodic;
+    GCoord _box;
+    GCoord _origin;
+    double _width[3];
+    int _n[3];
+
+    std::vector<uint> _cell_start;
+    std::vector<uint> _ids;
+    std::vector<GCoord> _coords;
+  };
+
+}
+
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <utils_structural.hpp>
 #include <OptionsFramework.hpp>
+#include <xtc.hpp>
 
 #include <boost/lambda/lambda.hpp>
 
@@ -301,7 +302,8 @@ namespace loos {
       opts.add_options()
         ("skip,k", po::value<unsigned int>(&skip)->default_value(skip), "Number of frames to skip")
         ("modeltype", po::value<std::string>(), modeltypes.c_str())
-        ("trajtype", po::value<std::string>(), trajtypes.c_str());
+        ("trajtype", po::value<std::string>(), trajtypes.c_str())
+        ("xtcthreads", po::value<unsigned int>(&xtc_threads)->default_value(xtc_threads), "Decompress XTC frames ahead with this many threads (1 = off)");
     };
 
     void BasicTrajectory::addHidden(po::options_description& opts) {
@@ -326,6 +328,7 @@ namespace loos {
       } else
         model = createSystem(model_name);
 
+      XTC::setDefaultDecodeThreads(xtc_threads);
       if (map.count("trajtype")) {
         traj_type = map["trajtype"].as<std::string>();
         trajectory = createTrajectory(traj_name, traj_type, model);
@@ -342,6 +345,8 @@ namespace loos {
     std::string BasicTrajectory::print() const {
       std::ostringstream oss;
       oss << boost::format("model='%s', model_type='%s', traj='%s', traj_type='%s', skip=%d") % model_name % model_type % traj_name % traj_type % skip;
+      if (xtc_threads > 1)
+        oss << ", xtcthreads=" << xtc_threads;
       return(oss.str());
     }
 
@@ -358,7 +363,9 @@ namespace loos {
         ("modeltype", po::value<std::string>(&model_type)->default_value(model_type), modeltypes.c_str())
         ("trajtype", po::value<std::string>(&traj_type)->default_value(traj_type), trajtypes.c_str())
         ("stride,i", po::value<unsigned int>(&stride)->default_value(stride), "Take every ith frame")
-        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use (matlab style range, overrides stride and skip)");
+        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use (matlab style range, overrides stride and skip)")
+        ("prefetch", po::value<unsigned int>(&prefetch)->default_value(prefetch), "Read this many frames ahead in the background (0 = off)")
+        ("xtcthreads", po::value<unsigned int>(&xtc_threads)->default_value(xtc_threads), "Decompress XTC frames ahead with this many threads (1 = off)");
     };
 
     void TrajectoryWithFrameIndices::addHidden(po::options_description& opts) {
@@ -387,11 +394,15 @@ namespace loos {
       else
         model = createSystem(model_name, model_type);
 
+      XTC::setDefaultDecodeThreads(xtc_threads);
       if (traj_type.empty())
         trajectory = createTrajectory(traj_name, model);
       else
         trajectory = createTrajectory(traj_name, traj_type, model);
 
+      if (prefetch > 0)
+        trajectory = pTraj(new PrefetchingTrajectory(trajectory, frameList(), prefetch));
+
       return(true);
     }
 
@@ -403,6 +414,10 @@ namespace loos {
         oss << ", skip=" << skip;
       else if (!frame_index_spec.empty())
         oss << ", range='" << frame_index_spec << "'";
+      if (prefetch > 0)
+        oss << ", prefetch=" << prefetch;
+      if (xtc_threads > 1)
+        oss << ", xtcthreads=" << xtc_threads;
 
       return(oss.str());
     }
@@ -423,7 +438,8 @@ namespace loos {
         ("modeltype", po::value<std::string>(), modeltypes.c_str())
         ("skip,k", po::value<uint>(&skip)->default_value(skip), "Number of frames to skip in sub-trajectories")
         ("stride,i", po::value<uint>(&stride)->default_value(stride), "Step through sub-trajectories by this amount")
-        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use in composite trajectory");
+        ("range,r", po::value<std::string>(&frame_index_spec), "Which frames to use in composite trajectory")
+        ("xtcthreads", po::value<uint>(&xtc_threads)->default_value(xtc_threads), "Decompress XTC frames ahead with this many threads (1 = off)");
     }
 
     void MultiTrajOptions::addHidden(po::options_description& opts) {
@@ -448,6 +464,7 @@ namespace loos {
       } else
         model = createSystem(model_name);
 
+      XTC::setDefaultDecodeThreads(xtc_threads);
       mtraj = MultiTrajectory(traj_names, model, skip, stride);
       trajectory = pTraj(&mtraj, boost::lambda::_1);
 
@@ -468,6 +485,8 @@ namespace loos {
       for (uint i=0; i<traj_names.size(); ++i)
         oss << "'" << traj_names[i] << "'" << (i < traj_names.size()-1 ? "," : "");
       oss << ")";
+      if (xtc_threads > 1)
+        oss << ", xtcthreads=" << xtc_threads;
       return oss.str();
     }
 
@@ -29,6 +29,7 @@
 #include <AtomicGroup.hpp>
 #include <Trajectory.hpp>
 #include <MultiTraj.hpp>
+#include <PrefetchingTrajectory.hpp>
 #include <sfactories.hpp>
 #include <boost/algorithm/string.hpp>
 #include <exceptions.hpp>
@@ -494,10 +495,11 @@ namespace loos {
      **/
     class BasicTrajectory : public OptionsPackage {
     public:
-      BasicTrajectory() : skip(0) { }
+      BasicTrajectory() : skip(0), xtc_threads(1) { }
 
 
       unsigned int skip;
+      unsigned int xtc_threads;   // Threads decoding XTC frames (see XTC::decodeInParallel())
       std::string model_name, model_type, traj_name, traj_type;
 
       //! Model that describes the trajectory
@@ -536,12 +538,14 @@ namespace loos {
      **/
     class TrajectoryWithFrameIndices : public OptionsPackage {
     public:
-      TrajectoryWithFrameIndices() : skip(0), stride(1), frame_index_spec("") { }
+      TrajectoryWithFrameIndices() : skip(0), stride(1), prefetch(0), xtc_threads(1), frame_index_spec("") { }
 
       //! Returns the list of frames the user requested
       std::vector<uint> frameList() const;
 
       unsigned int skip, stride;
+      unsigned int prefetch;      // Frames to read ahead (see PrefetchingTrajectory)
+      unsigned int xtc_threads;   // Threads decoding XTC frames (see XTC::decodeInParallel())
       std::string frame_index_spec;
       std::string model_name, model_type, traj_name, traj_type;
 
@@ -588,11 +592,12 @@ namespace loos {
      **/
     class MultiTrajOptions : public OptionsPackage {
     public:
-      MultiTrajOptions() : skip(0), stride(1) { }
+      MultiTrajOptions() : skip(0), stride(1), xtc_threads(1) { }
 
 
       uint skip;
       uint stride;
+      uint xtc_threads;           // Threads decoding XTC frames (see XTC::decodeInParallel())
       std::vector< std::string > traj_names;
       std::string model_name, model_type, frame_index_spec;
 
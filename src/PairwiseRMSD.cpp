@@ -0,0 +1,539 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <deque>
+#include <ctime>
+
+#include <boost/format.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <PairwiseRMSD.hpp>
+#include <MatrixWrite.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define LOOS_PAIRWISE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+
+namespace loos {
+
+
+  namespace {
+
+    // Doubles per SIMD-padded coordinate row (one AVX-512 register)
+    const uint pad_width = 8;
+
+    // Cache that the two sides of a tile should fit in
+    const size_t tile_cache_bytes = 256 * 1024;
+
+
+    // The nine x/y/z cross sums are kept in separate accumulators so
+    // the loop has no dependencies between lanes.  A[3*i+j] = sum V_i U_j,
+    // matching alignment::qcpRMSDFromInnerProduct().
+
+    void innerProductScalar(double* A, const double* U, const double* V, const uint stride) {
+      const double *ux = U, *uy = U + stride, *uz = U + 2*stride;
+      const double *vx = V, *vy = V + stride, *vz = V + 2*stride;
+
+      double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0, a4 = 0.0, a5 = 0.0, a6 = 0.0, a7 = 0.0, a8 = 0.0;
+      for (uint k=0; k<stride; ++k) {
+        a0 += vx[k] * ux[k];  a1 += vx[k] * uy[k];  a2 += vx[k] * uz[k];
+        a3 += vy[k] * ux[k];  a4 += vy[k] * uy[k];  a5 += vy[k] * uz[k];
+        a6 += vz[k] * ux[k];  a7 += vz[k] * uy[k];  a8 += vz[k] * uz[k];
+      }
+
+      A[0] = a0; A[1] = a1; A[2] = a2;
+      A[3] = a3; A[4] = a4; A[5] = a5;
+      A[6] = a6; A[7] = a7; A[8] = a8;
+    }
+
+
+#if defined(LOOS_PAIRWISE_X86_SIMD)
+
+    __attribute__((target("avx2,fma")))
+    double hsumAVX2(const __m256d v) {
+      __m128d lo = _mm256_castpd256_pd128(v);
+      __m128d hi = _mm256_extractf128_pd(v, 1);
+      lo = _mm_add_pd(lo, hi);
+      return(_mm_cvtsd_f64(_mm_add_sd(lo, _mm_unpackhi_pd(lo, lo))));
+    }
+
+
+    __attribute__((target("avx2,fma")))
+    void innerProductAVX2(double* A, const double* U, const double* V, const uint stride) {
+      const double *ux = U, *uy = U + stride, *uz = U + 2*stride;
+      const double *vx = V, *vy = V + stride, *vz = V + 2*stride;
+
+      __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd(), a2 = _mm256_setzero_pd();
+      __m256d a3 = _mm256_setzero_pd(), a4 = _mm256_setzero_pd(), a5 = _mm256_setzero_pd();
+      __m256d a6 = _mm256_setzero_pd(), a7 = _mm256_setzero_pd(), a8 = _mm256_setzero_pd();
+
+      for (uint k=0; k<stride; k += 4) {
+        const __m256d x = _mm256_load_pd(ux + k), y = _mm256_load_pd(uy + k), z = _mm256_load_pd(uz + k);
+        const __m256d p = _mm256_load_pd(vx + k), q = _mm256_load_pd(vy + k), r = _mm256_load_pd(vz + k);
+        a0 = _mm256_fmadd_pd(p, x, a0);  a1 = _mm256_fmadd_pd(p, y, a1);  a2 = _mm256_fmadd_pd(p, z, a2);
+        a3 = _mm256_fmadd_pd(q, x, a3);  a4 = _mm256_fmadd_pd(q, y, a4);  a5 = _mm256_fmadd_pd(q, z, a5);
+        a6 = _mm256_fmadd_pd(r, x, a6);  a7 = _mm256_fmadd_pd(r, y, a7);  a8 = _mm256_fmadd_pd(r, z, a8);
+      }
+
+      A[0] = hsumAVX2(a0); A[1] = hsumAVX2(a1); A[2] = hsumAVX2(a2);
+      A[3] = hsumAVX2(a3); A[4] = hsumAVX2(a4); A[5] = hsumAVX2(a5);
+      A[6] = hsumAVX2(a6); A[7] = hsumAVX2(a7); A[8] = hsumAVX2(a8);
+    }
+
+
+    // Stores and sums the lanes rather than using _mm512_reduce_add_pd()
+    // (or _mm512_extractf64x4_pd()), which draw -Wuninitialized
+    // warnings from GCC's headers
+    __attribute__((target("avx512f")))
+    double hsumAVX512(const __m512d v) {
+      double t[8] __attribute__((aligned(64)));
+      _mm512_store_pd(t, v);
+      return(((t[0] + t[1]) + (t[2] + t[3])) + ((t[4] + t[5]) + (t[6] + t[7])));
+    }
+
+
+    __attribute__((target("avx512f")))
+    void innerProductAVX512(double* A, const double* U, const double* V, const uint stride) {
+      const double *ux = U, *uy = U + stride, *uz = U + 2*stride;
+      const double *vx = V, *vy = V + stride, *vz = V + 2*stride;
+
+      __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd(), a2 = _mm512_setzero_pd();
+      __m512d a3 = _mm512_setzero_pd(), a4 = _mm512_setzero_pd(), a5 = _mm512_setzero_pd();
+      __m512d a6 = _mm512_setzero_pd(), a7 = _mm512_setzero_pd(), a8 = _mm512_setzero_pd();
+
+      for (uint k=0; k<stride; k += 8) {
+        const __m512d x = _mm512_load_pd(ux + k), y = _mm512_load_pd(uy + k), z = _mm512_load_pd(uz + k);
+        const __m512d p = _mm512_load_pd(vx + k), q = _mm512_load_pd(vy + k), r = _mm512_load_pd(vz + k);
+        a0 = _mm512_fmadd_pd(p, x, a0);  a1 = _mm512_fmadd_pd(p, y, a1);  a2 = _mm512_fmadd_pd(p, z, a2);
+        a3 = _mm512_fmadd_pd(q, x, a3);  a4 = _mm512_fmadd_pd(q, y, a4);  a5 = _mm512_fmadd_pd(q, z, a5);
+        a6 = _mm512_fmadd_pd(r, x, a6);  a7 = _mm512_fmadd_pd(r, y, a7);  a8 = _mm512_fmadd_pd(r, z, a8);
+      }
+
+      A[0] = hsumAVX512(a0); A[1] = hsumAVX512(a1); A[2] = hsumAVX512(a2);
+      A[3] = hsumAVX512(a3); A[4] = hsumAVX512(a4); A[5] = hsumAVX512(a5);
+      A[6] = hsumAVX512(a6); A[7] = hsumAVX512(a7); A[8] = hsumAVX512(a8);
+    }
+
+#endif // defined(LOOS_PAIRWISE_X86_SIMD)
+
+  }
+
+
+  // --------------------------------------------------------------------------------
+
+  void AsciiPairwiseRMSDWriter::begin(const uint rows, const uint cols) {
+    _os << boost::format("# %d %d (0)\n") % rows % cols;
+  }
+
+
+  void AsciiPairwiseRMSDWriter::rows(const uint first, const uint n, const uint cols, const double* values) {
+    for (uint j=0; j<n; ++j) {
+      const double* row = values + static_cast<size_t>(j) * cols;
+      for (uint i=0; i<cols; ++i)
+        _os << static_cast<RealMatrix::element_type>(row[i]) << " ";
+      _os << std::endl;
+    }
+  }
+
+
+  void BinaryPairwiseRMSDWriter::begin(const uint rows, const uint cols) {
+    typedef RealMatrix::element_type element_type;
+
+    if (_symmetric && rows != cols)
+      throw(LOOSError("A symmetric pairwise RMSD matrix must be square"));
+
+    internal::BinaryMatrixHeader h = _symmetric
+      ? internal::makeBinaryMatrixHeader(internal::BinaryMatrixType<element_type>::code, sizeof(element_type),
+                                         internal::BINARY_TRIANGULAR,
+                                         rows, cols, (static_cast<ulong>(rows) * (rows + 1)) / 2, _meta,
+                                         internal::binary_matrix_symmetric)
+      : internal::makeBinaryMatrixHeader(internal::BinaryMatrixType<element_type>::code, sizeof(element_type),
+                                         internal::BINARY_ROWMAJOR,
+                                         rows, cols, static_cast<ulong>(rows) * cols, _meta);
+    internal::writeBinaryMatrixHeader(_os, h, _meta);
+  }
+
+
+  void BinaryPairwiseRMSDWriter::rows(const uint first, const uint n, const uint cols, const double* values) {
+    if (_symmetric) {
+      // Row j of the lower triangle has j+1 elements
+      _buffer.clear();
+      for (uint j=0; j<n; ++j) {
+        const double* row = values + static_cast<size_t>(j) * cols;
+        _buffer.insert(_buffer.end(), row, row + first + j + 1);
+      }
+    } else {
+      size_t k = static_cast<size_t>(n) * cols;
+      _buffer.resize(k);
+      std::copy(values, values + k, _buffer.begin());
+    }
+    _os.write(reinterpret_cast<const char*>(_buffer.data()), _buffer.size() * sizeof(RealMatrix::element_type));
+  }
+
+
+  // --------------------------------------------------------------------------------
+
+  // Reports how many tiles are done, like the tools' old row counters
+  class PairwiseRMSD::Progress {
+  public:
+    Progress(const uint total, const bool verbose)
+      : _done(0), _total(total), _updatefreq(std::max(1u, total / 20)),
+        _verbose(verbose), _start_time(time(0)) { }
+
+    void tileDone() {
+      if (!_verbose)
+        return;
+      boost::mutex::scoped_lock lock(_mtx);
+      if (++_done % _updatefreq == 0)
+        updateStatus();
+    }
+
+    void updateStatus() const {
+      time_t dt = time(0) - _start_time;
+      uint d = _done ? (_total - _done) * dt / _done : 0;
+
+      uint hrs = d / 3600;
+      uint remain = d % 3600;
+      uint mins = remain / 60;
+      uint secs = remain % 60;
+
+      std::cerr << boost::format("Tile %5d /%5d, Elapsed = %5d s, Remaining = %02d:%02d:%02d\n")
+        % _done % _total % dt % hrs % mins % secs;
+    }
+
+  private:
+    uint _done, _total, _updatefreq;
+    bool _verbose;
+    time_t _start_time;
+    boost::mutex _mtx;
+  };
+
+
+  // Each thread has its own queue of tiles, dealt out in contiguous
+  // runs so a thread tends to reuse the row block it just had.  A
+  // thread takes from the front of its own queue and, once that is
+  // empty, steals from the back of the others'.
+  class PairwiseRMSD::Scheduler {
+  public:
+    Scheduler(const std::vector<Tile>& tiles, const uint nthreads)
+      : _queues(nthreads), _locks(nthreads)
+    {
+      for (uint t=0; t<nthreads; ++t) {
+        size_t begin = tiles.size() * t / nthreads;
+        size_t end = tiles.size() * (t+1) / nthreads;
+        _queues[t].assign(tiles.begin() + begin, tiles.begin() + end);
+      }
+    }
+
+    bool next(const uint self, Tile& tile) {
+      {
+        boost::mutex::scoped_lock lock(_locks[self]);
+        if (!_queues[self].empty()) {
+          tile = _queues[self].front();
+          _queues[self].pop_front();
+          return(true);
+        }
+      }
+
+      for (uint k=1; k<_queues.size(); ++k) {
+        uint victim = (self + k) % _queues.size();
+        boost::mutex::scoped_lock lock(_locks[victim]);
+        if (!_queues[victim].empty()) {
+          tile = _queues[victim].back();
+          _queues[victim].pop_back();
+          return(true);
+        }
+      }
+
+      return(false);
+    }
+
+  private:
+    std::vector< std::deque<Tile> > _queues;
+    std::vector<boost::mutex> _locks;
+  };
+
+
+  class PairwiseRMSD::Worker {
+  public:
+    Worker(const PairwiseRMSD& engine, Scheduler& scheduler, const Output& out, Progress& progress, const uint id)
+      : _engine(engine), _scheduler(scheduler), _out(out), _progress(progress), _id(id) { }
+
+    void operator()() {
+      InnerProduct ip = _engine.innerProduct();
+      Tile tile(0, 0, 0, 0, false);
+
+      while (_scheduler.next(_id, tile)) {
+        for (uint i=tile.row0; i<tile.row1; ++i) {
+          uint end = tile.lower ? std::min(i, tile.col1) : tile.col1;
+          for (uint j=tile.col0; j<end; ++j)
+            _out.store(i, j, _engine.pairRMSD(ip, i, j));
+        }
+        _progress.tileDone();
+      }
+    }
+
+  private:
+    const PairwiseRMSD& _engine;
+    Scheduler& _scheduler;
+    const Output& _out;
+    Progress& _progress;
+    uint _id;
+  };
+
+
+  // --------------------------------------------------------------------------------
+
+
+  void PairwiseRMSD::Packed::pack(const alignment::vecMatrix& frames) {
+    nframes = frames.size();
+    natoms = nframes ? frames[0].size() / 3 : 0;
+    stride = ((natoms + pad_width - 1) / pad_width) * pad_width;
+
+    // Over-allocate so the data can start on a 64-byte boundary; with
+    // stride a multiple of 8, every x, y, and z row is then aligned too
+    storage.assign(static_cast<size_t>(nframes) * 3 * stride + pad_width, 0.0);
+    size_t misalign = (reinterpret_cast<size_t>(&storage[0]) / sizeof(double)) % pad_width;
+    data = &storage[0] + (misalign ? pad_width - misalign : 0);
+
+    half_sumsq.resize(nframes);
+    for (uint f=0; f<nframes; ++f) {
+      if (frames[f].size() != 3 * natoms)
+        throw(LOOSError("PairwiseRMSD: all frames must have the same number of atoms"));
+
+      double cx = 0.0, cy = 0.0, cz = 0.0;
+      const double* src = &frames[f][0];
+      for (uint i=0; i<natoms; ++i) {
+        cx += src[3*i];
+        cy += src[3*i+1];
+        cz += src[3*i+2];
+      }
+      cx /= natoms;
+      cy /= natoms;
+      cz /= natoms;
+
+      double* x = data + static_cast<size_t>(f) * 3 * stride;
+      double* y = x + stride;
+      double* z = y + stride;
+      double g = 0.0;
+      for (uint i=0; i<natoms; ++i) {
+        x[i] = src[3*i] - cx;
+        y[i] = src[3*i+1] - cy;
+        z[i] = src[3*i+2] - cz;
+        g += x[i]*x[i] + y[i]*y[i] + z[i]*z[i];
+      }
+      half_sumsq[f] = 0.5 * g;
+    }
+  }
+
+
+  PairwiseRMSD::PairwiseRMSD(const alignment::vecMatrix& frames)
+    : _b(&_a), _nthreads(1), _tile(0), _verbose(false), _simd(availableSIMD())
+  {
+    _a.pack(frames);
+  }
+
+
+  PairwiseRMSD::PairwiseRMSD(const alignment::vecMatrix& A, const alignment::vecMatrix& B)
+    : _b(&_bstore), _nthreads(1), _tile(0), _verbose(false), _simd(availableSIMD())
+  {
+    _a.pack(A);
+    _bstore.pack(B);
+    if (_a.nframes && _bstore.nframes && _a.natoms != _bstore.natoms)
+      throw(LOOSError("PairwiseRMSD: both sets of structures must have the same number of atoms"));
+  }
+
+
+  PairwiseRMSD::SIMDLevel PairwiseRMSD::availableSIMD() {
+#if defined(LOOS_PAIRWISE_X86_SIMD)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+      return(AVX512);
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return(AVX2);
+#endif
+    return(SCALAR);
+  }
+
+
+  std::string PairwiseRMSD::simdName(const SIMDLevel level) {
+    switch(level) {
+    case AVX512: return("AVX-512");
+    case AVX2: return("AVX2");
+    default: return("scalar");
+    }
+  }
+
+
+  void PairwiseRMSD::simd(const SIMDLevel level) {
+    _simd = std::min(level, availableSIMD());
+  }
+
+
+  PairwiseRMSD::InnerProduct PairwiseRMSD::innerProduct() const {
+#if defined(LOOS_PAIRWISE_X86_SIMD)
+    if (_simd == AVX512)
+      return(innerProductAVX512);
+    if (_simd == AVX2)
+      return(innerProductAVX2);
+#endif
+    return(innerProductScalar);
+  }
+
+
+  uint PairwiseRMSD::threads() const {
+    uint n = _nthreads ? _nthreads : boost::thread::hardware_concurrency();
+    return(n ? n : 1);
+  }
+
+
+  // Largest tile whose two frame blocks fit in tile_cache_bytes, cut
+  // down until there are a few tiles per thread to balance
+  uint PairwiseRMSD::resolvedTileSize(const uint nthreads) const {
+    if (_tile)
+      return(_tile);
+
+    size_t frame_bytes = static_cast<size_t>(3) * _a.stride * sizeof(double);
+    uint tile = frame_bytes ? tile_cache_bytes / (2 * frame_bytes) : 1;
+    tile = std::max(8u, std::min(512u, tile));
+
+    while (tile > 1) {
+      size_t nr = (rows() + tile - 1) / tile;
+      size_t nc = (cols() + tile - 1) / tile;
+      size_t ntiles = symmetric() ? nr * (nr + 1) / 2 : nr * nc;
+      if (ntiles >= 4 * static_cast<size_t>(nthreads))
+        break;
+      tile /= 2;
+    }
+
+    return(tile);
+  }
+
+
+  double PairwiseRMSD::pairRMSD(InnerProduct ip, const uint i, const uint j) const {
+    if (symmetric() && i == j)
+      return(0.0);
+
+    double A[9];
+    (*ip)(A, _a.frame(i), _b->frame(j), _a.stride);
+    return(alignment::qcpRMSDFromInnerProduct(A, _a.half_sumsq[i] + _b->half_sumsq[j], _a.natoms));
+  }
+
+
+  double PairwiseRMSD::rmsd(const uint i, const uint j) const {
+    if (i >= rows() || j >= cols())
+      throw(LOOSError("PairwiseRMSD: frame index out of range"));
+    return(pairRMSD(innerProduct(), i, j));
+  }
+
+
+  void PairwiseRMSD::run(const std::vector<Tile>& tiles, const Output& out, const uint nthreads, Progress& progress) const {
+    uint n = std::max(1u, std::min(nthreads, static_cast<uint>(tiles.size())));
+    Scheduler scheduler(tiles, n);
+
+    std::vector<Worker> workers;
+    workers.reserve(n);
+    for (uint t=0; t<n; ++t)
+      workers.push_back(Worker(*this, scheduler, out, progress, t));
+
+    if (n == 1) {
+      workers[0]();
+      return;
+    }
+
+    std::vector<boost::thread*> threads(n);
+    for (uint t=0; t<n; ++t)
+      threads[t] = new boost::thread(boost::ref(workers[t]));
+    for (uint t=0; t<n; ++t) {
+      threads[t]->join();
+      delete threads[t];
+    }
+  }
+
+
+  RealMatrix PairwiseRMSD::compute() {
+    uint nthreads = threads();
+    uint tile = resolvedTileSize(nthreads);
+
+    std::vector<Tile> tiles;
+    for (uint r=0; r<rows(); r += tile) {
+      uint r1 = std::min(r + tile, rows());
+      if (symmetric()) {
+        for (uint c=0; c<=r; c += tile)
+          tiles.push_back(Tile(r, r1, c, std::min(c + tile, cols()), c == r));
+      } else {
+        for (uint c=0; c<cols(); c += tile)
+          tiles.push_back(Tile(r, r1, c, std::min(c + tile, cols()), false));
+      }
+    }
+
+    RealMatrix R(rows(), cols());
+    Output out;
+    out.matrix = &R;
+    out.mirror = symmetric();
+
+    Progress progress(tiles.size(), _verbose);
+    run(tiles, out, nthreads, progress);
+    if (_verbose)
+      progress.updateStatus();
+
+    return(R);
+  }
+
+
+  void PairwiseRMSD::compute(PairwiseRMSDWriter& writer) {
+    uint nthreads = threads();
+    uint tile = resolvedTileSize(nthreads);
+    uint ncoltiles = (cols() + tile - 1) / tile;
+    uint nbands = (rows() + tile - 1) / tile;
+
+    writer.begin(rows(), cols());
+
+    Progress progress(nbands * ncoltiles, _verbose);
+    std::vector<double> band(static_cast<size_t>(tile) * cols());
+    for (uint r=0; r<rows(); r += tile) {
+      uint r1 = std::min(r + tile, rows());
+
+      std::vector<Tile> tiles;
+      for (uint c=0; c<cols(); c += tile)
+        tiles.push_back(Tile(r, r1, c, std::min(c + tile, cols()), false));
+
+      Output out;
+      out.band = band.data();
+      out.band_row0 = r;
+      out.cols = cols();
+      run(tiles, out, nthreads, progress);
+
+      writer.rows(r, r1 - r, cols(), band.data());
+    }
+
+    writer.end();
+    if (_verbose)
+      progress.updateStatus();
+  }
+
+
+}
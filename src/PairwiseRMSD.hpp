@@ -0,0 +1,245 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_PAIRWISERMSD_HPP)
+#define LOOS_PAIRWISERMSD_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <loos_defs.hpp>
+#include <MatrixOps.hpp>
+#include <alignment.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Receives a pairwise RMSD matrix from PairwiseRMSD a block of rows at a time
+  /**
+   * Rows are always handed over in order, so a writer can stream the
+   * matrix out without ever holding all of it.
+   */
+  class PairwiseRMSDWriter {
+  public:
+    virtual ~PairwiseRMSDWriter() { }
+
+    //! Called once, before any rows, with the size of the whole matrix
+    virtual void begin(const uint rows, const uint cols) { }
+
+    //! Rows [first, first+n), stored row-major (n * cols values)
+    virtual void rows(const uint first, const uint n, const uint cols, const double* values) = 0;
+
+    //! Called once after the last row
+    virtual void end() { }
+  };
+
+
+  //! Writes rows in the same ASCII format as writing a Matrix with operator<<()
+  /**
+   * Any precision set on the stream is used for the elements.
+   */
+  class AsciiPairwiseRMSDWriter : public PairwiseRMSDWriter {
+  public:
+    AsciiPairwiseRMSDWriter(std::ostream& os) : _os(os) { }
+
+    void begin(const uint rows, const uint cols);
+    void rows(const uint first, const uint n, const uint cols, const double* values);
+
+  private:
+    std::ostream& _os;
+  };
+
+
+  //! Writes rows in the binary matrix format (see writeBinaryMatrix())
+  /**
+   * Since rows arrive in order, the payload is written row-major (as
+   * floats, like a RealMatrix).  readBinaryMatrix() converts it when
+   * reading into a column-major Matrix.
+   *
+   * If \a symmetric is set (i.e. a trajectory compared with itself),
+   * only the lower triangle of each row is kept, in the same layout
+   * as writeBinarySymmetricMatrix().
+   */
+  class BinaryPairwiseRMSDWriter : public PairwiseRMSDWriter {
+  public:
+    BinaryPairwiseRMSDWriter(std::ostream& os, const std::string& meta, const bool symmetric = false)
+      : _os(os), _meta(meta), _symmetric(symmetric) { }
+
+    void begin(const uint rows, const uint cols);
+    void rows(const uint first, const uint n, const uint cols, const double* values);
+
+  private:
+    std::ostream& _os;
+    std::string _meta;
+    bool _symmetric;
+    std::vector<RealMatrix::element_type> _buffer;
+  };
+
+
+  //! All-to-all RMSD (after optimal superposition) between sets of structures
+  /**
+   * The structures are copied into one packed, centered block with the
+   * x, y, and z coordinates of each frame stored separately and padded
+   * for SIMD.  The pair matrix is split into square tiles of frames
+   * sized so that both sides of a tile stay in cache, and the 3x3
+   * inner products for each pair are evaluated with AVX-512, AVX2, or
+   * plain scalar code, whichever is the best the CPU supports (checked
+   * at runtime).  The RMSD then comes from the QCP eigenvalue solver
+   * (see alignment::qcpRMSDFromInnerProduct()).
+   *
+   * Tiles are dealt out to per-thread queues, and threads that run out
+   * of work steal from the others, which keeps the uneven triangular
+   * workload balanced.
+   *
+   * With one set of structures, only the lower triangle is computed
+   * and the result is symmetric.  With two sets (\a A and \a B), the
+   * matrix is A.size() x B.size().
+   * \code
+   * alignment::vecMatrix T = readCoords(subset, traj, frames, false);
+   * PairwiseRMSD engine(T);
+   * engine.threads(8);
+   * RealMatrix R = engine.compute();
+   * \endcode
+   *
+   * The matrix can also be handed to a PairwiseRMSDWriter in blocks of
+   * rows as it is computed, so only one block of rows is ever held in
+   * memory.  For a single set, this computes both halves of the
+   * matrix, so it takes about twice as long as compute().
+   */
+  class PairwiseRMSD : public boost::noncopyable {
+  public:
+    enum SIMDLevel { SCALAR, AVX2, AVX512 };
+
+    //! Pairwise RMSDs between every pair of \a frames (each packed xyzxyz...)
+    explicit PairwiseRMSD(const alignment::vecMatrix& frames);
+
+    //! Pairwise RMSDs between every frame in \a A and every frame in \a B
+    PairwiseRMSD(const alignment::vecMatrix& A, const alignment::vecMatrix& B);
+
+    uint rows() const { return(_a.nframes); }
+    uint cols() const { return(_b->nframes); }
+    uint natoms() const { return(_a.natoms); }
+
+    //! True if the matrix is of one set against itself
+    bool symmetric() const { return(_b == &_a); }
+
+    //! Number of threads to use (0 = one per core)
+    void threads(const uint n) { _nthreads = n; }
+    uint threads() const;
+
+    //! Number of frames on a side of a tile (0 = pick from the cache size)
+    void tileSize(const uint n) { _tile = n; }
+    uint tileSize() const { return(resolvedTileSize(threads())); }
+
+    //! Report progress to stderr while computing
+    void verbose(const bool b) { _verbose = b; }
+
+    //! Force a SIMD level (capped at what the CPU supports)
+    void simd(const SIMDLevel level);
+    SIMDLevel simd() const { return(_simd); }
+
+    //! Best SIMD level supported by this CPU
+    static SIMDLevel availableSIMD();
+    static std::string simdName(const SIMDLevel level);
+
+    //! RMSD between frame \a i of the first set and frame \a j of the second
+    double rmsd(const uint i, const uint j) const;
+
+    //! Computes the whole matrix
+    RealMatrix compute();
+
+    //! Computes the matrix, handing it to \a writer a block of rows at a time
+    void compute(PairwiseRMSDWriter& writer);
+
+  private:
+
+    // Centered coordinates, one frame after another.  Each frame is
+    // x[stride], y[stride], z[stride], zero-padded past natoms.
+    struct Packed {
+      Packed() : nframes(0), natoms(0), stride(0), data(0) { }
+
+      void pack(const alignment::vecMatrix& frames);
+      const double* frame(const uint i) const { return(data + static_cast<size_t>(i) * 3 * stride); }
+
+      uint nframes, natoms, stride;
+      std::vector<double> storage;
+      std::vector<double> half_sumsq;
+      double* data;
+    };
+
+    // Frames [row0, row1) x [col0, col1).  A lower tile only does
+    // the pairs below the diagonal.
+    struct Tile {
+      Tile(const uint r0, const uint r1, const uint c0, const uint c1, const bool l)
+        : row0(r0), row1(r1), col0(c0), col1(c1), lower(l) { }
+      uint row0, row1, col0, col1;
+      bool lower;
+    };
+
+    // Where finished pairs go: either a whole matrix (optionally
+    // mirrored) or a row-major band of rows starting at band_row0
+    struct Output {
+      Output() : matrix(0), mirror(false), band(0), band_row0(0), cols(0) { }
+      void store(const uint i, const uint j, const double d) const {
+        if (matrix) {
+          (*matrix)(i, j) = d;
+          if (mirror)
+            (*matrix)(j, i) = d;
+        } else
+          band[static_cast<size_t>(i - band_row0) * cols + j] = d;
+      }
+
+      RealMatrix* matrix;
+      bool mirror;
+      double* band;
+      uint band_row0, cols;
+    };
+
+    class Progress;
+    class Scheduler;
+    class Worker;
+
+    typedef void (*InnerProduct)(double* A, const double* U, const double* V, const uint stride);
+
+    InnerProduct innerProduct() const;
+    double pairRMSD(InnerProduct ip, const uint i, const uint j) const;
+    uint resolvedTileSize(const uint nthreads) const;
+    void run(const std::vector<Tile>& tiles, const Output& out, const uint nthreads, Progress& progress) const;
+
+    Packed _a, _bstore;
+    const Packed* _b;
+    uint _nthreads, _tile;
+    bool _verbose;
+    SIMDLevel _simd;
+  };
+
+
+}
+
+
+#endif
@@ -31,6 +31,7 @@
 
 #include <AtomicGroup.hpp>
 #include <Kernel.hpp>
+#include <AtomColumns.hpp>
 #include <ParserDriver.hpp>
 
 
@@ -65,6 +66,15 @@ namespace loos {
    "CA" =~ "C"   -> true
    \endverbatim
    *
+   *  Spatial operators select atoms relative to another selection:
+   *  "within 5 of resname == 'HEME'", "around 3.5 of segid == 'PROT'"
+   *  (within, but excluding the atoms of the subselection), "same
+   *  residue as name == 'OH2'", and "same molecule as resid == 10".
+   *  These apply to the following relational expression, so use
+   *  parentheses for anything more complex.  The Kernel must be
+   *  prepared with the group being selected from before it is
+   *  executed (see Kernel::prepare()).
+   *
    *  Finally, the standard precedence and associativity that apply in
    *  C++ apply here.  Expressions are evaluated left to right and
    *  parenthesis may be used to alter precedence/evaluation order.
@@ -77,10 +87,18 @@ namespace loos {
    *  \code
    *  string selection_string = "resid >= 10 && resid <= 100 && name == 'CA'";
    *  Parser parsed(selection_string);
+   *  parsed.kernel().prepare(molecule);
    *  KernelSelector parsed_selector(parsed.kernel());
    *  AtomicGroup parsed_selection = molecule.select(parsed_selector)
    *  \endcode
    *
+   *  For a whole group, the Kernel can also evaluate the selection
+   *  column-wise, which is much faster for large systems:
+   *  \code
+   *  AtomColumns columns(molecule);
+   *  AtomicGroup parsed_selection = parsed.kernel().select(columns);
+   *  \endcode
+   *
    *  Parser objects are intended to be a parse-once object.  If you
    *  want to parse multiple selection strings, then you should
    *  instantiate a Parser object for each selection string.
@@ -0,0 +1,246 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2016, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+
+#include <PrefetchingTrajectory.hpp>
+#include <AtomicGroup.hpp>
+
+
+namespace loos {
+
+
+	PrefetchingTrajectory::PrefetchingTrajectory(const pTraj& traj, const uint depth)
+		: _traj(traj), _consume(1), _produce(1), _generation(0), _shutdown(false), _last_read(-1), _thread(0)
+	{
+		// Frame 0 is already cached, so start reading ahead at frame 1
+		for (uint i=0; i<traj->nframes(); ++i)
+			_schedule.push_back(i);
+		init(depth);
+	}
+
+
+	PrefetchingTrajectory::PrefetchingTrajectory(const pTraj& traj, const std::vector<uint>& frames, const uint depth)
+		: _traj(traj), _frames(frames), _schedule(frames), _consume(0), _produce(0),
+		  _generation(0), _shutdown(false), _last_read(-1), _thread(0)
+	{
+		for (uint i=0; i<frames.size(); ++i)
+			if (frames[i] >= traj->nframes())
+				throw(LOOSError("Frame index for PrefetchingTrajectory is out of range"));
+
+		// If the list starts with frame 0, that read is served from the
+		// cached first frame, so start reading ahead at the next one
+		if (!frames.empty() && frames[0] == 0)
+			_consume = _produce = 1;
+		init(depth);
+	}
+
+
+	// Copies the metadata and the currently cached frame from the
+	// wrapped trajectory, then starts the background thread
+	void PrefetchingTrajectory::init(const uint depth) {
+		if (depth == 0)
+			throw(LOOSError("PrefetchingTrajectory must be able to read at least one frame ahead"));
+
+		_filename = _traj->filename();
+		_description = _traj->description();
+		_natoms = _traj->natoms();
+		_nframes = _traj->nframes();
+		_timestep = _traj->timestep();
+		_has_velocities = _traj->hasVelocities();
+		_velocity_conversion = _traj->velocityConversionFactor();
+
+		_current.coords = _traj->coords();
+		_current.has_box = _traj->hasPeriodicBox();
+		if (_current.has_box)
+			_current.box = _traj->periodicBox();
+		if (_has_velocities)
+			_current.velocities = _traj->velocities();
+
+		_slots.resize(depth);
+		cached_first = true;
+
+		_thread = new boost::thread(&PrefetchingTrajectory::readAhead, this);
+	}
+
+
+	PrefetchingTrajectory::~PrefetchingTrajectory() {
+		{
+			boost::lock_guard<boost::mutex> lock(_mutex);
+			_shutdown = true;
+		}
+		_cond.notify_all();
+
+		_thread->join();
+		delete _thread;
+	}
+
+
+	// Reads a frame from the wrapped trajectory.  Only called from the
+	// background thread.
+	void PrefetchingTrajectory::readFrom(const uint frame, Frame& f) {
+		f.ok = false;
+		f.error.clear();
+
+		try {
+			// Let the wrapped trajectory step forward when it can rather
+			// than seek.  The first read always seeks, since the wrapped
+			// trajectory may still have its first frame cached.
+			if (static_cast<int>(frame) == _last_read + 1)
+				f.ok = _traj->readFrame();
+			else
+				f.ok = _traj->readFrame(frame);
+			_last_read = frame;
+
+			if (f.ok) {
+				f.coords = _traj->coords();
+				f.has_box = _traj->hasPeriodicBox();
+				if (f.has_box)
+					f.box = _traj->periodicBox();
+				if (_has_velocities)
+					f.velocities = _traj->velocities();
+			}
+		}
+		catch (std::exception& e) {
+			f.error = e.what();
+			_last_read = -1;
+		}
+	}
+
+
+	void PrefetchingTrajectory::readAhead() {
+		Frame local;
+
+		boost::unique_lock<boost::mutex> lock(_mutex);
+		while (!_shutdown) {
+			if (_produce >= _schedule.size() || _produce >= _consume + _slots.size()) {
+				_cond.wait(lock);
+				continue;
+			}
+
+			uint position = _produce++;
+			uint frame = _schedule[position];
+			ulong generation = _generation;
+			lock.unlock();
+
+			readFrom(frame, local);
+
+			lock.lock();
+			if (generation == _generation) {
+				Frame& slot = _slots[position % _slots.size()];
+				std::swap(slot, local);
+				slot.position = position;
+				slot.ready = true;
+				_cond.notify_all();
+			}
+		}
+	}
+
+
+	// Discards the read-ahead and picks up from the requested frame.
+	// Must be called with the mutex held.
+	void PrefetchingTrajectory::reposition(const uint frame) {
+		++_generation;
+		for (uint i=0; i<_slots.size(); ++i)
+			_slots[i].ready = false;
+
+		// Look for the frame in the caller's list, first from where we
+		// are and then from the start
+		std::vector<uint>::const_iterator i = _frames.end();
+		if (!_frames.empty() && _schedule == _frames) {
+			i = std::find(_frames.begin() + std::min(static_cast<size_t>(_consume), _frames.size()), _frames.end(), frame);
+			if (i == _frames.end())
+				i = std::find(_frames.begin(), _frames.end(), frame);
+		} else if (!_frames.empty())
+			i = std::find(_frames.begin(), _frames.end(), frame);
+
+		if (i != _frames.end()) {
+			_schedule = _frames;
+			_consume = _produce = i - _frames.begin();
+		} else {
+			_schedule.clear();
+			for (uint k=frame; k<_nframes; ++k)
+				_schedule.push_back(k);
+			_consume = _produce = 0;
+		}
+
+		_cond.notify_all();
+	}
+
+
+	bool PrefetchingTrajectory::parseFrame() {
+		uint frame = _current_frame;
+		if (frame >= _nframes)
+			return(false);
+
+		boost::unique_lock<boost::mutex> lock(_mutex);
+
+		if (_consume >= _schedule.size() || _schedule[_consume] != frame)
+			reposition(frame);
+
+		Frame& slot = _slots[_consume % _slots.size()];
+		while (!(slot.ready && slot.position == _consume))
+			_cond.wait(lock);
+
+		std::swap(_current, slot);
+		slot.ready = false;
+		++_consume;
+		_cond.notify_all();
+
+		if (!_current.error.empty())
+			throw(LOOSError(_current.error));
+
+		return(_current.ok);
+	}
+
+
+	void PrefetchingTrajectory::updateGroupCoordsImpl(AtomicGroup& g) {
+		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+			uint idx = (*i)->index();
+			if (idx >= _current.coords.size())
+				throw(LOOSError(**i, "Atom index into the trajectory frame is out of bounds"));
+			(*i)->coords(_current.coords[idx]);
+		}
+
+		if (_current.has_box)
+			g.periodicBox(_current.box);
+	}
+
+
+	void PrefetchingTrajectory::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+		plan.scatter(g, _current.coords);
+
+		if (_current.has_box)
+			g.periodicBox(_current.box);
+	}
+
+
+	void PrefetchingTrajectory::updateGroupVelocitiesImpl(AtomicGroup& g) {
+		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+			uint idx = (*i)->index();
+			if (idx >= _current.velocities.size())
+				throw(LOOSError(**i, "Atom index into the trajectory frame is out of bounds"));
+			(*i)->velocities(_current.velocities[idx]);
+		}
+	}
+
+}
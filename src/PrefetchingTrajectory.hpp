@@ -0,0 +1,164 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2016, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(LOOS_PREFETCHING_TRAJECTORY_HPP)
+#define LOOS_PREFETCHING_TRAJECTORY_HPP
+
+#include <vector>
+#include <string>
+
+#include <boost/utility.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <loos_defs.hpp>
+#include <Trajectory.hpp>
+
+
+namespace loos {
+
+	//! Reads frames from another trajectory on a background thread
+	/**
+	 * Wraps an existing pTraj so that reading the next frame overlaps
+	 * with whatever the caller does with the current one.  A background
+	 * thread reads frames from the wrapped trajectory, in the order they
+	 * are expected to be used, into a ring of \a depth frame buffers.
+	 * readFrame() then only has to wait if the reader has fallen
+	 * behind.
+	 *
+	 * By default frames are expected in order.  If the frames will be
+	 * visited from a list (e.g. from assignTrajectoryFrames() or
+	 * OptionsFramework::TrajectoryWithFrameIndices::frameList()), pass
+	 * the list in and frames will be read ahead in that order:
+	 * \code
+	 * std::vector<uint> frames = assignTrajectoryFrames(traj, "100:10:2000");
+	 * pTraj ptraj(new PrefetchingTrajectory(traj, frames));
+	 * for (uint i=0; i<frames.size(); ++i) {
+	 *   ptraj->readFrame(frames[i]);
+	 *   ptraj->updateGroupCoords(model);
+	 *   ...
+	 * }
+	 * \endcode
+	 * Asking for a frame other than the one expected discards the
+	 * read-ahead.  Reading then continues from that frame's place in
+	 * the list (or, if it is not in the list, sequentially from that
+	 * frame).
+	 *
+	 * This class can be used just about anywhere a regular
+	 * Trajectory/pTraj can be used.  The wrapped trajectory belongs to
+	 * the background thread, so it must not be used directly while the
+	 * PrefetchingTrajectory exists.
+	 */
+	class PrefetchingTrajectory : public Trajectory, public boost::noncopyable {
+	public:
+
+		//! Read frames from \a traj in order, keeping up to \a depth frames ahead
+		explicit PrefetchingTrajectory(const pTraj& traj, const uint depth = 4);
+
+		//! Read the frames in \a frames, in that order
+		PrefetchingTrajectory(const pTraj& traj, const std::vector<uint>& frames, const uint depth = 4);
+
+		virtual ~PrefetchingTrajectory();
+
+		virtual std::string description() const { return("prefetching " + _description); }
+
+		virtual uint natoms() const { return(_natoms); }
+		virtual float timestep() const { return(_timestep); }
+		virtual uint nframes() const { return(_nframes); }
+
+		virtual bool hasVelocities() const { return(_has_velocities); }
+		virtual double velocityConversionFactor() const { return(_velocity_conversion); }
+
+		virtual bool hasPeriodicBox() const { return(_current.has_box); }
+		virtual GCoord periodicBox() const { return(_current.box); }
+
+		virtual std::vector<GCoord> coords() const { return(_current.coords); }
+
+		//! Number of frames that may be read ahead
+		uint depth() const { return(_slots.size()); }
+
+		//! The trajectory being read from
+		/**
+		 * Do not read from this directly while the
+		 * PrefetchingTrajectory exists.
+		 */
+		pTraj trajectory() const { return(_traj); }
+
+		virtual bool parseFrame();
+
+	private:
+		struct Frame {
+			Frame() : position(0), ready(false), ok(false), has_box(false) { }
+
+			uint position;          // Position in the schedule
+			bool ready, ok;
+			std::string error;
+			bool has_box;
+			GCoord box;
+			std::vector<GCoord> coords;
+			std::vector<GCoord> velocities;
+		};
+
+		void init(const uint depth);
+		void readAhead();
+		void readFrom(const uint frame, Frame& f);
+		void reposition(const uint frame);
+
+		virtual void rewindImpl() { }
+		virtual void seekNextFrameImpl() { }
+		virtual void seekFrameImpl(const uint) { }
+		virtual void updateGroupCoordsImpl(AtomicGroup& g);
+		virtual void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
+		virtual void updateGroupVelocitiesImpl(AtomicGroup& g);
+		virtual std::vector<GCoord> velocitiesImpl() const { return(_current.velocities); }
+
+	private:
+		pTraj _traj;
+
+		// Metadata is copied so the wrapped trajectory is never touched
+		// by the reader's thread
+		std::string _description;
+		uint _natoms, _nframes;
+		float _timestep;
+		bool _has_velocities;
+		double _velocity_conversion;
+
+		std::vector<uint> _frames;     // Frames requested by the caller (if any)
+		std::vector<uint> _schedule;   // Frames being read ahead, in order
+		uint _consume;                 // Position in the schedule of the next frame to hand out
+		uint _produce;                 // Position in the schedule of the next frame to read
+		ulong _generation;             // Bumped whenever the read-ahead is discarded
+		bool _shutdown;
+		int _last_read;                // Last frame read from the wrapped trajectory
+
+		Frame _current;
+		std::vector<Frame> _slots;
+
+		boost::thread* _thread;
+		boost::mutex _mutex;
+		boost::condition_variable _cond;
+	};
+
+}
+
+
+#endif // !defined(LOOS_PREFETCHING_TRAJECTORY_HPP)
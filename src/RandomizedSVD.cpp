@@ -0,0 +1,324 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+#include <boost/format.hpp>
+#include <boost/random.hpp>
+
+#include <RandomizedSVD.hpp>
+#include <utils_random.hpp>
+
+
+namespace loos {
+
+
+  namespace {
+
+    // C = A * B + beta * C, with either operand optionally transposed
+    // (all column-major)
+    void gemm(const bool transa, const bool transb, f77int m, f77int n, f77int k,
+              const DoubleMatrix& A, const DoubleMatrix& B, const double beta, DoubleMatrix& C) {
+      double alpha = 1.0;
+      double b = beta;
+      f77int lda = A.rows();
+      f77int ldb = B.rows();
+      f77int ldc = C.rows();
+
+#if defined(__linux__) || defined(__CYGWIN__) || defined(__FreeBSD__)
+      char ta = (transa ? 'T' : 'N');
+      char tb = (transb ? 'T' : 'N');
+
+      dgemm_(&ta, &tb, &m, &n, &k, &alpha, A.get(), &lda, B.get(), &ldb, &b, C.get(), &ldc);
+#else
+      cblas_dgemm(CblasColMajor, transa ? CblasTrans : CblasNoTrans, transb ? CblasTrans : CblasNoTrans,
+                  m, n, k, alpha, A.get(), lda, B.get(), ldb, b, C.get(), ldc);
+#endif
+    }
+
+  }
+
+
+
+  RandomizedSVD::RandomizedSVD(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& frames, const uint k)
+    : _subset(subset), _traj(traj), _frames(frames), _cache(0), _k(k)
+  {
+    _frame = _subset.copy();
+    _plan = CoordinatePlan(_frame);
+    init();
+  }
+
+
+  RandomizedSVD::RandomizedSVD(const SubsetCache& cache, const uint k)
+    : _subset(cache.subset()), _cache(&cache), _k(k)
+  {
+    init();
+  }
+
+
+  void RandomizedSVD::init() {
+    _nframes = _cache ? _cache->nframes() : _frames.size();
+    _m = _subset.size() * 3;
+    _oversample = 10;
+    _power = 2;
+    _block = 128;
+    _verbose = false;
+    _computed = false;
+
+    if (_nframes == 0 || _m == 0)
+      throw(LOOSError("RandomizedSVD needs at least one atom and one frame"));
+    if (_k == 0 || _k > std::min(_m, _nframes))
+      throw(NumericalError("Number of modes requested for RandomizedSVD exceeds the matrix dimensions"));
+  }
+
+
+  void RandomizedSVD::transforms(const std::vector<XForm>& xforms) {
+    if (xforms.size() != _nframes)
+      throw(LOOSError("RandomizedSVD needs one transform per frame"));
+    _xforms = xforms;
+  }
+
+
+  void RandomizedSVD::checkComputed() const {
+    if (!_computed)
+      throw(LOOSError("RandomizedSVD::compute() has not been called"));
+  }
+
+
+  // Fills the columns of X with frames starting at first (minus
+  // center), returning how many frames there were
+
+  uint RandomizedSVD::loadBlock(const uint first, DoubleMatrix& X, const std::vector<double>& center) {
+    const uint n = std::min(X.cols(), _nframes - first);
+    const uint natoms = _m / 3;
+
+    for (uint c=0; c<n; ++c) {
+      const uint i = first + c;
+      bool xform = !_xforms.empty() && !_xforms[i].unset();
+      GMatrix M;
+      if (xform)
+        M = _xforms[i].current();
+
+      if (!_cache) {
+        if (!_traj->readFrame(_frames[i]))
+          throw(LOOSError("Unable to read frame from trajectory " + _traj->filename()));
+        _traj->updateGroupCoords(_frame, _plan);
+      }
+
+      double* dst = X.get() + static_cast<ulong>(c) * _m;
+      const float* src = _cache ? _cache->frame(i) : 0;
+      for (uint j=0; j<natoms; ++j) {
+        GCoord x = _cache ? GCoord(src[3*j], src[3*j+1], src[3*j+2]) : _frame[j]->coords();
+        if (xform)
+          x = M * x;
+        dst[3*j] = x.x() - center[3*j];
+        dst[3*j+1] = x.y() - center[3*j+1];
+        dst[3*j+2] = x.z() - center[3*j+2];
+      }
+    }
+
+    // Zero any unused columns of the last block so they add nothing
+    for (uint c=n; c<X.cols(); ++c)
+      std::fill(X.get() + static_cast<ulong>(c) * _m, X.get() + static_cast<ulong>(c+1) * _m, 0.0);
+
+    return(n);
+  }
+
+
+  // Modified Gram-Schmidt, done twice (which is enough to keep Q
+  // orthogonal to working precision).  Columns that vanish are left
+  // as zero.
+
+  void RandomizedSVD::orthonormalize(DoubleMatrix& Y) const {
+    const uint m = Y.rows();
+    const uint l = Y.cols();
+
+    for (uint pass = 0; pass < 2; ++pass)
+      for (uint j=0; j<l; ++j) {
+        double* y = Y.get() + static_cast<ulong>(j) * m;
+        for (uint i=0; i<j; ++i) {
+          const double* q = Y.get() + static_cast<ulong>(i) * m;
+          double d = 0.0;
+          for (uint r=0; r<m; ++r)
+            d += q[r] * y[r];
+          for (uint r=0; r<m; ++r)
+            y[r] -= d * q[r];
+        }
+
+        double norm = 0.0;
+        for (uint r=0; r<m; ++r)
+          norm += y[r] * y[r];
+        norm = sqrt(norm);
+        double scale = (norm > 1e-300) ? 1.0 / norm : 0.0;
+        for (uint r=0; r<m; ++r)
+          y[r] *= scale;
+      }
+  }
+
+
+  void RandomizedSVD::compute() {
+    const uint l = std::min(_k + _oversample, std::min(_m, _nframes));
+    const uint passes = this->passes();
+
+    DoubleMatrix X(_m, _block);
+    DoubleMatrix Y(_m, l);
+
+    // Pass 1: Y = X * Omega, with the coordinates taken relative to
+    // the first frame (to avoid cancellation), then corrected for the
+    // mean once it is known.  The first block is read as is and the
+    // first frame subtracted from it in place, so no frame is read
+    // twice.
+
+    if (_verbose)
+      std::cerr << boost::format("RandomizedSVD: pass 1 of %d (%d x %d, %d random vectors)\n") % passes % _m % _nframes % l;
+
+    std::vector<double> shift(_m, 0.0);
+
+    base_generator_type& rng = rng_singleton();
+    boost::normal_distribution<> gauss(0.0, 1.0);
+    boost::variate_generator<base_generator_type&, boost::normal_distribution<> > randn(rng, gauss);
+
+    DoubleMatrix Omega(_block, l);
+    std::vector<double> omega_sum(l, 0.0);
+    std::vector<double> sum(_m, 0.0);
+
+    for (uint first = 0; first < _nframes; first += _block) {
+      uint n = loadBlock(first, X, shift);
+      if (first == 0) {
+        for (uint r=0; r<_m; ++r)
+          shift[r] = X(r, 0);
+        for (uint c=0; c<n; ++c)
+          for (uint r=0; r<_m; ++r)
+            X(r, c) -= shift[r];
+      }
+
+      for (uint j=0; j<l; ++j)
+        for (uint c=0; c<_block; ++c) {
+          double w = (c < n) ? randn() : 0.0;
+          Omega(c, j) = w;
+          omega_sum[j] += w;
+        }
+      for (uint c=0; c<n; ++c)
+        for (uint r=0; r<_m; ++r)
+          sum[r] += X(r, c);
+
+      gemm(false, false, _m, l, _block, X, Omega, 1.0, Y);
+    }
+
+    _mean.resize(_m);
+    for (uint r=0; r<_m; ++r) {
+      double d = sum[r] / _nframes;
+      _mean[r] = shift[r] + d;
+      for (uint j=0; j<l; ++j)
+        Y(r, j) -= d * omega_sum[j];
+    }
+
+
+    // Power iterations, then the final projection
+
+    DoubleMatrix Z(l, _block);
+    DoubleMatrix G(l, l);
+    for (uint pass = 2; pass <= passes; ++pass) {
+      bool last = (pass == passes);
+      if (_verbose)
+        std::cerr << boost::format("RandomizedSVD: pass %d of %d\n") % pass % passes;
+
+      orthonormalize(Y);
+      DoubleMatrix Q = Y;
+      if (!last)
+        Y = DoubleMatrix(_m, l);
+
+      for (uint first = 0; first < _nframes; first += _block) {
+        loadBlock(first, X, _mean);
+        gemm(true, false, l, _block, _m, Q, X, 0.0, Z);          // Z = Q' * X
+        if (last)
+          gemm(false, true, l, l, _block, Z, Z, 1.0, G);         // G += Z * Z'
+        else
+          gemm(false, true, _m, l, _block, X, Z, 1.0, Y);        // Y += X * Z'
+      }
+
+      if (last)
+        Y = Q;
+    }
+
+
+    // G = Q' A A' Q = W L W', so the left singular vectors are Q * W
+    // and the singular values are sqrt(L)
+
+    DoubleMatrix L = Math::eigenDecomp(G);
+    Math::reverseColumns(G);
+    Math::reverseRows(L);
+
+    DoubleMatrix QW(_m, l);
+    gemm(false, false, _m, l, l, Y, G, 0.0, QW);
+
+    _U = DoubleMatrix(_m, _k);
+    _S = DoubleMatrix(_k, 1);
+    for (uint j=0; j<_k; ++j) {
+      _S[j] = L[j] > 0.0 ? sqrt(L[j]) : 0.0;
+      for (uint r=0; r<_m; ++r)
+        _U(r, j) = QW(r, j);
+    }
+
+    _computed = true;
+  }
+
+
+  AtomicGroup RandomizedSVD::average() const {
+    checkComputed();
+    AtomicGroup avg = _subset.copy();
+    for (uint j=0; j<avg.size(); ++j)
+      avg[j]->coords(GCoord(_mean[3*j], _mean[3*j+1], _mean[3*j+2]));
+    return(avg);
+  }
+
+
+  // V = A' * U * inv(S), a block of frames at a time
+
+  DoubleMatrix RandomizedSVD::V() {
+    checkComputed();
+    if (_verbose)
+      std::cerr << "RandomizedSVD: projecting frames\n";
+
+    DoubleMatrix X(_m, _block);
+    DoubleMatrix Z(_k, _block);
+    DoubleMatrix V(_nframes, _k);
+
+    std::vector<double> scale(_k);
+    for (uint j=0; j<_k; ++j)
+      scale[j] = _S[j] > 0.0 ? 1.0 / _S[j] : 0.0;
+
+    for (uint first = 0; first < _nframes; first += _block) {
+      uint n = loadBlock(first, X, _mean);
+      gemm(true, false, _k, _block, _m, _U, X, 0.0, Z);
+      for (uint c=0; c<n; ++c)
+        for (uint j=0; j<_k; ++j)
+          V(first + c, j) = Z(j, c) * scale[j];
+    }
+
+    return(V);
+  }
+
+
+}
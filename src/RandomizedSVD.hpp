@@ -0,0 +1,149 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_RANDOMIZEDSVD_HPP)
+#define LOOS_RANDOMIZEDSVD_HPP
+
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <Trajectory.hpp>
+#include <CoordinatePlan.hpp>
+#include <XForm.hpp>
+#include <MatrixOps.hpp>
+#include <SubsetCache.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Top singular vectors of a trajectory, in a few passes and without holding the trajectory
+  /**
+   * The coordinate matrix A has one column per frame (the coordinates
+   * of \a subset, after applying that frame's transform, minus the
+   * average structure), just as in the svd tool.  Rather than building
+   * A, this finds its top \a k left singular vectors (the PCA modes)
+   * and singular values with a randomized range finder:
+   *
+   *  - Pass 1 computes the average and Y = A * Omega for a random
+   *    Gaussian Omega with k + oversampling() columns (generated on
+   *    the fly, one row per frame)
+   *  - Each power iteration orthonormalizes Y into Q and makes another
+   *    pass to form Y = A * A' * Q, which sharpens the separation of
+   *    the leading modes
+   *  - A final pass forms the small matrix Q' * A * A' * Q, whose
+   *    eigenvectors rotate Q into the left singular vectors
+   *
+   * That is powerIterations() + 2 sequential passes in all, and the
+   * engine only ever holds a few 3N x (k + oversampling()) matrices plus
+   * one block of frames.  The right singular vectors (projections of
+   * each frame) take one more pass, and only if asked for.
+   * \code
+   * RandomizedSVD engine(subset, traj, frames, 20);
+   * engine.transforms(xforms);
+   * engine.compute();
+   * DoubleMatrix U = engine.U();
+   * DoubleMatrix s = engine.S();
+   * \endcode
+   *
+   * The random matrix is drawn from rng_singleton(), so the tool is
+   * responsible for seeding it.
+   */
+  class RandomizedSVD : public boost::noncopyable {
+  public:
+
+    //! Top \a k modes of \a subset over the given \a frames of \a traj
+    RandomizedSVD(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& frames, const uint k);
+
+    //! Top \a k modes of the frames held in \a cache
+    RandomizedSVD(const SubsetCache& cache, const uint k);
+
+    //! One transform per frame, applied before the average is removed
+    void transforms(const std::vector<XForm>& xforms);
+
+    //! Extra random vectors beyond k (default is 10)
+    void oversampling(const uint p) { _oversample = p; }
+    uint oversampling() const { return(_oversample); }
+
+    //! Number of power iterations (default is 2)
+    void powerIterations(const uint q) { _power = q; }
+    uint powerIterations() const { return(_power); }
+
+    //! Number of frames handed to BLAS at once (default is 128)
+    void blockSize(const uint b) { _block = b > 0 ? b : 1; }
+    uint blockSize() const { return(_block); }
+
+    //! Report each pass to stderr
+    void verbose(const bool b) { _verbose = b; }
+
+    //! Passes over the trajectory that compute() makes
+    uint passes() const { return(_power + 2); }
+
+    uint modes() const { return(_k); }
+    uint nframes() const { return(_nframes); }
+
+    //! Runs the passes over the trajectory
+    void compute();
+
+    //! Left singular vectors (3N x k), as columns
+    const DoubleMatrix& U() const { return(_U); }
+
+    //! Singular values (k x 1), largest first
+    const DoubleMatrix& S() const { return(_S); }
+
+    //! The average structure (after the transforms)
+    AtomicGroup average() const;
+
+    //! Right singular vectors (nframes x k), which makes one more pass
+    DoubleMatrix V();
+
+  private:
+    void init();
+    void checkComputed() const;
+    uint loadBlock(const uint first, DoubleMatrix& X, const std::vector<double>& center);
+    void orthonormalize(DoubleMatrix& Y) const;
+
+    AtomicGroup _subset, _frame;
+    CoordinatePlan _plan;
+    pTraj _traj;
+    std::vector<uint> _frames;
+    const SubsetCache* _cache;
+    std::vector<XForm> _xforms;
+
+    uint _k, _nframes, _m;
+    uint _oversample, _power, _block;
+    bool _verbose, _computed;
+
+    std::vector<double> _mean;
+    DoubleMatrix _U, _S;
+  };
+
+
+}
+
+
+#endif
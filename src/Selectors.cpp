@@ -124,13 +124,21 @@ namespace loos {
 
 
   bool BackboneSelector::operator()(const pAtom& pa) const {
-    if (std::binary_search(residue_names, residue_names + nresnames, pa->resname()))
-      if (std::binary_search(atom_names, atom_names + natomnames, pa->name()))
+    if (isBackboneResidue(pa->resname()))
+      if (isBackboneAtom(pa->name()))
         return(true);
 
     return(false);
   }
 
+  bool BackboneSelector::isBackboneResidue(const std::string& resname) {
+    return(std::binary_search(residue_names, residue_names + nresnames, resname));
+  }
+
+  bool BackboneSelector::isBackboneAtom(const std::string& name) {
+    return(std::binary_search(atom_names, atom_names + natomnames, name));
+  }
+
   bool SegidSelector::operator()(const pAtom& pa) const {
     return(pa->segid() == str);
   }
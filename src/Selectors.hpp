@@ -59,6 +59,12 @@ namespace loos {
 
   public:
     bool operator()(const pAtom&) const;
+
+    //! True if \a resname is one of the residues that have a backbone
+    static bool isBackboneResidue(const std::string& resname);
+
+    //! True if \a name is one of the backbone atom names
+    static bool isBackboneAtom(const std::string& name);
   };
 
 
@@ -212,9 +218,14 @@ namespace loos {
    * Example:
    * \code
    * Parser parsed(selection_string);
+   * parsed.kernel().prepare(group);
    * KernelSelector sel(parsed.kernel());
+   * AtomicGroup subset = group.select(sel);
    * \endcode
    *
+   * The call to Kernel::prepare() is only needed for selections that
+   * use spatial operators (e.g. "within"), but is harmless otherwise.
+   *
    */
   class KernelSelector : public AtomSelector {
   public:
@@ -0,0 +1,158 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include <SubsetCache.hpp>
+#include <CoordinatePlan.hpp>
+
+
+namespace loos {
+
+
+  const size_t SubsetCache::default_memory_limit = static_cast<size_t>(1) << 30;
+
+
+  SubsetCache::SubsetCache(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& frames,
+                           const size_t memory_limit, const std::string& spill_dir)
+    : _subset(subset), _frames(frames)
+  {
+    fill(subset, traj, memory_limit, spill_dir);
+  }
+
+
+  SubsetCache::SubsetCache(const AtomicGroup& subset, pTraj& traj,
+                           const size_t memory_limit, const std::string& spill_dir)
+    : _subset(subset), _frames(traj->nframes())
+  {
+    for (uint i=0; i<_frames.size(); ++i)
+      _frames[i] = i;
+    fill(subset, traj, memory_limit, spill_dir);
+  }
+
+
+  std::string SubsetCache::spillName(const std::string& spill_dir) const {
+    std::string dir(spill_dir);
+    if (dir.empty()) {
+      const char* p = getenv("TMPDIR");
+      dir = (p && *p) ? p : "/tmp";
+    }
+    return(dir + "/loos-subset-XXXXXX");
+  }
+
+
+  void SubsetCache::fill(const AtomicGroup& subset, pTraj& traj, const size_t memory_limit, const std::string& spill_dir) {
+    const uint natoms = subset.size();
+    const uint nframes = _frames.size();
+    if (natoms == 0 || nframes == 0)
+      throw(LOOSError("Cannot cache an empty subset or frame list"));
+
+    AtomicGroup g = subset.copy();
+    CoordinatePlan plan(g);
+    const uint stride = natoms * 3;
+    std::vector<float> frame(stride);
+    std::vector<float> buffer;
+    std::vector<GCoord> boxes;
+
+    FILE* fp = 0;
+    std::string fname;
+    if (static_cast<size_t>(nframes) * stride * sizeof(float) > memory_limit) {
+      fname = spillName(spill_dir);
+      std::vector<char> name(fname.begin(), fname.end());
+      name.push_back('\0');
+      int fd = mkstemp(&name[0]);
+      if (fd < 0)
+        throw(FileOpenError(fname, strerror(errno), errno));
+      fname = std::string(&name[0]);
+      fp = fdopen(fd, "wb");
+      if (!fp) {
+        close(fd);
+        unlink(fname.c_str());
+        throw(FileOpenError(fname, "Unable to open spill file for writing"));
+      }
+    } else
+      buffer.resize(static_cast<size_t>(nframes) * stride);
+
+    try {
+      for (uint i=0; i<nframes; ++i) {
+        if (!traj->readFrame(_frames[i]))
+          throw(LOOSError("Unable to read frame from trajectory " + traj->filename()));
+        traj->updateGroupCoords(g, plan);
+
+        if (traj->hasPeriodicBox()) {
+          if (boxes.empty())
+            boxes.resize(nframes);
+          boxes[i] = traj->periodicBox();
+        }
+
+        float* dst = fp ? &frame[0] : &buffer[static_cast<size_t>(i) * stride];
+        for (uint j=0; j<natoms; ++j) {
+          const GCoord& c = g[j]->coords();
+          *dst++ = c.x();
+          *dst++ = c.y();
+          *dst++ = c.z();
+        }
+
+        if (fp && fwrite(&frame[0], sizeof(float), stride, fp) != stride)
+          throw(FileWriteError(fname, "Unable to write to subset cache spill file"));
+      }
+
+      pMappedFile spill;
+      if (fp) {
+        int err = fclose(fp);
+        fp = 0;
+        if (err != 0)
+          throw(FileWriteError(fname, "Unable to write to subset cache spill file"));
+
+        // The mapping outlives the directory entry, so the file is
+        // reclaimed as soon as the cache goes away
+        spill = pMappedFile(new MappedFile(fname));
+        unlink(fname.c_str());
+      }
+
+      _ensemble = CoordinateEnsemble(subset, nframes, buffer, spill, boxes);
+    }
+    catch (...) {
+      if (fp)
+        fclose(fp);
+      if (!fname.empty())
+        unlink(fname.c_str());
+      throw;
+    }
+  }
+
+
+  bool SubsetCache::matches(const AtomicGroup& g) const {
+    if (g.size() != _subset.size())
+      return(false);
+    for (uint i=0; i<g.size(); ++i)
+      if (g[i] != _subset[i])
+        return(false);
+    return(true);
+  }
+
+
+}
@@ -0,0 +1,141 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#if !defined(LOOS_SUBSETCACHE_HPP)
+#define LOOS_SUBSETCACHE_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/utility.hpp>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <CoordinateEnsemble.hpp>
+#include <Trajectory.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  //! Coordinates of a subset of atoms over a set of frames, read once
+  /**
+   * Algorithms that make repeated passes over a trajectory (such as
+   * iterativeAlignment()) usually only need a small selection of the
+   * atoms.  A SubsetCache reads the trajectory once and keeps the
+   * coordinates of just those atoms, as floats, in one contiguous
+   * block (x, y, z interleaved, one frame after another):
+   * \code
+   * AtomicGroup calphas = selectAtoms(model, "name == 'CA'");
+   * SubsetCache cache(calphas, traj, frames);
+   * boost::tuple<std::vector<XForm>, greal, int> res = iterativeAlignment(cache);
+   * \endcode
+   *
+   * If the cache would be larger than \a memory_limit bytes, it is
+   * instead written to an unlinked temporary file in \a spill_dir
+   * (or $TMPDIR, or /tmp) and memory-mapped, leaving it to the OS to
+   * page it in as needed.
+   *
+   * Coordinates are stored in single precision, as they are in most
+   * trajectory formats.  Coordinates from double precision sources
+   * (e.g. double precision TRRs, or trajectories that have been
+   * transformed in memory) are rounded to about 7 significant
+   * digits, i.e. around 1e-5 Angstroms for coordinates in the
+   * hundreds.  Results computed from the cache (alignments, averages,
+   * etc) can differ from the same calculation on the trajectory by
+   * about that much.  Use the trajectory directly when that matters.
+   *
+   * If the trajectory has a periodic box, the box for each cached
+   * frame is kept as well (in double precision).
+   *
+   * The frames are held in a CoordinateEnsemble (see ensemble()), so
+   * anything that works on one, such as iterativeAlignment() or
+   * averageStructure(), works on the cache without copying it.
+   */
+  class SubsetCache : public boost::noncopyable {
+  public:
+    //! Default memory budget (1 GiB)
+    static const size_t default_memory_limit;
+
+    //! Caches \a subset's coordinates for the given \a frames
+    SubsetCache(const AtomicGroup& subset, pTraj& traj, const std::vector<uint>& frames,
+                const size_t memory_limit = default_memory_limit,
+                const std::string& spill_dir = "");
+
+    //! Caches \a subset's coordinates for every frame in \a traj
+    SubsetCache(const AtomicGroup& subset, pTraj& traj,
+                const size_t memory_limit = default_memory_limit,
+                const std::string& spill_dir = "");
+
+    uint nframes() const { return(_ensemble.size()); }
+    uint natoms() const { return(_ensemble.natoms()); }
+
+    //! Trajectory frame that cache frame \a i was read from
+    uint frameIndex(const uint i) const { return(_frames[i]); }
+    const std::vector<uint>& frameIndices() const { return(_frames); }
+
+    //! The atoms that were cached
+    const AtomicGroup& subset() const { return(_subset); }
+
+    //! True if \a g holds the same atoms, in the same order, as the cached subset
+    bool matches(const AtomicGroup& g) const;
+
+    //! True if the cache was spilled to disk rather than held in memory
+    bool spilled() const { return(_ensemble.mapped()); }
+
+    //! Size of the cache in bytes
+    size_t bytes() const { return(_ensemble.bytes()); }
+
+    //! The cached frames
+    const CoordinateEnsemble& ensemble() const { return(_ensemble); }
+
+    //! Interleaved coordinates for cache frame \a i (3 * natoms() floats)
+    const float* frame(const uint i) const { return(_ensemble.frame(i)); }
+
+    //! Copies cache frame \a i into \a v (as with AtomicGroup::coordsAsVector())
+    void copyFrame(const uint i, std::vector<double>& v) const { _ensemble.copyFrame(i, v); }
+
+    //! Copies cache frame \a i into the atoms of \a g (along with the periodic box, if any)
+    void copyFrame(const uint i, AtomicGroup& g) const { _ensemble.copyFrame(i, g); }
+
+    //! True if the periodic box was cached with each frame
+    bool hasPeriodicBox() const { return(_ensemble.isPeriodic()); }
+
+    //! Periodic box for cache frame \a i
+    GCoord periodicBox(const uint i) const { return(_ensemble.periodicBox(i)); }
+
+  private:
+    void fill(const AtomicGroup& subset, pTraj& traj, const size_t memory_limit, const std::string& spill_dir);
+    std::string spillName(const std::string& spill_dir) const;
+
+    AtomicGroup _subset;
+    std::vector<uint> _frames;
+    CoordinateEnsemble _ensemble;
+  };
+
+
+}
+
+
+#endif
@@ -0,0 +1,138 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include <TextParsing.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    namespace {
+
+      // Numeric fields in structure files are short, so the digits are
+      // copied to a small buffer on the stack to terminate them for
+      // strtod()...
+      const uint max_number_size = 64;
+
+
+      // Skips whitespace and copies the characters that may be part of
+      // a decimal number into buf.  Returns the offset of the end of the
+      // copied characters (0 if there weren't any).  Only decimal
+      // characters are accepted so that things like "inf" and hex,
+      // which a stream would not read, aren't accepted here either.
+
+      uint copyNumber(const char* s, const uint n, char* buf) {
+        uint i = 0;
+        while (i < n && isspace(s[i]))
+          ++i;
+
+        uint k = 0;
+        for (; i < n && k < max_number_size - 1; ++i, ++k) {
+          char c = s[i];
+          if (!(isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+            break;
+          buf[k] = c;
+        }
+        buf[k] = '\0';
+
+        return(k == 0 ? 0 : i);
+      }
+
+    }
+
+
+    uint parseNumber(const char* s, const uint n, float& val) {
+      char buf[max_number_size];
+      uint end = copyNumber(s, n, buf);
+      if (end == 0)
+        return(0);
+
+      char* stop;
+      val = strtof(buf, &stop);
+      if (stop == buf)
+        return(0);
+      return(end - (strlen(buf) - (stop - buf)));
+    }
+
+
+    uint parseNumber(const char* s, const uint n, double& val) {
+      char buf[max_number_size];
+      uint end = copyNumber(s, n, buf);
+      if (end == 0)
+        return(0);
+
+      char* stop;
+      val = strtod(buf, &stop);
+      if (stop == buf)
+        return(0);
+      return(end - (strlen(buf) - (stop - buf)));
+    }
+
+
+    uint copyWithoutSpaces(const char* s, const uint n, char* buf) {
+      uint k = 0;
+      for (uint i=0; i<n; ++i)
+        if (s[i] != ' ')
+          buf[k++] = s[i];
+      return(k);
+    }
+
+
+    bool nextToken(const char*& p, const char* end, const char*& tok, uint& len) {
+      while (p < end && isspace(*p))
+        ++p;
+      if (p == end)
+        return(false);
+
+      tok = p;
+      while (p < end && !isspace(*p))
+        ++p;
+      len = p - tok;
+
+      return(true);
+    }
+
+
+    bool MappedLines::next(std::string& line) {
+      if (_p >= _end) {
+        line.clear();
+        return(false);
+      }
+
+      const char* eol = static_cast<const char*>(memchr(_p, '\n', _end - _p));
+      if (eol == 0)
+        eol = _end;
+
+      line.assign(_p, eol);
+      _p = (eol == _end) ? _end : eol + 1;
+
+      return(true);
+    }
+
+  }
+
+}
@@ -0,0 +1,102 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_TEXTPARSING_HPP)
+#define LOOS_TEXTPARSING_HPP
+
+#include <iostream>
+#include <string>
+
+#include <loos_defs.hpp>
+#include <MappedFile.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    // Helpers for the structure file parsers.  These work directly on
+    // the characters of a line, so parsing a field does not create any
+    // temporary strings or streams.
+
+
+    //! Parses a number at the start of the \a n characters at \a s
+    /**
+     * As with reading from a stream, leading whitespace is skipped and
+     * parsing stops at the first character that can't be part of the
+     * number.  Returns the number of characters used (including the
+     * whitespace), or 0 if there was no number to parse.
+     */
+    uint parseNumber(const char* s, const uint n, float& val);
+    uint parseNumber(const char* s, const uint n, double& val);
+
+    //! Copies the \a n characters at \a s to \a buf, dropping all spaces
+    /**
+     * This is how parseStringAs<std::string>() treats a field.  \a buf
+     * must have room for \a n characters.  Returns the number copied.
+     */
+    uint copyWithoutSpaces(const char* s, const uint n, char* buf);
+
+    //! Finds the next whitespace-separated token in [\a p, \a end)
+    /**
+     * On success, \a tok and \a len give the token and \a p is moved
+     * past it.  Returns false if only whitespace remains.
+     */
+    bool nextToken(const char*& p, const char* end, const char*& tok, uint& len);
+
+
+    //! Reads lines from a stream, as getline() does
+    class StreamLines {
+    public:
+      explicit StreamLines(std::istream& is) : _is(is) { }
+
+      bool next(std::string& line) { return(static_cast<bool>(std::getline(_is, line))); }
+
+    private:
+      std::istream& _is;
+    };
+
+
+    //! Reads lines from a memory-mapped file, as getline() does
+    /**
+     * The line buffer passed to next() is reused, so once it has grown
+     * to the longest line, reading a line does not allocate.
+     */
+    class MappedLines {
+    public:
+      explicit MappedLines(const MappedFile& file) : _p(file.data()), _end(file.data() + file.size()) { }
+
+      bool next(std::string& line);
+
+    private:
+      const char* _p;
+      const char* _end;
+    };
+
+  }
+
+}
+
+
+#endif
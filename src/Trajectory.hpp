@@ -32,8 +32,7 @@
 
 #include <loos_defs.hpp>
 #include <AtomicGroup.hpp>
-
-#include <AtomicGroup.hpp>
+#include <CoordinatePlan.hpp>
 
 
 namespace loos {
@@ -173,6 +172,22 @@ namespace loos {
 		}
 
 
+		//! Update the coordinates in an AtomicGroup using a precomputed CoordinatePlan
+		/** The plan must have been built from \a g (see
+		 * CoordinatePlan).  Indices are checked once against the
+		 * trajectory rather than per atom, and formats that support
+		 * it copy coordinates directly from their frame buffers into
+		 * the group.
+		 */
+		void updateGroupCoords(AtomicGroup& g, const CoordinatePlan& plan)
+		{
+			if (!plan.matches(g))
+				throw(LOOSError("CoordinatePlan does not match the AtomicGroup passed to updateGroupCoords()"));
+
+			updateGroupCoordsWithCheckedPlan(*this, g, plan);
+		}
+
+
 
 		//! Returns the current frame's velocities as a vector of GCoords
 		/**
@@ -295,6 +310,17 @@ namespace loos {
 
 
 
+		//! Plan-based update of \a g from \a traj once the plan is known to match \a g
+		/** This lets trajectories that wrap others (e.g. MultiTrajectory)
+		 * pass a plan along without checking it against the group again.
+		 */
+		static void updateGroupCoordsWithCheckedPlan(Trajectory& traj, AtomicGroup& g, const CoordinatePlan& plan)
+		{
+			plan.validate(traj.natoms());
+			traj.updateGroupCoordsWithPlanImpl(g, plan);
+		}
+
+
 		pStream ifs;
 		bool cached_first;    // Indicates that the first frame is cached by
 		// the subclass...
@@ -316,6 +342,19 @@ namespace loos {
 		//! NVI implementation of updateGroupCoords() for derived classes to override
 		virtual void updateGroupCoordsImpl(AtomicGroup& g) =0;
 
+		//! NVI implementation of plan-based updateGroupCoords()
+		/** The default falls back on updateGroupCoordsImpl() and does
+		 * not use the plan beyond the bounds check already made by
+		 * updateGroupCoords().  This is what formats that keep their
+		 * frame as an AtomicGroup (e.g. CCPDB, TinkerArc) get, where
+		 * parsing the frame costs far more than the update.  Formats
+		 * with frame buffers should override this and copy from them
+		 * with CoordinatePlan::scatter().
+		 */
+		virtual void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+			updateGroupCoordsImpl(g);
+		}
+
 		virtual void updateGroupVelocitiesImpl(AtomicGroup& g) {
 			throw(LOOSError("No velocity update implementation defined but trajectory supports it"));
 		}
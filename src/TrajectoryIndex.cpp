@@ -0,0 +1,230 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <boost/crc.hpp>
+
+#include <TrajectoryIndex.hpp>
+
+
+namespace loos {
+
+
+  namespace {
+
+    // Sidecars are off unless LOOS_TRAJECTORY_INDEX is set (and isn't "0")
+    bool sidecarsFromEnvironment() {
+      const char* p = getenv("LOOS_TRAJECTORY_INDEX");
+      return(p != 0 && *p != '\0' && strcmp(p, "0") != 0);
+    }
+
+    const char index_magic[8] = { 'L', 'O', 'O', 'S', 'T', 'I', 'D', 'X' };
+    const unsigned int index_version = 1;
+    const unsigned int index_endian = 0x01020304;
+
+    // Number of bytes at the start of the trajectory that are checksummed
+    const uint checksum_bytes = 4096;
+
+
+    template<typename T>
+    void writeValue(std::ostream& os, const T& t) {
+      os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+    }
+
+    template<typename T>
+    bool readValue(std::istream& is, T& t) {
+      is.read(reinterpret_cast<char*>(&t), sizeof(T));
+      return(!is.fail());
+    }
+
+
+    bool writeAll(const int fd, const std::string& data) {
+      const char* p = data.data();
+      size_t n = data.size();
+      while (n > 0) {
+        ssize_t k = ::write(fd, p, n);
+        if (k < 0) {
+          if (errno == EINTR)
+            continue;
+          return(false);
+        }
+        p += k;
+        n -= k;
+      }
+      return(true);
+    }
+  }
+
+
+  bool TrajectoryIndex::use_sidecars = sidecarsFromEnvironment();
+
+
+
+  // Identifies the current contents of the trajectory file
+  bool TrajectoryIndex::signature(const std::string& fname, Signature& sig) {
+    struct stat st;
+    if (stat(fname.c_str(), &st) < 0)
+      return(false);
+
+    sig.size = st.st_size;
+    sig.mtime = st.st_mtime;
+
+    std::ifstream ifs(fname.c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!ifs)
+      return(false);
+
+    char buf[checksum_bytes];
+    ifs.read(buf, checksum_bytes);
+
+    boost::crc_32_type crc;
+    crc.process_bytes(buf, ifs.gcount());
+    sig.checksum = crc.checksum();
+
+    return(true);
+  }
+
+
+
+  bool TrajectoryIndex::read(const std::string& fname, const std::string& format) {
+    if (!use_sidecars)
+      return(false);
+
+    std::ifstream ifs(sidecarName(fname).c_str(), std::ios_base::in | std::ios_base::binary);
+    if (!ifs)
+      return(false);
+
+    char magic[sizeof(index_magic)];
+    ifs.read(magic, sizeof(magic));
+    if (ifs.fail() || !std::equal(magic, magic + sizeof(magic), index_magic))
+      return(false);
+
+    unsigned int version, endian, taglen;
+    if (!(readValue(ifs, version) && readValue(ifs, endian) && readValue(ifs, taglen)))
+      return(false);
+    if (version != index_version || endian != index_endian || taglen != format.size())
+      return(false);
+
+    std::string tag(taglen, ' ');
+    ifs.read(&tag[0], taglen);
+    if (ifs.fail() || tag != format)
+      return(false);
+
+    Signature stored, current;
+    if (!(readValue(ifs, stored.size) && readValue(ifs, stored.mtime) && readValue(ifs, stored.checksum)))
+      return(false);
+    if (!signature(fname, current))
+      return(false);
+    if (stored.size != current.size || stored.mtime != current.mtime || stored.checksum != current.checksum)
+      return(false);
+
+    unsigned int natoms;
+    double timestep;
+    unsigned long long n;
+    if (!(readValue(ifs, natoms) && readValue(ifs, timestep) && readValue(ifs, n)))
+      return(false);
+
+    // The offsets are all that's left, so a corrupt count is caught
+    // before it is used to size anything
+    std::streamoff start = ifs.tellg();
+    ifs.seekg(0, std::ios_base::end);
+    std::streamoff remaining = ifs.tellg() - start;
+    if (start < 0 || remaining < 0 || remaining % sizeof(unsigned long long) != 0
+        || n != static_cast<unsigned long long>(remaining) / sizeof(unsigned long long))
+      return(false);
+    ifs.seekg(start);
+
+    std::vector<unsigned long long> offsets(n);
+    if (n != 0) {
+      ifs.read(reinterpret_cast<char*>(&offsets[0]), n * sizeof(unsigned long long));
+      if (ifs.fail())
+        return(false);
+    }
+
+    _offsets.assign(offsets.begin(), offsets.end());
+    _natoms = natoms;
+    _timestep = timestep;
+
+    return(true);
+  }
+
+
+
+  // The sidecar is written to a uniquely named temporary file and then
+  // renamed, so another process or thread never sees a partially
+  // written index
+  bool TrajectoryIndex::write(const std::string& fname, const std::string& format) const {
+    if (!use_sidecars)
+      return(false);
+
+    Signature sig;
+    if (!signature(fname, sig))
+      return(false);
+
+    std::ostringstream oss;
+    oss.write(index_magic, sizeof(index_magic));
+    writeValue(oss, index_version);
+    writeValue(oss, index_endian);
+    writeValue(oss, static_cast<unsigned int>(format.size()));
+    oss.write(format.data(), format.size());
+
+    writeValue(oss, sig.size);
+    writeValue(oss, sig.mtime);
+    writeValue(oss, sig.checksum);
+
+    writeValue(oss, static_cast<unsigned int>(_natoms));
+    writeValue(oss, _timestep);
+    writeValue(oss, static_cast<unsigned long long>(_offsets.size()));
+
+    std::vector<unsigned long long> offsets(_offsets.begin(), _offsets.end());
+    if (!offsets.empty())
+      oss.write(reinterpret_cast<const char*>(&offsets[0]), offsets.size() * sizeof(unsigned long long));
+
+    std::string tmpname = sidecarName(fname) + ".XXXXXX";
+    int fd = mkstemp(&tmpname[0]);
+    if (fd < 0)
+      return(false);
+    fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+    bool ok = writeAll(fd, oss.str());
+    ok = (close(fd) == 0) && ok;
+    if (!ok || rename(tmpname.c_str(), sidecarName(fname).c_str()) != 0) {
+      unlink(tmpname.c_str());
+      return(false);
+    }
+
+    return(true);
+  }
+
+
+}
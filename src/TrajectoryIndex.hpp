@@ -0,0 +1,110 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_TRAJECTORY_INDEX_HPP)
+#define LOOS_TRAJECTORY_INDEX_HPP
+
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+
+
+namespace loos {
+
+
+  //! Frame offsets for a trajectory, cached in a sidecar file
+  /**
+   * Formats without a fixed frame size (e.g. XTC and TRR) or without a
+   * frame count (e.g. Amber ASCII) have to scan the entire file when
+   * they are opened.  A TrajectoryIndex holds the result of that scan
+   * (the file offset of each frame, plus the number of atoms and
+   * timestep) and can store it next to the trajectory, so the next
+   * time the trajectory is opened the scan can be skipped.
+   *
+   * The sidecar for "foo.xtc" is "foo.xtc.lidx".  It records the size,
+   * modification time, and a checksum of the start of the trajectory,
+   * and is ignored if any of these no longer match.  If the sidecar
+   * cannot be written (e.g. the directory is read-only), the index is
+   * simply rebuilt next time.
+   *
+   * Since sidecars are written next to the user's data, they are only
+   * used when asked for, either by calling useSidecars(true) or by
+   * setting the LOOS_TRAJECTORY_INDEX environment variable.
+   */
+  class TrajectoryIndex {
+  public:
+    TrajectoryIndex() : _natoms(0), _timestep(0.0) { }
+
+    TrajectoryIndex(const std::vector<size_t>& offsets, const uint natoms, const double timestep)
+      : _offsets(offsets), _natoms(natoms), _timestep(timestep) { }
+
+    //! File offset for the start of each frame
+    const std::vector<size_t>& offsets() const { return(_offsets); }
+
+    uint natoms() const { return(_natoms); }
+    double timestep() const { return(_timestep); }
+
+    //! Read the sidecar index for trajectory \a fname
+    /**
+     * Returns false if there is no sidecar, it is for a different
+     * \a format, or it is out of date.
+     */
+    bool read(const std::string& fname, const std::string& format);
+
+    //! Write the sidecar index for trajectory \a fname
+    /**
+     * Returns false if the sidecar could not be written
+     */
+    bool write(const std::string& fname, const std::string& format) const;
+
+    //! Name of the sidecar file for trajectory \a fname
+    static std::string sidecarName(const std::string& fname) { return(fname + ".lidx"); }
+
+    //! Turns reading and writing of sidecar files on or off (default is off)
+    static void useSidecars(const bool b) { use_sidecars = b; }
+    static bool usingSidecars() { return(use_sidecars); }
+
+  private:
+    struct Signature {
+      Signature() : size(0), mtime(0), checksum(0) { }
+      unsigned long long size;
+      long long mtime;
+      unsigned int checksum;
+    };
+
+    static bool signature(const std::string& fname, Signature& sig);
+
+    static bool use_sidecars;
+
+    std::vector<size_t> _offsets;
+    uint _natoms;
+    double _timestep;
+  };
+
+
+}
+
+
+#endif
@@ -5,8 +5,12 @@
 
 #include <ensembles.hpp>
 #include <alignment.hpp>
+#include <SubsetCache.hpp>
+#include <CoordinateEnsemble.hpp>
+#include <FrameMapReduce.hpp>
 
 #include <cmath>
+#include <algorithm>
 
 
 namespace loos {
@@ -277,6 +281,223 @@ namespace loos {
     }
 
 
+    // Quaternion characteristic polynomial (QCP) superposition.
+    // See Theobald, Acta Cryst A61:478 (2005) and Liu, Agrafiotis, &
+    // Theobald, J Comput Chem 31:1561 (2010).  The optimal rotation is
+    // given by the largest eigenvalue (and its eigenvector, a
+    // quaternion) of a 4x4 key matrix built from the 3x3 correlation
+    // matrix.  The eigenvalue is found by Newton-Raphson on the
+    // characteristic polynomial, so there is no SVD per pair.
+
+    namespace {
+
+      // Correlation matrix between V (target) and U (mobile), i.e.
+      // A[3*i+j] = sum V_i * U_j, and half the total sum of squares
+      double qcpInnerProduct(double* A, const double* U, const double* V, const uint n) {
+        double G = 0.0;
+        for (uint k=0; k<9; ++k)
+          A[k] = 0.0;
+
+        for (uint i=0; i<3*n; i += 3) {
+          const double ux = U[i], uy = U[i+1], uz = U[i+2];
+          const double vx = V[i], vy = V[i+1], vz = V[i+2];
+
+          G += ux*ux + uy*uy + uz*uz + vx*vx + vy*vy + vz*vz;
+
+          A[0] += vx * ux;  A[1] += vx * uy;  A[2] += vx * uz;
+          A[3] += vy * ux;  A[4] += vy * uy;  A[5] += vy * uz;
+          A[6] += vz * ux;  A[7] += vz * uy;  A[8] += vz * uz;
+        }
+
+        return(G * 0.5);
+      }
+
+
+      // Largest eigenvalue of the key matrix
+      double qcpMaxEigenvalue(const double* A, const double E0) {
+        const double Sxx = A[0], Sxy = A[1], Sxz = A[2];
+        const double Syx = A[3], Syy = A[4], Syz = A[5];
+        const double Szx = A[6], Szy = A[7], Szz = A[8];
+
+        const double Sxx2 = Sxx * Sxx, Syy2 = Syy * Syy, Szz2 = Szz * Szz;
+        const double Sxy2 = Sxy * Sxy, Syz2 = Syz * Syz, Sxz2 = Sxz * Sxz;
+        const double Syx2 = Syx * Syx, Szy2 = Szy * Szy, Szx2 = Szx * Szx;
+
+        const double SyzSzymSyySzz2 = 2.0 * (Syz * Szy - Syy * Szz);
+        const double Sxx2Syy2Szz2Syz2Szy2 = Syy2 + Szz2 - Sxx2 + Syz2 + Szy2;
+
+        const double c2 = -2.0 * (Sxx2 + Syy2 + Szz2 + Sxy2 + Syx2 + Sxz2 + Szx2 + Syz2 + Szy2);
+        const double c1 = 8.0 * (Sxx * Syz * Szy + Syy * Szx * Sxz + Szz * Sxy * Syx
+                                 - Sxx * Syy * Szz - Syz * Szx * Sxy - Szy * Syx * Sxz);
+
+        const double SxzpSzx = Sxz + Szx, SyzpSzy = Syz + Szy, SxypSyx = Sxy + Syx;
+        const double SyzmSzy = Syz - Szy, SxzmSzx = Sxz - Szx, SxymSyx = Sxy - Syx;
+        const double SxxpSyy = Sxx + Syy, SxxmSyy = Sxx - Syy;
+        const double Sxy2Sxz2Syx2Szx2 = Sxy2 + Sxz2 - Syx2 - Szx2;
+
+        const double c0 = Sxy2Sxz2Syx2Szx2 * Sxy2Sxz2Syx2Szx2
+          + (Sxx2Syy2Szz2Syz2Szy2 + SyzSzymSyySzz2) * (Sxx2Syy2Szz2Syz2Szy2 - SyzSzymSyySzz2)
+          + (-SxzpSzx * SyzmSzy + SxymSyx * (SxxmSyy - Szz)) * (-SxzmSzx * SyzpSzy + SxymSyx * (SxxmSyy + Szz))
+          + (-SxzpSzx * SyzpSzy - SxypSyx * (SxxpSyy - Szz)) * (-SxzmSzx * SyzmSzy - SxypSyx * (SxxpSyy + Szz))
+          + (SxypSyx * SyzpSzy + SxzpSzx * (SxxmSyy + Szz)) * (-SxymSyx * SyzmSzy + SxzpSzx * (SxxpSyy + Szz))
+          + (SxypSyx * SyzmSzy + SxzmSzx * (SxxmSyy - Szz)) * (-SxymSyx * SyzpSzy + SxzmSzx * (SxxpSyy - Szz));
+
+        // E0 is an upper bound on the eigenvalue, so Newton-Raphson
+        // started there converges on the largest root
+        double lambda = E0;
+        for (uint i=0; i<50; ++i) {
+          const double old = lambda;
+          const double x2 = lambda * lambda;
+          const double b = (x2 + c2) * lambda;
+          const double a = b + c1;
+          const double denom = 2.0 * x2 * lambda + b + a;
+          if (denom == 0.0)
+            break;
+          lambda -= (a * lambda + c0) / denom;
+          if (std::abs(lambda - old) < std::abs(1e-11 * lambda))
+            break;
+        }
+
+        return(lambda);
+      }
+
+
+      double qcpRMSD(const double E0, const double lambda, const uint n) {
+        return(std::sqrt(std::abs(2.0 * (E0 - lambda) / n)));
+      }
+
+
+      // Rotation from the eigenvector for lambda, computed from the
+      // adjoint of (K - lambda I).  Any column of the adjoint will do,
+      // so fall back on the others when one is degenerate.
+      GMatrix qcpRotation(const double* A, const double lambda) {
+        const double Sxx = A[0], Sxy = A[1], Sxz = A[2];
+        const double Syx = A[3], Syy = A[4], Syz = A[5];
+        const double Szx = A[6], Szy = A[7], Szz = A[8];
+
+        const double a11 = Sxx + Syy + Szz - lambda, a12 = Syz - Szy, a13 = Szx - Sxz, a14 = Sxy - Syx;
+        const double a21 = a12, a22 = Sxx - Syy - Szz - lambda, a23 = Sxy + Syx, a24 = Szx + Sxz;
+        const double a31 = a13, a32 = a23, a33 = Syy - Sxx - Szz - lambda, a34 = Syz + Szy;
+        const double a41 = a14, a42 = a24, a43 = a34, a44 = Szz - Sxx - Syy - lambda;
+
+        const double a3344_4334 = a33 * a44 - a43 * a34, a3244_4234 = a32 * a44 - a42 * a34;
+        const double a3243_4233 = a32 * a43 - a42 * a33, a3143_4133 = a31 * a43 - a41 * a33;
+        const double a3144_4134 = a31 * a44 - a41 * a34, a3142_4132 = a31 * a42 - a41 * a32;
+
+        const double evecprec = 1e-6;
+
+        double q1 =  a22 * a3344_4334 - a23 * a3244_4234 + a24 * a3243_4233;
+        double q2 = -a21 * a3344_4334 + a23 * a3144_4134 - a24 * a3143_4133;
+        double q3 =  a21 * a3244_4234 - a22 * a3144_4134 + a24 * a3142_4132;
+        double q4 = -a21 * a3243_4233 + a22 * a3143_4133 - a23 * a3142_4132;
+        double qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+        if (qsqr < evecprec) {
+          q1 =  a12 * a3344_4334 - a13 * a3244_4234 + a14 * a3243_4233;
+          q2 = -a11 * a3344_4334 + a13 * a3144_4134 - a14 * a3143_4133;
+          q3 =  a11 * a3244_4234 - a12 * a3144_4134 + a14 * a3142_4132;
+          q4 = -a11 * a3243_4233 + a12 * a3143_4133 - a13 * a3142_4132;
+          qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+          if (qsqr < evecprec) {
+            const double a1324_1423 = a13 * a24 - a14 * a23, a1224_1422 = a12 * a24 - a14 * a22;
+            const double a1223_1322 = a12 * a23 - a13 * a22, a1124_1421 = a11 * a24 - a14 * a21;
+            const double a1123_1321 = a11 * a23 - a13 * a21, a1122_1221 = a11 * a22 - a12 * a21;
+
+            q1 =  a42 * a1324_1423 - a43 * a1224_1422 + a44 * a1223_1322;
+            q2 = -a41 * a1324_1423 + a43 * a1124_1421 - a44 * a1123_1321;
+            q3 =  a41 * a1224_1422 - a42 * a1124_1421 + a44 * a1122_1221;
+            q4 = -a41 * a1223_1322 + a42 * a1123_1321 - a43 * a1122_1221;
+            qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+            if (qsqr < evecprec) {
+              q1 =  a32 * a1324_1423 - a33 * a1224_1422 + a34 * a1223_1322;
+              q2 = -a31 * a1324_1423 + a33 * a1124_1421 - a34 * a1123_1321;
+              q3 =  a31 * a1224_1422 - a32 * a1124_1421 + a34 * a1122_1221;
+              q4 = -a31 * a1223_1322 + a32 * a1123_1321 - a33 * a1122_1221;
+              qsqr = q1*q1 + q2*q2 + q3*q3 + q4*q4;
+
+              // The structures are already superimposed (or degenerate)
+              if (qsqr < evecprec) {
+                GMatrix I;
+                return(I);
+              }
+            }
+          }
+        }
+
+        const double normq = std::sqrt(qsqr);
+        q1 /= normq;
+        q2 /= normq;
+        q3 /= normq;
+        q4 /= normq;
+
+        const double a2 = q1 * q1, x2 = q2 * q2, y2 = q3 * q3, z2 = q4 * q4;
+        const double xy = q2 * q3, az = q1 * q4, zx = q4 * q2;
+        const double ay = q1 * q3, yz = q3 * q4, ax = q1 * q2;
+
+        GMatrix R;
+        R(0,0) = a2 + x2 - y2 - z2;
+        R(0,1) = 2.0 * (xy + az);
+        R(0,2) = 2.0 * (zx - ay);
+        R(1,0) = 2.0 * (xy - az);
+        R(1,1) = a2 - x2 + y2 - z2;
+        R(1,2) = 2.0 * (yz + ax);
+        R(2,0) = 2.0 * (zx + ay);
+        R(2,1) = 2.0 * (yz - ax);
+        R(2,2) = a2 - x2 - y2 + z2;
+
+        return(R);
+      }
+
+    }
+
+
+    double qcpCenteredRMSD(const double* U, const double* V, const uint n) {
+      double A[9];
+      double E0 = qcpInnerProduct(A, U, V, n);
+      return(qcpRMSD(E0, qcpMaxEigenvalue(A, E0), n));
+    }
+
+
+    double qcpRMSDFromInnerProduct(const double* A, const double E0, const uint n) {
+      return(qcpRMSD(E0, qcpMaxEigenvalue(A, E0), n));
+    }
+
+
+    double qcpCenteredRMSD(const vecDouble& U, const vecDouble& V) {
+      return(qcpCenteredRMSD(U.data(), V.data(), U.size() / 3));
+    }
+
+
+    GMatrix qcpCenteredRotation(const double* U, const double* V, const uint n, double* rmsd) {
+      double A[9];
+      double E0 = qcpInnerProduct(A, U, V, n);
+      double lambda = qcpMaxEigenvalue(A, E0);
+      if (rmsd)
+        *rmsd = qcpRMSD(E0, lambda, n);
+      return(qcpRotation(A, lambda));
+    }
+
+
+    GMatrix qcpSuperposition(const vecDouble& U, const vecDouble& V) {
+      vecDouble cU(U);
+      vecDouble cV(V);
+
+      GCoord U_center = centerAtOrigin(cU);
+      GCoord V_center = centerAtOrigin(cV);
+      GMatrix M = qcpCenteredRotation(cU.data(), cV.data(), cU.size() / 3);
+
+      XForm W;
+      W.identity();
+      W.translate(V_center);
+      W.concat(M);
+      W.translate(-U_center);
+
+      return W.current();
+    }
+
+
 
   }
 
@@ -352,55 +573,125 @@ namespace loos {
 
 
 
-  boost::tuple<std::vector<XForm>, greal, int> iterativeAlignment(const AtomicGroup& g,
-                                                                  pTraj& traj,
-                                                                  const std::vector<uint>& frame_indices,
-                                                                  greal threshold, int maxiter) {
+  namespace {
 
-    using namespace alignment;
+    // Aligns a chunk of a CoordinateEnsemble's frames onto the target,
+    // summing the aligned coordinates for that chunk.  The frames are
+    // left untouched, so each pass starts from the original
+    // coordinates rather than rounding the floats again.
+    class EnsembleAligner {
+    public:
+      EnsembleAligner(const CoordinateEnsemble& ensemble, std::vector<XForm>& xforms, const uint nchunks)
+        : _ensemble(ensemble), _xforms(xforms), _target(0),
+          _sums(nchunks, alignment::vecDouble(ensemble.natoms() * 3)) { }
 
-    // Must first prime the loop...
-    AtomicGroup frame = g.copy();
-    traj->readFrame(frame_indices[0]);
-    traj->updateGroupCoords(frame);
+      void target(const alignment::vecDouble& t) { _target = &t; }
 
-    int nf = frame_indices.size();
+      void operator()(const uint chunk, const uint begin, const uint end) {
+        alignment::vecDouble& sum = _sums[chunk];
+        std::fill(sum.begin(), sum.end(), 0.0);
 
-    int iter = 0;
-    greal rms;
-    std::vector<XForm> xforms(nf);
-    AtomicGroup avg = frame.copy();
+        alignment::vecDouble frame;
+        const uint n = sum.size();
+        for (uint i=begin; i<end; ++i) {
+          _ensemble.copyFrame(i, frame);
+          GMatrix M = alignment::kabsch(frame, *_target);
+          _xforms[i].load(M);
+          alignment::applyTransform(M, frame);
 
-    AtomicGroup target = frame.copy();
-    target.centerAtOrigin();
+          for (uint j=0; j<n; ++j)
+            sum[j] += frame[j];
+        }
+      }
 
-    do {
-      // Compute avg internally so we don't have to read traj twice...
-      for (uint j=0; j<avg.size(); ++j)
-        avg[j]->coords() = GCoord(0,0,0);
+      const std::vector<alignment::vecDouble>& sums() const { return(_sums); }
+
+    private:
+      const CoordinateEnsemble& _ensemble;
+      std::vector<XForm>& _xforms;
+      const alignment::vecDouble* _target;
+      std::vector<alignment::vecDouble> _sums;
+    };
+
+
+    // Iterative superposition shared by the CoordinateEnsemble and
+    // SubsetCache versions.  Each pass aligns the original frames
+    // onto the current target, accumulating the new average in the
+    // same sweep.  The frames themselves are not modified.
+    boost::tuple<std::vector<XForm>,greal,int> alignEnsembleFrames(const CoordinateEnsemble& ensemble,
+                                                                   const greal threshold, const int maxiter,
+                                                                   const uint nthreads) {
+      using namespace alignment;
+
+      uint nf = ensemble.size();
+      uint n = ensemble.natoms() * 3;
+      if (nf == 0)
+        throw(LOOSError("Cannot align an empty ensemble"));
+
+      std::vector<XForm> xforms(nf);
+
+      // Keep a few thousand coordinates per thread so small ensembles stay serial
+      uint nchunks = internal::threadsFor(nf, nthreads, std::max(1u, 8192u / std::max(n, 1u)));
+      EnsembleAligner aligner(ensemble, xforms, nchunks);
+
+      // Start by aligning against the first structure in the ensemble
+      vecDouble target;
+      ensemble.copyFrame(0, target);
+      centerAtOrigin(target);
+
+      double rms;
+      int iter = 0;
+      vecDouble avg(n);
+      do {
+        aligner.target(target);
+        internal::parallelChunks(nf, nchunks, aligner);
+
+        // Combine the chunks in frame order...
+        std::fill(avg.begin(), avg.end(), 0.0);
+        for (uint k=0; k<nchunks; ++k)
+          for (uint j=0; j<n; ++j)
+            avg[j] += aligner.sums()[k][j];
+        for (uint j=0; j<n; ++j)
+          avg[j] /= nf;
+
+        rms = rmsd(target, avg);
+        target = avg;
+        ++iter;
+      } while (rms > threshold && iter <= maxiter );
+
+      boost::tuple<std::vector<XForm>, greal, int> res(xforms, rms, iter);
+      return(res);
+    }
 
-      for (int i=0; i<nf; ++i) {
+  }
 
-        traj->readFrame(frame_indices[i]);
-        traj->updateGroupCoords(frame);
 
-        GMatrix M = frame.alignOnto(target);
-        xforms[i].load(M);
+  boost::tuple<std::vector<XForm>,greal,int> iterativeAlignment(CoordinateEnsemble& ensemble,
+                                                                greal threshold, int maxiter,
+                                                                uint nthreads) {
+    boost::tuple<std::vector<XForm>, greal, int> res = alignEnsembleFrames(ensemble, threshold, maxiter, nthreads);
 
-        for (uint j=0; j<avg.size(); ++j)
-          avg[j]->coords() += frame[j]->coords();
-      }
+    // Each transform maps an original frame onto the final average
+    applyTransforms(ensemble, boost::get<0>(res), nthreads);
+    return(res);
+  }
 
-      for (uint j=0; j<avg.size(); ++j)
-        avg[j]->coords() /= nf;
 
-      rms = avg.rmsd(target);
-      target = avg.copy();
-      ++iter;
-    } while (rms > threshold && iter <= maxiter);
 
-    boost::tuple<std::vector<XForm>, greal, int> res(xforms, rms, iter);
-    return(res);
+  boost::tuple<std::vector<XForm>, greal, int> iterativeAlignment(const SubsetCache& cache,
+                                                                  greal threshold, int maxiter,
+                                                                  uint nthreads) {
+    return(alignEnsembleFrames(cache.ensemble(), threshold, maxiter, nthreads));
+  }
+
+
+  boost::tuple<std::vector<XForm>, greal, int> iterativeAlignment(const AtomicGroup& g,
+                                                                  pTraj& traj,
+                                                                  const std::vector<uint>& frame_indices,
+                                                                  greal threshold, int maxiter) {
+
+    SubsetCache cache(g, traj, frame_indices);
+    return(iterativeAlignment(cache, threshold, maxiter));
   }
 
 
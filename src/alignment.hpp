@@ -36,6 +36,9 @@
 
 namespace loos {
 
+        class SubsetCache;
+        class CoordinateEnsemble;
+
         // Lower-level routines for optimizing alignment performance.
         namespace alignment {
         
@@ -54,6 +57,38 @@ namespace loos {
                 double rmsd(const vecDouble& u, const vecDouble& v);
 
 
+                //! RMSD after optimal superposition of two centered sets of \a n atoms (QCP)
+                /**
+                 * Uses the quaternion characteristic polynomial method
+                 * (Theobald 2005; Liu et al 2010) rather than an SVD, so
+                 * it is considerably cheaper than centeredRMSD() when
+                 * called for many pairs.  Coordinates are packed as
+                 * xyzxyz...
+                 */
+                double qcpCenteredRMSD(const double* U, const double* V, const uint n);
+                double qcpCenteredRMSD(const vecDouble& U, const vecDouble& V);
+
+                //! QCP RMSD from a precomputed inner product
+                /**
+                 * \a A is the 3x3 correlation matrix between the target
+                 * and mobile structures (A[3*i+j] = sum V_i U_j) and \a E0
+                 * is half their total sum of squares.  This lets callers
+                 * that compute the inner product themselves (e.g.
+                 * PairwiseRMSD) share the eigenvalue solver.
+                 */
+                double qcpRMSDFromInnerProduct(const double* A, const double E0, const uint n);
+
+                //! Rotation that superimposes centered \a U onto centered \a V (QCP)
+                /**
+                 * If \a rmsd is not null, the RMSD after superposition is
+                 * stored there as well.
+                 */
+                GMatrix qcpCenteredRotation(const double* U, const double* V, const uint n, double* rmsd = 0);
+
+                //! Same as kabsch(), but uses QCP for the rotation
+                GMatrix qcpSuperposition(const vecDouble& U, const vecDouble& V);
+
+
         }
 
 #if !defined(SWIG)
@@ -65,15 +100,45 @@ namespace loos {
                                                                       greal threshold=1e-6,
                                                                       int maxiter=1000);
 
+        //! Iteratively superimpose the frames of a CoordinateEnsemble (in place)
+        /**
+         * Behaves like the std::vector<AtomicGroup> version, but the
+         * frames can be aligned on \a nthreads threads (0 means one per
+         * core).  Each pass aligns the original coordinates, and the
+         * ensemble is only transformed once at the end, so rounding to
+         * float does not accumulate.  The returned transforms map the
+         * original frames onto the final average.
+         *
+         * With more than one thread, the average is summed in a
+         * different order, so the result can differ in the last few
+         * digits from a serial run (or one with a different number of
+         * threads).
+         */
+        boost::tuple<std::vector<XForm>,greal,int> iterativeAlignment(CoordinateEnsemble& ensemble,
+                                                                      greal threshold=1e-6,
+                                                                      int maxiter=1000,
+                                                                      uint nthreads=1);
+
+        //! Compute an iterative superposition from a SubsetCache
+        /**
+         * Aligns the cached frames exactly as the CoordinateEnsemble
+         * version does (see SubsetCache::ensemble()), except that the
+         * cache is left untouched, so the trajectory is never read
+         * again.  The returned transforms map the original
+         * (untransformed) frames onto the final average.
+         */
+        boost::tuple<std::vector<XForm>,greal,int> iterativeAlignment(const SubsetCache& cache,
+                                                                      greal threshold=1e-6,
+                                                                      int maxiter=1000,
+                                                                      uint nthreads=1);
+
         //! Compute an iterative superposition by reading in frames from the Trajectory.
         /**
-         * The iterativeAlignment() functions that take a trajectory as an argument do
-         * NOT cache frames of the trajectory internally.  This means that the trajectory
-         * will be read as many times as is necessary for the alignment to
-         * converge.  In practice, the OS-specific caching will likely result
-         * in decent performance.  If speed is essential, then consider
-         * using the iterativeAlignment() version that takes a
-         * \p std::vector<AtomicGroup>& as argument instead.
+         * The trajectory is read once, into a SubsetCache holding only
+         * the atoms in \a model, and the alignment then iterates over the
+         * cache.  Large caches are spilled to a temporary file (see
+         * SubsetCache).  To reuse the cached coordinates after aligning,
+         * build the SubsetCache yourself and pass it instead.
          */
         boost::tuple<std::vector<XForm>,greal,int> iterativeAlignment(const AtomicGroup& model,
                                                                       pTraj& traj,
@@ -70,6 +70,14 @@ namespace loos {
 		retval = nc_inq_varid(_ncid, "velocities", &_velocities_id);
 		_velocities = !retval;
 
+		// Amber stores velocities in its internal units, with a
+		// scale_factor that converts them to Angstroms/ps
+		if (_velocities) {
+			double scale;
+			if (!nc_get_att_double(_ncid, _velocities_id, "scale_factor", &scale))
+				_velocity_scale = scale;
+		}
+
 
 		// Attempt to determine timestep by looking at dT between frames 1 & 2
 		if (_nframes >= 2) {
@@ -123,6 +131,9 @@ namespace loos {
 			retval = VarTypeDecider<GCoord::element_type>::read(_ncid, _velocities_id, start, count, _velocity_data);
 			if (retval)
 				throw(FileReadError(_filename, "Cannot read Amber netcdf frame (velocities)", retval));
+			if (_velocity_scale != 1.0)
+				for (uint i=0; i<_natoms * 3; ++i)
+					_velocity_data[i] *= _velocity_scale;
 		}
 
 
@@ -161,6 +172,14 @@ namespace loos {
 	}
 
 
+	void AmberNetcdf::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+		plan.scatterInterleaved(g, _coord_data);
+
+		if (_periodic)
+			g.periodicBox(GCoord(_box_data[0], _box_data[1], _box_data[2]));
+	}
+
+
 	void AmberNetcdf::updateGroupVelocitiesImpl(AtomicGroup& g) {
 
 		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
@@ -168,14 +187,14 @@ namespace loos {
 			if (idx >= _natoms)
 				throw(LOOSError(**i, "Atom index into trajectory frame is out of bounds"));
 			idx *= 3;
-			(*i)->coords(GCoord(_velocity_data[idx], _velocity_data[idx+1], _velocity_data[idx+2]));
+			(*i)->velocities(GCoord(_velocity_data[idx], _velocity_data[idx+1], _velocity_data[idx+2]));
 		}
 	}
 
 
 	std::vector<GCoord> AmberNetcdf::velocitiesImpl() const {
 		std::vector<GCoord> res;
-		for (uint i=0; i<_natoms; i += 3)
+		for (uint i=0; i<_natoms * 3; i += 3)
 			res.push_back(GCoord(_velocity_data[i], _velocity_data[i+1], _velocity_data[i+2]));
 		return(res);
 	}
@@ -79,6 +79,7 @@ namespace loos {
 			  _box_data(new GCoord::element_type[3]),
 			  _periodic(false),
 			  _velocities(false),
+			  _velocity_scale(1.0),
 			  _timestep(1e-12)
 		{
 			cached_first = false;
@@ -91,6 +92,7 @@ namespace loos {
 			nc_close(_ncid);
 
 			delete[] _coord_data;
+			delete[] _velocity_data;
 			delete[] _box_data;
 		}
 
@@ -115,7 +117,7 @@ namespace loos {
 
 		std::vector<GCoord> coords() const {
 			std::vector<GCoord> res;
-			for (uint i=0; i<_natoms; i += 3)
+			for (uint i=0; i<_natoms * 3; i += 3)
 				res.push_back(GCoord(_coord_data[i], _coord_data[i+1], _coord_data[i+2]));
 			return(res);
 		}
@@ -132,6 +134,7 @@ namespace loos {
 		void readRawFrame(const uint frameno);
 
 		void updateGroupCoordsImpl(AtomicGroup& g);
+		void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
 		void updateGroupVelocitiesImpl(AtomicGroup& g);
 		bool parseFrame();
 		void seekNextFrameImpl() { }
@@ -147,6 +150,7 @@ namespace loos {
 		GCoord::element_type* _box_data;
 		bool _periodic;
 		bool _velocities;
+		double _velocity_scale;    // From the velocities' scale_factor (Amber units -> \AA/ps)
 		float _timestep;
 		int _ncid;
 		size_t _nframes;
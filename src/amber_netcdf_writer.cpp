@@ -0,0 +1,316 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <sys/stat.h>
+
+#include <amber_netcdf_writer.hpp>
+#include <exceptions.hpp>
+
+
+extern std::string revision_label;
+
+
+namespace loos {
+
+
+	namespace {
+
+		// Converts Angstroms/ps to Amber's internal velocity units
+		const double amber_velocity_scale = 20.455;
+
+		int putText(const int id, const int var, const std::string& name, const std::string& value) {
+			return(nc_put_att_text(id, var, name.c_str(), value.size(), value.c_str()));
+		}
+
+	}
+
+
+	// The file is created (or opened) here so it is truncated just as
+	// with the other writers, but the dimensions and variables are not
+	// defined until the first frame is written
+	AmberNetcdfWriter::AmberNetcdfWriter(const std::string& fname, const bool append)
+		: TrajectoryWriter(static_cast<std::iostream*>(0), append),
+		  _ncid(-1), _defined(false), _natoms(0), _periodic(false), _velocities(false),
+		  _dt(1.0), _current(0), _staged(0), _buffer_bytes(0),
+		  _title("AUTO GENERATED BY LOOS"),
+		  _time_id(-1), _coord_id(-1), _velocities_id(-1), _cell_lengths_id(-1), _cell_angles_id(-1)
+	{
+		_filename = fname;
+
+		struct stat statbuf;
+		appending_ = append && !stat(fname.c_str(), &statbuf);
+
+		if (appending_)
+			openForAppend();
+		else {
+			int retval = nc_create(fname.c_str(), NC_CLOBBER | NC_64BIT_OFFSET, &_ncid);
+			if (retval)
+				throw(FileOpenError(fname, "Cannot create NetCDF file", retval));
+		}
+	}
+
+
+	AmberNetcdfWriter::~AmberNetcdfWriter() {
+		try {
+			flush();
+		}
+		catch(...) {
+			std::cerr << "Warning- error while finishing NetCDF '" << _filename << "'" << std::endl;
+		}
+
+		// ignore the return code since throwing in destructors is bad...
+		nc_close(_ncid);
+	}
+
+
+	void AmberNetcdfWriter::check(const int retval, const std::string& msg) const {
+		if (retval)
+			throw(FileWriteError(_filename, msg + " (" + nc_strerror(retval) + ")", retval));
+	}
+
+
+	void AmberNetcdfWriter::setComments(const std::vector<std::string>& comments) {
+		if (_defined)
+			throw(std::logic_error("Cannot set the NetCDF title after frames have been written"));
+
+		_title.clear();
+		for (std::vector<std::string>::const_iterator i = comments.begin(); i != comments.end(); ++i) {
+			if (i != comments.begin())
+				_title += '\n';
+			_title += *i;
+		}
+	}
+
+
+	// Defines the dimensions, variables, and attributes for the AMBER
+	// convention using the first frame written
+	void AmberNetcdfWriter::defineFile(const AtomicGroup& model) {
+		_natoms = model.size();
+		_periodic = model.isPeriodic();
+		_velocities = !model.empty() && model.allHaveProperty(Atom::velbit);
+
+		check(putText(_ncid, NC_GLOBAL, "title", _title), "Cannot write title");
+		check(putText(_ncid, NC_GLOBAL, "application", "AMBER"), "Cannot write application");
+		check(putText(_ncid, NC_GLOBAL, "program", "LOOS"), "Cannot write program");
+		check(putText(_ncid, NC_GLOBAL, "programVersion", revision_label), "Cannot write programVersion");
+		check(putText(_ncid, NC_GLOBAL, "Conventions", "AMBER"), "Cannot write Conventions");
+		check(putText(_ncid, NC_GLOBAL, "ConventionVersion", "1.0"), "Cannot write ConventionVersion");
+
+		int frame_dim, spatial_dim, atom_dim;
+		check(nc_def_dim(_ncid, "frame", NC_UNLIMITED, &frame_dim), "Cannot define frame dimension");
+		check(nc_def_dim(_ncid, "spatial", 3, &spatial_dim), "Cannot define spatial dimension");
+		check(nc_def_dim(_ncid, "atom", _natoms, &atom_dim), "Cannot define atom dimension");
+
+		int spatial_id;
+		check(nc_def_var(_ncid, "spatial", NC_CHAR, 1, &spatial_dim, &spatial_id), "Cannot define spatial");
+
+		check(nc_def_var(_ncid, "time", NC_FLOAT, 1, &frame_dim, &_time_id), "Cannot define time");
+		check(putText(_ncid, _time_id, "units", "picosecond"), "Cannot write time units");
+
+		int dims[3] = { frame_dim, atom_dim, spatial_dim };
+		check(nc_def_var(_ncid, "coordinates", NC_FLOAT, 3, dims, &_coord_id), "Cannot define coordinates");
+		check(putText(_ncid, _coord_id, "units", "angstrom"), "Cannot write coordinate units");
+
+		if (_velocities) {
+			check(nc_def_var(_ncid, "velocities", NC_FLOAT, 3, dims, &_velocities_id), "Cannot define velocities");
+			check(putText(_ncid, _velocities_id, "units", "angstrom/picosecond"), "Cannot write velocity units");
+			check(nc_put_att_double(_ncid, _velocities_id, "scale_factor", NC_DOUBLE, 1, &amber_velocity_scale),
+			      "Cannot write velocity scale factor");
+		}
+
+		int cell_spatial_id, cell_angular_id;
+		if (_periodic) {
+			int cell_spatial_dim, cell_angular_dim, label_dim;
+			check(nc_def_dim(_ncid, "cell_spatial", 3, &cell_spatial_dim), "Cannot define cell_spatial dimension");
+			check(nc_def_dim(_ncid, "cell_angular", 3, &cell_angular_dim), "Cannot define cell_angular dimension");
+			check(nc_def_dim(_ncid, "label", 5, &label_dim), "Cannot define label dimension");
+
+			check(nc_def_var(_ncid, "cell_spatial", NC_CHAR, 1, &cell_spatial_dim, &cell_spatial_id), "Cannot define cell_spatial");
+			int label_dims[2] = { cell_angular_dim, label_dim };
+			check(nc_def_var(_ncid, "cell_angular", NC_CHAR, 2, label_dims, &cell_angular_id), "Cannot define cell_angular");
+
+			int cell_dims[2] = { frame_dim, cell_spatial_dim };
+			check(nc_def_var(_ncid, "cell_lengths", NC_DOUBLE, 2, cell_dims, &_cell_lengths_id), "Cannot define cell_lengths");
+			check(putText(_ncid, _cell_lengths_id, "units", "angstrom"), "Cannot write cell_lengths units");
+
+			cell_dims[1] = cell_angular_dim;
+			check(nc_def_var(_ncid, "cell_angles", NC_DOUBLE, 2, cell_dims, &_cell_angles_id), "Cannot define cell_angles");
+			check(putText(_ncid, _cell_angles_id, "units", "degree"), "Cannot write cell_angles units");
+		}
+
+		check(nc_enddef(_ncid), "Cannot finish defining NetCDF file");
+
+		check(nc_put_var_text(_ncid, spatial_id, "xyz"), "Cannot write spatial labels");
+		if (_periodic) {
+			check(nc_put_var_text(_ncid, cell_spatial_id, "abc"), "Cannot write cell_spatial labels");
+			check(nc_put_var_text(_ncid, cell_angular_id, "alphabeta gamma"), "Cannot write cell_angular labels");
+		}
+
+		_defined = true;
+	}
+
+
+	// Picks up the variables from an existing file.  If no frames were
+	// ever written to it, it is put back into define mode so the first
+	// frame can define it.
+	void AmberNetcdfWriter::openForAppend() {
+		int retval = nc_open(_filename.c_str(), NC_WRITE, &_ncid);
+		if (retval)
+			throw(FileOpenError(_filename, "Cannot open NetCDF file for appending", retval));
+
+		int atom_dim;
+		if (nc_inq_dimid(_ncid, "atom", &atom_dim)) {
+			check(nc_redef(_ncid), "Cannot define NetCDF file");
+			return;
+		}
+
+		size_t n;
+		check(nc_inq_dimlen(_ncid, atom_dim, &n), "Cannot get number of atoms");
+		_natoms = n;
+
+		int frame_dim;
+		check(nc_inq_dimid(_ncid, "frame", &frame_dim), "Cannot get frame dimension");
+		check(nc_inq_dimlen(_ncid, frame_dim, &n), "Cannot get number of frames");
+		_current = n;
+
+		check(nc_inq_varid(_ncid, "time", &_time_id), "Cannot get id for time");
+		check(nc_inq_varid(_ncid, "coordinates", &_coord_id), "Cannot get id for coordinates");
+
+		_velocities = !nc_inq_varid(_ncid, "velocities", &_velocities_id);
+		_periodic = !nc_inq_varid(_ncid, "cell_lengths", &_cell_lengths_id);
+		if (_periodic)
+			check(nc_inq_varid(_ncid, "cell_angles", &_cell_angles_id), "Cannot get id for cell_angles");
+
+		_defined = true;
+	}
+
+
+	size_t AmberNetcdfWriter::frameSize() const {
+		size_t n = sizeof(float) + _natoms * 3 * sizeof(float);
+		if (_velocities)
+			n += _natoms * 3 * sizeof(float);
+		if (_periodic)
+			n += 6 * sizeof(double);
+		return(n);
+	}
+
+
+	void AmberNetcdfWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
+
+		if (!_defined)
+			defineFile(model);
+		else {
+			if (model.size() != _natoms)
+				throw(LOOSError("Frame group atom count mismatch"));
+			if (_periodic && !model.isPeriodic())
+				throw(LOOSError("Periodic box data was requested for the NetCDF trajectory but the passed frame is missing it"));
+			if (_velocities && !model.allHaveProperty(Atom::velbit))
+				throw(LOOSError("Velocities were requested for the NetCDF trajectory but the passed frame is missing them"));
+		}
+
+		_time_data.push_back(time);
+
+		size_t m = _coord_data.size();
+		_coord_data.resize(m + _natoms * 3);
+		for (uint i=0; i<_natoms; ++i) {
+			const GCoord& c = model[i]->coords();
+			_coord_data[m++] = c.x();
+			_coord_data[m++] = c.y();
+			_coord_data[m++] = c.z();
+		}
+
+		if (_velocities) {
+			m = _velocity_data.size();
+			_velocity_data.resize(m + _natoms * 3);
+			for (uint i=0; i<_natoms; ++i) {
+				const Atom& atom = *(model[i]);     // The non-const accessor would set velbit
+				const GCoord& v = atom.velocities();
+				_velocity_data[m++] = v.x() / amber_velocity_scale;
+				_velocity_data[m++] = v.y() / amber_velocity_scale;
+				_velocity_data[m++] = v.z() / amber_velocity_scale;
+			}
+		}
+
+		if (_periodic) {
+			GCoord box = model.periodicBox();
+			_box_data.push_back(box[0]);
+			_box_data.push_back(box[1]);
+			_box_data.push_back(box[2]);
+		}
+
+		++_staged;
+		++_current;
+
+		if (_buffer_bytes == 0 || (_staged + 1) * frameSize() > _buffer_bytes)
+			writeStaged();
+	}
+
+
+	void AmberNetcdfWriter::writeFrame(const AtomicGroup& model) {
+		writeFrame(model, _current, _dt * _current);
+	}
+
+
+	// Writes all staged frames as one block of records per variable
+	void AmberNetcdfWriter::writeStaged() {
+		if (_staged == 0)
+			return;
+
+		size_t start[3] = { _current - _staged, 0, 0 };
+		size_t count[3] = { _staged, _natoms, 3 };
+
+		check(nc_put_vara_float(_ncid, _time_id, start, count, &_time_data[0]), "Cannot write frame times");
+		check(nc_put_vara_float(_ncid, _coord_id, start, count, &_coord_data[0]), "Cannot write coordinates");
+		if (_velocities)
+			check(nc_put_vara_float(_ncid, _velocities_id, start, count, &_velocity_data[0]), "Cannot write velocities");
+
+		if (_periodic) {
+			count[1] = 3;
+			std::vector<double> angles(_staged * 3, 90.0);
+			check(nc_put_vara_double(_ncid, _cell_lengths_id, start, count, &_box_data[0]), "Cannot write cell lengths");
+			check(nc_put_vara_double(_ncid, _cell_angles_id, start, count, &angles[0]), "Cannot write cell angles");
+		}
+
+		_time_data.clear();
+		_coord_data.clear();
+		_velocity_data.clear();
+		_box_data.clear();
+		_staged = 0;
+	}
+
+
+	void AmberNetcdfWriter::bufferOutput(const size_t nbytes) {
+		if (nbytes == 0)
+			writeStaged();
+		_buffer_bytes = nbytes;
+	}
+
+
+	// A file with no frames is still in define mode, where it can't be synced
+	void AmberNetcdfWriter::flush() {
+		writeStaged();
+		if (_defined)
+			check(nc_sync(_ncid), "Cannot sync NetCDF file");
+	}
+
+}
@@ -0,0 +1,127 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_AMBER_NETCDF_WRITER_HPP)
+#define LOOS_AMBER_NETCDF_WRITER_HPP
+
+#include <string>
+#include <vector>
+#include <netcdf.h>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <trajwriter.hpp>
+
+
+namespace loos {
+
+
+	//! Class for writing Amber trajectories in NetCDF format
+	/**
+	 * Writes trajectories following the AMBER NetCDF convention (v1.0),
+	 * so they can be read by LOOS, cpptraj, VMD, etc.  The file is
+	 * defined when the first frame is written: the number of atoms,
+	 * whether there is a periodic box, and whether velocities are
+	 * stored (only if every atom has them) all come from that frame,
+	 * and later frames must match.  Velocities are stored in Amber's
+	 * internal units along with the scale_factor that converts them to
+	 * Angstroms/ps, as the convention requires.
+	 *
+	 * Each frame is written with one call per variable.  After
+	 * bufferOutput(), frames are staged in memory and written as a
+	 * block of records, and the file is only synced when flush() is
+	 * called or the writer is destroyed.
+	 *
+	 * Note: the NetCDF library opens the file itself, so this writer
+	 * has no stream.
+	 */
+	class AmberNetcdfWriter : public TrajectoryWriter {
+	public:
+
+		//! Class factory function
+		static pTrajectoryWriter create(const std::string& s, const bool append = false) {
+			return(pTrajectoryWriter(new AmberNetcdfWriter(s, append)));
+		}
+
+		explicit AmberNetcdfWriter(const std::string& fname, const bool append = false);
+
+		//! Writes any staged frames and closes the file
+		~AmberNetcdfWriter();
+
+
+		//! Time between frames (in ps) when none is given to writeFrame()
+		double timePerFrame() const { return(_dt); }
+		void timePerFrame(const double dt) { _dt = dt; }
+
+		//! Comments are stored as the title (before the first frame only)
+		void setComments(const std::vector<std::string>& comments);
+
+		void writeFrame(const AtomicGroup& model);
+
+		//! Writes a frame at \a time (in ps).  Amber NetCDF has no step, so it is ignored.
+		void writeFrame(const AtomicGroup& model, const uint step, const double time);
+
+		bool hasFrameTime() const { return(true); }
+		bool hasComments() const { return(true); }
+
+		uint framesWritten() const { return(_current); }
+
+		void bufferOutput(const size_t nbytes = 64 * 1024 * 1024);
+
+		//! Writes any staged frames and syncs the file
+		void flush();
+
+	private:
+		void check(const int retval, const std::string& msg) const;
+		void defineFile(const AtomicGroup& model);
+		void openForAppend();
+		size_t frameSize() const;
+		void writeStaged();
+
+	private:
+		int _ncid;
+		bool _defined;
+		uint _natoms;
+		bool _periodic;
+		bool _velocities;
+		double _dt;
+		uint _current;
+		uint _staged;
+		size_t _buffer_bytes;
+		std::string _title;
+
+		int _time_id, _coord_id, _velocities_id, _cell_lengths_id, _cell_angles_id;
+
+		// Staged frames, in the order they are written to the file
+		std::vector<float> _time_data;
+		std::vector<float> _coord_data;
+		std::vector<float> _velocity_data;
+		std::vector<double> _box_data;
+	};
+
+
+}
+
+
+#endif
@@ -23,6 +23,7 @@
 
 #include <amber_traj.hpp>
 #include <AtomicGroup.hpp>
+#include <TrajectoryIndex.hpp>
 #include <iomanip>
 #include <sstream>
 
@@ -61,14 +62,31 @@ namespace loos {
 
     frame_size = fpos - frame_offset;
 
-    // Now try to count the number of frames...
-    _nframes = 1;
-    double dummy;
-    while (!ifs->fail()) {
-      ++_nframes;
-      fpos = _nframes * frame_size + frame_offset;
-      ifs->seekg(fpos);
-      *(ifs) >> dummy;
+    // Now try to count the number of frames, unless there is a
+    // sidecar index from a previous scan (see TrajectoryIndex)...
+    bool from_file = (_filename != "istream");
+    TrajectoryIndex index;
+    if (from_file && index.read(_filename, "amber") && index.natoms() == _natoms
+        && !index.offsets().empty() && index.offsets()[0] == frame_offset
+        && (index.offsets().size() == 1 || index.offsets()[1] - index.offsets()[0] == frame_size)) {
+      _nframes = index.offsets().size();
+
+    } else {
+      _nframes = 1;
+      double dummy;
+      while (!ifs->fail()) {
+        ++_nframes;
+        fpos = _nframes * frame_size + frame_offset;
+        ifs->seekg(fpos);
+        *(ifs) >> dummy;
+      }
+
+      if (from_file) {
+        std::vector<size_t> offsets(_nframes);
+        for (uint i=0; i<_nframes; ++i)
+          offsets[i] = frame_offset + i * frame_size;
+        TrajectoryIndex(offsets, _natoms, 0.0).write(_filename, "amber");
+      }
     }
 
 
@@ -143,4 +161,12 @@ namespace loos {
     if (periodic)
       g.periodicBox(box);
   }
+
+
+  void AmberTraj::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+    plan.scatter(g, frame);
+
+    if (periodic)
+      g.periodicBox(box);
+  }
 }
@@ -36,7 +36,8 @@ namespace loos {
   /*!
    * This class will read in the first frame of the trajectory upon
    * instantiation.  It will also scan the file to determine how many
-   * frames there are.
+   * frames there are.  The result of the scan is cached in a sidecar
+   * file (see TrajectoryIndex).
    *
    * Since the Amber trajectory format does not store the # of atoms
    * present, this must be passed to the AmberTraj constructor.
@@ -86,6 +87,7 @@ namespace loos {
     virtual void seekNextFrameImpl(void) { }
     virtual void seekFrameImpl(const uint);
     virtual void updateGroupCoordsImpl(AtomicGroup&);
+    virtual void updateGroupCoordsWithPlanImpl(AtomicGroup&, const CoordinatePlan&);
 
 
   private:
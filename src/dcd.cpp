@@ -29,9 +29,17 @@
 #include <stdexcept>
 #include <vector>
 
+#include <algorithm>
+
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
 
 #include <dcd.hpp>
 #include <AtomicGroup.hpp>
@@ -45,6 +53,7 @@ namespace loos {
 
 
   bool DCD::suppress_warnings = false;
+  const size_t DCD::sparse_coalesce_bytes = 4096;
   
   
   std::vector<std::string> DCD::titles(void) const { return(_titles); }
@@ -59,9 +68,9 @@ namespace loos {
   float DCD::timestep(void) const { return(_delta); }
   uint DCD::nframes(void) const { return(_nframes); }
 
-  std::vector<dcd_real> DCD::xcoords(void) const { return(xcrds); }
-  std::vector<dcd_real> DCD::ycoords(void) const { return(ycrds); }
-  std::vector<dcd_real> DCD::zcoords(void) const { return(zcrds); }
+  std::vector<dcd_real> DCD::xcoords(void) const { return(std::vector<dcd_real>(xdata(), xdata() + _natoms)); }
+  std::vector<dcd_real> DCD::ycoords(void) const { return(std::vector<dcd_real>(ydata(), ydata() + _natoms)); }
+  std::vector<dcd_real> DCD::zcoords(void) const { return(std::vector<dcd_real>(zdata(), zdata() + _natoms)); }
 
   // The following track CHARMm names (more or less...)
   unsigned int DCD::nsteps(void) const { return(_icntrl[3]); }
@@ -80,6 +89,8 @@ namespace loos {
     xcrds = std::vector<dcd_real>(n);
     ycrds = std::vector<dcd_real>(n);
     zcrds = std::vector<dcd_real>(n);
+
+    x_offset = y_offset = z_offset = 0;
   }
 
 
@@ -130,6 +141,8 @@ namespace loos {
   // Returns a pointer to the read data and puts the # of bytes read into *len
   // Returns a null pointer and 0 length at EOF
   // Note:  It is up to the caller to swab individual elements...
+  // Note:  The returned pointer is to an internal buffer that is reused
+  //        by the next call...
 
   DCD::DataOverlay* DCD::readF77Line(unsigned int *len) {
     DataOverlay* ptr;
@@ -140,7 +153,9 @@ namespace loos {
     if (n == 0)
       return(0);
     
-    ptr = new DataOverlay[n];
+    if (record_buffer.size() < n / sizeof(DataOverlay) + 1)
+      record_buffer.resize(n / sizeof(DataOverlay) + 1);
+    ptr = &record_buffer[0];
 
     ifs->read((char *)ptr, n);
     if (ifs->fail())
@@ -207,8 +222,6 @@ namespace loos {
     if (nfixed() != 0)
       throw(LOOSError("Fixed atoms not yet supported by LOOS DCD reader"));
 
-    delete[] ptr;
-
     // Now read in the TITLE info...
 
     ptr = readF77Line(&len);
@@ -227,7 +240,6 @@ namespace loos {
       std::string s(sbuff);
       _titles.push_back(s);
     }
-    delete[] ptr;
 
     // get the NATOMS...
     ptr = readF77Line(&len);
@@ -237,7 +249,6 @@ namespace loos {
       _natoms = swab(ptr->i);
     else
       _natoms = ptr->i;
-    delete[] ptr;
 
 
     // Finally, set internal variables and allocate space for a frame...
@@ -290,8 +301,6 @@ namespace loos {
         for (int i=0; i<6; ++i)
             qcrys[i] = swab(qcrys[i]);
 
-    delete[] o;
-
     return(true);
   }
 
@@ -320,8 +329,6 @@ namespace loos {
       else
         v[i] = op[i].f;
 
-    delete[] op;
-
     return(true);
   }
 
@@ -334,6 +341,11 @@ namespace loos {
     if (i >= nframes())
       throw(FileError(_filename, "Requested DCD frame is out of range"));
 
+    if (mapping || sparseReading()) {
+      frame_pos = first_frame_pos + static_cast<std::streamoff>(i) * frame_size;
+      return;
+    }
+
     ifs->clear();
     ifs->seekg(first_frame_pos + i * frame_size);
     if (ifs->fail() || ifs->bad())
@@ -351,6 +363,11 @@ namespace loos {
     if (first_frame_pos == 0)
       throw(FileReadError(_filename, "Trying to read a DCD frame without first having read the header."));
 
+    if (mapping)
+      return(parseMappedFrame());
+    if (sparseReading())
+      return(parseSparseFrame());
+
     // This will not catch most cases of reading to the end of the file...
     if (ifs->eof())
       return(false);
@@ -371,7 +388,299 @@ namespace loos {
   }
 
 
+  // ----------------------------------------------------------
+  // Memory-mapped I/O
+
+
+  // Fetch the F77 record length at pos in the mapping
+  unsigned int DCD::mappedRecordLen(const size_t pos) const {
+    unsigned int n;
+    memcpy(&n, mapping->data() + pos, sizeof(n));
+    if (swabbing)
+      n = swab(n);
+    return(n);
+  }
+
+
+  // Validates one record of coordinates beginning at pos, advancing
+  // pos past it.  Returns the offset of the coords in the mapping if
+  // they can be used in place.  Otherwise (they are not native-endian
+  // or not aligned), they are copied into v and 0 is returned...
+  size_t DCD::mappedCoordLine(size_t& pos, std::vector<dcd_real>& v) {
+    const unsigned int n = _natoms * sizeof(dcd_real);
+
+    if (mappedRecordLen(pos) != n)
+      throw(FileReadError(_filename, "Size of coords stored in frame does not match model size"));
+    if (mappedRecordLen(pos + 4 + n) != n)
+      throw(FileReadError(_filename, "Mismatch in record length while reading from DCD"));
+
+    const size_t offset = pos + 4;
+    const char* p = mapping->data() + offset;
+    pos += n + 8;
+
+    if (!swabbing && reinterpret_cast<uintptr_t>(p) % sizeof(dcd_real) == 0)
+      return(offset);
+
+    memcpy(&v[0], p, n);
+    if (swabbing)
+      for (uint i=0; i<_natoms; ++i)
+        v[i] = swab(v[i]);
+    return(0);
+  }
+
+
+  bool DCD::parseMappedFrame(void) {
+    size_t pos = frame_pos;
+
+    if (pos >= mapping->size())
+      return(false);
+    if (pos + frame_size > mapping->size())
+      throw(FileReadError(_filename, "Unexpected EOF reading frame from DCD"));
+
+    if (hasCrystalParams()) {
+      if (mappedRecordLen(pos) != 48 || mappedRecordLen(pos + 52) != 48)
+        throw(FileReadError(_filename, "Cannot read crystal parameters"));
+
+      double dp[6];
+      memcpy(dp, mapping->data() + pos + 4, sizeof(dp));
+      qcrys[0] = dp[0];
+      qcrys[1] = dp[2];
+      qcrys[2] = dp[5];
+      qcrys[3] = dp[1];
+      qcrys[4] = dp[3];
+      qcrys[5] = dp[4];
+
+      if (swabbing)
+        for (int i=0; i<6; ++i)
+          qcrys[i] = swab(qcrys[i]);
+
+      pos += 56;
+    }
+
+    x_offset = mappedCoordLine(pos, xcrds);
+    y_offset = mappedCoordLine(pos, ycrds);
+    z_offset = mappedCoordLine(pos, zcrds);
+
+    frame_pos = pos;
+    return(true);
+  }
+
+
+  // ----------------------------------------------------------
+  // Sparse I/O
+
+
+  static void closeDescriptor(int* fd) {
+    close(*fd);
+    delete fd;
+  }
+
+
+  void DCD::setSparseIndices(const std::vector<uint>& indices) {
+    if (mapping)
+      return;
+
+    std::vector<uint> sorted(indices);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    if (sorted.empty()) {
+      clearSparseIndices();
+      return;
+    }
+    if (sorted.back() >= _natoms)
+      throw(LOOSError("Atom index for sparse DCD reading is out of bounds"));
+
+    if (!sparse_fd) {
+      int fd = open(_filename.c_str(), O_RDONLY);
+      if (fd < 0)
+        throw(FileOpenError(_filename, strerror(errno), errno));
+      sparse_fd = boost::shared_ptr<int>(new int(fd), closeDescriptor);
+
+      struct stat st;
+      if (fstat(fd, &st) < 0)
+        throw(FileOpenError(_filename, strerror(errno), errno));
+      sparse_file_size = st.st_size;
+    }
+
+    // Pick up from wherever the stream currently is...
+    if (!sparseReading()) {
+      ifs->clear();
+      frame_pos = ifs->tellg();
+    }
+
+    // Build byte ranges within a coordinate record.  Both record
+    // lengths are always included so they can be checked.
+    sparse_indices = sorted;
+    sparse_ranges.clear();
+
+    sparse_mask.assign(_natoms, 0);
+    for (std::vector<uint>::const_iterator i = sparse_indices.begin(); i != sparse_indices.end(); ++i)
+      sparse_mask[*i] = 1;
+
+    off_t begin = 0;
+    off_t end = sizeof(unsigned int);
+    uint first = 0;
+    size_t longest = 0;
+    for (uint i=0; i<sparse_indices.size(); ++i) {
+      off_t offset = sizeof(unsigned int) + static_cast<off_t>(sparse_indices[i]) * sizeof(dcd_real);
+      if (offset - end > static_cast<off_t>(sparse_coalesce_bytes)) {
+        sparse_ranges.push_back(SparseRange(begin, end - begin, first, i));
+        longest = std::max(longest, static_cast<size_t>(end - begin));
+        begin = offset;
+        first = i;
+      }
+      end = offset + sizeof(dcd_real);
+    }
+
+    off_t trailer = sizeof(unsigned int) + static_cast<off_t>(_natoms) * sizeof(dcd_real);
+    if (trailer - end > static_cast<off_t>(sparse_coalesce_bytes)) {
+      sparse_ranges.push_back(SparseRange(begin, end - begin, first, sparse_indices.size()));
+      longest = std::max(longest, static_cast<size_t>(end - begin));
+      begin = trailer;
+      first = sparse_indices.size();
+    }
+    end = trailer + sizeof(unsigned int);
+    sparse_ranges.push_back(SparseRange(begin, end - begin, first, sparse_indices.size()));
+    longest = std::max(longest, static_cast<size_t>(end - begin));
+    sparse_buffer.resize(longest);
+  }
+
+
+  void DCD::setSparseIndices(const AtomicGroup& g) {
+    setSparseIndices(CoordinatePlan(g).uniqueIndices());
+  }
+
+
+  void DCD::clearSparseIndices(void) {
+    if (!sparseReading())
+      return;
+
+    sparse_indices.clear();
+    sparse_mask.clear();
+    sparse_ranges.clear();
+    sparse_buffer.clear();
+
+    // Put the stream where the next frame would have been read from
+    ifs->clear();
+    ifs->seekg(frame_pos);
+    if (ifs->fail() || ifs->bad())
+      throw(FileError(_filename, "Cannot seek to requested frame"));
+  }
+
+
+  void DCD::preadFully(void* buf, const size_t n, const off_t pos) {
+    char* p = static_cast<char*>(buf);
+    size_t done = 0;
+
+    while (done < n) {
+      ssize_t k = pread(*sparse_fd, p + done, n - done, pos + done);
+      if (k < 0) {
+        if (errno == EINTR)
+          continue;
+        throw(FileReadError(_filename, std::string("Error reading from DCD: ") + strerror(errno)));
+      }
+      if (k == 0)
+        throw(FileReadError(_filename, "Unexpected EOF reading frame from DCD"));
+      done += k;
+    }
+  }
+
+
+  // Reads the selected atoms from the coordinate record beginning at
+  // pos into v
+  void DCD::readSparseCoords(const off_t pos, std::vector<dcd_real>& v) {
+    const unsigned int n = _natoms * sizeof(dcd_real);
+
+    for (std::vector<SparseRange>::const_iterator r = sparse_ranges.begin(); r != sparse_ranges.end(); ++r) {
+      preadFully(&sparse_buffer[0], r->length, pos + r->offset);
+
+      if (r->offset == 0) {
+        unsigned int len;
+        memcpy(&len, &sparse_buffer[0], sizeof(len));
+        if (swabbing)
+          len = swab(len);
+        if (len != n)
+          throw(FileReadError(_filename, "Size of coords stored in frame does not match model size"));
+      }
+
+      if (static_cast<size_t>(r->offset) + r->length == n + 2 * sizeof(unsigned int)) {
+        unsigned int len;
+        memcpy(&len, &sparse_buffer[r->length - sizeof(len)], sizeof(len));
+        if (swabbing)
+          len = swab(len);
+        if (len != n)
+          throw(FileReadError(_filename, "Mismatch in record length while reading from DCD"));
+      }
+
+      for (uint i=r->first; i<r->last; ++i) {
+        uint idx = sparse_indices[i];
+        off_t offset = sizeof(unsigned int) + static_cast<off_t>(idx) * sizeof(dcd_real) - r->offset;
+        dcd_real d;
+        memcpy(&d, &sparse_buffer[offset], sizeof(d));
+        v[idx] = swabbing ? swab(d) : d;
+      }
+    }
+  }
+
+
+  bool DCD::parseSparseFrame(void) {
+    off_t pos = frame_pos;
+
+    if (pos >= sparse_file_size)
+      return(false);
+    if (pos + frame_size > sparse_file_size)
+      throw(FileReadError(_filename, "Unexpected EOF reading frame from DCD"));
+
+    if (hasCrystalParams()) {
+      char buf[56];
+      preadFully(buf, sizeof(buf), pos);
+
+      unsigned int n1, n2;
+      memcpy(&n1, buf, sizeof(n1));
+      memcpy(&n2, buf + 52, sizeof(n2));
+      if (swabbing) {
+        n1 = swab(n1);
+        n2 = swab(n2);
+      }
+      if (n1 != 48 || n2 != 48)
+        throw(FileReadError(_filename, "Cannot read crystal parameters"));
+
+      double dp[6];
+      memcpy(dp, buf + 4, sizeof(dp));
+      qcrys[0] = dp[0];
+      qcrys[1] = dp[2];
+      qcrys[2] = dp[5];
+      qcrys[3] = dp[1];
+      qcrys[4] = dp[3];
+      qcrys[5] = dp[4];
+
+      if (swabbing)
+        for (int i=0; i<6; ++i)
+          qcrys[i] = swab(qcrys[i]);
+
+      pos += 56;
+    }
+
+    const off_t record_size = _natoms * sizeof(dcd_real) + 8;
+    readSparseCoords(pos, xcrds);
+    readSparseCoords(pos + record_size, ycrds);
+    readSparseCoords(pos + 2 * record_size, zcrds);
+
+    frame_pos = pos + 3 * record_size;
+    return(true);
+  }
+
+
+  // ----------------------------------------------------------
+
+
   void DCD::rewindImpl(void) {
+    if (mapping || sparseReading()) {
+      frame_pos = first_frame_pos;
+      return;
+    }
+
     ifs->clear();
     ifs->seekg(first_frame_pos);
     if (ifs->fail() || ifs->bad())
@@ -383,27 +692,29 @@ namespace loos {
 
 
   std::vector<GCoord> DCD::coords(void) const {
+    const dcd_real *px = xdata(), *py = ydata(), *pz = zdata();
     std::vector<GCoord> crds(_natoms);
 
     for (uint i=0; i<_natoms; i++) {
-      crds[i].x(xcrds[i]);
-      crds[i].y(ycrds[i]);
-      crds[i].z(zcrds[i]);
+      crds[i].x(px[i]);
+      crds[i].y(py[i]);
+      crds[i].z(pz[i]);
     }
 
     return(crds);
   }
 
   std::vector<GCoord> DCD::mappedCoords(const std::vector<int>& indices) {
+    const dcd_real *px = xdata(), *py = ydata(), *pz = zdata();
     std::vector<int>::const_iterator iter;
     std::vector<GCoord> crds(indices.size());
 
     int j = 0;
     for (iter = indices.begin(); iter != indices.end(); iter++, j++) {
       int index = *iter;
-      crds[j].x(xcrds[index]);
-      crds[j].y(ycrds[index]);
-      crds[j].z(zcrds[index]);
+      crds[j].x(px[index]);
+      crds[j].y(py[index]);
+      crds[j].z(pz[index]);
     }
 
     return(crds);
@@ -411,11 +722,15 @@ namespace loos {
 
 
   void DCD::updateGroupCoordsImpl(AtomicGroup& g) {
+    const dcd_real *px = xdata(), *py = ydata(), *pz = zdata();
+    const bool sparse = sparseReading();
     for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
       uint idx = (*i)->index();
       if (idx >= _natoms)
         throw(LOOSError(**i, "Atom index into the trajectory frame is out of bounds"));
-      (*i)->coords(GCoord(xcrds[idx], ycrds[idx], zcrds[idx]));
+      if (sparse && !sparse_mask[idx])
+        continue;
+      (*i)->coords(GCoord(px[idx], py[idx], pz[idx]));
     }
 
     // Handle periodic boundary conditions (if present)
@@ -425,9 +740,31 @@ namespace loos {
   }
 
 
+  // Indices have already been validated against the frame size...
+  // When reading sparsely, atoms that were not read are skipped, so
+  // the frame buffers don't line up with the plan's indices...
+  void DCD::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+    if (sparseReading()) {
+      updateGroupCoordsImpl(g);
+      return;
+    }
+
+    plan.scatter(g, xdata(), ydata(), zdata());
+
+    if (hasPeriodicBox()) {
+      g.periodicBox(periodicBox());
+    }
+  }
+
+
 
-  void DCD::initTrajectory() {
+  void DCD::initTrajectory(const bool memory_mapped) {
         readHeader();
+        if (memory_mapped) {
+          mapping = pMappedFile(new MappedFile(_filename));
+          mapping->adviseSequential();
+          frame_pos = first_frame_pos;
+        }
         bool b = parseFrame();
         if (!b)
             throw(LOOSError("Cannot read first frame of DCD during initialization"));
@@ -28,11 +28,13 @@
 #include <iostream>
 #include <string>
 #include <stdexcept>
+#include <sys/types.h>
 #include <exception>
 
 #include <loos_defs.hpp>
 
 #include <Trajectory.hpp>
+#include <MappedFile.hpp>
 
 
 namespace loos {
@@ -59,6 +61,16 @@ namespace loos {
      *  - [Almost] everything returned is a copy
      *
      *  - Endian detection is based on the expected size of the header
+     *
+     *  - The DCD can be memory-mapped (see DCD(const std::string&, const bool)),
+     *    in which case frames are validated and read in place rather
+     *    than through the stream.  For native-endian files, the
+     *    coordinates are not copied at all until they are used.
+     *
+     *  - If only a few atoms are needed from a large system, the DCD
+     *    can be told which ones in advance (see setSparseIndices()).
+     *    Only the parts of each frame that hold those atoms are then
+     *    read from the file.
      */
     class DCD : public Trajectory {
         static bool suppress_warnings;
@@ -77,17 +89,25 @@ namespace loos {
         explicit DCD(const std::string s) :  Trajectory(s), _natoms(0), _nframes(0),
                                              qcrys(std::vector<double>(6)),
                                              frame_size(0), first_frame_pos(0),
-                                             swabbing(false) { initTrajectory(); }
+                                             swabbing(false), frame_pos(0), sparse_file_size(0) { initTrajectory(); }
+
+        //! Begin reading from the file named s, optionally memory-mapping it
+        DCD(const std::string& s, const bool memory_mapped) :  Trajectory(s), _natoms(0), _nframes(0),
+                                                               qcrys(std::vector<double>(6)),
+                                                               frame_size(0), first_frame_pos(0),
+                                                               swabbing(false), frame_pos(0), sparse_file_size(0) {
+          initTrajectory(memory_mapped);
+        }
 
         //! Begin reading from the file named s
         explicit DCD(const char* s) :  Trajectory(s), _natoms(0), _nframes(0),
                                        qcrys(std::vector<double>(6)), frame_size(0),
-                                       first_frame_pos(0), swabbing(false) { initTrajectory(); }
+                                       first_frame_pos(0), swabbing(false), frame_pos(0), sparse_file_size(0) { initTrajectory(); }
 
         //! Begin reading from the stream ifs
         explicit DCD(std::istream& fs) : Trajectory(fs), _natoms(0), _nframes(0),
                                          qcrys(std::vector<double>(6)), frame_size(0), first_frame_pos(0),
-                                         swabbing(false) { initTrajectory(); };
+                                         swabbing(false), frame_pos(0), sparse_file_size(0) { initTrajectory(); };
 
         std::string description() const { return("CHARMM/NAMD DCD"); }
 
@@ -95,6 +115,11 @@ namespace loos {
             return(pTraj(new DCD(fname)));
         }
 
+        //! Create a memory-mapped DCD
+        static pTraj createMapped(const std::string& fname, const AtomicGroup& model) {
+            return(pTraj(new DCD(fname, true)));
+        }
+
 
 
         // Accessor methods...
@@ -135,6 +160,46 @@ namespace loos {
         //! Returns true if the DCD file being read is in the native endian format
         bool nativeFormat(void) const;
 
+        //! Returns true if the DCD is being read through a memory mapping
+        bool memoryMapped(void) const { return(mapping.get() != 0); }
+
+        //! Only read the atoms with the given indices from each frame
+        /**
+         * Because every DCD frame is the same size, the location of
+         * any atom's coordinates in the file is known in advance.  Once
+         * the indices are set, each frame is read with pread() over
+         * just the byte ranges covering those atoms (nearby ranges are
+         * coalesced so the number of reads stays small).  Both record
+         * lengths around each coordinate block are still checked.
+         *
+         * While sparse reading is on, updateGroupCoords() only updates
+         * atoms whose indices were given; any other atoms in the group
+         * keep their coordinates.  In the frame buffers themselves
+         * (e.g. xcoords() and coords()), the atoms not read are left
+         * with whatever was last read for them, so those values
+         * should not be used.
+         *
+         * Memory-mapped DCDs already only touch the pages that are
+         * used, so this has no effect on them.  Passing an empty set
+         * of indices is the same as calling clearSparseIndices().
+         *
+         * Requires that the DCD was opened from a file rather than a
+         * stream.
+         */
+        void setSparseIndices(const std::vector<uint>& indices);
+
+        //! Only read the atoms in \a g from each frame
+        void setSparseIndices(const AtomicGroup& g);
+
+        //! Go back to reading whole frames
+        void clearSparseIndices(void);
+
+        //! Returns true if only a subset of atoms is being read
+        bool sparseReading(void) const { return(!sparse_indices.empty()); }
+
+        //! Sorted indices of atoms being read (empty if reading whole frames)
+        std::vector<uint> sparseIndices(void) const { return(sparse_indices); }
+
         //! Auto-interleave the coords into a vector of GCoord()'s.
         /*!  This can be a pretty slow operation, so be careful. */
 		virtual std::vector<GCoord> coords(void) const;
@@ -155,7 +220,7 @@ namespace loos {
         //! Read in the header from the stored stream
         void readHeader(void);
 
-        void initTrajectory();
+        void initTrajectory(const bool memory_mapped = false);
 
         uint calculateNumberOfFrames();
 
@@ -169,6 +234,7 @@ namespace loos {
 
         //! Update an AtomicGroup coordinates with the currently-read frame.
         virtual void updateGroupCoordsImpl(AtomicGroup& g);
+        virtual void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
 
 
 
@@ -176,6 +242,24 @@ namespace loos {
         bool readCrystalParams(void);
         bool readCoordLine(std::vector<float>& v);
 
+        // Memory-mapped equivalents of the above
+        bool parseMappedFrame(void);
+        unsigned int mappedRecordLen(const size_t pos) const;
+        size_t mappedCoordLine(size_t& pos, std::vector<dcd_real>& v);
+
+        // The current frame's coords
+        const dcd_real* coordData(const size_t offset, const std::vector<dcd_real>& v) const {
+          return(offset ? reinterpret_cast<const dcd_real*>(mapping->data() + offset) : &v[0]);
+        }
+        const dcd_real* xdata(void) const { return(coordData(x_offset, xcrds)); }
+        const dcd_real* ydata(void) const { return(coordData(y_offset, ycrds)); }
+        const dcd_real* zdata(void) const { return(coordData(z_offset, zcrds)); }
+
+        // Sparse (pread) equivalents
+        bool parseSparseFrame(void);
+        void readSparseCoords(const off_t pos, std::vector<dcd_real>& v);
+        void preadFully(void* buf, const size_t n, const off_t pos);
+
         void endianMatch(pStream& fsw);
 
         // For reading F77 I/O
@@ -199,6 +283,38 @@ namespace loos {
 
         std::vector<dcd_real> xcrds, ycrds, zcrds;
 
+        // Where the current frame's coords are in the memory-mapped
+        // file, or 0 if they are in the vectors above.  These are
+        // offsets rather than pointers so a copied DCD stays valid.
+        size_t x_offset, y_offset, z_offset;
+
+        std::vector<DataOverlay> record_buffer;   // Reused for each F77 record
+
+        pMappedFile mapping;
+        size_t frame_pos;         // Location of next frame when mapped or sparse
+
+        // A block of bytes read from each coordinate record when
+        // reading sparsely.  Offsets are relative to the start of the
+        // record (i.e. the leading record length).  The atoms covered
+        // are sparse_indices[first, last).  The first range always
+        // starts with the leading record length and the last always
+        // ends with the trailing one.
+        struct SparseRange {
+          SparseRange(const off_t o, const size_t n, const uint f, const uint l) : offset(o), length(n), first(f), last(l) { }
+          off_t offset;
+          size_t length;
+          uint first, last;
+        };
+
+        static const size_t sparse_coalesce_bytes;   // Gaps smaller than this are read through
+
+        std::vector<uint> sparse_indices;
+        std::vector<char> sparse_mask;                // Non-zero for atoms being read
+        std::vector<SparseRange> sparse_ranges;
+        std::vector<char> sparse_buffer;
+        boost::shared_ptr<int> sparse_fd;
+        off_t sparse_file_size;
+
     };
 
 }
@@ -58,16 +58,23 @@ namespace loos {
 
 
   void DCDWriter::writeHeader(void) {
+    writeHeaderRecords(_nsteps);
+    _header_frames = _nsteps;
+    _header_written = true;
+  }
+
+
+  void DCDWriter::writeHeaderRecords(const uint nframes) {
     unsigned int icntrl[21];
     DataOverlay *dop = (DataOverlay *)(&icntrl[0]);
     unsigned int i;
     for (i=0; i<21; i++)
       icntrl[i] = 0;
 
-    icntrl[1] = _nsteps;
+    icntrl[1] = nframes;
     icntrl[2] = 1;
     icntrl[3] = 1;
-    icntrl[4] = _nsteps;
+    icntrl[4] = nframes;
     icntrl[8] = _natoms * 3 - 6;
     icntrl[9] = 0;
     dop[10].f = _timestep;
@@ -91,17 +98,68 @@ namespace loos {
 
     dop[0].ui = _natoms;
     writeF77Line((char *)dop, 1 * sizeof(unsigned int));
+  }
+
 
+  // Rewrites the header in place, leaving the stream at the end of
+  // the file...
+  void DCDWriter::updateHeader(const uint nframes) {
+    stream_->seekp(0);
+    writeHeaderRecords(nframes);
+    stream_->seekp(0, std::ios_base::end);
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while re-writing DCD header"));
+
+    _header_frames = nframes;
     _header_written = true;
   }
 
 
 
-  void DCDWriter::writeBox(const GCoord& box) {
-    double xtal[6] = { box[0], default_unit_cell_angle, box[1],
-                       default_unit_cell_angle, default_unit_cell_angle, box[2] };
+  // Bytes used by one frame, including the F77 record markers
+  size_t DCDWriter::frameSize() const {
+    size_t n = 3 * (_natoms * sizeof(float) + 2 * sizeof(unsigned int));
+    if (_has_box)
+      n += 6 * sizeof(double) + 2 * sizeof(unsigned int);
+    return(n);
+  }
+
+
+  // Formats a frame (crystal record and the x, y, and z records) at
+  // dst, which must have room for frameSize() bytes
+  void DCDWriter::encodeFrame(const AtomicGroup& grp, char* dst) const {
+    unsigned int len;
 
-    writeF77Line((char *)xtal, 6*sizeof(double));
+    if (_has_box) {
+      GCoord box = grp.periodicBox();
+      double xtal[6] = { box[0], default_unit_cell_angle, box[1],
+                         default_unit_cell_angle, default_unit_cell_angle, box[2] };
+
+      len = sizeof(xtal);
+      memcpy(dst, &len, sizeof(len));
+      memcpy(dst + sizeof(len), xtal, len);
+      memcpy(dst + sizeof(len) + len, &len, sizeof(len));
+      dst += len + 2 * sizeof(len);
+    }
+
+    // The x, y, and z records are filled in together so each atom
+    // is only visited once
+    len = _natoms * sizeof(float);
+    size_t stride = len + 2 * sizeof(len);
+    for (uint k=0; k<3; ++k) {
+      memcpy(dst + k * stride, &len, sizeof(len));
+      memcpy(dst + k * stride + sizeof(len) + len, &len, sizeof(len));
+    }
+
+    float* x = reinterpret_cast<float*>(dst + sizeof(len));
+    float* y = reinterpret_cast<float*>(dst + stride + sizeof(len));
+    float* z = reinterpret_cast<float*>(dst + 2 * stride + sizeof(len));
+    for (uint i=0; i<_natoms; i++) {
+      const GCoord& c = grp[i]->coords();
+      x[i] = c.x();
+      y[i] = c.y();
+      z[i] = c.z();
+    }
   }
 
 
@@ -122,35 +180,91 @@ namespace loos {
 
     }
 
-    if (_current >= _nsteps) {
-      stream_->seekp(0);
-      ++_nsteps;
-      writeHeader();
-      stream_->seekp(0, std::ios_base::end);
+    size_t n = frameSize();
+
+    if (_buffer_bytes == 0) {
+      if (_current >= _nsteps)
+        updateHeader(++_nsteps);
+      else if (!_header_written)
+        writeHeader();
+
+      _buffer.resize(n);
+      encodeFrame(grp, &_buffer[0]);
+      stream_->write(&_buffer[0], n);
+      _buffer.clear();
+
+      stream_->flush();
       if (stream_->fail())
-        throw(FileWriteError(_filename, "Error while re-writing DCD header"));
+        throw(FileWriteError(_filename, "Error while writing DCD frame"));
+      ++_current;
+      return;
     }
 
-    if (_has_box)
-      writeBox(grp.periodicBox());
+    if (!_header_written)
+      writeHeader();
+
+    size_t m = _buffer.size();
+    _buffer.resize(m + n);
+    encodeFrame(grp, &_buffer[m]);
+    ++_staged;
+    ++_current;
+
+    if (_buffer.size() + n > _buffer_bytes)
+      writeStaged();
+  }
+
+
+  void DCDWriter::writeStaged() {
+    if (_staged == 0)
+      return;
+
+    // The header no longer describes the file, so mark the frame
+    // count as unknown until the true count is written by flush()
+    if (_current > _header_frames && _header_frames != 0)
+      updateHeader(0);
+
+    stream_->write(&_buffer[0], _buffer.size());
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing DCD frames"));
+
+    _buffer.clear();
+    _staged = 0;
+  }
 
-    float *data = new float[_natoms];
-    for (uint i=0; i<_natoms; i++)
-      data[i] = grp[i]->coords().x();
-    writeF77Line((char *)data, _natoms * sizeof(float));
 
-    for (uint i=0; i<_natoms; i++)
-      data[i] = grp[i]->coords().y();
-    writeF77Line((char *)data, _natoms * sizeof(float));
+  void DCDWriter::bufferOutput(const size_t nbytes) {
+    if (nbytes == 0)
+      flush();
+    _buffer_bytes = nbytes;
+  }
+
+
+  // Only touches the stream if there's something to write, so a
+  // writer with nothing pending can outlive a stream it was given
+  void DCDWriter::flush() {
+    if (!_header_written)
+      return;
 
-    for (uint i=0; i<_natoms; i++)
-      data[i] = grp[i]->coords().z();
-    writeF77Line((char *)data, _natoms * sizeof(float));
+    if (_current > _nsteps)
+      _nsteps = _current;
+    if (_staged == 0 && _header_frames == _nsteps)
+      return;
 
-    delete[] data;
+    writeStaged();
+    if (_header_frames != _nsteps)
+      updateHeader(_nsteps);
 
     stream_->flush();
-    ++_current;
+  }
+
+
+  DCDWriter::~DCDWriter() {
+    try {
+      flush();
+    }
+    catch(...) {
+      std::cerr << "Warning- error while finishing DCD '" << _filename << "'" << std::endl;
+    }
   }
 
 
@@ -172,6 +286,9 @@ namespace loos {
     _current = _nsteps = dcd.nframes();
     _titles = dcd.titles();
 
+    _header_frames = _nsteps;
+    _header_written = true;
+
     stream_->seekp(0, std::ios_base::end);
   }
 
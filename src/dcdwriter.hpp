@@ -72,7 +72,8 @@ namespace loos {
       _natoms(0), _nsteps(0),
       _timestep(0.001), _current(0),
       _has_box(false),
-      _header_written(false)
+      _header_written(false),
+      _header_frames(0), _buffer_bytes(0), _staged(0)
     {
       if (appending_)
 	prepareToAppend();
@@ -84,7 +85,8 @@ namespace loos {
     explicit DCDWriter(std::iostream& fs, const bool append = false) : 
       TrajectoryWriter(&fs, append),
       _natoms(0), _nsteps(0), _timestep(0.001), _current(0),
-      _has_box(false), _header_written(false)
+      _has_box(false), _header_written(false),
+      _header_frames(0), _buffer_bytes(0), _staged(0)
     {
       if (appending_)
 	prepareToAppend();
@@ -100,7 +102,8 @@ namespace loos {
       _timestep(1e-3),
       _current(0),
       _has_box(grps[0].isPeriodic()),
-      _header_written(false)
+      _header_written(false),
+      _header_frames(0), _buffer_bytes(0), _staged(0)
     {
       if (appending_)
 	prepareToAppend();
@@ -119,7 +122,8 @@ namespace loos {
       _timestep(1e-3),
       _current(0),
       _has_box(grps[0].isPeriodic()),
-      _header_written(false)
+      _header_written(false),
+      _header_frames(0), _buffer_bytes(0), _staged(0)
     {
       if (appending_)
 	prepareToAppend();
@@ -138,7 +142,8 @@ namespace loos {
       _timestep(1e-3),
       _current(0),
       _has_box(grps[0].isPeriodic()),
-      _header_written(false)
+      _header_written(false),
+      _header_frames(0), _buffer_bytes(0), _staged(0)
     {
       _titles = comments;
 
@@ -146,8 +151,8 @@ namespace loos {
       writeFrames(grps);
     }
 
-    ~DCDWriter() {
-    }
+    //! Writes any staged frames and finalizes the header
+    ~DCDWriter();
 
 
     //! Sets header parameters
@@ -206,12 +211,38 @@ namespace loos {
 
     void writeHeader(void);
 
+    //! Frames given to the writer, including any that are staged
     uint framesWritten(void) const { return(_current); }
 
+    //! Stage frames and write them in blocks of about \a nbytes
+    /**
+     * Writing a frame normally rewrites the header at the start of the
+     * file whenever the DCD grows, and flushes the stream.  With
+     * buffering, frames are instead copied into a reused buffer that
+     * is written with a single large write when full.  The header's
+     * frame count is set to 0 the first time the file grows past it
+     * (readers then count the frames from the file size, so a file
+     * left by a crash can still be read), and the true count is only
+     * written by flush() or when the writer is destroyed.
+     *
+     * At least one frame is always staged, and a size of 0 turns
+     * buffering off again.
+     */
+    void bufferOutput(const size_t nbytes = 64 * 1024 * 1024);
+
+    //! Writes any staged frames and updates the header's frame count
+    void flush();
+
   private:
     void writeF77Line(const char* const data, const unsigned int len); 
     std::string fixStringSize(const std::string& s, const unsigned int size);
-    void writeBox(const GCoord& box);
+
+    void writeHeaderRecords(const uint nframes);
+    void updateHeader(const uint nframes);
+
+    size_t frameSize() const;
+    void encodeFrame(const AtomicGroup& grp, char* dst) const;
+    void writeStaged();
 
     void prepareToAppend();
 
@@ -223,6 +254,11 @@ namespace loos {
     bool _has_box;
     bool _header_written;
     std::vector<std::string> _titles;
+
+    uint _header_frames;          // Frame count in the header on disk
+    size_t _buffer_bytes;         // 0 when frames are not staged
+    uint _staged;                 // Frames in _buffer not yet written
+    std::vector<char> _buffer;
   };
 
 }
@@ -23,66 +23,266 @@
 
 
 
+#include <algorithm>
+
 #include <ensembles.hpp>
 #include <XForm.hpp>
 #include <AtomicGroup.hpp>
 #include <Trajectory.hpp>
 #include <alignment.hpp>
+#include <SubsetCache.hpp>
+#include <CoordinateEnsemble.hpp>
+#include <CoordinatePlan.hpp>
+#include <FrameMapReduce.hpp>
 
 namespace loos {
 
-  // Assume all groups are already sorted or matched...
+  namespace {
 
-  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble) {
-    AtomicGroup avg = ensemble[0].copy();
+    // Each thread is given at least this many coordinates to work on,
+    // so small ensembles stay on the calling thread
+    const uint parallel_grain = 1u << 15;
 
-    // First, zap our coords...
-    int n = avg.size();
-    int i;
-    for (i=0; i<n; i++)
-      avg[i]->coords() = GCoord(0.0, 0.0, 0.0);
+    uint ensembleThreads(const uint nframes, const uint natoms, const uint nthreads) {
+      uint per_frame = natoms * 3;
+      uint grain = (per_frame >= parallel_grain) ? 1 : parallel_grain / std::max(per_frame, 1u);
+      return(internal::threadsFor(nframes, nthreads, grain));
+    }
+
+
+    // Sums the (optionally transformed) coordinates of each chunk of frames
+    // separately, so the totals can be combined in frame order afterwards
+
+    class GroupSummer {
+    public:
+      GroupSummer(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>* xforms, const uint nchunks)
+        : _ensemble(ensemble), _xforms(xforms), _sums(nchunks, std::vector<double>(ensemble[0].size() * 3, 0.0)) { }
+
+      void operator()(const uint chunk, const uint begin, const uint end) {
+        std::vector<double>& sum = _sums[chunk];
+        for (uint i=begin; i<end; ++i) {
+          const AtomicGroup& frame = _ensemble[i];
+          if (frame.size() * 3 != sum.size())
+            throw(LOOSError("Structures in the ensemble have different sizes"));
+
+          GMatrix W;
+          if (_xforms)
+            W = (*_xforms)[i].current();
+          for (uint j=0; j<frame.size(); ++j) {
+            GCoord c = _xforms ? W * frame[j]->coords() : frame[j]->coords();
+            sum[3*j] += c.x();
+            sum[3*j+1] += c.y();
+            sum[3*j+2] += c.z();
+          }
+        }
+      }
 
-    // Now, accumulate...
-    std::vector<AtomicGroup>::const_iterator j;
-    for (j = ensemble.begin(); j != ensemble.end(); j++) {
-      for (i = 0; i<n; i++)
-        avg[i]->coords() += (*j)[i]->coords();
+      const std::vector< std::vector<double> >& sums() const { return(_sums); }
+
+    private:
+      const std::vector<AtomicGroup>& _ensemble;
+      const std::vector<XForm>* _xforms;
+      std::vector< std::vector<double> > _sums;
+    };
+
+
+    class FrameSummer {
+    public:
+      FrameSummer(const CoordinateEnsemble& ensemble, const std::vector<XForm>* xforms, const uint nchunks)
+        : _ensemble(ensemble), _xforms(xforms), _sums(nchunks, std::vector<double>(ensemble.natoms() * 3, 0.0)) { }
+
+      void operator()(const uint chunk, const uint begin, const uint end) {
+        std::vector<double>& sum = _sums[chunk];
+        const uint n = _ensemble.natoms();
+        for (uint i=begin; i<end; ++i) {
+          const float* p = _ensemble.frame(i);
+          if (_xforms) {
+            GMatrix W = (*_xforms)[i].current();
+            for (uint j=0; j<n; ++j) {
+              GCoord c = W * GCoord(p[3*j], p[3*j+1], p[3*j+2]);
+              sum[3*j] += c.x();
+              sum[3*j+1] += c.y();
+              sum[3*j+2] += c.z();
+            }
+          } else
+            for (uint j=0; j<3*n; ++j)
+              sum[j] += p[j];
+        }
+      }
+
+      const std::vector< std::vector<double> >& sums() const { return(_sums); }
+
+    private:
+      const CoordinateEnsemble& _ensemble;
+      const std::vector<XForm>* _xforms;
+      std::vector< std::vector<double> > _sums;
+    };
+
+
+    // Copy of the model holding the combined sums divided by n
+    AtomicGroup averageFromSums(const AtomicGroup& model, const std::vector< std::vector<double> >& sums, const uint n) {
+      AtomicGroup avg = model.copy();
+      for (uint j=0; j<avg.size(); ++j) {
+        GCoord c(0.0, 0.0, 0.0);
+        for (uint k=0; k<sums.size(); ++k)
+          c += GCoord(sums[k][3*j], sums[k][3*j+1], sums[k][3*j+2]);
+        avg[j]->coords(c / n);
+      }
+
+      avg.removePeriodicBox();
+      return(avg);
     }
 
-    for (i=0; i<n; i++)
-      avg[i]->coords() /= ensemble.size();
 
-    avg.removePeriodicBox();
-    return(avg);
+    class GroupTransformer {
+    public:
+      GroupTransformer(std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms)
+        : _ensemble(ensemble), _xforms(xforms) { }
+
+      void operator()(const uint, const uint begin, const uint end) {
+        for (uint i=begin; i<end; ++i)
+          _ensemble[i].applyTransform(_xforms[i]);
+      }
+
+    private:
+      std::vector<AtomicGroup>& _ensemble;
+      const std::vector<XForm>& _xforms;
+    };
+
+
+    class FrameTransformer {
+    public:
+      FrameTransformer(CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms)
+        : _ensemble(ensemble), _xforms(xforms) { }
+
+      void operator()(const uint, const uint begin, const uint end) {
+        for (uint i=begin; i<end; ++i)
+          _ensemble.applyTransform(i, _xforms[i]);
+      }
+
+    private:
+      CoordinateEnsemble& _ensemble;
+      const std::vector<XForm>& _xforms;
+    };
+
+
+    // Fills columns of a coordinate matrix from either kind of ensemble
+
+    class GroupExtractor {
+    public:
+      GroupExtractor(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>* xforms, RealMatrix& M)
+        : _ensemble(ensemble), _xforms(xforms), _M(M) { }
+
+      void operator()(const uint, const uint begin, const uint end) {
+        const uint m = _M.rows() / 3;
+        for (uint i=begin; i<end; ++i) {
+          const AtomicGroup& frame = _ensemble[i];
+          if (frame.size() != m)
+            throw(LOOSError("Structures in the ensemble have different sizes"));
+
+          GMatrix W;
+          if (_xforms)
+            W = (*_xforms)[i].current();
+          for (uint j=0; j<m; ++j) {
+            GCoord c = _xforms ? W * frame[j]->coords() : frame[j]->coords();
+            _M(3*j, i) = c.x();
+            _M(3*j+1, i) = c.y();
+            _M(3*j+2, i) = c.z();
+          }
+        }
+      }
+
+    private:
+      const std::vector<AtomicGroup>& _ensemble;
+      const std::vector<XForm>* _xforms;
+      RealMatrix& _M;
+    };
+
+
+    class FrameExtractor {
+    public:
+      FrameExtractor(const CoordinateEnsemble& ensemble, const std::vector<XForm>* xforms, RealMatrix& M)
+        : _ensemble(ensemble), _xforms(xforms), _M(M) { }
+
+      void operator()(const uint, const uint begin, const uint end) {
+        const uint m = _ensemble.natoms();
+        for (uint i=begin; i<end; ++i) {
+          const float* p = _ensemble.frame(i);
+          float* col = _M.get() + static_cast<ulong>(i) * 3 * m;
+          if (_xforms) {
+            GMatrix W = (*_xforms)[i].current();
+            for (uint j=0; j<m; ++j) {
+              GCoord c = W * GCoord(p[3*j], p[3*j+1], p[3*j+2]);
+              col[3*j] = c.x();
+              col[3*j+1] = c.y();
+              col[3*j+2] = c.z();
+            }
+          } else
+            std::copy(p, p + 3*m, col);
+        }
+      }
+
+    private:
+      const CoordinateEnsemble& _ensemble;
+      const std::vector<XForm>* _xforms;
+      RealMatrix& _M;
+    };
+
   }
 
 
+  // Assume all groups are already sorted or matched...
 
-  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms) {
+  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const uint nthreads) {
+    if (ensemble.empty())
+      throw(LOOSError("Cannot average an empty ensemble in loos::averageStructure()"));
+
+    uint nchunks = ensembleThreads(ensemble.size(), ensemble[0].size(), nthreads);
+    GroupSummer summer(ensemble, 0, nchunks);
+    internal::parallelChunks(ensemble.size(), nchunks, summer);
+
+    return(averageFromSums(ensemble[0], summer.sums(), ensemble.size()));
+  }
+
+
+
+  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms, const uint nthreads) {
     if (xforms.size() != ensemble.size())
       throw(LOOSError("Transforms do not match the passed ensemble in loos::averageStructure()"));
+    if (ensemble.empty())
+      throw(LOOSError("Cannot average an empty ensemble in loos::averageStructure()"));
 
-    AtomicGroup avg = ensemble[0].copy();
+    uint nchunks = ensembleThreads(ensemble.size(), ensemble[0].size(), nthreads);
+    GroupSummer summer(ensemble, &xforms, nchunks);
+    internal::parallelChunks(ensemble.size(), nchunks, summer);
 
-    // First, zap our coords...
-    int n = avg.size();
-    int i;
-    for (i=0; i<n; i++)
-      avg[i]->coords() = GCoord(0.0, 0.0, 0.0);
+    return(averageFromSums(ensemble[0], summer.sums(), ensemble.size()));
+  }
 
-    // Now, accumulate...
-    for (uint j=0; j<ensemble.size(); ++j) {
-      AtomicGroup frame = ensemble[j].copy();
-      frame.applyTransform(xforms[j]);
-      for (i = 0; i<n; i++)
-        avg[i]->coords() += frame[i]->coords();
-    }
-    
-    for (i=0; i<n; i++)
-      avg[i]->coords() /= ensemble.size();
 
-    avg.removePeriodicBox();
-    return(avg);
+  AtomicGroup averageStructure(const CoordinateEnsemble& ensemble, const uint nthreads) {
+    if (ensemble.empty())
+      throw(LOOSError("Cannot average an empty ensemble in loos::averageStructure()"));
+
+    uint nchunks = ensembleThreads(ensemble.size(), ensemble.natoms(), nthreads);
+    FrameSummer summer(ensemble, 0, nchunks);
+    internal::parallelChunks(ensemble.size(), nchunks, summer);
+
+    return(averageFromSums(ensemble.model(), summer.sums(), ensemble.size()));
+  }
+
+
+  AtomicGroup averageStructure(const CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads) {
+    if (xforms.size() != ensemble.size())
+      throw(LOOSError("Transforms do not match the passed ensemble in loos::averageStructure()"));
+    if (ensemble.empty())
+      throw(LOOSError("Cannot average an empty ensemble in loos::averageStructure()"));
+
+    uint nchunks = ensembleThreads(ensemble.size(), ensemble.natoms(), nthreads);
+    FrameSummer summer(ensemble, &xforms, nchunks);
+    internal::parallelChunks(ensemble.size(), nchunks, summer);
+
+    return(averageFromSums(ensemble.model(), summer.sums(), ensemble.size()));
   }
 
 
@@ -137,22 +337,52 @@ namespace loos {
 
 
 
-  void applyTransforms(std::vector<AtomicGroup>& ensemble, std::vector<XForm>& xforms) {
+  AtomicGroup averageStructure(const AtomicGroup& g, const std::vector<XForm>& xforms, const SubsetCache& cache) {
+    if (cache.natoms() != g.size())
+      throw(LOOSError("SubsetCache does not match the passed group in loos::averageStructure()"));
+    if (cache.nframes() != xforms.size())
+      throw(LOOSError("Mismatch in number of cached frames and passed transforms for loos::averageStructure()"));
+
+    FrameSummer summer(cache.ensemble(), &xforms, 1);
+    summer(0, 0, cache.nframes());
+
+    return(averageFromSums(g, summer.sums(), cache.nframes()));
+  }
+
+
+
+  void applyTransforms(std::vector<AtomicGroup>& ensemble, std::vector<XForm>& xforms, const uint nthreads) {
     uint n = ensemble.size();
     if (n != xforms.size())
       throw(std::runtime_error("Mismatch in the size of the ensemble and the transformations"));
+    if (n == 0)
+      return;
 
-    for (uint i=0; i<n; ++i)
-      ensemble[i].applyTransform(xforms[i]);
+    GroupTransformer transformer(ensemble, xforms);
+    internal::parallelChunks(n, ensembleThreads(n, ensemble[0].size(), nthreads), transformer);
+  }
+
+
+  void applyTransforms(CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads) {
+    uint n = ensemble.size();
+    if (n != xforms.size())
+      throw(std::runtime_error("Mismatch in the size of the ensemble and the transformations"));
+    if (n == 0)
+      return;
+
+    ensemble.unmap();
+    FrameTransformer transformer(ensemble, xforms);
+    internal::parallelChunks(n, ensembleThreads(n, ensemble.natoms(), nthreads), transformer);
   }
 
 
 
   void readTrajectory(std::vector<AtomicGroup>& ensemble, const AtomicGroup& model, pTraj trajectory) {
     AtomicGroup clone = model.copy();
-    
+    CoordinatePlan plan(clone);
+
     while (trajectory->readFrame()) {
-      trajectory->updateGroupCoords(clone);
+      trajectory->updateGroupCoords(clone, plan);
       AtomicGroup frame = clone.copy();
       ensemble.push_back(frame);
     }
@@ -161,37 +391,67 @@ namespace loos {
 
   void readTrajectory(std::vector<AtomicGroup>& ensemble, const AtomicGroup& model, pTraj trajectory, std::vector<uint>& frames) {
     AtomicGroup clone = model.copy();
-    
+    CoordinatePlan plan(clone);
+
     std::vector<uint>::iterator i;
     for (i = frames.begin(); i != frames.end(); ++i) {
       if (*i >= trajectory->nframes())
         throw(std::runtime_error("Frame index exceeds trajectory size in readTrajectory()"));
       trajectory->readFrame(*i);
-      trajectory->updateGroupCoords(clone);
+      trajectory->updateGroupCoords(clone, plan);
       AtomicGroup frame = clone.copy();
       ensemble.push_back(frame);
     }
   }
 
 
+  // An empty ensemble takes its topology (and periodicity) from the
+  // model as it is after reading the first frame
 
-  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble) {
+  void readTrajectory(CoordinateEnsemble& ensemble, const AtomicGroup& model, pTraj trajectory) {
+    AtomicGroup clone = model.copy();
+    CoordinatePlan plan(clone);
+
+    ensemble.reserve(ensemble.size() + trajectory->nframes());
+    while (trajectory->readFrame()) {
+      trajectory->updateGroupCoords(clone, plan);
+      if (ensemble.empty())
+        ensemble = CoordinateEnsemble(clone);
+      ensemble.append(clone);
+    }
+  }
+
+
+  void readTrajectory(CoordinateEnsemble& ensemble, const AtomicGroup& model, pTraj trajectory, const std::vector<uint>& frames) {
+    AtomicGroup clone = model.copy();
+    CoordinatePlan plan(clone);
+
+    ensemble.reserve(ensemble.size() + frames.size());
+    for (std::vector<uint>::const_iterator i = frames.begin(); i != frames.end(); ++i) {
+      if (*i >= trajectory->nframes())
+        throw(std::runtime_error("Frame index exceeds trajectory size in readTrajectory()"));
+      trajectory->readFrame(*i);
+      trajectory->updateGroupCoords(clone, plan);
+      if (ensemble.empty())
+        ensemble = CoordinateEnsemble(clone);
+      ensemble.append(clone);
+    }
+  }
+
+
+
+  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const uint nthreads) {
     uint n = ensemble.size();
     uint m = ensemble[0].size();
     RealMatrix M(3*m, n);
 
-    for (uint i=0; i<n; ++i)
-      for (uint j=0; j<m; ++j) {
-        M(3*j, i) = ensemble[i][j]->coords().x();
-        M(3*j+1, i) = ensemble[i][j]->coords().y();
-        M(3*j+2, i) = ensemble[i][j]->coords().z();
-      }
-
+    GroupExtractor extractor(ensemble, 0, M);
+    internal::parallelChunks(n, ensembleThreads(n, m, nthreads), extractor);
     return(M);
   }
 
 
-  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms) {
+  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms, const uint nthreads) {
     uint n = ensemble.size();
 
     if (n != xforms.size())
@@ -200,17 +460,34 @@ namespace loos {
     uint m = ensemble[0].size();
     RealMatrix M(3*m, n);
 
-    for (uint i=0; i<n; ++i) {
-      GMatrix W = xforms[i].current();
+    GroupExtractor extractor(ensemble, &xforms, M);
+    internal::parallelChunks(n, ensembleThreads(n, m, nthreads), extractor);
+    return(M);
+  }
 
-      for (uint j=0; j<m; ++j) {
-        GCoord c = W * ensemble[i][j]->coords();
-        M(3*j, i) = c.x();
-        M(3*j+1, i) = c.y();
-        M(3*j+2, i) = c.z();
-      }
-    }
 
+  RealMatrix extractCoords(const CoordinateEnsemble& ensemble, const uint nthreads) {
+    uint n = ensemble.size();
+    uint m = ensemble.natoms();
+    RealMatrix M(3*m, n);
+
+    FrameExtractor extractor(ensemble, 0, M);
+    internal::parallelChunks(n, ensembleThreads(n, m, nthreads), extractor);
+    return(M);
+  }
+
+
+  RealMatrix extractCoords(const CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads) {
+    uint n = ensemble.size();
+
+    if (n != xforms.size())
+      throw(std::runtime_error("Mismatch between the size of the ensemble and the transformations"));
+
+    uint m = ensemble.natoms();
+    RealMatrix M(3*m, n);
+
+    FrameExtractor extractor(ensemble, &xforms, M);
+    internal::parallelChunks(n, ensembleThreads(n, m, nthreads), extractor);
     return(M);
   }
 
@@ -250,6 +527,19 @@ namespace loos {
   }
 
 
+  boost::tuple<RealMatrix, RealMatrix, RealMatrix> svd(CoordinateEnsemble& ensemble, bool align) {
+
+    if (align)
+      iterativeAlignment(ensemble);
+
+    RealMatrix M = extractCoords(ensemble);
+
+    subtractAverage(M);
+    boost::tuple<RealMatrix, RealMatrix, RealMatrix> res = Math::svd(M);
+    return(res);
+  }
+
+
   void appendCoords(std::vector< std::vector<double> >& M, AtomicGroup& model, pTraj& traj, const std::vector<uint>& indices, const bool updates = false) {
     
     uint l = indices.size();
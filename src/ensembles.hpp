@@ -39,15 +39,26 @@
 
 namespace loos {
   class XForm;
+  class SubsetCache;
+  class CoordinateEnsemble;
+
+  /*
+   * Functions below that take an nthreads argument can split the
+   * frames over that many threads (0 means one per core).  Small
+   * ensembles are handled on the calling thread.  The default is one
+   * thread, since sums taken in parallel are added in a different
+   * order (and so can differ in the last few digits), and tools
+   * usually have threads of their own to account for.
+   */
 
   //! Compute the average structure of a set of AtomicGroup objects
-  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble);
+  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const uint nthreads = 1);
 
   //! Compute the average structure of a set of AtomicGroup objects
   /**
    * Takes into consideration the passed set of transforms...
    */
-  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms);
+  AtomicGroup averageStructure(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms, const uint nthreads = 1);
 
   //! Compute the average structure from a trajectory reading only certain frames
   /**
@@ -64,19 +75,51 @@ namespace loos {
     */
   AtomicGroup averageStructure(const AtomicGroup&, const std::vector<XForm>&, pTraj& traj);
 
+#if !defined(SWIG)
+  //! Compute the average structure from the frames held in a SubsetCache
+  /**
+   * The group supplies the atoms for the returned structure and must
+   * be the one the cache was built from.  There must be one transform
+   * per cached frame.
+   */
+  AtomicGroup averageStructure(const AtomicGroup&, const std::vector<XForm>&, const SubsetCache& cache);
+#endif
+
 
-  void applyTransforms(std::vector<AtomicGroup>& ensemble, std::vector<XForm>& xforms);
+  //! Applies each transform to the matching structure in the ensemble
+  /**
+   * Only use more than one thread when no two structures share atoms
+   * (e.g. each is a copy(), as readTrajectory() makes).
+   */
+  void applyTransforms(std::vector<AtomicGroup>& ensemble, std::vector<XForm>& xforms, const uint nthreads = 1);
 
   void readTrajectory(std::vector<AtomicGroup>& ensemble, const AtomicGroup& model, pTraj trajectory);
   void readTrajectory(std::vector<AtomicGroup>& ensemble, const AtomicGroup& model, pTraj trajectory, std::vector<uint>& frames);
 
+#if !defined(SWIG)
+  //! Compute the average structure of a CoordinateEnsemble
+  AtomicGroup averageStructure(const CoordinateEnsemble& ensemble, const uint nthreads = 1);
+
+  //! Compute the average structure of a CoordinateEnsemble after applying the transforms
+  AtomicGroup averageStructure(const CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads = 1);
+
+  void applyTransforms(CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads = 1);
+
+  //! Append every frame of \a trajectory to the ensemble (only the coordinates of \a model are stored)
+  void readTrajectory(CoordinateEnsemble& ensemble, const AtomicGroup& model, pTraj trajectory);
+  void readTrajectory(CoordinateEnsemble& ensemble, const AtomicGroup& model, pTraj trajectory, const std::vector<uint>& frames);
+#endif
+
 
 
 
   
 #if !defined(SWIG)
-  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble);
-  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms);
+  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const uint nthreads = 1);
+  RealMatrix extractCoords(const std::vector<AtomicGroup>& ensemble, const std::vector<XForm>& xforms, const uint nthreads = 1);
+
+  RealMatrix extractCoords(const CoordinateEnsemble& ensemble, const uint nthreads = 1);
+  RealMatrix extractCoords(const CoordinateEnsemble& ensemble, const std::vector<XForm>& xforms, const uint nthreads = 1);
 
   void subtractAverage(RealMatrix& M);
 
@@ -86,6 +129,7 @@ namespace loos {
    * is iteratively aligned prior to computing the SVD.
    */
   boost::tuple<RealMatrix, RealMatrix, RealMatrix> svd(std::vector<AtomicGroup>& ensemble, const bool align = true);
+  boost::tuple<RealMatrix, RealMatrix, RealMatrix> svd(CoordinateEnsemble& ensemble, const bool align = true);
 
 
 
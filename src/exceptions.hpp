@@ -228,6 +228,7 @@ namespace loos {
     FileWriteError() : FileError("writing to") { }
     FileWriteError(const std::string& fname) : FileError("writing to", fname) {}
     FileWriteError(const std::string& fname, const std::string& msg) : FileError("writing to", fname, '\n' + msg) {}
+    FileWriteError(const std::string& fname, const std::string& msg, const int err) : FileError("writing to", fname, '\n' + msg, err) {}
   };
   
 
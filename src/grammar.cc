@@ -1,41 +1,43 @@
-/* A Bison parser, made by GNU Bison 2.7.  */
-
-/* Skeleton implementation for Bison LALR(1) parsers in C++
-   
-      Copyright (C) 2002-2012 Free Software Foundation, Inc.
-   
-   This program is free software: you can redistribute it and/or modify
-   it under the terms of the GNU General Public License as published by
-   the Free Software Foundation, either version 3 of the License, or
-   (at your option) any later version.
-   
-   This program is distributed in the hope that it will be useful,
-   but WITHOUT ANY WARRANTY; without even the implied warranty of
-   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-   GNU General Public License for more details.
-   
-   You should have received a copy of the GNU General Public License
-   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
-
-/* As a special exception, you may create a larger work that contains
-   part or all of the Bison parser skeleton and distribute that work
-   under terms of your choice, so long as that work isn't itself a
-   parser generator using the skeleton or a modified version thereof
-   as a parser skeleton.  Alternatively, if you modify or redistribute
-   the parser skeleton itself, you may (at your option) remove this
-   special exception, which will cause the skeleton and the resulting
-   Bison output files to be licensed under the GNU General Public
-   License without this special exception.
-   
-   This special exception was added by the Free Software Foundation in
-   version 2.2 of Bison.  */
-
-// Take the name prefix into account.
-#define yylex   looslex
-
-/* First part of user declarations.  */
-/* Line 279 of lalr1.cc  */
-#line 6 "grammar.yy"
+// A Bison parser, made by GNU Bison 3.8.2.
+
+// Skeleton implementation for Bison LALR(1) parsers in C++
+
+// Copyright (C) 2002-2015, 2018-2021 Free Software Foundation, Inc.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// As a special exception, you may create a larger work that contains
+// part or all of the Bison parser skeleton and distribute that work
+// under terms of your choice, so long as that work isn't itself a
+// parser generator using the skeleton or a modified version thereof
+// as a parser skeleton.  Alternatively, if you modify or redistribute
+// the parser skeleton itself, you may (at your option) remove this
+// special exception, which will cause the skeleton and the resulting
+// Bison output files to be licensed under the GNU General Public
+// License without this special exception.
+
+// This special exception was added by the Free Software Foundation in
+// version 2.2 of Bison.
+
+// DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+// especially those whose name start with YY_ or yy_.  They are
+// private implementation details that can be changed or removed.
+
+
+
+// First part of user prologue.
+#line 8 "grammar.yy"
 
 
 #include <ctype.h>
@@ -51,15 +53,13 @@ namespace loos {
 
 
 
-/* Line 279 of lalr1.cc  */
-#line 56 "grammar.cc"
+#line 57 "grammar.cc"
 
 
 #include "grammar.hh"
 
-/* User implementation prologue.  */
-/* Line 285 of lalr1.cc  */
-#line 30 "grammar.yy"
+// Second part of user prologue.
+#line 33 "grammar.yy"
 
 
 #include "ParserDriver.hpp"
@@ -68,7 +68,7 @@ namespace loos {
 #include "Kernel.hpp"
 
 #undef yylex
-#define yylex driver.lexer->looslex
+#define yylex(yylval, yylloc) driver.lexer->looslex(yylval)
 
 
 namespace loos {
@@ -76,22 +76,14 @@ namespace loos {
 };
 
 
-/* Line 285 of lalr1.cc  */
-#line 81 "grammar.cc"
+#line 80 "grammar.cc"
 
 
-# ifndef YY_NULL
-#  if defined __cplusplus && 201103L <= __cplusplus
-#   define YY_NULL nullptr
-#  else
-#   define YY_NULL 0
-#  endif
-# endif
 
 #ifndef YY_
 # if defined YYENABLE_NLS && YYENABLE_NLS
 #  if ENABLE_NLS
-#   include <libintl.h> /* FIXME: INFRINGES ON USER NAME SPACE */
+#   include <libintl.h> // FIXME: INFRINGES ON USER NAME SPACE.
 #   define YY_(msgid) dgettext ("bison-runtime", msgid)
 #  endif
 # endif
@@ -100,7 +92,17 @@ namespace loos {
 # endif
 #endif
 
-#define YYRHSLOC(Rhs, K) ((Rhs)[K])
+
+// Whether we are compiled with exception support.
+#ifndef YY_EXCEPTIONS
+# if defined __GNUC__ && !defined __EXCEPTIONS
+#  define YY_EXCEPTIONS 0
+# else
+#  define YY_EXCEPTIONS 1
+# endif
+#endif
+
+#define YYRHSLOC(Rhs, K) ((Rhs)[K].location)
 /* YYLLOC_DEFAULT -- Set CURRENT to span from RHS[1] to RHS[N].
    If N is 0, then set CURRENT to the empty location which ends
    the previous symbol: RHS[0] (always defined).  */
@@ -117,172 +119,345 @@ namespace loos {
         {                                                               \
           (Current).begin = (Current).end = YYRHSLOC (Rhs, 0).end;      \
         }                                                               \
-    while (/*CONSTCOND*/ false)
+    while (false)
 # endif
 
 
-/* Suppress unused-variable warnings by "using" E.  */
-#define YYUSE(e) ((void) (e))
-
-/* Enable debugging if requested.  */
+// Enable debugging if requested.
 #if YYDEBUG
 
-/* A pseudo ostream that takes yydebug_ into account.  */
+// A pseudo ostream that takes yydebug_ into account.
 # define YYCDEBUG if (yydebug_) (*yycdebug_)
 
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location)	\
-do {							\
-  if (yydebug_)						\
-    {							\
-      *yycdebug_ << Title << ' ';			\
-      yy_symbol_print_ ((Type), (Value), (Location));	\
-      *yycdebug_ << std::endl;				\
-    }							\
-} while (false)
-
-# define YY_REDUCE_PRINT(Rule)		\
-do {					\
-  if (yydebug_)				\
-    yy_reduce_print_ (Rule);		\
-} while (false)
-
-# define YY_STACK_PRINT()		\
-do {					\
-  if (yydebug_)				\
-    yystack_print_ ();			\
-} while (false)
-
-#else /* !YYDEBUG */
+# define YY_SYMBOL_PRINT(Title, Symbol)         \
+  do {                                          \
+    if (yydebug_)                               \
+    {                                           \
+      *yycdebug_ << Title << ' ';               \
+      yy_print_ (*yycdebug_, Symbol);           \
+      *yycdebug_ << '\n';                       \
+    }                                           \
+  } while (false)
+
+# define YY_REDUCE_PRINT(Rule)          \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_reduce_print_ (Rule);          \
+  } while (false)
+
+# define YY_STACK_PRINT()               \
+  do {                                  \
+    if (yydebug_)                       \
+      yy_stack_print_ ();                \
+  } while (false)
+
+#else // !YYDEBUG
 
 # define YYCDEBUG if (false) std::cerr
-# define YY_SYMBOL_PRINT(Title, Type, Value, Location) YYUSE(Type)
-# define YY_REDUCE_PRINT(Rule)        static_cast<void>(0)
-# define YY_STACK_PRINT()             static_cast<void>(0)
+# define YY_SYMBOL_PRINT(Title, Symbol)  YY_USE (Symbol)
+# define YY_REDUCE_PRINT(Rule)           static_cast<void> (0)
+# define YY_STACK_PRINT()                static_cast<void> (0)
 
-#endif /* !YYDEBUG */
+#endif // !YYDEBUG
 
-#define yyerrok		(yyerrstatus_ = 0)
-#define yyclearin	(yychar = yyempty_)
+#define yyerrok         (yyerrstatus_ = 0)
+#define yyclearin       (yyla.clear ())
 
-#define YYACCEPT	goto yyacceptlab
-#define YYABORT		goto yyabortlab
-#define YYERROR		goto yyerrorlab
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
 #define YYRECOVERING()  (!!yyerrstatus_)
 
-
+#line 5 "grammar.yy"
 namespace loos {
-/* Line 353 of lalr1.cc  */
-#line 176 "grammar.cc"
+#line 174 "grammar.cc"
 
   /// Build a parser object.
   parser::parser (ParserDriver& driver_yyarg)
-    :
 #if YYDEBUG
-      yydebug_ (false),
+    : yydebug_ (false),
       yycdebug_ (&std::cerr),
+#else
+    :
 #endif
       driver (driver_yyarg)
+  {}
+
+  parser::~parser ()
+  {}
+
+  parser::syntax_error::~syntax_error () YY_NOEXCEPT YY_NOTHROW
+  {}
+
+  /*---------.
+  | symbol.  |
+  `---------*/
+
+  // basic_symbol.
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (const basic_symbol& that)
+    : Base (that)
+    , value (that.value)
+    , location (that.location)
+  {}
+
+
+  /// Constructor for valueless symbols.
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (typename Base::kind_type t, YY_MOVE_REF (location_type) l)
+    : Base (t)
+    , value ()
+    , location (l)
+  {}
+
+  template <typename Base>
+  parser::basic_symbol<Base>::basic_symbol (typename Base::kind_type t, YY_RVREF (value_type) v, YY_RVREF (location_type) l)
+    : Base (t)
+    , value (YY_MOVE (v))
+    , location (YY_MOVE (l))
+  {}
+
+
+  template <typename Base>
+  parser::symbol_kind_type
+  parser::basic_symbol<Base>::type_get () const YY_NOEXCEPT
   {
+    return this->kind ();
   }
 
-  parser::~parser ()
+
+  template <typename Base>
+  bool
+  parser::basic_symbol<Base>::empty () const YY_NOEXCEPT
   {
+    return this->kind () == symbol_kind::S_YYEMPTY;
   }
 
-#if YYDEBUG
-  /*--------------------------------.
-  | Print this symbol on YYOUTPUT.  |
-  `--------------------------------*/
+  template <typename Base>
+  void
+  parser::basic_symbol<Base>::move (basic_symbol& s)
+  {
+    super_type::move (s);
+    value = YY_MOVE (s.value);
+    location = YY_MOVE (s.location);
+  }
+
+  // by_kind.
+  parser::by_kind::by_kind () YY_NOEXCEPT
+    : kind_ (symbol_kind::S_YYEMPTY)
+  {}
 
-  inline void
-  parser::yy_symbol_value_print_ (int yytype,
-			   const semantic_type* yyvaluep, const location_type* yylocationp)
+#if 201103L <= YY_CPLUSPLUS
+  parser::by_kind::by_kind (by_kind&& that) YY_NOEXCEPT
+    : kind_ (that.kind_)
   {
-    YYUSE (yylocationp);
-    YYUSE (yyvaluep);
-    std::ostream& yyo = debug_stream ();
-    std::ostream& yyoutput = yyo;
-    YYUSE (yyoutput);
-    switch (yytype)
-      {
-         default:
-	  break;
-      }
+    that.clear ();
   }
+#endif
+
+  parser::by_kind::by_kind (const by_kind& that) YY_NOEXCEPT
+    : kind_ (that.kind_)
+  {}
+
+  parser::by_kind::by_kind (token_kind_type t) YY_NOEXCEPT
+    : kind_ (yytranslate_ (t))
+  {}
+
 
 
   void
-  parser::yy_symbol_print_ (int yytype,
-			   const semantic_type* yyvaluep, const location_type* yylocationp)
+  parser::by_kind::clear () YY_NOEXCEPT
   {
-    *yycdebug_ << (yytype < yyntokens_ ? "token" : "nterm")
-	       << ' ' << yytname_[yytype] << " ("
-	       << *yylocationp << ": ";
-    yy_symbol_value_print_ (yytype, yyvaluep, yylocationp);
-    *yycdebug_ << ')';
+    kind_ = symbol_kind::S_YYEMPTY;
   }
-#endif
 
   void
-  parser::yydestruct_ (const char* yymsg,
-			   int yytype, semantic_type* yyvaluep, location_type* yylocationp)
+  parser::by_kind::move (by_kind& that)
   {
-    YYUSE (yylocationp);
-    YYUSE (yymsg);
-    YYUSE (yyvaluep);
+    kind_ = that.kind_;
+    that.clear ();
+  }
+
+  parser::symbol_kind_type
+  parser::by_kind::kind () const YY_NOEXCEPT
+  {
+    return kind_;
+  }
+
 
+  parser::symbol_kind_type
+  parser::by_kind::type_get () const YY_NOEXCEPT
+  {
+    return this->kind ();
+  }
+
+
+
+  // by_state.
+  parser::by_state::by_state () YY_NOEXCEPT
+    : state (empty_state)
+  {}
+
+  parser::by_state::by_state (const by_state& that) YY_NOEXCEPT
+    : state (that.state)
+  {}
+
+  void
+  parser::by_state::clear () YY_NOEXCEPT
+  {
+    state = empty_state;
+  }
+
+  void
+  parser::by_state::move (by_state& that)
+  {
+    state = that.state;
+    that.clear ();
+  }
+
+  parser::by_state::by_state (state_type s) YY_NOEXCEPT
+    : state (s)
+  {}
+
+  parser::symbol_kind_type
+  parser::by_state::kind () const YY_NOEXCEPT
+  {
+    if (state == empty_state)
+      return symbol_kind::S_YYEMPTY;
+    else
+      return YY_CAST (symbol_kind_type, yystos_[+state]);
+  }
+
+  parser::stack_symbol_type::stack_symbol_type ()
+  {}
+
+  parser::stack_symbol_type::stack_symbol_type (YY_RVREF (stack_symbol_type) that)
+    : super_type (YY_MOVE (that.state), YY_MOVE (that.value), YY_MOVE (that.location))
+  {
+#if 201103L <= YY_CPLUSPLUS
+    // that is emptied.
+    that.state = empty_state;
+#endif
+  }
+
+  parser::stack_symbol_type::stack_symbol_type (state_type s, YY_MOVE_REF (symbol_type) that)
+    : super_type (s, YY_MOVE (that.value), YY_MOVE (that.location))
+  {
+    // that is emptied.
+    that.kind_ = symbol_kind::S_YYEMPTY;
+  }
+
+#if YY_CPLUSPLUS < 201103L
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (const stack_symbol_type& that)
+  {
+    state = that.state;
+    value = that.value;
+    location = that.location;
+    return *this;
+  }
+
+  parser::stack_symbol_type&
+  parser::stack_symbol_type::operator= (stack_symbol_type& that)
+  {
+    state = that.state;
+    value = that.value;
+    location = that.location;
+    // that is emptied.
+    that.state = empty_state;
+    return *this;
+  }
+#endif
+
+  template <typename Base>
+  void
+  parser::yy_destroy_ (const char* yymsg, basic_symbol<Base>& yysym) const
+  {
     if (yymsg)
-      YY_SYMBOL_PRINT (yymsg, yytype, yyvaluep, yylocationp);
+      YY_SYMBOL_PRINT (yymsg, yysym);
 
-    switch (yytype)
-      {
-        case 4: /* STRING */
-/* Line 455 of lalr1.cc  */
-#line 75 "grammar.yy"
-        { delete ((*yyvaluep).sval); };
-/* Line 455 of lalr1.cc  */
-#line 245 "grammar.cc"
+    // User destructor.
+    switch (yysym.kind ())
+    {
+      case symbol_kind::S_STRING: // STRING
+#line 89 "grammar.yy"
+                    { delete (yysym.value.sval); }
+#line 386 "grammar.cc"
         break;
-      case 5: /* SKEY */
-/* Line 455 of lalr1.cc  */
-#line 75 "grammar.yy"
-        { delete ((*yyvaluep).sval); };
-/* Line 455 of lalr1.cc  */
-#line 252 "grammar.cc"
+
+      case symbol_kind::S_SKEY: // SKEY
+#line 89 "grammar.yy"
+                    { delete (yysym.value.sval); }
+#line 392 "grammar.cc"
+        break;
+
+      case symbol_kind::S_NKEY: // NKEY
+#line 89 "grammar.yy"
+                    { delete (yysym.value.sval); }
+#line 398 "grammar.cc"
         break;
-      case 6: /* NKEY */
-/* Line 455 of lalr1.cc  */
-#line 75 "grammar.yy"
-        { delete ((*yyvaluep).sval); };
-/* Line 455 of lalr1.cc  */
-#line 259 "grammar.cc"
+
+      case symbol_kind::S_string: // string
+#line 89 "grammar.yy"
+                    { delete (yysym.value.sval); }
+#line 404 "grammar.cc"
         break;
-      case 31: /* string */
-/* Line 455 of lalr1.cc  */
-#line 75 "grammar.yy"
-        { delete ((*yyvaluep).sval); };
-/* Line 455 of lalr1.cc  */
-#line 266 "grammar.cc"
+
+      case symbol_kind::S_strval: // strval
+#line 89 "grammar.yy"
+                    { delete (yysym.value.sval); }
+#line 410 "grammar.cc"
         break;
-      case 32: /* strval */
-/* Line 455 of lalr1.cc  */
-#line 75 "grammar.yy"
-        { delete ((*yyvaluep).sval); };
-/* Line 455 of lalr1.cc  */
-#line 273 "grammar.cc"
+
+      default:
         break;
+    }
+  }
 
-	default:
-	  break;
+#if YYDEBUG
+  template <typename Base>
+  void
+  parser::yy_print_ (std::ostream& yyo, const basic_symbol<Base>& yysym) const
+  {
+    std::ostream& yyoutput = yyo;
+    YY_USE (yyoutput);
+    if (yysym.empty ())
+      yyo << "empty symbol";
+    else
+      {
+        symbol_kind_type yykind = yysym.kind ();
+        yyo << (yykind < YYNTOKENS ? "token" : "nterm")
+            << ' ' << yysym.name () << " ("
+            << yysym.location << ": ";
+        YY_USE (yykind);
+        yyo << ')';
       }
   }
+#endif
 
   void
-  parser::yypop_ (unsigned int n)
+  parser::yypush_ (const char* m, YY_MOVE_REF (stack_symbol_type) sym)
   {
-    yystate_stack_.pop (n);
-    yysemantic_stack_.pop (n);
-    yylocation_stack_.pop (n);
+    if (m)
+      YY_SYMBOL_PRINT (m, sym);
+    yystack_.push (YY_MOVE (sym));
+  }
+
+  void
+  parser::yypush_ (const char* m, state_type s, YY_MOVE_REF (symbol_type) sym)
+  {
+#if 201103L <= YY_CPLUSPLUS
+    yypush_ (m, stack_symbol_type (s, std::move (sym)));
+#else
+    stack_symbol_type ss (s, sym);
+    yypush_ (m, ss);
+#endif
+  }
+
+  void
+  parser::yypop_ (int n) YY_NOEXCEPT
+  {
+    yystack_.pop (n);
   }
 
 #if YYDEBUG
@@ -310,377 +485,427 @@ namespace loos {
   {
     yydebug_ = l;
   }
-#endif
+#endif // YYDEBUG
 
-  inline bool
-  parser::yy_pact_value_is_default_ (int yyvalue)
+  parser::state_type
+  parser::yy_lr_goto_state_ (state_type yystate, int yysym)
+  {
+    int yyr = yypgoto_[yysym - YYNTOKENS] + yystate;
+    if (0 <= yyr && yyr <= yylast_ && yycheck_[yyr] == yystate)
+      return yytable_[yyr];
+    else
+      return yydefgoto_[yysym - YYNTOKENS];
+  }
+
+  bool
+  parser::yy_pact_value_is_default_ (int yyvalue) YY_NOEXCEPT
   {
     return yyvalue == yypact_ninf_;
   }
 
-  inline bool
-  parser::yy_table_value_is_error_ (int yyvalue)
+  bool
+  parser::yy_table_value_is_error_ (int yyvalue) YY_NOEXCEPT
   {
     return yyvalue == yytable_ninf_;
   }
 
   int
-  parser::parse ()
+  parser::operator() ()
   {
-    /// Lookahead and lookahead in internal form.
-    int yychar = yyempty_;
-    int yytoken = 0;
+    return parse ();
+  }
 
-    // State.
+  int
+  parser::parse ()
+  {
     int yyn;
+    /// Length of the RHS of the rule being reduced.
     int yylen = 0;
-    int yystate = 0;
 
     // Error handling.
     int yynerrs_ = 0;
     int yyerrstatus_ = 0;
 
-    /// Semantic value of the lookahead.
-    static semantic_type yyval_default;
-    semantic_type yylval = yyval_default;
-    /// Location of the lookahead.
-    location_type yylloc;
-    /// The locations where the error started and ended.
-    location_type yyerror_range[3];
+    /// The lookahead symbol.
+    symbol_type yyla;
 
-    /// $$.
-    semantic_type yyval;
-    /// @$.
-    location_type yyloc;
+    /// The locations where the error started and ended.
+    stack_symbol_type yyerror_range[3];
 
+    /// The return value of parse ().
     int yyresult;
 
-    // FIXME: This shoud be completely indented.  It is not yet to
-    // avoid gratuitous conflicts when merging into the master branch.
+#if YY_EXCEPTIONS
     try
+#endif // YY_EXCEPTIONS
       {
-    YYCDEBUG << "Starting parse" << std::endl;
+    YYCDEBUG << "Starting parse\n";
 
 
-    /* Initialize the stacks.  The initial state will be pushed in
+    /* Initialize the stack.  The initial state will be set in
        yynewstate, since the latter expects the semantical and the
        location values to have been already stored, initialize these
        stacks with a primary value.  */
-    yystate_stack_ = state_stack_type (0);
-    yysemantic_stack_ = semantic_stack_type (0);
-    yylocation_stack_ = location_stack_type (0);
-    yysemantic_stack_.push (yylval);
-    yylocation_stack_.push (yylloc);
+    yystack_.clear ();
+    yypush_ (YY_NULLPTR, 0, YY_MOVE (yyla));
 
-    /* New state.  */
+  /*-----------------------------------------------.
+  | yynewstate -- push a new symbol on the stack.  |
+  `-----------------------------------------------*/
   yynewstate:
-    yystate_stack_.push (yystate);
-    YYCDEBUG << "Entering state " << yystate << std::endl;
+    YYCDEBUG << "Entering state " << int (yystack_[0].state) << '\n';
+    YY_STACK_PRINT ();
 
-    /* Accept?  */
-    if (yystate == yyfinal_)
-      goto yyacceptlab;
+    // Accept?
+    if (yystack_[0].state == yyfinal_)
+      YYACCEPT;
 
     goto yybackup;
 
-    /* Backup.  */
-  yybackup:
 
-    /* Try to take a decision without lookahead.  */
-    yyn = yypact_[yystate];
+  /*-----------.
+  | yybackup.  |
+  `-----------*/
+  yybackup:
+    // Try to take a decision without lookahead.
+    yyn = yypact_[+yystack_[0].state];
     if (yy_pact_value_is_default_ (yyn))
       goto yydefault;
 
-    /* Read a lookahead token.  */
-    if (yychar == yyempty_)
+    // Read a lookahead token.
+    if (yyla.empty ())
       {
-        YYCDEBUG << "Reading a token: ";
-        yychar = yylex (&yylval);
+        YYCDEBUG << "Reading a token\n";
+#if YY_EXCEPTIONS
+        try
+#endif // YY_EXCEPTIONS
+          {
+            yyla.kind_ = yytranslate_ (yylex (&yyla.value, &yyla.location));
+          }
+#if YY_EXCEPTIONS
+        catch (const syntax_error& yyexc)
+          {
+            YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+            error (yyexc);
+            goto yyerrlab1;
+          }
+#endif // YY_EXCEPTIONS
       }
+    YY_SYMBOL_PRINT ("Next token is", yyla);
 
-    /* Convert token to internal form.  */
-    if (yychar <= yyeof_)
-      {
-	yychar = yytoken = yyeof_;
-	YYCDEBUG << "Now at end of input." << std::endl;
-      }
-    else
+    if (yyla.kind () == symbol_kind::S_YYerror)
+    {
+      // The scanner already issued an error message, process directly
+      // to error recovery.  But do not keep the error token as
+      // lookahead, it is too special and may lead us to an endless
+      // loop in error recovery. */
+      yyla.kind_ = symbol_kind::S_YYUNDEF;
+      goto yyerrlab1;
+    }
+
+    /* If the proper action on seeing token YYLA.TYPE is to reduce or
+       to detect an error, take that action.  */
+    yyn += yyla.kind ();
+    if (yyn < 0 || yylast_ < yyn || yycheck_[yyn] != yyla.kind ())
       {
-	yytoken = yytranslate_ (yychar);
-	YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+        goto yydefault;
       }
 
-    /* If the proper action on seeing token YYTOKEN is to reduce or to
-       detect an error, take that action.  */
-    yyn += yytoken;
-    if (yyn < 0 || yylast_ < yyn || yycheck_[yyn] != yytoken)
-      goto yydefault;
-
-    /* Reduce or error.  */
+    // Reduce or error.
     yyn = yytable_[yyn];
     if (yyn <= 0)
       {
-	if (yy_table_value_is_error_ (yyn))
-	  goto yyerrlab;
-	yyn = -yyn;
-	goto yyreduce;
+        if (yy_table_value_is_error_ (yyn))
+          goto yyerrlab;
+        yyn = -yyn;
+        goto yyreduce;
       }
 
-    /* Shift the lookahead token.  */
-    YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
-
-    /* Discard the token being shifted.  */
-    yychar = yyempty_;
-
-    yysemantic_stack_.push (yylval);
-    yylocation_stack_.push (yylloc);
-
-    /* Count tokens shifted since error; after three, turn off error
-       status.  */
+    // Count tokens shifted since error; after three, turn off error status.
     if (yyerrstatus_)
       --yyerrstatus_;
 
-    yystate = yyn;
+    // Shift the lookahead token.
+    yypush_ ("Shifting", state_type (yyn), YY_MOVE (yyla));
     goto yynewstate;
 
+
   /*-----------------------------------------------------------.
   | yydefault -- do the default action for the current state.  |
   `-----------------------------------------------------------*/
   yydefault:
-    yyn = yydefact_[yystate];
+    yyn = yydefact_[+yystack_[0].state];
     if (yyn == 0)
       goto yyerrlab;
     goto yyreduce;
 
+
   /*-----------------------------.
-  | yyreduce -- Do a reduction.  |
+  | yyreduce -- do a reduction.  |
   `-----------------------------*/
   yyreduce:
     yylen = yyr2_[yyn];
-    /* If YYLEN is nonzero, implement the default value of the action:
-       `$$ = $1'.  Otherwise, use the top of the stack.
-
-       Otherwise, the following line sets YYVAL to garbage.
-       This behavior is undocumented and Bison
-       users should not rely upon it.  */
-    if (yylen)
-      yyval = yysemantic_stack_[yylen - 1];
-    else
-      yyval = yysemantic_stack_[0];
-
-    // Compute the default @$.
     {
-      slice<location_type, location_stack_type> slice (yylocation_stack_, yylen);
-      YYLLOC_DEFAULT (yyloc, slice, yylen);
-    }
-
-    // Perform the reduction.
-    YY_REDUCE_PRINT (yyn);
-    switch (yyn)
+      stack_symbol_type yylhs;
+      yylhs.state = yy_lr_goto_state_ (yystack_[yylen].state, yyr1_[yyn]);
+      /* If YYLEN is nonzero, implement the default value of the
+         action: '$$ = $1'.  Otherwise, use the top of the stack.
+
+         Otherwise, the following line sets YYLHS.VALUE to garbage.
+         This behavior is undocumented and Bison users should not rely
+         upon it.  */
+      if (yylen)
+        yylhs.value = yystack_[yylen - 1].value;
+      else
+        yylhs.value = yystack_[0].value;
+
+      // Default location.
       {
-          case 3:
-/* Line 670 of lalr1.cc  */
-#line 81 "grammar.yy"
-    { driver.kern.push(new internal::logicalAnd); }
+        stack_type::slice range (yystack_, yylen);
+        YYLLOC_DEFAULT (yylhs.location, range, yylen);
+        yyerror_range[1].location = yylhs.location;
+      }
+
+      // Perform the reduction.
+      YY_REDUCE_PRINT (yyn);
+#if YY_EXCEPTIONS
+      try
+#endif // YY_EXCEPTIONS
+        {
+          switch (yyn)
+            {
+  case 3: // expr: expr "&&" rexpr
+#line 95 "grammar.yy"
+                          { driver.kern.push(new internal::logicalAnd); }
+#line 681 "grammar.cc"
     break;
 
-  case 4:
-/* Line 670 of lalr1.cc  */
-#line 82 "grammar.yy"
-    { driver.kern.push(new internal::logicalOr); }
+  case 4: // expr: expr "||" rexpr
+#line 96 "grammar.yy"
+                          { driver.kern.push(new internal::logicalOr); }
+#line 687 "grammar.cc"
     break;
 
-  case 6:
-/* Line 670 of lalr1.cc  */
-#line 87 "grammar.yy"
-    { driver.kern.push(new internal::logicalNot); }
+  case 6: // rexpr: "!" rexpr
+#line 101 "grammar.yy"
+                               { driver.kern.push(new internal::logicalNot); }
+#line 693 "grammar.cc"
     break;
 
-  case 7:
-/* Line 670 of lalr1.cc  */
-#line 88 "grammar.yy"
-    { driver.kern.push(new internal::lessThan); }
+  case 7: // rexpr: value "<" value
+#line 102 "grammar.yy"
+                        { driver.kern.push(new internal::lessThan); }
+#line 699 "grammar.cc"
     break;
 
-  case 8:
-/* Line 670 of lalr1.cc  */
-#line 89 "grammar.yy"
-    { driver.kern.push(new internal::lessThanEquals); }
+  case 8: // rexpr: value "<=" value
+#line 103 "grammar.yy"
+                         { driver.kern.push(new internal::lessThanEquals); }
+#line 705 "grammar.cc"
     break;
 
-  case 9:
-/* Line 670 of lalr1.cc  */
-#line 90 "grammar.yy"
-    { driver.kern.push(new internal::greaterThanEquals); }
+  case 9: // rexpr: value ">=" value
+#line 104 "grammar.yy"
+                         { driver.kern.push(new internal::greaterThanEquals); }
+#line 711 "grammar.cc"
     break;
 
-  case 10:
-/* Line 670 of lalr1.cc  */
-#line 91 "grammar.yy"
-    { driver.kern.push(new internal::greaterThan); }
+  case 10: // rexpr: value ">" value
+#line 105 "grammar.yy"
+                        { driver.kern.push(new internal::greaterThan); }
+#line 717 "grammar.cc"
     break;
 
-  case 11:
-/* Line 670 of lalr1.cc  */
-#line 92 "grammar.yy"
-    { driver.kern.push(new internal::equals); }
+  case 11: // rexpr: value "==" value
+#line 106 "grammar.yy"
+                         { driver.kern.push(new internal::equals); }
+#line 723 "grammar.cc"
     break;
 
-  case 12:
-/* Line 670 of lalr1.cc  */
-#line 93 "grammar.yy"
-    { driver.kern.push(new internal::equals); driver.kern.push(new internal::logicalNot); }
+  case 12: // rexpr: value "!=" value
+#line 107 "grammar.yy"
+                         { driver.kern.push(new internal::equals); driver.kern.push(new internal::logicalNot); }
+#line 729 "grammar.cc"
     break;
 
-  case 13:
-/* Line 670 of lalr1.cc  */
-#line 94 "grammar.yy"
-    { driver.kern.push(new internal::matchRegex(*((yysemantic_stack_[(3) - (3)].sval)))); }
+  case 13: // rexpr: alphid "=~" strval
+#line 108 "grammar.yy"
+                           { driver.kern.push(new internal::matchRegex(*((yystack_[0].value.sval)))); }
+#line 735 "grammar.cc"
     break;
 
-  case 14:
-/* Line 670 of lalr1.cc  */
-#line 95 "grammar.yy"
-    { driver.kern.push(new internal::logicalTrue); }
+  case 14: // rexpr: ALL
+#line 109 "grammar.yy"
+            { driver.kern.push(new internal::logicalTrue); }
+#line 741 "grammar.cc"
     break;
 
-  case 15:
-/* Line 670 of lalr1.cc  */
-#line 96 "grammar.yy"
-    { driver.kern.push(new internal::Hydrogen); }
+  case 15: // rexpr: HYDROGEN
+#line 110 "grammar.yy"
+                 { driver.kern.push(new internal::Hydrogen); }
+#line 747 "grammar.cc"
     break;
 
-  case 16:
-/* Line 670 of lalr1.cc  */
-#line 97 "grammar.yy"
-    { driver.kern.push(new internal::Backbone); }
+  case 16: // rexpr: BACKBONE
+#line 111 "grammar.yy"
+                 { driver.kern.push(new internal::Backbone); }
+#line 753 "grammar.cc"
     break;
 
-  case 23:
-/* Line 670 of lalr1.cc  */
-#line 105 "grammar.yy"
-    { driver.kern.push(new internal::extractNumber(*((yysemantic_stack_[(3) - (3)].sval)))); }
+  case 17: // rexpr: WITHIN distance OF mark rexpr
+#line 112 "grammar.yy"
+                                      { driver.kern.push(new internal::withinSelection((yystack_[3].value.dval), driver.kern.split((yystack_[1].value.ival)), false)); }
+#line 759 "grammar.cc"
     break;
 
-  case 24:
-/* Line 670 of lalr1.cc  */
-#line 107 "grammar.yy"
-    { driver.kern.push(new internal::pushInt((yysemantic_stack_[(1) - (1)].ival))); }
+  case 18: // rexpr: AROUND distance OF mark rexpr
+#line 113 "grammar.yy"
+                                      { driver.kern.push(new internal::withinSelection((yystack_[3].value.dval), driver.kern.split((yystack_[1].value.ival)), true)); }
+#line 765 "grammar.cc"
     break;
 
-  case 27:
-/* Line 670 of lalr1.cc  */
-#line 112 "grammar.yy"
-    { (yyval.sval) = (yysemantic_stack_[(1) - (1)].sval); driver.kern.push(new internal::pushString(*((yysemantic_stack_[(1) - (1)].sval)))); }
+  case 19: // rexpr: SAME RESIDUE AS mark rexpr
+#line 114 "grammar.yy"
+                                   { driver.kern.push(new internal::sameResidueAs(driver.kern.split((yystack_[1].value.ival)))); }
+#line 771 "grammar.cc"
     break;
 
-  case 29:
-/* Line 670 of lalr1.cc  */
-#line 121 "grammar.yy"
-    {
-(yyval.sval) = (yysemantic_stack_[(1) - (1)].sval);
-if (*((yysemantic_stack_[(1) - (1)].sval)) == "name")
+  case 20: // rexpr: SAME MOLECULE AS mark rexpr
+#line 115 "grammar.yy"
+                                    { driver.kern.push(new internal::sameMoleculeAs(driver.kern.split((yystack_[1].value.ival)))); }
+#line 777 "grammar.cc"
+    break;
+
+  case 21: // mark: %empty
+#line 123 "grammar.yy"
+                        { (yylhs.value.ival) = driver.kern.size(); }
+#line 783 "grammar.cc"
+    break;
+
+  case 22: // distance: NUMBER
+#line 125 "grammar.yy"
+                        { (yylhs.value.dval) = (yystack_[0].value.ival); }
+#line 789 "grammar.cc"
+    break;
+
+  case 23: // distance: FLOAT
+#line 126 "grammar.yy"
+                        { (yylhs.value.dval) = (yystack_[0].value.dval); }
+#line 795 "grammar.cc"
+    break;
+
+  case 30: // numex: alphid "->" strval
+#line 134 "grammar.yy"
+                           { driver.kern.push(new internal::extractNumber(*((yystack_[0].value.sval)))); }
+#line 801 "grammar.cc"
+    break;
+
+  case 31: // number: NUMBER
+#line 136 "grammar.yy"
+                        { driver.kern.push(new internal::pushInt((yystack_[0].value.ival))); }
+#line 807 "grammar.cc"
+    break;
+
+  case 34: // string: STRING
+#line 141 "grammar.yy"
+                        { (yylhs.value.sval) = (yystack_[0].value.sval); driver.kern.push(new internal::pushString(*((yystack_[0].value.sval)))); }
+#line 813 "grammar.cc"
+    break;
+
+  case 35: // strval: STRING
+#line 143 "grammar.yy"
+          { (yylhs.value.sval) = (yystack_[0].value.sval); }
+#line 819 "grammar.cc"
+    break;
+
+  case 36: // alphid: SKEY
+#line 150 "grammar.yy"
+                        {
+(yylhs.value.sval) = (yystack_[0].value.sval);
+if (*((yystack_[0].value.sval)) == "name")
    driver.kern.push(new internal::pushAtomName);
-else if (*((yysemantic_stack_[(1) - (1)].sval)) == "resname")
+else if (*((yystack_[0].value.sval)) == "resname")
    driver.kern.push(new internal::pushAtomResname);
-else if (*((yysemantic_stack_[(1) - (1)].sval)) == "segid" || *((yysemantic_stack_[(1) - (1)].sval)) == "segname")
+else if (*((yystack_[0].value.sval)) == "segid" || *((yystack_[0].value.sval)) == "segname")
    driver.kern.push(new internal::pushAtomSegid);
-else if (*((yysemantic_stack_[(1) - (1)].sval)) == "chainid")
+else if (*((yystack_[0].value.sval)) == "chainid")
    driver.kern.push(new internal::pushAtomChainId);
 else
-   loos::parse_error("Unknown string keyword " + *((yysemantic_stack_[(1) - (1)].sval)));
+   loos::parse_error("Unknown string keyword " + *((yystack_[0].value.sval)));
 }
+#line 837 "grammar.cc"
     break;
 
-  case 30:
-/* Line 670 of lalr1.cc  */
-#line 138 "grammar.yy"
-    {
-if (*((yysemantic_stack_[(1) - (1)].sval)) == "id")
+  case 37: // numid: NKEY
+#line 167 "grammar.yy"
+                        {
+if (*((yystack_[0].value.sval)) == "id")
    driver.kern.push(new internal::pushAtomId);
-else if (*((yysemantic_stack_[(1) - (1)].sval)) == "resid")
+else if (*((yystack_[0].value.sval)) == "resid")
    driver.kern.push(new internal::pushAtomResid);
-else if (*((yysemantic_stack_[(1) - (1)].sval)) == "index")
+else if (*((yystack_[0].value.sval)) == "index")
    driver.kern.push(new internal::pushAtomIndex);	
 else
-   loos::parse_error("Unknown numeric keyword " + *((yysemantic_stack_[(1) - (1)].sval)));   
+   loos::parse_error("Unknown numeric keyword " + *((yystack_[0].value.sval)));   
 }
+#line 852 "grammar.cc"
     break;
 
 
-/* Line 670 of lalr1.cc  */
-#line 613 "grammar.cc"
-      default:
-        break;
-      }
-
-    /* User semantic actions sometimes alter yychar, and that requires
-       that yytoken be updated with the new translation.  We take the
-       approach of translating immediately before every use of yytoken.
-       One alternative is translating here after every semantic action,
-       but that translation would be missed if the semantic action
-       invokes YYABORT, YYACCEPT, or YYERROR immediately after altering
-       yychar.  In the case of YYABORT or YYACCEPT, an incorrect
-       destructor might then be invoked immediately.  In the case of
-       YYERROR, subsequent parser actions might lead to an incorrect
-       destructor call or verbose syntax error message before the
-       lookahead is translated.  */
-    YY_SYMBOL_PRINT ("-> $$ =", yyr1_[yyn], &yyval, &yyloc);
-
-    yypop_ (yylen);
-    yylen = 0;
-    YY_STACK_PRINT ();
-
-    yysemantic_stack_.push (yyval);
-    yylocation_stack_.push (yyloc);
-
-    /* Shift the result of the reduction.  */
-    yyn = yyr1_[yyn];
-    yystate = yypgoto_[yyn - yyntokens_] + yystate_stack_[0];
-    if (0 <= yystate && yystate <= yylast_
-	&& yycheck_[yystate] == yystate_stack_[0])
-      yystate = yytable_[yystate];
-    else
-      yystate = yydefgoto_[yyn - yyntokens_];
+#line 856 "grammar.cc"
+
+            default:
+              break;
+            }
+        }
+#if YY_EXCEPTIONS
+      catch (const syntax_error& yyexc)
+        {
+          YYCDEBUG << "Caught exception: " << yyexc.what() << '\n';
+          error (yyexc);
+          YYERROR;
+        }
+#endif // YY_EXCEPTIONS
+      YY_SYMBOL_PRINT ("-> $$ =", yylhs);
+      yypop_ (yylen);
+      yylen = 0;
+
+      // Shift the result of the reduction.
+      yypush_ (YY_NULLPTR, YY_MOVE (yylhs));
+    }
     goto yynewstate;
 
-  /*------------------------------------.
-  | yyerrlab -- here on detecting error |
-  `------------------------------------*/
-  yyerrlab:
-    /* Make sure we have latest lookahead translation.  See comments at
-       user semantic actions for why this is necessary.  */
-    yytoken = yytranslate_ (yychar);
 
-    /* If not already recovering from an error, report this error.  */
+  /*--------------------------------------.
+  | yyerrlab -- here on detecting error.  |
+  `--------------------------------------*/
+  yyerrlab:
+    // If not already recovering from an error, report this error.
     if (!yyerrstatus_)
       {
-	++yynerrs_;
-	if (yychar == yyempty_)
-	  yytoken = yyempty_;
-	error (yylloc, yysyntax_error_ (yystate, yytoken));
+        ++yynerrs_;
+        std::string msg = YY_("syntax error");
+        error (yyla.location, YY_MOVE (msg));
       }
 
-    yyerror_range[1] = yylloc;
+
+    yyerror_range[1].location = yyla.location;
     if (yyerrstatus_ == 3)
       {
         /* If just tried and failed to reuse lookahead token after an
            error, discard it.  */
-        if (yychar <= yyeof_)
-          {
-            /* Return failure if at end of input.  */
-            if (yychar == yyeof_)
-              YYABORT;
-          }
-        else
+
+        // Return failure if at end of input.
+        if (yyla.kind () == symbol_kind::S_YYEOF)
+          YYABORT;
+        else if (!yyla.empty ())
           {
-            yydestruct_ ("Error: discarding", yytoken, &yylval, &yylloc);
-            yychar = yyempty_;
+            yy_destroy_ ("Error: discarding", yyla);
+            yyla.clear ();
           }
       }
 
-    /* Else will try to reuse lookahead token after shifting the error
-       token.  */
+    // Else will try to reuse lookahead token after shifting the error token.
     goto yyerrlab1;
 
 
@@ -688,342 +913,308 @@ else
   | yyerrorlab -- error raised explicitly by YYERROR.  |
   `---------------------------------------------------*/
   yyerrorlab:
-
-    /* Pacify compilers like GCC when the user code never invokes
-       YYERROR and the label yyerrorlab therefore never appears in user
-       code.  */
+    /* Pacify compilers when the user code never invokes YYERROR and
+       the label yyerrorlab therefore never appears in user code.  */
     if (false)
-      goto yyerrorlab;
+      YYERROR;
 
-    yyerror_range[1] = yylocation_stack_[yylen - 1];
-    /* Do not reclaim the symbols of the rule which action triggered
+    /* Do not reclaim the symbols of the rule whose action triggered
        this YYERROR.  */
     yypop_ (yylen);
     yylen = 0;
-    yystate = yystate_stack_[0];
+    YY_STACK_PRINT ();
     goto yyerrlab1;
 
+
   /*-------------------------------------------------------------.
   | yyerrlab1 -- common code for both syntax error and YYERROR.  |
   `-------------------------------------------------------------*/
   yyerrlab1:
-    yyerrstatus_ = 3;	/* Each real token shifted decrements this.  */
-
+    yyerrstatus_ = 3;   // Each real token shifted decrements this.
+    // Pop stack until we find a state that shifts the error token.
     for (;;)
       {
-	yyn = yypact_[yystate];
-	if (!yy_pact_value_is_default_ (yyn))
-	{
-	  yyn += yyterror_;
-	  if (0 <= yyn && yyn <= yylast_ && yycheck_[yyn] == yyterror_)
-	    {
-	      yyn = yytable_[yyn];
-	      if (0 < yyn)
-		break;
-	    }
-	}
-
-	/* Pop the current state because it cannot handle the error token.  */
-	if (yystate_stack_.height () == 1)
-	  YYABORT;
-
-	yyerror_range[1] = yylocation_stack_[0];
-	yydestruct_ ("Error: popping",
-		     yystos_[yystate],
-		     &yysemantic_stack_[0], &yylocation_stack_[0]);
-	yypop_ ();
-	yystate = yystate_stack_[0];
-	YY_STACK_PRINT ();
-      }
+        yyn = yypact_[+yystack_[0].state];
+        if (!yy_pact_value_is_default_ (yyn))
+          {
+            yyn += symbol_kind::S_YYerror;
+            if (0 <= yyn && yyn <= yylast_
+                && yycheck_[yyn] == symbol_kind::S_YYerror)
+              {
+                yyn = yytable_[yyn];
+                if (0 < yyn)
+                  break;
+              }
+          }
 
-    yyerror_range[2] = yylloc;
-    // Using YYLLOC is tempting, but would change the location of
-    // the lookahead.  YYLOC is available though.
-    YYLLOC_DEFAULT (yyloc, yyerror_range, 2);
-    yysemantic_stack_.push (yylval);
-    yylocation_stack_.push (yyloc);
+        // Pop the current state because it cannot handle the error token.
+        if (yystack_.size () == 1)
+          YYABORT;
 
-    /* Shift the error token.  */
-    YY_SYMBOL_PRINT ("Shifting", yystos_[yyn],
-		     &yysemantic_stack_[0], &yylocation_stack_[0]);
+        yyerror_range[1].location = yystack_[0].location;
+        yy_destroy_ ("Error: popping", yystack_[0]);
+        yypop_ ();
+        YY_STACK_PRINT ();
+      }
+    {
+      stack_symbol_type error_token;
 
-    yystate = yyn;
+      yyerror_range[2].location = yyla.location;
+      YYLLOC_DEFAULT (error_token.location, yyerror_range, 2);
+
+      // Shift the error token.
+      error_token.state = state_type (yyn);
+      yypush_ ("Shifting", YY_MOVE (error_token));
+    }
     goto yynewstate;
 
-    /* Accept.  */
+
+  /*-------------------------------------.
+  | yyacceptlab -- YYACCEPT comes here.  |
+  `-------------------------------------*/
   yyacceptlab:
     yyresult = 0;
     goto yyreturn;
 
-    /* Abort.  */
+
+  /*-----------------------------------.
+  | yyabortlab -- YYABORT comes here.  |
+  `-----------------------------------*/
   yyabortlab:
     yyresult = 1;
     goto yyreturn;
 
+
+  /*-----------------------------------------------------.
+  | yyreturn -- parsing is finished, return the result.  |
+  `-----------------------------------------------------*/
   yyreturn:
-    if (yychar != yyempty_)
-      {
-        /* Make sure we have latest lookahead translation.  See comments
-           at user semantic actions for why this is necessary.  */
-        yytoken = yytranslate_ (yychar);
-        yydestruct_ ("Cleanup: discarding lookahead", yytoken, &yylval,
-                     &yylloc);
-      }
+    if (!yyla.empty ())
+      yy_destroy_ ("Cleanup: discarding lookahead", yyla);
 
-    /* Do not reclaim the symbols of the rule which action triggered
+    /* Do not reclaim the symbols of the rule whose action triggered
        this YYABORT or YYACCEPT.  */
     yypop_ (yylen);
-    while (1 < yystate_stack_.height ())
+    YY_STACK_PRINT ();
+    while (1 < yystack_.size ())
       {
-        yydestruct_ ("Cleanup: popping",
-                     yystos_[yystate_stack_[0]],
-                     &yysemantic_stack_[0],
-                     &yylocation_stack_[0]);
+        yy_destroy_ ("Cleanup: popping", yystack_[0]);
         yypop_ ();
       }
 
     return yyresult;
-    }
+  }
+#if YY_EXCEPTIONS
     catch (...)
       {
-        YYCDEBUG << "Exception caught: cleaning lookahead and stack"
-                 << std::endl;
+        YYCDEBUG << "Exception caught: cleaning lookahead and stack\n";
         // Do not try to display the values of the reclaimed symbols,
-        // as their printer might throw an exception.
-        if (yychar != yyempty_)
-          {
-            /* Make sure we have latest lookahead translation.  See
-               comments at user semantic actions for why this is
-               necessary.  */
-            yytoken = yytranslate_ (yychar);
-            yydestruct_ (YY_NULL, yytoken, &yylval, &yylloc);
-          }
+        // as their printers might throw an exception.
+        if (!yyla.empty ())
+          yy_destroy_ (YY_NULLPTR, yyla);
 
-        while (1 < yystate_stack_.height ())
+        while (1 < yystack_.size ())
           {
-            yydestruct_ (YY_NULL,
-                         yystos_[yystate_stack_[0]],
-                         &yysemantic_stack_[0],
-                         &yylocation_stack_[0]);
+            yy_destroy_ (YY_NULLPTR, yystack_[0]);
             yypop_ ();
           }
         throw;
       }
+#endif // YY_EXCEPTIONS
+  }
+
+  void
+  parser::error (const syntax_error& yyexc)
+  {
+    error (yyexc.location, yyexc.what ());
   }
 
-  // Generate an error message.
-  std::string
-  parser::yysyntax_error_ (int, int)
+#if YYDEBUG || 0
+  const char *
+  parser::symbol_name (symbol_kind_type yysymbol)
   {
-    return YY_("syntax error");
+    return yytname_[yysymbol];
   }
+#endif // #if YYDEBUG || 0
+
+
+
+
+
+
+
+
 
+  const signed char parser::yypact_ninf_ = -44;
+
+  const signed char parser::yytable_ninf_ = -1;
 
-  /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
-     STATE-NUM.  */
-  const signed char parser::yypact_ninf_ = -10;
   const signed char
   parser::yypact_[] =
   {
-        27,   -10,   -10,   -10,   -10,   -10,   -10,   -10,    27,    27,
-      39,   -10,    40,   -10,   -10,   -10,   -10,   -10,    -6,   -10,
-     -10,    -8,    29,   -10,    27,    27,     2,     2,     2,     2,
-       2,     2,     0,     0,   -10,   -10,   -10,   -10,     2,   -10,
-      -4,   -10,   -10,   -10,   -10,   -10,   -10,   -10,   -10,    15
+      13,   -44,   -44,   -44,   -44,   -44,   -44,   -44,    13,     3,
+       3,    31,    13,    40,   -44,    56,   -44,   -44,   -44,   -44,
+     -44,    41,   -44,   -44,   -44,   -44,   -20,   -14,    -9,    -2,
+      -3,    32,   -44,    13,    13,     8,     8,     8,     8,     8,
+       8,     7,     7,   -44,   -44,   -44,   -44,   -44,   -44,   -44,
+     -44,     8,   -44,    19,   -44,   -44,   -44,   -44,   -44,   -44,
+     -44,   -44,    13,    13,    13,    13,    11,   -44,   -44,   -44,
+     -44
   };
 
-  /* YYDEFACT[S] -- default reduction number in state S.  Performed when
-     YYTABLE doesn't specify something else to do.  Zero means the
-     default is an error.  */
-  const unsigned char
+  const signed char
   parser::yydefact_[] =
   {
-         0,    24,    27,    29,    30,    14,    15,    16,     0,     0,
-       0,     2,     0,    18,    20,    21,    19,    25,    26,    22,
-       6,     0,     0,     1,     0,     0,     0,     0,     0,     0,
-       0,     0,     0,     0,     5,    17,     3,     4,     0,     7,
-      26,     8,     9,    10,    11,    12,    28,    13,    23,     0
+       0,    31,    34,    36,    37,    14,    15,    16,     0,     0,
+       0,     0,     0,     0,     2,     0,    25,    27,    28,    26,
+      32,    33,    29,     6,    22,    23,     0,     0,     0,     0,
+       0,     0,     1,     0,     0,     0,     0,     0,     0,     0,
+       0,     0,     0,    21,    21,    21,    21,     5,    24,     3,
+       4,     0,     7,    33,     8,     9,    10,    11,    12,    35,
+      13,    30,     0,     0,     0,     0,     0,    17,    18,    19,
+      20
   };
 
-  /* YYPGOTO[NTERM-NUM].  */
   const signed char
   parser::yypgoto_[] =
   {
-       -10,     7,     3,    -9,   -10,   -10,   -10,   -10,   -10,     5,
-       1,   -10
+     -44,    63,    -8,   -43,    33,    -7,   -44,   -44,   -44,   -44,
+     -44,    34,    28,   -44
   };
 
-  /* YYDEFGOTO[NTERM-NUM].  */
   const signed char
   parser::yydefgoto_[] =
   {
-        -1,    10,    11,    12,    13,    14,    15,    16,    17,    47,
-      40,    19
+       0,    13,    14,    62,    26,    15,    16,    17,    18,    19,
+      20,    60,    21,    22
   };
 
-  /* YYTABLE[YYPACT[STATE-NUM]].  What to do in state STATE-NUM.  If
-     positive, shift that token.  If negative, reduce the rule which
-     number is the opposite.  If YYTABLE_NINF_, syntax error.  */
-  const signed char parser::yytable_ninf_ = -1;
-  const unsigned char
+  const signed char
   parser::yytable_[] =
   {
-        22,    18,    24,    25,    46,     1,     2,     3,     4,    18,
-      18,    20,    32,    33,    34,    33,    21,    39,    41,    42,
-      43,    44,    45,    38,     0,    18,    18,    36,    37,    49,
-       1,     2,     3,     4,     5,     6,     7,    35,    48,    23,
-       0,    26,    27,    28,    29,    30,    31,     8,     9,    24,
-      25,    35,    26,    27,    28,    29,    30,    31
+      23,    63,    64,    65,    43,    31,    24,    25,    33,    34,
+      44,     1,    59,     2,     3,     4,     1,    45,     2,     3,
+       4,     5,     6,     7,    46,    49,    50,    47,    52,    54,
+      55,    56,    57,    58,     8,     9,    10,    51,    11,    42,
+      32,    48,    12,    27,    66,    35,    36,    37,    38,    39,
+      40,    33,    34,     0,    67,    68,    69,    70,    28,    29,
+      41,    42,    48,    53,    53,    53,    53,    53,    53,    35,
+      36,    37,    38,    39,    40,    30,    61,     0,     0,    53
   };
 
-  /* YYCHECK.  */
   const signed char
   parser::yycheck_[] =
   {
-         9,     0,    10,    11,     4,     3,     4,     5,     6,     8,
-       9,     8,    18,    19,    22,    19,     9,    26,    27,    28,
-      29,    30,    31,    21,    -1,    24,    25,    24,    25,    38,
-       3,     4,     5,     6,     7,     8,     9,    22,    33,     0,
-      -1,    12,    13,    14,    15,    16,    17,    20,    21,    10,
-      11,    22,    12,    13,    14,    15,    16,    17
+       8,    44,    45,    46,    24,    12,     3,     4,    11,    12,
+      24,     3,     5,     5,     6,     7,     3,    26,     5,     6,
+       7,     8,     9,    10,    26,    33,    34,    30,    35,    36,
+      37,    38,    39,    40,    21,    22,    23,    29,    25,    20,
+       0,    30,    29,    10,    51,    13,    14,    15,    16,    17,
+      18,    11,    12,    -1,    62,    63,    64,    65,    27,    28,
+      19,    20,    30,    35,    36,    37,    38,    39,    40,    13,
+      14,    15,    16,    17,    18,    12,    42,    -1,    -1,    51
   };
 
-  /* STOS_[STATE-NUM] -- The (internal number of the) accessing
-     symbol of state STATE-NUM.  */
-  const unsigned char
+  const signed char
   parser::yystos_[] =
   {
-         0,     3,     4,     5,     6,     7,     8,     9,    20,    21,
-      24,    25,    26,    27,    28,    29,    30,    31,    33,    34,
-      25,    24,    26,     0,    10,    11,    12,    13,    14,    15,
-      16,    17,    18,    19,    22,    22,    25,    25,    21,    26,
-      33,    26,    26,    26,    26,    26,     4,    32,    32,    26
+       0,     3,     5,     6,     7,     8,     9,    10,    21,    22,
+      23,    25,    29,    32,    33,    36,    37,    38,    39,    40,
+      41,    43,    44,    33,     3,     4,    35,    35,    27,    28,
+      32,    36,     0,    11,    12,    13,    14,    15,    16,    17,
+      18,    19,    20,    24,    24,    26,    26,    30,    30,    33,
+      33,    29,    36,    43,    36,    36,    36,    36,    36,     5,
+      42,    42,    34,    34,    34,    34,    36,    33,    33,    33,
+      33
   };
 
-#if YYDEBUG
-  /* TOKEN_NUMBER_[YYLEX-NUM] -- Internal symbol number corresponding
-     to YYLEX-NUM.  */
-  const unsigned short int
-  parser::yytoken_number_[] =
-  {
-         0,   256,   257,   258,   259,   260,   261,   262,   263,   264,
-     265,   266,   267,   268,   269,   270,   271,   272,   273,   274,
-     275,    40,    41
-  };
-#endif
-
-  /* YYR1[YYN] -- Symbol number of symbol that rule YYN derives.  */
-  const unsigned char
+  const signed char
   parser::yyr1_[] =
   {
-         0,    23,    24,    24,    24,    25,    25,    25,    25,    25,
-      25,    25,    25,    25,    25,    25,    25,    26,    26,    26,
-      26,    27,    27,    28,    29,    30,    30,    31,    32,    33,
-      34
+       0,    31,    32,    32,    32,    33,    33,    33,    33,    33,
+      33,    33,    33,    33,    33,    33,    33,    33,    33,    33,
+      33,    34,    35,    35,    36,    36,    36,    36,    37,    37,
+      38,    39,    40,    40,    41,    42,    43,    44
   };
 
-  /* YYR2[YYN] -- Number of symbols composing right hand side of rule YYN.  */
-  const unsigned char
+  const signed char
   parser::yyr2_[] =
   {
-         0,     2,     1,     3,     3,     3,     2,     3,     3,     3,
-       3,     3,     3,     3,     1,     1,     1,     3,     1,     1,
-       1,     1,     1,     3,     1,     1,     1,     1,     1,     1,
-       1
+       0,     2,     1,     3,     3,     3,     2,     3,     3,     3,
+       3,     3,     3,     3,     1,     1,     1,     5,     5,     5,
+       5,     0,     1,     1,     3,     1,     1,     1,     1,     1,
+       3,     1,     1,     1,     1,     1,     1,     1
   };
 
+
 #if YYDEBUG
-  /* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
-     First, the terminals, then, starting at \a yyntokens_, nonterminals.  */
+  // YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+  // First, the terminals, then, starting at \a YYNTOKENS, nonterminals.
   const char*
   const parser::yytname_[] =
   {
-    "END", "error", "$undefined", "NUMBER", "STRING", "SKEY", "NKEY", "ALL",
-  "HYDROGEN", "BACKBONE", "\"&&\"", "\"||\"", "\"<\"", "\"<=\"", "\">=\"",
-  "\">\"", "\"==\"", "\"!=\"", "\"=~\"", "\"->\"", "\"!\"", "'('", "')'",
-  "$accept", "expr", "rexpr", "value", "numeric", "numex", "number",
-  "alpha", "string", "strval", "alphid", "numid", YY_NULL
-  };
-
-
-  /* YYRHS -- A `-1'-separated list of the rules' RHS.  */
-  const parser::rhs_number_type
-  parser::yyrhs_[] =
-  {
-        24,     0,    -1,    25,    -1,    24,    10,    25,    -1,    24,
-      11,    25,    -1,    21,    24,    22,    -1,    20,    25,    -1,
-      26,    12,    26,    -1,    26,    13,    26,    -1,    26,    14,
-      26,    -1,    26,    15,    26,    -1,    26,    16,    26,    -1,
-      26,    17,    26,    -1,    33,    18,    32,    -1,     7,    -1,
-       8,    -1,     9,    -1,    21,    26,    22,    -1,    27,    -1,
-      30,    -1,    28,    -1,    29,    -1,    34,    -1,    33,    19,
-      32,    -1,     3,    -1,    31,    -1,    33,    -1,     4,    -1,
-       4,    -1,     5,    -1,     6,    -1
+  "END", "error", "\"invalid token\"", "NUMBER", "FLOAT", "STRING",
+  "SKEY", "NKEY", "ALL", "HYDROGEN", "BACKBONE", "\"&&\"", "\"||\"",
+  "\"<\"", "\"<=\"", "\">=\"", "\">\"", "\"==\"", "\"!=\"", "\"=~\"",
+  "\"->\"", "\"!\"", "WITHIN", "AROUND", "OF", "SAME", "AS", "RESIDUE",
+  "MOLECULE", "'('", "')'", "$accept", "expr", "rexpr", "mark", "distance",
+  "value", "numeric", "numex", "number", "alpha", "string", "strval",
+  "alphid", "numid", YY_NULLPTR
   };
+#endif
 
-  /* YYPRHS[YYN] -- Index of the first RHS symbol of rule number YYN in
-     YYRHS.  */
-  const unsigned char
-  parser::yyprhs_[] =
-  {
-         0,     0,     3,     5,     9,    13,    17,    20,    24,    28,
-      32,    36,    40,    44,    48,    50,    52,    54,    58,    60,
-      62,    64,    66,    68,    72,    74,    76,    78,    80,    82,
-      84
-  };
 
-  /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+#if YYDEBUG
   const unsigned char
   parser::yyrline_[] =
   {
-         0,    80,    80,    81,    82,    86,    87,    88,    89,    90,
-      91,    92,    93,    94,    95,    96,    97,   101,   101,   101,
-     101,   103,   103,   105,   107,   109,   109,   112,   114,   121,
-     138
+       0,    94,    94,    95,    96,   100,   101,   102,   103,   104,
+     105,   106,   107,   108,   109,   110,   111,   112,   113,   114,
+     115,   123,   125,   126,   130,   130,   130,   130,   132,   132,
+     134,   136,   138,   138,   141,   143,   150,   167
   };
 
-  // Print the state stack on the debug stream.
   void
-  parser::yystack_print_ ()
+  parser::yy_stack_print_ () const
   {
     *yycdebug_ << "Stack now";
-    for (state_stack_type::const_iterator i = yystate_stack_.begin ();
-	 i != yystate_stack_.end (); ++i)
-      *yycdebug_ << ' ' << *i;
-    *yycdebug_ << std::endl;
+    for (stack_type::const_iterator
+           i = yystack_.begin (),
+           i_end = yystack_.end ();
+         i != i_end; ++i)
+      *yycdebug_ << ' ' << int (i->state);
+    *yycdebug_ << '\n';
   }
 
-  // Report on the debug stream that the rule \a yyrule is going to be reduced.
   void
-  parser::yy_reduce_print_ (int yyrule)
+  parser::yy_reduce_print_ (int yyrule) const
   {
-    unsigned int yylno = yyrline_[yyrule];
+    int yylno = yyrline_[yyrule];
     int yynrhs = yyr2_[yyrule];
-    /* Print the symbols being reduced, and their result.  */
+    // Print the symbols being reduced, and their result.
     *yycdebug_ << "Reducing stack by rule " << yyrule - 1
-	       << " (line " << yylno << "):" << std::endl;
-    /* The symbols being reduced.  */
+               << " (line " << yylno << "):\n";
+    // The symbols being reduced.
     for (int yyi = 0; yyi < yynrhs; yyi++)
       YY_SYMBOL_PRINT ("   $" << yyi + 1 << " =",
-		       yyrhs_[yyprhs_[yyrule] + yyi],
-		       &(yysemantic_stack_[(yynrhs) - (yyi + 1)]),
-		       &(yylocation_stack_[(yynrhs) - (yyi + 1)]));
+                       yystack_[(yynrhs) - (yyi + 1)]);
   }
 #endif // YYDEBUG
 
-  /* YYTRANSLATE(YYLEX) -- Bison symbol number corresponding to YYLEX.  */
-  parser::token_number_type
-  parser::yytranslate_ (int t)
+  parser::symbol_kind_type
+  parser::yytranslate_ (int t) YY_NOEXCEPT
   {
+    // YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to
+    // TOKEN-NUM as returned by yylex.
     static
-    const token_number_type
+    const signed char
     translate_table[] =
     {
-           0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-      21,    22,     2,     2,     2,     2,     2,     2,     2,     2,
+      29,    30,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -1046,36 +1237,29 @@ else
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    16,    17,    18,    19,    20
+      15,    16,    17,    18,    19,    20,    21,    22,    23,    24,
+      25,    26,    27,    28
     };
-    if ((unsigned int) t <= yyuser_token_number_max_)
-      return translate_table[t];
+    // Last valid token kind.
+    const int code_max = 283;
+
+    if (t <= 0)
+      return symbol_kind::S_YYEOF;
+    else if (t <= code_max)
+      return static_cast <symbol_kind_type> (translate_table[t]);
     else
-      return yyundef_token_;
+      return symbol_kind::S_YYUNDEF;
   }
 
-  const int parser::yyeof_ = 0;
-  const int parser::yylast_ = 57;
-  const int parser::yynnts_ = 12;
-  const int parser::yyempty_ = -2;
-  const int parser::yyfinal_ = 23;
-  const int parser::yyterror_ = 1;
-  const int parser::yyerrcode_ = 256;
-  const int parser::yyntokens_ = 23;
-
-  const unsigned int parser::yyuser_token_number_max_ = 275;
-  const parser::token_number_type parser::yyundef_token_ = 2;
-
-
+#line 5 "grammar.yy"
 } // loos
-/* Line 1141 of lalr1.cc  */
-#line 1073 "grammar.cc"
-/* Line 1142 of lalr1.cc  */
-#line 151 "grammar.yy"
+#line 1257 "grammar.cc"
+
+#line 180 "grammar.yy"
 
 
 
-void loos::parser::error(const loos::location& loc, const std::string& s = "unknown error") {
+void loos::parser::error(const loos::location& loc, const std::string& s) {
   std::cerr << "***ERROR***  Bad selection syntax - " << s << std::endl;
 }
 
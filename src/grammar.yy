@@ -1,6 +1,8 @@
+%require "3.0"
 %skeleton "lalr1.cc"
 %defines
-%name-prefix="loos"
+%locations
+%define api.namespace {loos}
 
 
 %{
@@ -25,6 +27,7 @@ namespace loos {
 {
 	std::string *sval;
 	int ival;
+	double dval;
 };
 
 %{
@@ -35,7 +38,7 @@ namespace loos {
 #include "Kernel.hpp"
 
 #undef yylex
-#define yylex driver.lexer->looslex
+#define yylex(yylval, yylloc) driver.lexer->looslex(yylval)
 
 
 namespace loos {
@@ -47,6 +50,7 @@ namespace loos {
 
 %token		END	0
 %token <ival>	NUMBER
+%token <dval>	FLOAT
 %token <sval>	STRING
 %token <sval>   SKEY
 %token <sval>   NKEY
@@ -67,10 +71,20 @@ namespace loos {
 %token NEKEY "->"
 %token NOT "!"
 
+%token WITHIN
+%token AROUND
+%token OF
+%token SAME
+%token AS
+%token RESIDUE
+%token MOLECULE
+
 %left "&&" "||"
 %left "<" "<=" ">=" ">" "==" "!=" "=~"
 
 %type <sval> string alphid strval
+%type <dval> distance
+%type <ival> mark
 
 %destructor { delete $$; } STRING string strval SKEY NKEY
 
@@ -95,9 +109,24 @@ rexpr : '(' expr ')'
       | ALL { driver.kern.push(new internal::logicalTrue); }
       | HYDROGEN { driver.kern.push(new internal::Hydrogen); }
       | BACKBONE { driver.kern.push(new internal::Backbone); }
+      | WITHIN distance OF mark rexpr { driver.kern.push(new internal::withinSelection($2, driver.kern.split($4), false)); }
+      | AROUND distance OF mark rexpr { driver.kern.push(new internal::withinSelection($2, driver.kern.split($4), true)); }
+      | SAME RESIDUE AS mark rexpr { driver.kern.push(new internal::sameResidueAs(driver.kern.split($4))); }
+      | SAME MOLECULE AS mark rexpr { driver.kern.push(new internal::sameMoleculeAs(driver.kern.split($4))); }
       ;
 
 
+/* Spatial operators compile their subselection into a separate
+Kernel.  The mark records where the subselection's commands begin in
+the current Kernel so they can be split off once it has been parsed. */
+
+mark    : %empty        { $$ = driver.kern.size(); } ;
+
+distance : NUMBER       { $$ = $1; }
+         | FLOAT        { $$ = $1; }
+         ;
+
+
 value : '(' value ')' | numeric | alpha | numex;
 
 numeric : number | numid;
@@ -151,7 +180,7 @@ else
 %%
 
 
-void loos::parser::error(const loos::location& loc, const std::string& s = "unknown error") {
+void loos::parser::error(const loos::location& loc, const std::string& s) {
   std::cerr << "***ERROR***  Bad selection syntax - " << s << std::endl;
 }
 
@@ -0,0 +1,499 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <lct.hpp>
+#include <exceptions.hpp>
+#include <utils.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    namespace lct {
+
+      namespace {
+
+        const uint group_size = 32;
+
+        // Largest magnitude allowed for a rounded coordinate, so the
+        // difference between two of them still fits in an int
+        const double max_quantized = 1073741823.0;
+
+
+        // Maps small negative and positive differences to small
+        // unsigned values (0, -1, 1, -2, ... => 0, 1, 2, 3, ...)
+        inline unsigned int zigzag(const int i) {
+          return((static_cast<unsigned int>(i) << 1) ^ static_cast<unsigned int>(i >> 31));
+        }
+
+        inline int unzigzag(const unsigned int u) {
+          return(static_cast<int>(u >> 1) ^ -static_cast<int>(u & 1));
+        }
+
+
+        // Copies a value out of the file's bytes, swapping them if the
+        // file came from a machine with the other byte order
+        template<typename T>
+        inline void get(T& v, const char* p, const bool swapped) {
+          memcpy(&v, p, sizeof(T));
+          if (swapped)
+            v = swab(v);
+        }
+
+
+        inline int quantize(const float x, const double precision) {
+          double v = x * precision;
+          if (fabs(v) > max_quantized)
+            throw(LOOSError("Coordinate is too large to be stored in an LCT trajectory at this precision"));
+          return(static_cast<int>(floor(v + 0.5)));
+        }
+
+
+        // Writes the number of bits needed by the largest of the n
+        // values, followed by the values packed at that width
+        char* packGroup(const unsigned int* v, const uint n, char* dst) {
+          unsigned int all = 0;
+          for (uint i=0; i<n; ++i)
+            all |= v[i];
+
+          uint bits = 0;
+          while (all) {
+            ++bits;
+            all >>= 1;
+          }
+          *dst++ = bits;
+
+          unsigned long long acc = 0;
+          uint nbits = 0;
+          for (uint i=0; i<n; ++i) {
+            acc |= static_cast<unsigned long long>(v[i]) << nbits;
+            nbits += bits;
+            while (nbits >= 8) {
+              *dst++ = acc & 0xff;
+              acc >>= 8;
+              nbits -= 8;
+            }
+          }
+          if (nbits > 0)
+            *dst++ = acc & 0xff;
+
+          return(dst);
+        }
+
+
+        const char* unpackGroup(const char* src, const char* end, const uint n, unsigned int* v) {
+          if (src >= end)
+            throw(LOOSError("Corrupted LCT chunk"));
+
+          uint bits = static_cast<unsigned char>(*src++);
+          if (bits > 32 || src + (n * bits + 7) / 8 > end)
+            throw(LOOSError("Corrupted LCT chunk"));
+
+          unsigned long long mask = (1ull << bits) - 1;
+          unsigned long long acc = 0;
+          uint nbits = 0;
+          for (uint i=0; i<n; ++i) {
+            while (nbits < bits) {
+              acc |= static_cast<unsigned long long>(static_cast<unsigned char>(*src++)) << nbits;
+              nbits += 8;
+            }
+            v[i] = acc & mask;
+            acc >>= bits;
+            nbits -= bits;
+          }
+
+          return(src);
+        }
+
+      }
+
+
+      size_t maxChunkSize(const uint n, const float precision) {
+        if (precision == 0.0)
+          return(n * 3 * sizeof(float));
+        if (n == 0)
+          return(0);
+
+        size_t values = 3 * (n - 1);
+        size_t groups = (values + group_size - 1) / group_size;
+        return(3 * sizeof(int) + groups + values * sizeof(int));
+      }
+
+
+      // The first atom is stored as is.  Each following coordinate is
+      // stored as its difference from the same coordinate of the
+      // previous atom, since atoms that are next to each other in a
+      // structure are usually close in space.
+      size_t encodeChunk(const float* xyz, const uint n, const float precision, char* dst) {
+        if (precision == 0.0) {
+          memcpy(dst, xyz, n * 3 * sizeof(float));
+          return(n * 3 * sizeof(float));
+        }
+        if (n == 0)
+          return(0);
+
+        char* p = dst;
+        int prev[3];
+        for (uint k=0; k<3; ++k) {
+          prev[k] = quantize(xyz[k], precision);
+          memcpy(p, prev + k, sizeof(int));
+          p += sizeof(int);
+        }
+
+        unsigned int group[group_size];
+        uint m = 0;
+        for (uint i=3; i<3*n; ++i) {
+          int q = quantize(xyz[i], precision);
+          group[m++] = zigzag(q - prev[i % 3]);
+          prev[i % 3] = q;
+
+          if (m == group_size) {
+            p = packGroup(group, m, p);
+            m = 0;
+          }
+        }
+        if (m > 0)
+          p = packGroup(group, m, p);
+
+        return(p - dst);
+      }
+
+
+      void decodeChunk(const char* src, const size_t size, const uint n, const float precision, float* xyz,
+                       const bool swapped) {
+        if (precision == 0.0) {
+          if (size != n * 3 * sizeof(float))
+            throw(LOOSError("Corrupted LCT chunk"));
+          memcpy(xyz, src, size);
+          if (swapped)
+            for (uint i=0; i<3*n; ++i)
+              xyz[i] = swab(xyz[i]);
+          return;
+        }
+        if (n == 0)
+          return;
+
+        const char* end = src + size;
+        if (size < 3 * sizeof(int))
+          throw(LOOSError("Corrupted LCT chunk"));
+
+        double scale = 1.0 / precision;
+        int prev[3];
+        for (uint k=0; k<3; ++k) {
+          get(prev[k], src, swapped);
+          src += sizeof(int);
+          xyz[k] = prev[k] * scale;
+        }
+
+        unsigned int group[group_size];
+        for (uint i=3; i<3*n; i += group_size) {
+          uint m = std::min(group_size, 3*n - i);
+          src = unpackGroup(src, end, m, group);
+          for (uint j=0; j<m; ++j) {
+            uint k = (i + j) % 3;
+            prev[k] += unzigzag(group[j]);
+            xyz[i + j] = prev[k] * scale;
+          }
+        }
+      }
+
+    }
+
+  }
+
+
+
+  void LCT::init() {
+    using namespace internal::lct;
+
+    natoms_ = 0;
+    chunk_atoms_ = 0;
+    precision_ = 0.0;
+    periodic_ = false;
+    timestep_ = 0.0;
+    swabbing_ = false;
+    data_end_ = header_size;
+    step_ = 0;
+    time_ = 0.0;
+
+    ifs->seekg(0, std::ios_base::end);
+    unsigned long long file_size = ifs->tellg();
+    ifs->seekg(0);
+
+    char buf[header_size];
+    ifs->read(buf, header_size);
+    if (ifs->fail() || memcmp(buf, magic, sizeof(magic)))
+      throw(FileOpenError(_filename, "Not a LOOS LCT trajectory"));
+
+    uint ver, order, flags;
+    double dt;
+    const char* p = buf + sizeof(magic);
+    memcpy(&order, p + 4, 4);
+    if (order == swab(byte_order))
+      swabbing_ = true;
+    else if (order != byte_order)
+      throw(FileOpenError(_filename, "Corrupted LCT header"));
+
+    get(ver, p, swabbing_);
+    get(natoms_, p + 8, swabbing_);
+    get(chunk_atoms_, p + 12, swabbing_);
+    get(precision_, p + 16, swabbing_);
+    get(flags, p + 20, swabbing_);
+    get(dt, p + 24, swabbing_);
+
+    if (ver != version)
+      throw(FileOpenError(_filename, "Unsupported LCT trajectory version"));
+    if (natoms_ > 0 && chunk_atoms_ == 0)
+      throw(FileOpenError(_filename, "Corrupted LCT header"));
+
+    periodic_ = flags & periodic_flag;
+    timestep_ = dt;
+
+    uint nchunks = natoms_ ? (natoms_ + chunk_atoms_ - 1) / chunk_atoms_ : 0;
+    chunk_sizes_.resize(nchunks);
+    chunk_starts_.resize(nchunks);
+    decoded_.assign(nchunks, 0);
+    xyz_.resize(3 * natoms_);
+
+    if (!readIndex(file_size))
+      scanFrames(file_size);
+
+    rewindImpl();
+    parseFrame();
+    cached_first = true;
+  }
+
+
+  // The index is only used if it accounts for the whole end of the
+  // file.  Otherwise it is stale (or not there) and the frames are
+  // found by scanning.
+  bool LCT::readIndex(const unsigned long long file_size) {
+    using namespace internal::lct;
+
+    if (file_size < header_size + trailer_size)
+      return(false);
+
+    char buf[trailer_size];
+    ifs->clear();
+    ifs->seekg(file_size - trailer_size);
+    ifs->read(buf, trailer_size);
+    if (ifs->fail() || memcmp(buf + 16, index_magic, sizeof(index_magic)))
+      return(false);
+
+    unsigned long long n, offset;
+    get(n, buf, swabbing_);
+    get(offset, buf + 8, swabbing_);
+    if (offset < header_size || offset + n * 8 + trailer_size != file_size)
+      return(false);
+
+    frame_offsets_.resize(n);
+    ifs->seekg(offset);
+    if (n > 0)
+      ifs->read(reinterpret_cast<char*>(&frame_offsets_[0]), n * 8);
+    if (swabbing_)
+      for (unsigned long long i=0; i<n; ++i)
+        frame_offsets_[i] = swab(frame_offsets_[i]);
+    if (ifs->fail() || (n > 0 && frame_offsets_.back() >= offset)) {
+      frame_offsets_.clear();
+      return(false);
+    }
+
+    data_end_ = offset;
+    return(true);
+  }
+
+
+  // Walk the frames using their sizes, stopping at the first one that
+  // is incomplete or whose size doesn't match its chunk table
+  void LCT::scanFrames(const unsigned long long file_size) {
+    using namespace internal::lct;
+
+    uint nchunks = chunk_sizes_.size();
+    uint fixed = 16 + (periodic_ ? 24 : 0) + 4 * nchunks;
+    std::vector<char> buf(fixed);
+    unsigned long long pos = header_size;
+    frame_offsets_.clear();
+
+    ifs->clear();
+    while (pos + fixed <= file_size) {
+      ifs->seekg(pos);
+      ifs->read(&buf[0], fixed);
+      if (ifs->fail())
+        break;
+
+      uint size;
+      get(size, &buf[0], swabbing_);
+      unsigned long long total = fixed;
+      for (uint i=0; i<nchunks; ++i) {
+        uint n;
+        get(n, &buf[fixed - 4 * (nchunks - i)], swabbing_);
+        total += n;
+      }
+      if (total != size || pos + size > file_size)
+        break;
+
+      frame_offsets_.push_back(pos);
+      pos += size;
+    }
+
+    data_end_ = pos;
+    ifs->clear();
+  }
+
+
+  bool LCT::parseFrame() {
+    using namespace internal::lct;
+
+    if (_current_frame >= nframes())
+      return(false);
+
+    // Step, time, box, and chunk sizes (after the frame size)
+    uint nchunks = chunk_sizes_.size();
+    size_t fixed = 12 + (periodic_ ? 24 : 0) + 4 * nchunks;
+
+    uint size;
+    ifs->read(reinterpret_cast<char*>(&size), 4);
+    if (ifs->fail())
+      throw(FileReadError(_filename, "Cannot read LCT frame"));
+    if (swabbing_)
+      size = swab(size);
+    if (size < 4 + fixed)
+      throw(FileReadError(_filename, "Corrupted LCT frame"));
+
+    data_.resize(size - 4);
+    ifs->read(&data_[0], size - 4);
+    if (ifs->fail())
+      throw(FileReadError(_filename, "Cannot read LCT frame"));
+
+    const char* p = &data_[0];
+    get(step_, p, swabbing_);
+    get(time_, p + 4, swabbing_);
+    p += 12;
+    if (periodic_) {
+      double box[3];
+      for (uint i=0; i<3; ++i)
+        get(box[i], p + 8 * i, swabbing_);
+      box_ = GCoord(box[0], box[1], box[2]);
+      p += sizeof(box);
+    }
+
+    size_t start = fixed;
+    for (uint i=0; i<nchunks; ++i) {
+      get(chunk_sizes_[i], p, swabbing_);
+      p += 4;
+      chunk_starts_[i] = start;
+      start += chunk_sizes_[i];
+    }
+    if (start != data_.size())
+      throw(FileReadError(_filename, "Corrupted LCT frame"));
+
+    decoded_.assign(nchunks, 0);
+    return(true);
+  }
+
+
+  void LCT::decode(const uint chunk) const {
+    uint first = chunk * chunk_atoms_;
+    uint n = std::min(chunk_atoms_, natoms_ - first);
+
+    internal::lct::decodeChunk(&data_[chunk_starts_[chunk]], chunk_sizes_[chunk], n, precision_, &xyz_[3 * first], swabbing_);
+    decoded_[chunk] = 1;
+  }
+
+
+  void LCT::decodeAll() const {
+    for (uint i=0; i<decoded_.size(); ++i)
+      if (!decoded_[i])
+        decode(i);
+  }
+
+
+  uint LCT::chunksDecoded() const {
+    uint n = 0;
+    for (uint i=0; i<decoded_.size(); ++i)
+      n += decoded_[i];
+    return(n);
+  }
+
+
+  std::vector<GCoord> LCT::coords() const {
+    decodeAll();
+
+    std::vector<GCoord> res(natoms_);
+    for (uint i=0, k=0; i<natoms_; ++i, k += 3)
+      res[i] = GCoord(xyz_[k], xyz_[k+1], xyz_[k+2]);
+    return(res);
+  }
+
+
+  void LCT::seekFrameImpl(const uint i) {
+    if (i >= nframes())
+      throw(FileError(_filename, "Requested LCT frame is out of range"));
+
+    ifs->clear();
+    ifs->seekg(frame_offsets_[i]);
+  }
+
+
+  // Only the chunks holding the group's atoms are decoded
+  void LCT::updateGroupCoordsImpl(AtomicGroup& g) {
+    for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
+      uint idx = (*i)->index();
+      if (idx >= natoms_)
+        throw(LOOSError(**i, "Atom index into trajectory frame is out of bounds"));
+
+      uint chunk = idx / chunk_atoms_;
+      if (!decoded_[chunk])
+        decode(chunk);
+
+      idx *= 3;
+      (*i)->coords(GCoord(xyz_[idx], xyz_[idx+1], xyz_[idx+2]));
+    }
+
+    if (periodic_)
+      g.periodicBox(box_);
+  }
+
+
+  void LCT::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+    if (!plan.empty()) {
+      const std::vector<uint>& indices = plan.uniqueIndices();
+      for (std::vector<uint>::const_iterator i = indices.begin(); i != indices.end(); ++i) {
+        uint chunk = *i / chunk_atoms_;
+        if (!decoded_[chunk])
+          decode(chunk);
+      }
+
+      plan.scatterInterleaved(g, &xyz_[0]);
+    }
+
+    if (periodic_)
+      g.periodicBox(box_);
+  }
+
+}
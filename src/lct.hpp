@@ -0,0 +1,203 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_LCT_HPP)
+#define LOOS_LCT_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <Coord.hpp>
+#include <AtomicGroup.hpp>
+#include <Trajectory.hpp>
+
+
+namespace loos {
+
+  namespace internal {
+
+    //! Layout and coordinate encoding of LCT trajectories (see LCT)
+    namespace lct {
+
+      const char magic[8] = { 'L', 'O', 'O', 'S', '-', 'L', 'C', 'T' };
+      const char index_magic[8] = { 'L', 'C', 'T', 'I', 'N', 'D', 'E', 'X' };
+      const uint version = 1;
+      const uint byte_order = 0x01020304;
+
+      // magic, version, byte order, natoms, chunk atoms, precision, flags, timestep
+      const uint header_size = 8 + 6 * 4 + 8;
+      // frame count, offset of the index, index magic
+      const uint trailer_size = 8 + 8 + 8;
+
+      const uint periodic_flag = 0x01;
+
+      //! Upper bound on the bytes needed to encode \a n atoms
+      size_t maxChunkSize(const uint n, const float precision);
+
+      //! Encodes \a n atoms (interleaved xyz) at \a dst, returning the bytes used
+      /**
+       * With a precision of 0, the coordinates are stored as floats.
+       * Otherwise each is rounded to the nearest 1/precision Angstroms.
+       */
+      size_t encodeChunk(const float* xyz, const uint n, const float precision, char* dst);
+
+      //! Decodes \a n atoms from the \a size bytes at \a src into \a xyz
+      /**
+       * \a swapped means the chunk was written on a machine with the
+       * other byte order.
+       */
+      void decodeChunk(const char* src, const size_t size, const uint n, const float precision, float* xyz,
+                       const bool swapped = false);
+    }
+
+  }
+
+
+  //! LOOS compressed trajectory
+  /**
+   * A LOOS-native format with XTC-like size and DCD-like random access
+   * (see LCTWriter for writing).  Each frame is split into chunks of
+   * consecutive atoms that are compressed independently.  Unless the
+   * trajectory was written losslessly (a precision of 0), coordinates
+   * are rounded to a fixed precision (1/precision Angstroms), stored
+   * as differences from the previous atom in the chunk, and bit-packed
+   * in groups of 32 values.
+   *
+   * Reading a frame only reads its compressed data.  Chunks are decoded
+   * when their atoms are first needed, so updating a small subset
+   * (e.g. the protein in a large solvated system) only decodes the
+   * chunks that hold its atoms.  The end of the file holds an index of
+   * frame offsets, so seeking to a frame does not require a scan.  If
+   * the index is missing (e.g. the writer did not finish), the frames
+   * are found by walking the file instead.
+   *
+   * The file is written in the byte order of the machine that wrote it.
+   * Files from a machine with the other byte order are byte-swapped as
+   * they are read.
+   *
+   * File layout:
+   * \verbatim
+   header   "LOOS-LCT", version, byte order, natoms, atoms per chunk,
+            precision, flags, timestep
+   frames   size of frame in bytes, step, time, box (if periodic),
+            size of each chunk in bytes, chunk data
+   index    offset of each frame, number of frames, offset of index, "LCTINDEX"
+   \endverbatim
+   */
+  class LCT : public Trajectory {
+  public:
+    explicit LCT(const std::string& s) : Trajectory(s) {
+      init();
+    }
+
+    explicit LCT(std::istream& is) : Trajectory(is) {
+      init();
+    }
+
+    std::string description() const { return("LOOS compressed trajectory"); }
+    static pTraj create(const std::string& fname, const AtomicGroup& model) {
+      return(pTraj(new LCT(fname)));
+    }
+
+    uint natoms() const { return(natoms_); }
+    float timestep() const { return(timestep_); }
+    uint nframes() const { return(frame_offsets_.size()); }
+
+    bool hasPeriodicBox() const { return(periodic_); }
+    GCoord periodicBox() const { return(box_); }
+
+    //! Decodes the entire frame
+    std::vector<GCoord> coords() const;
+
+    //! Step of the current frame
+    uint step() const { return(step_); }
+
+    //! Time of the current frame
+    double time() const { return(time_); }
+
+    //! Steps per Angstrom coordinates are rounded to (0 if stored as floats)
+    float precision() const { return(precision_); }
+
+    //! Atoms per compressed chunk
+    uint chunkAtoms() const { return(chunk_atoms_); }
+
+    //! Number of chunks in each frame
+    uint nchunks() const { return(chunk_sizes_.size()); }
+
+    //! Number of chunks decoded for the current frame so far
+    uint chunksDecoded() const;
+
+    //! File offset of the start of each frame
+    const std::vector<unsigned long long>& frameOffsets() const { return(frame_offsets_); }
+
+    //! Whether the file is in this machine's byte order
+    bool nativeByteOrder() const { return(!swabbing_); }
+
+    //! File offset of the end of the last frame
+    unsigned long long dataEnd() const { return(data_end_); }
+
+    bool parseFrame();
+
+  private:
+    void init();
+    bool readIndex(const unsigned long long file_size);
+    void scanFrames(const unsigned long long file_size);
+    void decode(const uint chunk) const;
+    void decodeAll() const;
+
+    void rewindImpl() { ifs->clear(); ifs->seekg(internal::lct::header_size); }
+    void seekNextFrameImpl() { }
+    void seekFrameImpl(const uint);
+    void updateGroupCoordsImpl(AtomicGroup& g);
+    void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
+
+  private:
+    uint natoms_;
+    uint chunk_atoms_;
+    float precision_;
+    bool periodic_;
+    float timestep_;
+    bool swabbing_;                           // File is not in native byte order
+
+    std::vector<unsigned long long> frame_offsets_;
+    unsigned long long data_end_;
+
+    // The current frame.  Chunks are decoded on demand, so these
+    // change in const functions.
+    uint step_;
+    double time_;
+    GCoord box_;
+    std::vector<char> data_;                  // Compressed chunks
+    std::vector<uint> chunk_sizes_;
+    std::vector<size_t> chunk_starts_;        // Offset of each chunk in data_
+    mutable std::vector<float> xyz_;
+    mutable std::vector<char> decoded_;
+  };
+
+}
+
+
+#endif
@@ -0,0 +1,260 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <cstring>
+
+#include <lctwriter.hpp>
+#include <lct.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+
+  void LCTWriter::init() {
+    dt_ = 1.0;
+    step_ = 0;
+    steps_per_frame_ = 1;
+    natoms_ = 0;
+    periodic_ = false;
+    header_written_ = false;
+    index_written_ = false;
+    data_end_ = file_end_ = 0;
+    buffer_bytes_ = 0;
+    staged_ = 0;
+
+    if (precision_ < 0.0)
+      throw(LOOSError("LCT precision cannot be negative"));
+    if (chunk_atoms_ == 0)
+      throw(LOOSError("LCT chunks must hold at least one atom"));
+
+    if (appending_)
+      prepareToAppend();
+  }
+
+
+  LCTWriter::~LCTWriter() {
+    try {
+      // Even an empty trajectory gets a header, so it can be read
+      if (!header_written_)
+        writeHeader(AtomicGroup());
+      flush();
+    }
+    catch(...) {
+      std::cerr << "Warning- error while finishing LCT '" << _filename << "'" << std::endl;
+    }
+  }
+
+
+  void LCTWriter::writeHeader(const AtomicGroup& model) {
+    using namespace internal::lct;
+
+    natoms_ = model.size();
+    periodic_ = model.isPeriodic();
+
+    uint flags = periodic_ ? periodic_flag : 0;
+    double dt = dt_ * steps_per_frame_;
+
+    char buf[header_size];
+    char* p = buf;
+    memcpy(p, magic, sizeof(magic));
+    p += sizeof(magic);
+    memcpy(p, &version, 4);
+    memcpy(p + 4, &byte_order, 4);
+    memcpy(p + 8, &natoms_, 4);
+    memcpy(p + 12, &chunk_atoms_, 4);
+    memcpy(p + 16, &precision_, 4);
+    memcpy(p + 20, &flags, 4);
+    memcpy(p + 24, &dt, 8);
+
+    stream_->seekp(0);
+    stream_->write(buf, header_size);
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT header"));
+
+    data_end_ = file_end_ = header_size;
+    header_written_ = true;
+  }
+
+
+  // Frames are encoded into the staging buffer.  Each frame starts with
+  // its size and a table of its chunk sizes, so a reader can find any
+  // chunk without decoding the others.
+  void LCTWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
+    using namespace internal::lct;
+
+    if (!header_written_)
+      writeHeader(model);
+    else {
+      if (model.size() != natoms_)
+        throw(LOOSError("Frame group atom count mismatch"));
+      if (periodic_ && !model.isPeriodic())
+        throw(LOOSError("Periodic box data was requested for the LCT but the passed frame is missing it"));
+    }
+
+    crds_.resize(3 * natoms_);
+    for (uint i=0, k=0; i<natoms_; ++i) {
+      const GCoord& c = model[i]->coords();
+      crds_[k++] = c.x();
+      crds_[k++] = c.y();
+      crds_[k++] = c.z();
+    }
+
+    uint nchunks = natoms_ ? (natoms_ + chunk_atoms_ - 1) / chunk_atoms_ : 0;
+    size_t fixed = 16 + (periodic_ ? 24 : 0) + 4 * nchunks;
+    size_t max_size = fixed;
+    for (uint i=0; i<nchunks; ++i)
+      max_size += maxChunkSize(std::min(chunk_atoms_, natoms_ - i * chunk_atoms_), precision_);
+
+    size_t m = buffer_.size();
+    buffer_.resize(m + max_size);
+    char* frame = &buffer_[m];
+
+    memcpy(frame + 4, &step, 4);
+    memcpy(frame + 8, &time, 8);
+    char* table = frame + 16;
+    if (periodic_) {
+      GCoord box = model.periodicBox();
+      double b[3] = { box[0], box[1], box[2] };
+      memcpy(table, b, sizeof(b));
+      table += sizeof(b);
+    }
+
+    char* p = frame + fixed;
+    for (uint i=0; i<nchunks; ++i) {
+      uint first = i * chunk_atoms_;
+      uint n = std::min(chunk_atoms_, natoms_ - first);
+      uint size = encodeChunk(&crds_[3 * first], n, precision_, p);
+      memcpy(table + 4 * i, &size, 4);
+      p += size;
+    }
+
+    uint size = p - frame;
+    memcpy(frame, &size, 4);
+    buffer_.resize(m + size);
+
+    offsets_.push_back(data_end_ + m);
+    ++staged_;
+
+    if (buffer_bytes_ == 0 || buffer_.size() + size > buffer_bytes_)
+      writeStaged();
+  }
+
+
+  void LCTWriter::writeFrame(const AtomicGroup& model) {
+    writeFrame(model, step_, dt_ * step_);
+    step_ += steps_per_frame_;
+  }
+
+
+  void LCTWriter::writeStaged() {
+    if (staged_ == 0)
+      return;
+
+    // New frames go where the index is, so mark the index as no longer
+    // valid (by clearing its magic) in case the writer never gets to
+    // write a new one
+    char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    if (file_end_ >= data_end_ + sizeof(zeros)) {
+      stream_->seekp(file_end_ - sizeof(zeros));
+      stream_->write(zeros, sizeof(zeros));
+    }
+    index_written_ = false;
+
+    stream_->seekp(data_end_);
+    stream_->write(&buffer_[0], buffer_.size());
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT frames"));
+
+    data_end_ += buffer_.size();
+    if (data_end_ > file_end_)
+      file_end_ = data_end_;
+
+    buffer_.clear();
+    staged_ = 0;
+  }
+
+
+  // The index follows the last frame
+  void LCTWriter::writeIndex() {
+    using namespace internal::lct;
+
+    unsigned long long n = offsets_.size();
+
+    stream_->seekp(data_end_);
+    if (n > 0)
+      stream_->write(reinterpret_cast<const char*>(&offsets_[0]), n * 8);
+    stream_->write(reinterpret_cast<const char*>(&n), 8);
+    stream_->write(reinterpret_cast<const char*>(&data_end_), 8);
+    stream_->write(index_magic, sizeof(index_magic));
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing LCT frame index"));
+
+    unsigned long long end = data_end_ + n * 8 + trailer_size;
+    if (end > file_end_)
+      file_end_ = end;
+    index_written_ = true;
+  }
+
+
+  void LCTWriter::bufferOutput(const size_t nbytes) {
+    if (nbytes == 0)
+      writeStaged();
+    buffer_bytes_ = nbytes;
+  }
+
+
+  void LCTWriter::flush() {
+    if (!header_written_)
+      return;
+
+    writeStaged();
+    if (!index_written_)
+      writeIndex();
+    stream_->flush();
+  }
+
+
+  // Read the existing LCT to get its layout and frames.  New frames are
+  // written over its index.
+  void LCTWriter::prepareToAppend() {
+    stream_->seekg(0, std::ios_base::end);
+    file_end_ = stream_->tellg();
+    stream_->seekg(0);
+
+    LCT lct(*stream_);
+    if (!lct.nativeByteOrder())
+      throw(FileOpenError(_filename, "Cannot append to an LCT trajectory written with a different byte order"));
+    natoms_ = lct.natoms();
+    periodic_ = lct.hasPeriodicBox();
+    precision_ = lct.precision();
+    chunk_atoms_ = lct.chunkAtoms();
+    offsets_ = lct.frameOffsets();
+    data_end_ = lct.dataEnd();
+
+    // A trajectory with no frames may not have had a group to size it
+    header_written_ = !(offsets_.empty() && natoms_ == 0);
+    index_written_ = (data_end_ + offsets_.size() * 8 + internal::lct::trailer_size == file_end_);
+  }
+
+}
@@ -0,0 +1,166 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_LCTWRITER_HPP)
+#define LOOS_LCTWRITER_HPP
+
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <trajwriter.hpp>
+
+
+namespace loos {
+
+
+  //! Class for writing LOOS compressed (LCT) trajectories
+  /**
+   * See LCT for a description of the format.  The \a precision is the
+   * number of steps per Angstrom coordinates are rounded to, so the
+   * default of 100 keeps coordinates to within 0.005 Angstroms (the
+   * same as an XTC at its default precision).  A precision of 0 stores
+   * the coordinates as floats without any loss.  Each frame is split
+   * into chunks of \a chunk_atoms atoms.  Smaller chunks let readers
+   * decode small subsets with less work, but compress slightly less.
+   *
+   * The number of atoms and whether there is a periodic box come from
+   * the first frame written.  When appending, the precision and chunk
+   * size of the existing trajectory are used (and it must be in this
+   * machine's byte order).
+   *
+   * As with XTCWriter, the step and time for each frame come from the
+   * timePerStep() and stepsPerFrame() counters unless they are passed
+   * to writeFrame() explicitly.
+   *
+   * The frame index at the end of the file is written by flush() and
+   * when the writer is destroyed.  Until then, readers find the frames
+   * by scanning.  After bufferOutput(), frames are staged in memory
+   * and written in blocks of about the requested size.
+   */
+  class LCTWriter : public TrajectoryWriter {
+  public:
+
+    //! Class factory function
+    static pTrajectoryWriter create(const std::string& s, const bool append = false) {
+      return(pTrajectoryWriter(new LCTWriter(s, append)));
+    }
+
+
+    explicit LCTWriter(const std::string& fname, const bool append = false) :
+      TrajectoryWriter(fname, append),
+      precision_(100.0), chunk_atoms_(1024)
+    {
+      init();
+    }
+
+
+    LCTWriter(const std::string& fname, const float precision, const uint chunk_atoms = 1024, const bool append = false) :
+      TrajectoryWriter(fname, append),
+      precision_(precision), chunk_atoms_(chunk_atoms)
+    {
+      init();
+    }
+
+
+    //! Writes any staged frames and the frame index
+    ~LCTWriter();
+
+
+    //! Get the time per step
+    double timePerStep() const { return(dt_); }
+
+    //! Set the time per step
+    void timePerStep(const double dt) { dt_ = dt; }
+
+    //! How many steps per frame written
+    uint stepsPerFrame() const { return(steps_per_frame_); }
+
+    //! Set how many steps pass per frame written
+    void stepsPerFrame(const uint s) { steps_per_frame_ = s; }
+
+    //! What the current output step is
+    uint currentStep() const { return(step_); }
+
+    //! Sets the current output step
+    void currentStep(const uint s) { step_ = s; }
+
+    //! Steps per Angstrom coordinates are rounded to (0 = stored as floats)
+    float precision() const { return(precision_); }
+
+    //! Atoms per compressed chunk
+    uint chunkAtoms() const { return(chunk_atoms_); }
+
+
+    //! Write a frame to the trajectory
+    void writeFrame(const AtomicGroup& model);
+
+    //! Write a frame to the trajectory with explicit step and time metadata
+    void writeFrame(const AtomicGroup& model, const uint step, const double time);
+
+    bool hasFrameStep() const { return(true); }
+    bool hasFrameTime() const { return(true); }
+
+    uint framesWritten() const { return(offsets_.size()); }
+
+    void bufferOutput(const size_t nbytes = 64 * 1024 * 1024);
+
+    //! Write any staged frames and bring the frame index up to date
+    void flush();
+
+  private:
+    void init();
+    void writeHeader(const AtomicGroup& model);
+    void writeStaged();
+    void writeIndex();
+    void prepareToAppend();
+
+  private:
+    float precision_;
+    uint chunk_atoms_;
+    double dt_;
+    uint step_;
+    uint steps_per_frame_;
+
+    uint natoms_;
+    bool periodic_;
+    bool header_written_;
+    bool index_written_;        // The file ends with an index that is up to date
+
+    std::vector<unsigned long long> offsets_;
+    unsigned long long data_end_;          // End of the frames written to the file
+    unsigned long long file_end_;
+
+    size_t buffer_bytes_;
+    uint staged_;
+    std::vector<char> buffer_;
+    std::vector<float> crds_;
+  };
+
+
+}
+
+
+#endif
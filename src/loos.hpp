@@ -67,6 +67,18 @@
 #include <AtomicNumberDeducer.hpp>
 #include <Atom.hpp>
 #include <AtomicGroup.hpp>
+#include <CoordinatePlan.hpp>
+#include <TrajectoryIndex.hpp>
+#include <PrefetchingTrajectory.hpp>
+#include <FrameMapReduce.hpp>
+#include <NeighborGrid.hpp>
+#include <SubsetCache.hpp>
+#include <PairwiseRMSD.hpp>
+#include <RandomizedSVD.hpp>
+#include <CovarianceAccumulator.hpp>
+#include <CoordinateEnsemble.hpp>
+#include <AtomColumns.hpp>
+#include <InternedString.hpp>
 #include <pdb.hpp>
 #include <psf.hpp>
 #include <amber.hpp>
@@ -80,11 +92,15 @@
 #include <trajwriter.hpp>
 #include <dcdwriter.hpp>
 #include <xtcwriter.hpp>
+#include <trrwriter.hpp>
+#include <lctwriter.hpp>
+#include <AsyncTrajectoryWriter.hpp>
 
 #include <amber_traj.hpp>
 
 #if defined(HAS_NETCDF)
 #include <amber_netcdf.hpp>
+#include <amber_netcdf_writer.hpp>
 #endif
 
 #include <amber_rst.hpp>
@@ -94,6 +110,7 @@
 #include <xtc.hpp>
 #include <gro.hpp>
 #include <trr.hpp>
+#include <lct.hpp>
 
 
 
@@ -10,6 +10,7 @@
 
 %include <std_string.i>
 %include <std_vector.i>
+%include <std_pair.i>
 %include <boost_shared_ptr.i>
 
 
@@ -52,6 +53,8 @@ namespace loos {
 %template(DoubleVectorMatrix)   std::vector< std::vector<double> >;
 %template(IntVector)            std::vector<int>;
 %template(UIntVector)           std::vector<uint>;
+%template(UIntPair)             std::pair<uint, uint>;
+%template(UIntPairVector)       std::vector< std::pair<uint, uint> >;
 
 
 
@@ -76,6 +79,8 @@ namespace loos {
 %include "trajwriter.i"
 %include "dcdwriter.i"
 %include "xtcwriter.i"
+%include "trrwriter.i"
+%include "lctwriter.i"
 %include "sfactories.i"
 %include "alignment.i"
 %include "gro.i"
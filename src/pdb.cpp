@@ -23,8 +23,12 @@
 #include <pdb.hpp>
 #include <utils.hpp>
 #include <Fmt.hpp>
+#include <MappedFile.hpp>
+#include <TextParsing.hpp>
 
+#include <algorithm>
 #include <iomanip>
+#include <boost/make_shared.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/format.hpp>
 #include <boost/algorithm/string.hpp>
@@ -59,81 +63,95 @@ namespace loos {
   }
 
 
-  // Parse an ATOM or HETATM record...
-  // Note: ParseErrors can come from parseStringAs
+  // The fixed-column fields of an ATOM record are parsed directly from
+  // the line's characters rather than via parseStringAs(), which
+  // creates a substring and a stream for each field.  A field that
+  // can't be parsed this way is handed to parseStringAs() so that the
+  // result and any error are the same as they have always been.
 
-  void PDB::parseAtomRecord(const std::string& s) {
-    greal r;
-    gint i;
-    std::string t;
-    GCoord c;
-    pAtom pa(new Atom);
+  namespace {
 
-    pa->index(_max_index++);
+    // Same as parseStringAs<std::string>(s, pos, n): all spaces are
+    // removed, and a field that runs off the end of the line is empty.
+    InternedString stringField(const std::string& s, const uint pos, const uint n) {
+      char buf[16];
+
+      if (pos + n > s.size())
+        return(InternedString());
+      return(InternedString(buf, internal::copyWithoutSpaces(s.data() + pos, n, buf)));
+    }
 
-    t = parseStringAs<std::string>(s, 0, 6);
-    pa->recordName(t);
+    int hybrid36Field(const std::string& s, const uint pos, const uint n) {
+      if (pos + n > s.size())
+        return(0);
+      return(parseHybrid36Field(s.data() + pos, n));
+    }
 
-    i = parseStringAsHybrid36(s, 6, 5);
-    pa->id(i);
+    float floatField(const std::string& s, const uint pos, const uint n) {
+      float val;
 
-    t = parseStringAs<std::string>(s, 12, 4);
-    pa->name(t);
+      if (pos < s.size() && internal::parseNumber(s.data() + pos, std::min(n, static_cast<uint>(s.size()) - pos), val))
+        return(val);
+      return(parseStringAs<float>(s, pos, n));
+    }
 
-    t = parseStringAs<std::string>(s, 16, 1);
-    pa->altLoc(t);
+  }
 
-    t = parseStringAs<std::string>(s, 17, 4);
-    pa->resname(t);
 
-    t = parseStringAs<std::string>(s, 21, 1);
-    pa->chainId(t);
+  // Parse an ATOM or HETATM record...
+  // Note: ParseErrors can come from parseStringAs
 
-    i = parseStringAsHybrid36(s, 22, 4);
-    pa->resid(i);
+  void PDB::parseAtomRecord(const std::string& s) {
+    GCoord c;
+    pAtom pa = boost::make_shared<Atom>();
 
-    t = parseStringAs<std::string>(s, 26, 1);
+    pa->index(_max_index++);
+
+    pa->recordName(stringField(s, 0, 6));
+    pa->id(hybrid36Field(s, 6, 5));
+    pa->name(stringField(s, 12, 4));
+    pa->altLoc(stringField(s, 16, 1));
+    pa->resname(stringField(s, 17, 4));
+    pa->chainId(stringField(s, 21, 1));
+    pa->resid(hybrid36Field(s, 22, 4));
+
+    // The iCode field with spaces removed, as parseStringAs would
+    // give it...
+    InternedString icode = stringField(s, 26, 1);
+    char ic = icode.str().c_str()[0];
 
     // Special handling of resid field since it may be frame-shifted by
     // 1 col in some cases...
     if (strictness_policy) {
-      char c = t[0];
-
-      if (c != ' ' && !isalpha(c))
+      if (ic != ' ' && !isalpha(ic))
         throw(ParseError("Non-alpha character in iCode column of PDB"));
     } else {
-      char c = t[0];
 
       // Assume that if we see this variant, then we're not using hybrid-36
-      if (c != ' ' && isdigit(c)) {
-        i = parseStringAs<int>(s, 22, 5);
-        pa->resid(i);
-        t = " ";
+      if (ic != ' ' && isdigit(ic)) {
+        pa->resid(parseStringAs<int>(s, 22, 5));
+        icode = InternedString(" ", 1);
       }
 
     }
-    pa->iCode(t);
+    pa->iCode(icode);
 
-    c[0] = parseStringAs<float>(s, 30, 8);
-    c[1] = parseStringAs<float>(s, 38, 8);
-    c[2] = parseStringAs<float>(s, 46, 8);
+    c[0] = floatField(s, 30, 8);
+    c[1] = floatField(s, 38, 8);
+    c[2] = floatField(s, 46, 8);
     pa->coords(c);
 
     if (s.size() > 54) {
-      r = parseStringAs<float>(s, 54, 6);
-      pa->occupancy(r);
+      pa->occupancy(floatField(s, 54, 6));
 
       if (s.size() > 60) {
-	r = parseStringAs<float>(s, 60, 6);
-	pa->bfactor(r);
+	pa->bfactor(floatField(s, 60, 6));
 
 	if (s.size() > 72) {
-	  t = parseStringAs<std::string>(s, 72, 4);
-	  pa->segid(t);
+	  pa->segid(stringField(s, 72, 4));
 
 	  if (s.size() > 76) {
-	    t = parseStringAs<std::string>(s, 76, 2);
-	    pa->PDBelement(t);
+	    pa->PDBelement(stringField(s, 76, 2));
 
 	    // Charge is not currently handled...
 	    // t = parseStringAs<std::string>(s, 78, 2);
@@ -148,10 +166,6 @@ namespace loos {
       _missing_q = _missing_b = _missing_segid = true;
     }
     append(pa);
-
-    // Record which pAtom belongs to this atomid.
-    // NOTE: duplicate atomid's are NOT checked for
-    _atomid_to_patom[pa->id()] = pa;
   }
 
 
@@ -208,7 +222,14 @@ namespace loos {
 
   // Private function to search the map of atomid's -> pAtoms
   // Throws an error if the atom is not found
+  //
+  // The map is only needed for CONECT records, so atoms are added to
+  // it here rather than as they're parsed.  Later atoms still replace
+  // earlier ones with the same atomid.
   pAtom PDB::findAtom(const int id) {
+    for (; _ids_mapped < atoms.size(); ++_ids_mapped)
+      _atomid_to_patom[atoms[_ids_mapped]->id()] = atoms[_ids_mapped];
+
     std::map<int, pAtom>::iterator i = _atomid_to_patom.find(id);
     if (i == _atomid_to_patom.end()) {
       std::ostringstream oss;
@@ -330,26 +351,56 @@ namespace loos {
    * Will transform any caught exceptions into a FileReadError
    */
   void PDB::read(std::istream& is) {
+    internal::StreamLines lines(is);
+    readRecords(lines);
+  }
+
+
+  // Regular files are mapped and parsed in place.  Anything else
+  // (e.g. a pipe) is read as a stream.
+
+  void PDB::readFile(const std::string& fname) {
+    if (!MappedFile::isRegularFile(fname)) {
+      std::ifstream ifs(fname.c_str());
+      if (!ifs)
+        throw(FileOpenError(fname));
+      read(ifs);
+      return;
+    }
+
+    MappedFile file(fname);
+    file.adviseSequential();
+
+    internal::MappedLines lines(file);
+    readRecords(lines);
+  }
+
+
+  template<typename Lines>
+  void PDB::readRecords(Lines& lines) {
     std::string input;
     bool has_cryst = false;
     bool has_bonds = false;
     boost::unordered_set<std::string> seen;
 
-    while (getline(is, input)) {
+    // Only atoms read from here on can be bonded by CONECT records
+    _ids_mapped = atoms.size();
+
+    while (lines.next(input)) {
       try {
-	if (input.substr(0, 4) == "ATOM" || input.substr(0,6) == "HETATM")
+	if (input.compare(0, 4, "ATOM") == 0 || input.compare(0, 6, "HETATM") == 0)
 	  parseAtomRecord(input);
-	else if (input.substr(0, 6) == "REMARK")
+	else if (input.compare(0, 6, "REMARK") == 0)
 	  parseRemark(input);
-	else if (input.substr(0,6) == "CONECT") {
+	else if (input.compare(0, 6, "CONECT") == 0) {
 	  has_bonds = true;
 	  parseConectRecord(input);
-	} else if (input.substr(0, 6) == "CRYST1") {
+	} else if (input.compare(0, 6, "CRYST1") == 0) {
 	  parseCryst1Record(input);
 	  has_cryst = true;
-	} else if (input.substr(0,3) == "TER")
+	} else if (input.compare(0, 3, "TER") == 0)
 	  ;
-	else if (input.substr(0,3) == "END")
+	else if (input.compare(0, 3, "END") == 0)
 	  break;
 	else {
 	  int space = input.find_first_of(' ');
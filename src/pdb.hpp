@@ -70,7 +70,7 @@ namespace loos {
     public:
         PDB() : _max_index(0), _show_charge(false), _auto_ter(true), _has_cryst(false),
                 strictness_policy(false), _missing_q(false), _missing_b(false),
-                _missing_segid(false), _fname("<not set>") { }
+                _missing_segid(false), _fname("<not set>"), _ids_mapped(0) { }
         virtual ~PDB() {}
       
         //! Read in PDB from a filename
@@ -78,12 +78,9 @@ namespace loos {
             : _max_index(0), _show_charge(false), _auto_ter(true),
               _has_cryst(false), strictness_policy(false),
               _missing_q(false), _missing_b(false), _missing_segid(false),
-              _fname(fname)
+              _fname(fname), _ids_mapped(0)
         {
-            std::ifstream ifs(fname.c_str());
-            if (!ifs)
-                throw(FileOpenError(fname));
-            read(ifs);
+            readFile(fname);
         }
       
         //! Read in a PDB from an ifstream
@@ -91,7 +88,7 @@ namespace loos {
             : _max_index(0), _show_charge(false), _auto_ter(true),
               _has_cryst(false), strictness_policy(false),
               _missing_q(false), _missing_b(false), _missing_segid(false),              
-              _fname("stream")
+              _fname("stream"), _ids_mapped(0)
         {
             read(ifs);
         }
@@ -153,7 +150,7 @@ namespace loos {
 
 
         //! Create a PDB from an AtomicGroup (i.e. upcast)
-        PDB(const AtomicGroup& grp) : AtomicGroup(grp), _show_charge(false), _auto_ter(true), _has_cryst(false) { }
+        PDB(const AtomicGroup& grp) : AtomicGroup(grp), _show_charge(false), _auto_ter(true), _has_cryst(false), _ids_mapped(0) { }
 
         bool emptyString(const std::string&);
 
@@ -163,6 +160,12 @@ namespace loos {
     bool isMissingFields() const { return(_missing_q || _missing_b || _missing_segid); }
 
 
+        // Reads the file via a memory-mapping
+        void readFile(const std::string& fname);
+
+        // Parses lines from either a stream or a mapped file
+        template<typename Lines> void readRecords(Lines& lines);
+
         // These will modify the PDB upon a successful parse...
         void parseRemark(const std::string&);
         void parseAtomRecord(const std::string&);
@@ -190,6 +193,7 @@ namespace loos {
         Remarks _remarks;
         UnitCell cell;
         std::map<int, pAtom> _atomid_to_patom;
+        uint _ids_mapped;    // Index of the first atom not yet in _atomid_to_patom
     };
 
 }
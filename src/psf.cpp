@@ -21,6 +21,12 @@
 
 #include <psf.hpp>
 #include <exceptions.hpp>
+#include <utils.hpp>
+#include <MappedFile.hpp>
+#include <TextParsing.hpp>
+
+#include <sstream>
+#include <boost/make_shared.hpp>
 
 
 namespace loos {
@@ -41,48 +47,73 @@ namespace loos {
 
 
   void PSF::read(std::istream& is) {
+    internal::StreamLines lines(is);
+    readRecords(lines);
+  }
+
+
+  // Regular files are mapped and parsed in place.  Anything else
+  // (e.g. a pipe) is read as a stream.
+
+  void PSF::readFile(const std::string& fname) {
+    if (!MappedFile::isRegularFile(fname)) {
+      std::ifstream ifs(fname.c_str());
+      if (!ifs)
+        throw(FileOpenError(fname));
+      read(ifs);
+      return;
+    }
+
+    MappedFile file(fname);
+    file.adviseSequential();
+
+    internal::MappedLines lines(file);
+    readRecords(lines);
+  }
+
+
+  template<typename Lines>
+  void PSF::readRecords(Lines& lines) {
     std::string input;
 
     // first line is the PSF header
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "Failed reading first line of psf"));
     if (input.substr(0,3) != "PSF")
       throw(FileReadError(_filename, "PSF detected a non-PSF file"));
 
     // second line is blank
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "PSF failed reading first header blank"));
 
     // third line is title header
-    getline(is, input);
+    lines.next(input);
     int num_title_lines;
     if (!(std::stringstream(input) >> num_title_lines))
       throw(FileReadError(_filename, "PSF has malformed title header"));
 
-    // skip the rest of the title
+    // skip the rest of the title, verifying nothing went wrong
     for (int i=0; i<num_title_lines; i++)
-      getline(is, input);
-
-    // verify nothing went wrong
-    if (!(is.good()))
-      // Yes, I know, I should figure out what went wrong instead
-      // of running home crying.  Sorry, Tod...
-      throw(FileReadError(_filename, "PSF choked reading the header"));
+      if (!lines.next(input))
+        // Yes, I know, I should figure out what went wrong instead
+        // of running home crying.  Sorry, Tod...
+        throw(FileReadError(_filename, "PSF choked reading the header"));
 
     // next line is blank
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "PSF failed reading second header blank"));
 
     // next line is the number of atoms
 
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "PSF failed reading natom line"));
     int num_atoms;
     if (!(std::stringstream(input) >> num_atoms))
       throw(FileReadError(_filename, "PSF has malformed natom line"));
 
+    atoms.reserve(atoms.size() + num_atoms);
     for (int i=0; i<num_atoms; i++) {
-      if (!getline(is, input)) {
+      if (!lines.next(input)) {
 	std::ostringstream oss;
 	oss << "Failed reading PSF atom line for atom #" << (i+1);
         throw(FileReadError(_filename, oss.str()));
@@ -91,31 +122,32 @@ namespace loos {
     }
 
     // next line is blank
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "PSF failed reading blank after atom lines"));
 
     // next block of lines is the list of bonds
     // Bond title line
-    if (!getline(is, input))
+    if (!lines.next(input))
       throw(FileReadError(_filename, "PSF failed reading nbond line"));
     int num_bonds;
     if (!(std::stringstream(input) >> num_bonds))
       throw(FileReadError(_filename, "PSF has malformed nbond line"));
 
     int bonds_found = 0;
-    getline(is, input);
+    lines.next(input);
     while (input.size() > 1) { // end of the block is marked by a blank line
                                // Note: >1 to handle \r in files that came from windows...
-      int ind1, ind2;
-      std::string buf1, buf2;
-      std::stringstream s(input);
+      const char* p = input.data();
+      const char* end = p + input.size();
+      const char *tok1, *tok2;
+      uint len1, len2;
 
-      while (s.good()) {
-        if (!(s >> buf1 >> buf2))
+      while (p != end) {
+        if (!internal::nextToken(p, end, tok1, len1) || !internal::nextToken(p, end, tok2, len2))
           throw(FileReadError(_filename, "PSF error parsing bonds.\n> " + input));
 
-        ind1 = parseStringAsHybrid36(buf1);
-        ind2 = parseStringAsHybrid36(buf2);
+        int ind1 = parseHybrid36Field(tok1, len1);
+        int ind2 = parseHybrid36Field(tok2, len2);
 
         if (ind1 > num_atoms || ind2 > num_atoms)
           throw(FileReadError(_filename, "PSF bond error: bound atomid exceeds number of atoms.\n> " + input));
@@ -129,10 +161,11 @@ namespace loos {
         bonds_found++;
 
         // Catch returns in files that came from windows...
-        if (s.peek() == '\r')
+        if (p != end && *p == '\r')
           break;
       }
-      getline(is, input);
+
+      lines.next(input);
     }
     // sanity check
     if (bonds_found != num_bonds)
@@ -144,45 +177,40 @@ namespace loos {
 
 
 
-  void PSF::parseAtomRecord(const std::string s) {
-    gint index;
-    std::string segname;
-    gint resid;
-    std::string resname;
-    std::string atomname;
-    std::string atomtype;
-    greal charge;
-    greal mass;
-    gint fixed;
-    std::string buf;
+  // Fields are whitespace-separated, and are taken directly from the
+  // line rather than read through a stringstream...
 
-    pAtom pa(new Atom);
-    pa->index(_max_index++);
+  void PSF::parseAtomRecord(const std::string& s) {
+    const char* p = s.data();
+    const char* end = p + s.size();
+    const char* tok;
+    uint len;
+    double x;
 
-    std::stringstream ss(s);
+    const std::string msg("PSF parse error.\n> ");
 
-    if (!(ss >> buf))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    index = parseStringAsHybrid36(buf);
-    pa->id(index);
+    pAtom pa = boost::make_shared<Atom>();
+    pa->index(_max_index++);
 
-    if (!(ss >> segname))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    pa->segid(segname);
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
+    pa->id(parseHybrid36Field(tok, len));
 
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
+    pa->segid(InternedString(tok, len));
 
-    if (!(ss >> buf))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    resid = parseStringAsHybrid36(buf);
-    pa->resid(resid);
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
+    pa->resid(parseHybrid36Field(tok, len));
 
-    if (!(ss >> resname))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    pa->resname(resname);
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
+    pa->resname(InternedString(tok, len));
 
-    if (!(ss >> atomname))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    pa->name(atomname);
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
+    pa->name(InternedString(tok, len));
 
     // If this is a charmm psf, the atomtype will be an integer.
     // NAMD/XPLOR psfs use the symbolic atomtype, which must start with a letter
@@ -190,20 +218,19 @@ namespace loos {
     // used in charmm and namd as a means to look up parameters), so we're going to
     // discard it.  However, if we ever decide we're going to use this, we'll need
     // to keep track of the distinction between charmm and namd usage.
-    if (!(ss >> atomtype))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
+    if (!internal::nextToken(p, end, tok, len))
+      throw(FileReadError(_filename, msg + s));
 
-    if (!(ss >> charge))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    pa->charge(charge);
+    if (!internal::nextToken(p, end, tok, len) || internal::parseNumber(tok, len, x) != len)
+      throw(FileReadError(_filename, msg + s));
+    pa->charge(x);
 
-    if (!(ss >> mass))
-      throw(FileReadError(_filename, "PSF parse error.\n> " + s));
-    pa->mass(mass);
+    if (!internal::nextToken(p, end, tok, len) || internal::parseNumber(tok, len, x) != len)
+      throw(FileReadError(_filename, msg + s));
+    pa->mass(x);
 
     // Is the atom fixed or mobile?
     // for now, we're going to silently drop this
-    ss >> fixed;
 
     append(pa);
   }
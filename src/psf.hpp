@@ -63,10 +63,7 @@ namespace loos {
     virtual ~PSF() {}
 
     explicit PSF(const std::string& fname) : _max_index(0), _filename(fname) {
-      std::ifstream ifs(fname.c_str());
-      if (!ifs)
-        throw(FileOpenError(fname));
-      read(ifs);
+      readFile(fname);
     }
 
     explicit PSF(std::fstream &ifs) : _max_index(0), _filename("stream") {
@@ -89,7 +86,14 @@ namespace loos {
   private:
 
     PSF(const AtomicGroup& grp) : AtomicGroup(grp) { }
-    void parseAtomRecord(const std::string s);  
+
+    // Reads the file via a memory-mapping
+    void readFile(const std::string& fname);
+
+    // Parses lines from either a stream or a mapped file
+    template<typename Lines> void readRecords(Lines& lines);
+
+    void parseAtomRecord(const std::string& s);
 
     uint _max_index;
     std::string _filename;
@@ -325,8 +325,8 @@ int yyFlexLexer::yywrap() { return 1; }
 	*yy_cp = '\0'; \
 	(yy_c_buf_p) = yy_cp;
 
-#define YY_NUM_RULES 25
-#define YY_END_OF_BUFFER 26
+#define YY_NUM_RULES 33
+#define YY_END_OF_BUFFER 34
 /* This struct is not used in this scanner,
    but its presence is necessary. */
 struct yy_trans_info
@@ -334,16 +334,21 @@ struct yy_trans_info
 	flex_int32_t yy_verify;
 	flex_int32_t yy_nxt;
 	};
-static yyconst flex_int16_t yy_accept[81] =
+static yyconst flex_int16_t yy_accept[112] =
     {   0,
-        0,    0,   26,   24,   23,    1,   14,   22,   24,   24,
-        1,   24,    3,    4,   24,    7,   24,   24,   24,   24,
-       24,   24,   24,   24,   24,   23,    9,    2,   12,   16,
-        3,    5,    8,   11,    6,    0,    0,    0,    0,   21,
-        0,    0,   10,    0,    0,    0,   13,   17,    0,    0,
-        0,    0,    0,   15,    0,    0,    0,    0,    0,    0,
-       20,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-        0,    0,    0,    0,    0,    0,    0,   19,   18,    0
+        0,    0,   34,   32,   31,    1,   15,   30,   32,   32,
+        1,   32,   32,    3,    5,   32,    8,   32,   32,   32,
+       32,   32,   32,   32,   32,   32,   32,   32,   32,   31,
+       10,    2,   13,   17,    4,    4,    3,    6,    9,   12,
+        7,    0,    0,   27,    0,    0,    0,   22,    0,    0,
+        0,   11,    0,   25,    0,    0,    0,    0,   14,   18,
+        0,    0,    0,    0,    0,    0,    0,   16,    0,    0,
+        0,    0,    0,    0,    0,    0,    0,    0,   21,    0,
+        0,   26,    0,    0,    0,    0,    0,    0,    0,    0,
+       22,    0,    0,    0,   24,    0,    0,    0,    0,    0,
+
+        0,    0,   23,    0,    0,    0,   28,   20,   19,   29,
+        0
     } ;
 
 static yyconst flex_int32_t yy_ec[256] =
@@ -352,16 +357,16 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    2,    4,    5,    6,    1,    1,    7,    8,    1,
-        1,    1,    9,    1,   10,    1,    1,   11,   11,   11,
-       11,   11,   11,   11,   11,   11,   11,    1,    1,   12,
-       13,   14,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    9,    1,   10,   11,    1,   12,   12,   12,
+       12,   12,   12,   12,   12,   12,   12,    1,    1,   13,
+       14,   15,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,   15,   16,   17,   18,
+        1,    1,    1,    1,    1,    1,   16,   17,   18,   19,
 
-       19,    1,   20,   21,   22,    1,   23,   24,   25,   26,
-       27,    1,    1,   28,   29,   30,    1,    1,    1,   31,
-       32,    1,    1,   33,    1,   34,    1,    1,    1,    1,
+       20,   21,   22,   23,   24,    1,   25,   26,   27,   28,
+       29,    1,    1,   30,   31,   32,   33,    1,   34,   35,
+       36,    1,    1,   37,    1,   38,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -378,76 +383,90 @@ static yyconst flex_int32_t yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int32_t yy_meta[35] =
+static yyconst flex_int32_t yy_meta[39] =
     {   0,
         1,    1,    2,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1
+        1,    1,    1,    1,    1,    1,    1,    1
     } ;
 
-static yyconst flex_int16_t yy_base[82] =
+static yyconst flex_int16_t yy_base[113] =
     {   0,
-        0,    0,   97,   98,   94,   98,   82,   98,    0,   87,
-       98,   79,   81,   78,   22,   77,   65,   73,   66,   54,
-       18,   22,   66,   65,   50,   80,   98,    0,   98,   98,
-       70,   98,   98,   98,   98,   56,   62,   63,   59,   98,
-       58,   50,   98,   44,   44,   52,   98,   98,   48,   48,
-       41,   49,   48,   98,   16,   17,   50,   39,   37,   32,
-       98,   44,   46,   42,   44,   31,   35,   35,   29,   28,
-       26,   33,   31,   29,   28,   27,   19,   98,   98,   98,
-       39
+        0,    0,  130,  131,  127,  131,  114,  131,    0,  120,
+      131,  111,  113,   28,  110,   27,  109,   16,  106,   98,
+       84,   24,   90,   28,   97,   97,   29,   92,   78,  112,
+      131,    0,  131,  131,  101,  100,   39,  131,  131,  131,
+      131,   85,   81,  131,   91,   92,   88,  131,   87,   79,
+       77,  131,   71,  131,   71,   74,   78,   67,  131,  131,
+       65,   72,   72,   65,   74,   73,   72,  131,   30,   71,
+       31,   67,   61,   71,   59,   57,   50,   66,  131,   64,
+       66,  131,   62,   64,   55,   59,   48,   52,   53,   41,
+       40,   45,   44,   42,  131,   41,   49,   47,   40,   44,
+
+       43,   42,  131,   41,   32,   36,  131,  131,  131,  131,
+      131,   52
     } ;
 
-static yyconst flex_int16_t yy_def[82] =
+static yyconst flex_int16_t yy_def[113] =
     {   0,
-       80,    1,   80,   80,   80,   80,   80,   80,   81,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   81,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,    0,
-       80
+      111,    1,  111,  111,  111,  111,  111,  111,  112,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  112,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+        0,  111
     } ;
 
-static yyconst flex_int16_t yy_nxt[133] =
+static yyconst flex_int16_t yy_nxt[170] =
     {   0,
         4,    5,    6,    7,    8,    9,   10,    8,   11,   12,
-       13,   14,   15,   16,   17,   18,   19,    4,    4,    4,
-       20,   21,    4,    4,    4,   22,    4,   23,   24,    4,
-        4,    4,   25,    4,   33,   40,   42,   62,   64,   28,
-       43,   63,   65,   41,   79,   78,   61,   61,   44,   77,
-       61,   76,   75,   74,   73,   34,   72,   71,   70,   61,
-       69,   40,   40,   68,   67,   66,   61,   60,   59,   58,
-       57,   56,   55,   54,   53,   52,   51,   50,   49,   48,
-       31,   26,   47,   46,   45,   39,   38,   37,   36,   35,
-       32,   31,   30,   29,   27,   26,   80,    3,   80,   80,
-
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80
+       13,   14,   15,   16,   17,   18,   19,   20,    4,    4,
+        4,    4,   21,   22,    4,    4,   23,   24,   25,   26,
+       27,    4,    4,   28,    4,    4,   29,    4,   36,   37,
+       39,   42,   48,   51,   56,   43,   44,   52,   57,   36,
+       37,   49,   32,   80,   83,  110,   53,   81,   84,  109,
+      108,   79,   79,  107,   40,  106,  105,   79,  104,  103,
+      102,  101,  100,   99,   98,   97,   96,   95,   94,   93,
+       79,   92,   91,   90,   48,   89,   88,   87,   86,   85,
+       82,   79,   78,   77,   76,   75,   74,   73,   72,   71,
+
+       70,   69,   68,   67,   66,   65,   64,   63,   62,   61,
+       60,   36,   35,   30,   59,   58,   55,   54,   50,   47,
+       46,   45,   41,   38,   35,   34,   33,   31,   30,  111,
+        3,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111
     } ;
 
-static yyconst flex_int16_t yy_chk[133] =
+static yyconst flex_int16_t yy_chk[170] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,   15,   21,   22,   55,   56,   81,
-       22,   55,   56,   21,   77,   76,   75,   74,   22,   73,
-       72,   71,   70,   69,   68,   15,   67,   66,   65,   64,
-       63,   62,   60,   59,   58,   57,   53,   52,   51,   50,
-       49,   46,   45,   44,   42,   41,   39,   38,   37,   36,
-       31,   26,   25,   24,   23,   20,   19,   18,   17,   16,
-       14,   13,   12,   10,    7,    5,    3,   80,   80,   80,
-
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80,   80,   80,   80,   80,   80,   80,   80,   80,
-       80,   80
+        1,    1,    1,    1,    1,    1,    1,    1,   14,   14,
+       16,   18,   22,   24,   27,   18,   18,   24,   27,   37,
+       37,   22,  112,   69,   71,  106,   24,   69,   71,  105,
+      104,  102,  101,  100,   16,   99,   98,   97,   96,   94,
+       93,   92,   91,   90,   89,   88,   87,   86,   85,   84,
+       83,   81,   80,   78,   77,   76,   75,   74,   73,   72,
+       70,   67,   66,   65,   64,   63,   62,   61,   58,   57,
+
+       56,   55,   53,   51,   50,   49,   47,   46,   45,   43,
+       42,   36,   35,   30,   29,   28,   26,   25,   23,   21,
+       20,   19,   17,   15,   13,   12,   10,    7,    5,    3,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111,  111,
+      111,  111,  111,  111,  111,  111,  111,  111,  111
     } ;
 
 /* The intent behind this definition is that it'll catch
@@ -481,7 +500,7 @@ typedef loos::parser::token_type token_type;
 #define YY_DECL loos::parser::token_type LoosLexer::looslex(loos::parser::semantic_type* yylval)
 
 
-#line 485 "<stdout>"
+#line 504 "<stdout>"
 
 #define INITIAL 0
 
@@ -581,9 +600,9 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
     
-#line 33 "scanner.ll"
+#line 34 "scanner.ll"
 
-#line 587 "<stdout>"
+#line 606 "<stdout>"
 
 	if ( !(yy_init) )
 		{
@@ -636,13 +655,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 81 )
+				if ( yy_current_state >= 112 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 98 );
+		while ( yy_base[yy_current_state] != 131 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -669,112 +688,152 @@ do_action:	/* This label is used only to access EOF actions. */
 case 1:
 /* rule 1 can match eol */
 YY_RULE_SETUP
-#line 34 "scanner.ll"
+#line 35 "scanner.ll"
 /* Swallow newlines? */
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 36 "scanner.ll"
+#line 37 "scanner.ll"
 
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 37 "scanner.ll"
+#line 38 "scanner.ll"
 { yylval->ival = atoi(yytext); return(token::NUMBER); }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 38 "scanner.ll"
-{ return(token::LT); }
+#line 39 "scanner.ll"
+{ yylval->dval = atof(yytext); return(token::FLOAT); }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
-#line 39 "scanner.ll"
-{ return(token::LTE); }
+#line 40 "scanner.ll"
+{ return(token::LT); }
 	YY_BREAK
 case 6:
 YY_RULE_SETUP
-#line 40 "scanner.ll"
-{ return(token::GTE); }
+#line 41 "scanner.ll"
+{ return(token::LTE); }
 	YY_BREAK
 case 7:
 YY_RULE_SETUP
-#line 41 "scanner.ll"
-{ return(token::GT); }
+#line 42 "scanner.ll"
+{ return(token::GTE); }
 	YY_BREAK
 case 8:
 YY_RULE_SETUP
-#line 42 "scanner.ll"
-{ return(token::EQ); }
+#line 43 "scanner.ll"
+{ return(token::GT); }
 	YY_BREAK
 case 9:
 YY_RULE_SETUP
-#line 43 "scanner.ll"
-{ return(token::NE); }
+#line 44 "scanner.ll"
+{ return(token::EQ); }
 	YY_BREAK
 case 10:
 YY_RULE_SETUP
-#line 44 "scanner.ll"
+#line 45 "scanner.ll"
 { return(token::NE); }
 	YY_BREAK
 case 11:
 YY_RULE_SETUP
-#line 45 "scanner.ll"
-{ return(token::REGEX); }
+#line 46 "scanner.ll"
+{ return(token::NE); }
 	YY_BREAK
 case 12:
 YY_RULE_SETUP
 #line 47 "scanner.ll"
-{ return(token::AND); }
+{ return(token::REGEX); }
 	YY_BREAK
 case 13:
 YY_RULE_SETUP
-#line 48 "scanner.ll"
-{ return(token::OR); }
+#line 49 "scanner.ll"
+{ return(token::AND); }
 	YY_BREAK
 case 14:
 YY_RULE_SETUP
 #line 50 "scanner.ll"
-{ return(token::NOT); }
+{ return(token::OR); }
 	YY_BREAK
 case 15:
 YY_RULE_SETUP
-#line 51 "scanner.ll"
+#line 52 "scanner.ll"
 { return(token::NOT); }
 	YY_BREAK
 case 16:
 YY_RULE_SETUP
-#line 52 "scanner.ll"
-{ return(token::NEKEY); }
+#line 53 "scanner.ll"
+{ return(token::NOT); }
 	YY_BREAK
 case 17:
 YY_RULE_SETUP
 #line 54 "scanner.ll"
-{ return(token::ALL); }
+{ return(token::NEKEY); }
 	YY_BREAK
 case 18:
 YY_RULE_SETUP
-#line 55 "scanner.ll"
-{ return(token::HYDROGEN); }
+#line 56 "scanner.ll"
+{ return(token::ALL); }
 	YY_BREAK
 case 19:
 YY_RULE_SETUP
-#line 56 "scanner.ll"
-{ return(token::BACKBONE); }
+#line 57 "scanner.ll"
+{ return(token::HYDROGEN); }
 	YY_BREAK
 case 20:
 YY_RULE_SETUP
-#line 57 "scanner.ll"
-{ yylval->sval = new std::string(yytext, yyleng); return(token::SKEY); }
+#line 58 "scanner.ll"
+{ return(token::BACKBONE); }
 	YY_BREAK
 case 21:
 YY_RULE_SETUP
-#line 58 "scanner.ll"
-{ yylval->sval = new std::string(yytext, yyleng); return(token::NKEY); }
+#line 59 "scanner.ll"
+{ yylval->sval = new std::string(yytext, yyleng); return(token::SKEY); }
 	YY_BREAK
 case 22:
 YY_RULE_SETUP
 #line 60 "scanner.ll"
+{ yylval->sval = new std::string(yytext, yyleng); return(token::NKEY); }
+	YY_BREAK
+case 23:
+YY_RULE_SETUP
+#line 62 "scanner.ll"
+{ return(token::WITHIN); }
+	YY_BREAK
+case 24:
+YY_RULE_SETUP
+#line 63 "scanner.ll"
+{ return(token::AROUND); }
+	YY_BREAK
+case 25:
+YY_RULE_SETUP
+#line 64 "scanner.ll"
+{ return(token::OF); }
+	YY_BREAK
+case 26:
+YY_RULE_SETUP
+#line 65 "scanner.ll"
+{ return(token::SAME); }
+	YY_BREAK
+case 27:
+YY_RULE_SETUP
+#line 66 "scanner.ll"
+{ return(token::AS); }
+	YY_BREAK
+case 28:
+YY_RULE_SETUP
+#line 67 "scanner.ll"
+{ return(token::RESIDUE); }
+	YY_BREAK
+case 29:
+YY_RULE_SETUP
+#line 68 "scanner.ll"
+{ return(token::MOLECULE); }
+	YY_BREAK
+case 30:
+YY_RULE_SETUP
+#line 70 "scanner.ll"
 {                /* Special handling for strings... */
  std::string delim(yytext, yyleng);
  int c;
@@ -792,22 +851,22 @@ YY_RULE_SETUP
  return(token::STRING);
 }
 	YY_BREAK
-case 23:
+case 31:
 YY_RULE_SETUP
-#line 79 "scanner.ll"
+#line 89 "scanner.ll"
 /* Swallow up remaining white-space */
 	YY_BREAK
-case 24:
+case 32:
 YY_RULE_SETUP
-#line 81 "scanner.ll"
+#line 91 "scanner.ll"
 { return(static_cast<token_type>(*yytext)); }
 	YY_BREAK
-case 25:
+case 33:
 YY_RULE_SETUP
-#line 83 "scanner.ll"
+#line 93 "scanner.ll"
 YY_FATAL_ERROR( "flex scanner jammed" );
 	YY_BREAK
-#line 811 "<stdout>"
+#line 870 "<stdout>"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1188,7 +1247,7 @@ int yyFlexLexer::yy_get_next_buffer()
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 81 )
+			if ( yy_current_state >= 112 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1216,11 +1275,11 @@ int yyFlexLexer::yy_get_next_buffer()
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 81 )
+		if ( yy_current_state >= 112 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 80);
+	yy_is_jam = (yy_current_state == 111);
 
 		return yy_is_jam ? 0 : yy_current_state;
 }
@@ -1705,7 +1764,7 @@ void yyfree (void * ptr )
 
 #define YYTABLES_NAME "yytables"
 
-#line 83 "scanner.ll"
+#line 93 "scanner.ll"
 
 
 
@@ -28,6 +28,7 @@ typedef loos::parser::token_type token_type;
 
 ws       [ \t]+
 number   [0-9]+
+float    [0-9]+\.[0-9]*|\.[0-9]+
 ID       [a-zA-Z][a-zA-Z0-9]+
 
 %%
@@ -35,6 +36,7 @@ ID       [a-zA-Z][a-zA-Z0-9]+
 
 #.+
 {number}                { yylval->ival = atoi(yytext); return(token::NUMBER); }
+{float}                 { yylval->dval = atof(yytext); return(token::FLOAT); }
 "<"                     { return(token::LT); }
 "<="                    { return(token::LTE); }
 ">="                    { return(token::GTE); }
@@ -57,6 +59,14 @@ backbone	     { return(token::BACKBONE); }
 name|resname|segid|segname|chainid   { yylval->sval = new std::string(yytext, yyleng); return(token::SKEY); }
 id|resid|index       { yylval->sval = new std::string(yytext, yyleng); return(token::NKEY); }
 
+within               { return(token::WITHIN); }
+around               { return(token::AROUND); }
+of                   { return(token::OF); }
+same                 { return(token::SAME); }
+as                   { return(token::AS); }
+residue              { return(token::RESIDUE); }
+molecule             { return(token::MOLECULE); }
+
 \"|\'                {                /* Special handling for strings... */
  std::string delim(yytext, yyleng);
  int c;
@@ -49,11 +49,18 @@
 #include <gro.hpp>
 #include <xtc.hpp>
 #include <trr.hpp>
+#include <lct.hpp>
 
 
 #include <trajwriter.hpp>
 #include <dcdwriter.hpp>
 #include <xtcwriter.hpp>
+#include <trrwriter.hpp>
+#include <lctwriter.hpp>
+
+#if defined(HAS_NETCDF)
+#include <amber_netcdf_writer.hpp>
+#endif
 
 namespace loos {
 
@@ -142,9 +149,11 @@ namespace loos {
       { "rst", "Amber Restart", &AmberRst::create},
       { "rst7", "Amber Restart", &AmberRst::create},
       { "dcd", "CHARMM/NAMD DCD", &DCD::create},
+      { "mmdcd", "CHARMM/NAMD DCD (memory-mapped)", &DCD::createMapped},
       { "pdb", "Concatenated PDB", &CCPDB::create},
       { "trr", "Gromacs TRR", &TRR::create},
       { "xtc", "Gromacs XTC", &XTC::create},
+      { "lct", "LOOS compressed trajectory", &LCT::create},
       { "arc", "Tinker ARC", &TinkerArc::create},
       { "", "", 0}
     };
@@ -203,6 +212,12 @@ namespace loos {
     OutputTrajectoryNameBindingType output_trajectory_name_bindings[] = {
       { "dcd", "NAMD DCD", &DCDWriter::create},
       { "xtc", "Gromacs XTC (compressed trajectory)", &XTCWriter::create},
+      { "trr", "Gromacs TRR (coordinates and velocities)", &TRRWriter::create},
+      { "lct", "LOOS compressed trajectory (random access)", &LCTWriter::create},
+#if defined(HAS_NETCDF)
+      { "nc", "Amber Traj (NetCDF)", &AmberNetcdfWriter::create},
+      { "netcdf", "Amber Traj (NetCDF)", &AmberNetcdfWriter::create},
+#endif
       { "", "", 0}
     };
 
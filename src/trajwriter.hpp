@@ -73,7 +73,7 @@ namespace loos {
      * the TrajectoryWriter object.
      */
     TrajectoryWriter(std::iostream* s, const bool append = false)
-      : _filename("stream"), appending_(append), delete_(false) {}
+      : stream_(s), _filename("stream"), appending_(append), delete_(false) {}
 
 
     virtual ~TrajectoryWriter() {
@@ -122,6 +122,27 @@ namespace loos {
     //! Returns true if appending to an existing trajectory
     bool isAppending() const { return(appending_); }
 
+    //! Stage frames in memory and write them in blocks of about \a nbytes
+    /**
+     * Formats that support this write fewer, larger blocks and only
+     * bring their header up to date when flush() is called or the
+     * writer is destroyed.  A size of 0 writes each frame as it is
+     * given, which is the default.  Other formats ignore this.
+     */
+    virtual void bufferOutput(const size_t nbytes = 64 * 1024 * 1024) { }
+
+    //! Write any staged frames and update the file's metadata
+    virtual void flush() { }
+
+    //! Encode frames on \a nthreads background threads (0 = one per core)
+    /**
+     * Formats that compress their frames may compress several at once
+     * when this is enabled.  Frames are still written in the order
+     * they are given, and the file is the same as one written without
+     * threads.  Other formats ignore this.
+     */
+    virtual void useThreads(const uint nthreads = 0) { }
+
   protected:
     std::iostream* stream_;
     std::string _filename;
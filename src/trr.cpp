@@ -29,6 +29,7 @@
 
 
 #include <trr.hpp>
+#include <TrajectoryIndex.hpp>
 
 
 namespace loos {
@@ -127,6 +128,32 @@ namespace loos {
 		rewindImpl();
 		frame_indices.clear();
 
+		// Use the sidecar index if there is one (see TrajectoryIndex)
+		bool from_file = (_filename != "istream");
+		TrajectoryIndex index;
+		if (from_file && index.read(_filename, "trr")) {
+			frame_indices = index.offsets();
+			maxatoms = index.natoms();
+		} else
+			scanFrames(h, maxatoms);
+
+		coords_.reserve(maxatoms);
+		velo_.reserve(maxatoms);
+		forc_.reserve(maxatoms);
+
+		rewindImpl();
+
+		parseFrame();
+		cached_first = true;
+		if (from_file && index.offsets().empty() && !frame_indices.empty())
+			TrajectoryIndex(frame_indices, maxatoms, 0.0).write(_filename, "trr");
+
+	}
+
+
+	// Walk the file, reading only the frame headers, to build the
+	// frame index
+	void TRR::scanFrames(Header& h, int& maxatoms) {
 		size_t frame_start = (xdr_file.get())->tellg();
 		while (readHeader(h)) {
 			frame_indices.push_back(frame_start);
@@ -145,17 +172,6 @@ namespace loos {
 			(xdr_file.get())->seekg(offset, std::ios_base::cur);
 			frame_start = (xdr_file.get())->tellg();
 		}
-
-		coords_.reserve(maxatoms);
-		velo_.reserve(maxatoms);
-		forc_.reserve(maxatoms);
-
-		rewindImpl();
-
-		parseFrame();
-		cached_first = true;
-		hdr_ = h;
-
 	}
 
 	void TRR::updateGroupCoordsImpl(AtomicGroup& g) {
@@ -171,6 +187,13 @@ namespace loos {
 			g.periodicBox(box);
 	}
 
+	void TRR::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+		plan.scatter(g, coords_);
+
+		if (hdr_.box_size)
+			g.periodicBox(box);
+	}
+
 	void TRR::updateGroupVelocitiesImpl(AtomicGroup& g) {
 
 		for (AtomicGroup::iterator i = g.begin(); i != g.end(); ++i) {
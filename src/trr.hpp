@@ -69,6 +69,7 @@ namespace loos {
 	 * Since the TRR frame size is not fixed, the entire
 	 * trajectory will be quickly scanned to build up an index of where
 	 * the frames begin (see the loos::XTC class for more information).
+	 * The index is cached in a sidecar file (see TrajectoryIndex).
 	 *
 	 * Finally, note that GROMACS stores data in nm whereas LOOS uses
 	 * angstroms, so coordinate/box data will be automatically scaled by
@@ -165,6 +166,7 @@ namespace loos {
 
 	private:
 		void init(void);
+		void scanFrames(Header& h, int& maxatoms);
 		int floatSize(Header& h);
 		bool readHeader(Header& h);
 
@@ -243,6 +245,7 @@ namespace loos {
 		void seekNextFrameImpl(void) { }
 		void seekFrameImpl(uint);
 		void updateGroupCoordsImpl(AtomicGroup& g);
+		void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
 		void updateGroupVelocitiesImpl(AtomicGroup& g);
 		std::vector<GCoord> velocitiesImpl() const { return(velo_); }
 
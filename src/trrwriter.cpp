@@ -0,0 +1,235 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+#include <cstring>
+
+#include <trrwriter.hpp>
+#include <trr.hpp>
+#include <exceptions.hpp>
+
+
+namespace loos {
+
+  namespace {
+
+    // TRR frames are XDR encoded, i.e. big-endian in 4-byte units.
+    // Frames are formatted directly into a byte buffer rather than
+    // through an XDRWriter so a whole frame (or many frames) can be
+    // handed to the stream at once.
+
+    const int trr_magic = 1993;
+    const char trr_version[] = "GMX_trn_file";
+
+    inline char* putInt(char* p, const unsigned int u) {
+      p[0] = (u >> 24) & 0xff;
+      p[1] = (u >> 16) & 0xff;
+      p[2] = (u >> 8) & 0xff;
+      p[3] = u & 0xff;
+      return(p + 4);
+    }
+
+    inline char* putReal(char* p, const float f) {
+      unsigned int u;
+      memcpy(&u, &f, sizeof(u));
+      return(putInt(p, u));
+    }
+
+    inline char* putReal(char* p, const double d) {
+      unsigned long long u;
+      memcpy(&u, &d, sizeof(u));
+      p = putInt(p, u >> 32);
+      return(putInt(p, u & 0xffffffff));
+    }
+
+
+    // Header ints: magic, the version string (written by Gromacs as
+    // its length including the terminator, then as an xdr_string), the
+    // 10 block sizes, natoms, step, and nre
+    const size_t version_bytes = sizeof(trr_version) - 1;
+    const size_t header_ints = 1 + 2 + 10 + 3;
+  }
+
+
+  void TRRWriter::init() {
+    current_ = 0;
+    buffer_bytes_ = 0;
+    staged_ = 0;
+
+    if (appending_)
+      prepareToAppend();
+  }
+
+
+  TRRWriter::~TRRWriter() {
+    try {
+      flush();
+    }
+    catch(...) {
+      std::cerr << "Warning- error while finishing TRR '" << _filename << "'" << std::endl;
+    }
+  }
+
+
+  void TRRWriter::doublePrecision(const bool b) {
+    if (current_ != 0)
+      throw(std::logic_error("Cannot change the precision of a TRR after frames have been written"));
+    double_ = b;
+  }
+
+
+  size_t TRRWriter::frameSize(const uint natoms, const bool box, const bool velocities) const {
+    size_t real = double_ ? sizeof(double) : sizeof(float);
+
+    size_t n = header_ints * 4 + version_bytes + 2 * real;
+    if (box)
+      n += 9 * real;
+    n += natoms * 3 * real;
+    if (velocities)
+      n += natoms * 3 * real;
+
+    return(n);
+  }
+
+
+  // Formats a frame (header, box, coordinates, and velocities) at dst,
+  // which must have room for frameSize() bytes
+  template<typename T>
+  void TRRWriter::encodeFrame(const AtomicGroup& model, const bool box, const bool velocities,
+                              const int step, const double time, char* dst) const {
+    uint natoms = model.size();
+    uint xsize = natoms * 3 * sizeof(T);
+
+    dst = putInt(dst, trr_magic);
+    dst = putInt(dst, version_bytes + 1);
+    dst = putInt(dst, version_bytes);
+    memcpy(dst, trr_version, version_bytes);
+    dst += version_bytes;
+
+    dst = putInt(dst, 0);                             // ir_size
+    dst = putInt(dst, 0);                             // e_size
+    dst = putInt(dst, box ? 9 * sizeof(T) : 0);       // box_size
+    dst = putInt(dst, 0);                             // vir_size
+    dst = putInt(dst, 0);                             // pres_size
+    dst = putInt(dst, 0);                             // top_size
+    dst = putInt(dst, 0);                             // sym_size
+    dst = putInt(dst, xsize);                         // x_size
+    dst = putInt(dst, velocities ? xsize : 0);        // v_size
+    dst = putInt(dst, 0);                             // f_size
+    dst = putInt(dst, natoms);
+    dst = putInt(dst, step);
+    dst = putInt(dst, 0);                             // nre
+    dst = putReal(dst, static_cast<T>(time));
+    dst = putReal(dst, static_cast<T>(0.0));          // lambda
+
+    // All lengths are converted from Angstroms to nm
+    if (box) {
+      GCoord b = model.periodicBox();
+      T outbox[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+      outbox[0] = b[0] / 10.0;
+      outbox[4] = b[1] / 10.0;
+      outbox[8] = b[2] / 10.0;
+      for (uint i=0; i<9; ++i)
+        dst = putReal(dst, outbox[i]);
+    }
+
+    for (uint i=0; i<natoms; ++i) {
+      const GCoord& c = model[i]->coords();
+      dst = putReal(dst, static_cast<T>(c.x() / 10.0));
+      dst = putReal(dst, static_cast<T>(c.y() / 10.0));
+      dst = putReal(dst, static_cast<T>(c.z() / 10.0));
+    }
+
+    if (velocities)
+      for (uint i=0; i<natoms; ++i) {
+        const Atom& atom = *(model[i]);     // The non-const accessor would set velbit
+        const GCoord& v = atom.velocities();
+        dst = putReal(dst, static_cast<T>(v.x() / 10.0));
+        dst = putReal(dst, static_cast<T>(v.y() / 10.0));
+        dst = putReal(dst, static_cast<T>(v.z() / 10.0));
+      }
+  }
+
+
+
+  void TRRWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
+    bool box = model.isPeriodic();
+    bool velocities = !model.empty() && model.allHaveProperty(Atom::velbit);
+    size_t n = frameSize(model.size(), box, velocities);
+
+    size_t m = buffer_.size();
+    buffer_.resize(m + n);
+    if (double_)
+      encodeFrame<double>(model, box, velocities, step, time, &buffer_[m]);
+    else
+      encodeFrame<float>(model, box, velocities, step, time, &buffer_[m]);
+    ++staged_;
+    ++current_;
+
+    if (buffer_bytes_ == 0 || buffer_.size() + n > buffer_bytes_)
+      writeStaged();
+  }
+
+
+  void TRRWriter::writeFrame(const AtomicGroup& model) {
+    writeFrame(model, step_, dt_ * step_);
+    step_ += steps_per_frame_;
+  }
+
+
+  void TRRWriter::writeStaged() {
+    if (staged_ == 0)
+      return;
+
+    stream_->write(&buffer_[0], buffer_.size());
+    if (stream_->fail())
+      throw(FileWriteError(_filename, "Error while writing TRR frames"));
+
+    buffer_.clear();
+    staged_ = 0;
+  }
+
+
+  void TRRWriter::bufferOutput(const size_t nbytes) {
+    if (nbytes == 0)
+      writeStaged();
+    buffer_bytes_ = nbytes;
+  }
+
+
+  void TRRWriter::flush() {
+    writeStaged();
+    stream_->flush();
+  }
+
+
+  // Read existing TRR to get the frame count and precision...
+  void TRRWriter::prepareToAppend() {
+    stream_->seekg(0);
+    TRR trr(*stream_);
+    current_ = trr.nframes();
+    if (current_ > 0)
+      double_ = trr.isDouble();
+    stream_->seekp(0, std::ios_base::end);
+  }
+
+}
@@ -0,0 +1,156 @@
+/*
+  This file is part of LOOS.
+
+  LOOS (Lightweight Object-Oriented Structure library)
+  Copyright (c) 2008, Tod D. Romo, Alan Grossfield
+  Department of Biochemistry and Biophysics
+  School of Medicine & Dentistry, University of Rochester
+
+  This package (LOOS) is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation under version 3 of the License.
+
+  This package is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+
+
+#if !defined(LOOS_TRRWRITER_HPP)
+#define LOOS_TRRWRITER_HPP
+
+#include <string>
+#include <vector>
+
+#include <loos_defs.hpp>
+#include <AtomicGroup.hpp>
+#include <trajwriter.hpp>
+
+
+namespace loos {
+
+
+  //! Class for writing Gromacs TRR trajectories
+  /**
+   * Each frame holds the coordinates of the group, its periodic box
+   * (if it has one), and its velocities (if every atom has them).
+   * Since TRR frames carry their own header, this is decided frame by
+   * frame.  Coordinates and the box are converted from Angstroms to
+   * nm, and velocities from Angstroms/ps to nm/ps, so they read back
+   * into LOOS unchanged.
+   *
+   * Frames are written in single precision unless doublePrecision()
+   * is set before the first frame is written.  When appending, the
+   * precision of the existing trajectory is used.
+   *
+   * As with the XTCWriter, the step and time for each frame come from
+   * the timePerStep() and stepsPerFrame() counters unless they are
+   * passed to writeFrame() explicitly (which does not change the
+   * counters).
+   *
+   * Each frame is formatted in memory and written with a single call.
+   * After bufferOutput(), frames are staged in memory and written in
+   * blocks of about the requested size.
+   */
+  class TRRWriter : public TrajectoryWriter {
+  public:
+
+    //! Class factory function
+    static pTrajectoryWriter create(const std::string& s, const bool append = false) {
+      return(pTrajectoryWriter(new TRRWriter(s, append)));
+    }
+
+
+    explicit TRRWriter(const std::string& fname, const bool append = false) :
+      TrajectoryWriter(fname, append),
+      dt_(1.0), step_(0), steps_per_frame_(1), double_(false)
+    {
+      init();
+    }
+
+
+    TRRWriter(const std::string& fname, const double dt, const uint steps_per_frame,
+              const bool double_precision = false, const bool append = false) :
+      TrajectoryWriter(fname, append),
+      dt_(dt), step_(0), steps_per_frame_(steps_per_frame), double_(double_precision)
+    {
+      init();
+    }
+
+
+    //! Writes any staged frames
+    ~TRRWriter();
+
+
+    //! Get the time per step
+    double timePerStep() const { return(dt_); }
+
+    //! Set the time per step
+    void timePerStep(const double dt) { dt_ = dt; }
+
+    //! How many steps per frame written
+    uint stepsPerFrame() const { return(steps_per_frame_); }
+
+    //! Set how many steps pass per frame written
+    void stepsPerFrame(const uint s) { steps_per_frame_ = s; }
+
+    //! What the current output step is
+    uint currentStep() const { return(step_); }
+
+    //! Sets the current output step
+    void currentStep(const uint s) { step_ = s; }
+
+    //! Are frames written in double precision?
+    bool doublePrecision() const { return(double_); }
+
+    //! Write frames in double precision (only before the first frame)
+    void doublePrecision(const bool b);
+
+
+    //! Write a frame to the trajectory
+    void writeFrame(const AtomicGroup& model);
+
+    //! Write a frame to the trajectory with explicit step and time metadata
+    void writeFrame(const AtomicGroup& model, const uint step, const double time);
+
+    bool hasFrameStep() const { return(true); }
+    bool hasFrameTime() const { return(true); }
+
+    uint framesWritten() const { return(current_); }
+
+    void bufferOutput(const size_t nbytes = 64 * 1024 * 1024);
+
+    //! Write any staged frames
+    void flush();
+
+  private:
+    void init();
+    size_t frameSize(const uint natoms, const bool box, const bool velocities) const;
+    template<typename T>
+    void encodeFrame(const AtomicGroup& model, const bool box, const bool velocities,
+                     const int step, const double time, char* dst) const;
+    void writeStaged();
+    void prepareToAppend();
+
+  private:
+    double dt_;
+    uint step_;
+    uint steps_per_frame_;
+    bool double_;
+    uint current_;
+    size_t buffer_bytes_;
+    uint staged_;
+    std::vector<char> buffer_;
+  };
+
+
+}
+
+
+#endif
@@ -42,6 +42,7 @@
 
 #include <Selectors.hpp>
 #include <Parser.hpp>
+#include <AtomColumns.hpp>
 
 #include <utils.hpp>
 
@@ -193,6 +194,14 @@ namespace loos {
    *  catcher cannot disambiguate between the two.
    */
   AtomicGroup selectAtoms(const AtomicGroup& source, const std::string selection) {
+    AtomColumns columns(source);
+    return(selectAtoms(columns, selection));
+  }
+
+
+  // The selection is evaluated column-wise (see Kernel::evaluate())
+
+  AtomicGroup selectAtoms(const AtomColumns& columns, const std::string selection) {
   
     Parser parser;
 
@@ -203,8 +212,7 @@ namespace loos {
       throw(ParseError("Error in parsing '" + selection + "' ... " + e.what()));
     }
 
-    KernelSelector selector(parser.kernel());
-    AtomicGroup subset = source.select(selector);
+    AtomicGroup subset = parser.kernel().select(columns);
 
     return(subset);
   }
@@ -268,43 +276,50 @@ namespace loos {
     if (pos + n > source.size())
       return(0);
 
-    if (n > 6)
+    return(parseHybrid36Field(source.data() + pos, n));
+  }
+
+
+  int parseHybrid36Field(const char* s, const uint nelem) {
+    if (nelem > 6)
       throw(std::logic_error("Requested size exceeds max"));
-    
-    std::string s(source.substr(pos, n));
+
+    const char* end = s + nelem;
     bool negative(false);
-    std::string::iterator si(s.begin());
-    n = s.size();
 
-    if (*si == '-') {
+    if (s != end && *s == '-') {
       negative = true;
-      ++si;
-      --n;
+      ++s;
     }
 
     // Skip leading whitespace
-    for (;si != s.end() && *si == ' '; ++si, --n) ;
+    for (;s != end && *s == ' '; ++s) ;
+
+    uint n = end - s;
+    int result = 0;
+
+    if (n == 0)
+      return(0);
 
     int offset = 0;   // This adjusts the range of the result
     char cbase = 'a'; // Which set or characters (upper or lower) for the alpha-part
     int ibase = 10;   // Number-base (i.e. 10 or 36)
 
     // Decide which chunk we're in...
-    if (*si >= 'a') {
+    if (*s >= 'a') {
       offset = pow10[n] + 16*pow36[n-1];
       cbase = 'a';
       ibase = 36;
-    } else if (*si >= 'A') {
+    } else if (*s >= 'A') {
       offset = pow10[n] - 10*pow36[n-1];
       cbase = 'A';
       ibase = 36;
     }
 
-    int result = 0;
-    while (si != s.end()) {
-      int c = (*si >= cbase) ? *si-cbase+10 : *si-'0';
+    while (s != end) {
+      int c = (*s >= cbase) ? *s-cbase+10 : *s-'0';
       result = result * ibase + c;
-      ++si;
+      ++s;
     }
 
     result += offset;
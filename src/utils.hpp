@@ -292,6 +292,15 @@ namespace loos {
   //! Applies a string-based selection to an atomic group...
   AtomicGroup selectAtoms(const AtomicGroup&, const std::string);
 
+#if !defined(SWIG)
+  //! Applies a string-based selection to the group in \a columns
+  /**
+   * Reusing the same AtomColumns for many selections from one group
+   * avoids rebuilding the columns each time.
+   */
+  AtomicGroup selectAtoms(const AtomColumns& columns, const std::string);
+#endif
+
 
   //! Returns a byte-swapped copy of an arbitrary type
   /** 
@@ -369,6 +378,15 @@ namespace loos {
   //! Convert a hybrid-36 encoded string into an int
   int parseStringAsHybrid36(const std::string& source, const uint pos =0, const uint nelem =0);
 
+#if !defined(SWIG)
+  //! Convert the \a n hybrid-36 encoded characters at \a s into an int
+  /**
+   * As parseStringAsHybrid36(), but without needing a std::string.
+   * Fields longer than 6 characters throw a std::logic_error.
+   */
+  int parseHybrid36Field(const char* s, const uint n);
+#endif
+
   //! Convert an int into a hybrid-36 encoded string
   std::string hybrid36AsString(int value, uint fieldsize);
 
@@ -236,12 +236,7 @@ namespace loos {
       //! Writes an opaque array of n-bytes
       uint write(const char* p, const uint n) {
 	uint rndup;
-	static char buf[sizeof(block_type)];
-	static bool init(false);
-
-	if (!init)
-	  for (uint i=0; i<sizeof(block_type); ++i)
-	    buf[i] = '\0';
+	static const char buf[sizeof(block_type)] = { 0 };
 
 	rndup = n % sizeof(block_type);
 	if (rndup > 0)
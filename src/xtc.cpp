@@ -29,6 +29,13 @@
 
 
 #include <xtc.hpp>
+#include <TrajectoryIndex.hpp>
+
+#include <fstream>
+
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 
 
 namespace loos {
@@ -52,6 +59,77 @@ namespace loos {
   const int XTC::magic = 1995;
 
   const uint XTC::min_compressed_system_size = 9;
+
+  size_t XTC::parallel_scan_size = 1ul << 30;
+
+  uint XTC::default_decode_threads = 0;
+
+
+  // Reads and decompresses frames ahead of the reader.  Each worker
+  // claims the next frame that is within depth frames of the one the
+  // reader wants, reads it through its own stream, decodes it, and
+  // stores it in that frame's slot.  The reader waits on its slot and
+  // swaps the decoded coordinates out.
+  //
+  // The pipeline keeps its own copy of what it needs from the XTC so
+  // it does not depend on the XTC's lifetime.
+  class XTC::DecodePipeline {
+  public:
+    DecodePipeline(const XTC& xtc, const uint nthreads, const uint depth, const uint start)
+      : filename(xtc._filename), offsets(xtc.frame_indices), natoms(xtc.natoms_),
+        slots(depth), wanted(start), next_claim(start), generation(0), shutdown(false)
+    {
+      for (uint i=0; i<nthreads; ++i)
+        threads.push_back(new boost::thread(&DecodePipeline::work, this));
+    }
+
+    ~DecodePipeline() {
+      {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        shutdown = true;
+      }
+      cond.notify_all();
+
+      for (uint i=0; i<threads.size(); ++i) {
+        threads[i]->join();
+        delete threads[i];
+      }
+    }
+
+    uint size() const { return(threads.size()); }
+
+    bool fetch(XTC& xtc, const uint frame);
+
+  private:
+    struct Slot {
+      Slot() : frame(0), ready(false), ok(false), precision(0.0) { }
+
+      uint frame;
+      bool ready, ok;
+      std::string error;
+      Header header;
+      GCoord box;
+      std::vector<GCoord> coords;
+      double precision;
+    };
+
+    void work();
+
+    std::string filename;
+    std::vector<size_t> offsets;
+    uint natoms;
+
+    std::vector<Slot> slots;
+    uint wanted;              // Frame the reader will ask for next
+    uint next_claim;          // Next frame for a worker to decode
+    ulong generation;         // Bumped whenever the read-ahead is discarded
+    bool shutdown;
+
+    std::vector<boost::thread*> threads;
+    boost::mutex mtx;
+    boost::condition_variable cond;
+  };
+
     
 
 
@@ -159,10 +237,9 @@ namespace loos {
 
 
 
-  // Coordinates are converted into GCoords and stored in the object's
-  // coords_ vector
+  // Coordinates are converted into GCoords and appended to coords
 
-  bool XTC::readCompressedCoords(void)
+  bool XTC::readCompressedCoords(internal::XDRReader& xdr, std::vector<GCoord>& coords, double& stored_precision)
   {
     int minint[3], maxint[3], *lip;
     int smallidx;
@@ -174,7 +251,7 @@ namespace loos {
     unsigned int bitsize;
   
      
-    if (!xdr_file.read(lsize))
+    if (!xdr.read(lsize))
       return(false);
 
     size3 = lsize * 3;
@@ -182,24 +259,24 @@ namespace loos {
     /* Dont bother with compression for three atoms or less */
     if(lsize<=9) {
       float* tmp = new xtc_t[size3];
-      xdr_file.read(tmp, size3);
+      xdr.read(tmp, size3);
       for (uint i=0; i<size3; i += 3)
-        coords_.push_back(GCoord(tmp[i], tmp[i+1], tmp[i+2]) * 10.0);
+        coords.push_back(GCoord(tmp[i], tmp[i+1], tmp[i+2]) * 10.0);
       delete[] tmp;
       return(true);
     }
 
     /* Compression-time if we got here. Read precision first */
-    xdr_file.read(precision);
-    precision_ = precision;
+    xdr.read(precision);
+    stored_precision = precision;
   
     int size3padded = static_cast<int>(size3 * 1.2);
     buf1 = new int[size3padded];
     buf2 = new int[size3padded];
     /* buf2[0-2] are special and do not contain actual data */
     buf2[0] = buf2[1] = buf2[2] = 0;
-    xdr_file.read(minint, 3);
-    xdr_file.read(maxint, 3);
+    xdr.read(minint, 3);
+    xdr.read(maxint, 3);
   
     sizeint[0] = maxint[0] - minint[0]+1;
     sizeint[1] = maxint[1] - minint[1]+1;
@@ -215,7 +292,7 @@ namespace loos {
       bitsize = sizeofints(sizeint, 3);
     }
 	
-    if (!xdr_file.read(smallidx)) {
+    if (!xdr.read(smallidx)) {
       delete[] buf1;
       delete[] buf2;
       return(false);
@@ -230,13 +307,13 @@ namespace loos {
 
     /* buf2[0] holds the length in bytes */
   
-    if (!xdr_file.read(buf2, 1)) {
+    if (!xdr.read(buf2, 1)) {
       delete[] buf1;
       delete[] buf2;
       return(false);
     }
 
-    if (!xdr_file.read(reinterpret_cast<char*>(&(buf2[3])), static_cast<uint>(buf2[0]))) {
+    if (!xdr.read(reinterpret_cast<char*>(&(buf2[3])), static_cast<uint>(buf2[0]))) {
       delete[] buf1;
       delete[] buf2;
       return(false);
@@ -294,7 +371,7 @@ namespace loos {
             tmp = thiscoord[2]; thiscoord[2] = prevcoord[2];
             prevcoord[2] = tmp;
 
-            coords_.push_back(GCoord(prevcoord[0] * inv_precision,
+            coords.push_back(GCoord(prevcoord[0] * inv_precision,
                                 prevcoord[1] * inv_precision,
                                 prevcoord[2] * inv_precision) * 10.0);
           } else {
@@ -302,12 +379,12 @@ namespace loos {
             prevcoord[1] = thiscoord[1];
             prevcoord[2] = thiscoord[2];
           }
-          coords_.push_back(GCoord(thiscoord[0] * inv_precision,
+          coords.push_back(GCoord(thiscoord[0] * inv_precision,
                               thiscoord[1] * inv_precision,
                               thiscoord[2] * inv_precision) * 10.0);
         }
       } else {
-        coords_.push_back(GCoord(thiscoord[0] * inv_precision,
+        coords.push_back(GCoord(thiscoord[0] * inv_precision,
                             thiscoord[1] * inv_precision,
                             thiscoord[2] * inv_precision) * 10.0);
       }
@@ -333,23 +410,23 @@ namespace loos {
 
 
 
-  bool XTC::readUncompressedCoords(void) 
+  bool XTC::readUncompressedCoords(internal::XDRReader& xdr, std::vector<GCoord>& coords, const std::string& fname)
   {
       uint lsize;
       
-      if (!xdr_file.read(lsize))
+      if (!xdr.read(lsize))
 	  return(false);
       
       uint size3 = lsize * 3;
-      coords_ = std::vector<GCoord>(lsize);
+      coords = std::vector<GCoord>(lsize);
       float* tmp_coords = new float[size3];
-      uint n = xdr_file.read(tmp_coords, size3);
+      uint n = xdr.read(tmp_coords, size3);
       if (n != size3)
-	throw(FileReadError(_filename, "XTC Error: number of uncompressed coords read did not match number expected"));
+	throw(FileReadError(fname, "XTC Error: number of uncompressed coords read did not match number expected"));
       
       uint i = 0;
       for (uint j=0; j<lsize; ++j, i += 3)
-	  coords_[j] = GCoord(tmp_coords[i], tmp_coords[i+1], tmp_coords[i+2]) * 10.0;
+	  coords[j] = GCoord(tmp_coords[i], tmp_coords[i+1], tmp_coords[i+2]) * 10.0;
       
       delete[] tmp_coords;
       return(true);
@@ -371,59 +448,146 @@ namespace loos {
   }
 
 
+  void XTC::updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan) {
+    plan.scatter(g, coords_);
+    g.periodicBox(box);
+  }
+
+
   bool XTC::parseFrame(void) {
+    if (pipeline)
+      return(pipeline->fetch(*this, _current_frame));
+
     if (ifs->eof())
       return(false);
 
-    // First, clear out existing coords...  A read error after this
-    // point will invalidate the current object's coord state
+    // A read error after this point will invalidate the current
+    // object's coord state
+    return(readFrameData(xdr_file, _filename, natoms_, current_header_, box, coords_, precision_));
+  }
+
 
-    coords_.clear();
-    if (!readFrameHeader(current_header_))
+  // Reads a complete frame from xdr.  This does not depend on the
+  // state of the XTC object, so it can be used from multiple threads
+  // (each with its own stream).
+  bool XTC::readFrameData(internal::XDRReader& xdr, const std::string& fname, const uint natoms,
+                          Header& hdr, GCoord& box, std::vector<GCoord>& coords, double& precision) {
+    // First, clear out existing coords...
+    coords.clear();
+    if (!readFrameHeader(xdr, hdr, fname))
       return(false);
     
-    box = GCoord(current_header_.box[0], 
-		 current_header_.box[4], 
-		 current_header_.box[8]) * 10.0; // Convert to Angstroms
-    if (natoms_ <= min_compressed_system_size)
-	return(readUncompressedCoords());
+    box = GCoord(hdr.box[0], 
+		 hdr.box[4], 
+		 hdr.box[8]) * 10.0; // Convert to Angstroms
+    if (natoms <= min_compressed_system_size)
+	return(readUncompressedCoords(xdr, coords, fname));
     else
-	return(readCompressedCoords());
+	return(readCompressedCoords(xdr, coords, precision));
   }
 
 
   bool XTC::readFrameHeader(XTC::Header& hdr) {
+    return(readFrameHeader(xdr_file, hdr, _filename));
+  }
+
+
+  bool XTC::readFrameHeader(internal::XDRReader& xdr, XTC::Header& hdr, const std::string& fname) {
     int magic_no;
-    int ok = xdr_file.read(magic_no);
+    int ok = xdr.read(magic_no);
     if (!ok)
       return(false);
     if (magic_no != magic) {
       std::ostringstream oss;
       oss << "Invalid XTC magic number (got " << magic_no << " but expected " << magic << ")";
-      throw(FileReadError(_filename, oss.str()));
+      throw(FileReadError(fname, oss.str()));
     }
 
     // Defer error-checks until the end...
-    xdr_file.read(hdr.natoms);
+    xdr.read(hdr.natoms);
 
-    xdr_file.read(hdr.step);
-    xdr_file.read(hdr.time);
-    ok = xdr_file.read(hdr.box, 9);
+    xdr.read(hdr.step);
+    xdr.read(hdr.time);
+    ok = xdr.read(hdr.box, 9);
     if (!ok)
-      throw(FileReadError(_filename, "Problem reading XTC header"));
+      throw(FileReadError(fname, "Problem reading XTC header"));
 
     return(true);
   }
 
 
+  // Skips over the coordinates of a frame whose header has just been
+  // read
+  void XTC::skipFrameCoords(internal::XDRReader& xdr, const uint natoms) const {
+    uint block_size = sizeof(internal::XDRReader::block_type);
+
+    size_t offset = 0;
+    uint nbytes = 0;
+
+    if (natoms <= min_compressed_system_size) {
+      nbytes = natoms * 3 * sizeof(float);
+      uint dummy;
+      xdr.read(dummy);
+      if (dummy != natoms)
+        throw(FileOpenError(_filename, "XTC small system vector size is not what was expected"));
+    } else {
+      offset = 9 * block_size;
+      xdr.get()->seekg(offset, std::ios_base::cur);
+      xdr.read(nbytes);
+    }
+
+    uint nblocks = nbytes / block_size;
+
+    if (nbytes % block_size != 0)
+      ++nblocks;   // round up
+    offset = nblocks * block_size;
+    xdr.get()->seekg(offset, std::ios_base::cur);
+  }
+
+
   // Scan the trajectory file, skipping each compressed frame.  In the
   // process, we build up an index relating file-pos to frame index.
   // This permits fast seeking of indivual frames.
+  //
+  // If there is an up-to-date sidecar index, it is used instead.
+  // Otherwise, once the index is built it is saved for next time.
   void XTC::scanFrames(void) {
     frame_indices.clear();
-    
+
+    // Trajectories read from a stream cannot be reopened or indexed
+    bool from_file = (_filename != "istream");
+
+    if (from_file) {
+      TrajectoryIndex index;
+      if (index.read(_filename, "xtc")) {
+        frame_indices = index.offsets();
+        natoms_ = index.natoms();
+        timestep_ = index.timestep();
+        rewindImpl();
+        return;
+      }
+    }
+
+    ifs->seekg(0, std::ios_base::end);
+    size_t file_size = ifs->tellg();
     rewindImpl();
 
+    uint nthreads = boost::thread::hardware_concurrency();
+    if (from_file && nthreads > 1 && file_size >= parallel_scan_size)
+      scanInParallel(file_size, nthreads);
+    else
+      scanSerially(0);
+
+    if (from_file && !frame_indices.empty())
+      TrajectoryIndex(frame_indices, natoms_, timestep_).write(_filename, "xtc");
+  }
+
+
+  // Scan frames starting at file-pos start, appending them to the index
+  void XTC::scanSerially(const size_t start) {
+    ifs->clear();
+    ifs->seekg(start);
+
     Header h;
     
     while (! ifs->eof()) {
@@ -441,33 +605,11 @@ namespace loos {
       else if (natoms_ != h.natoms)
         throw(FileOpenError(_filename, "XTC frames have differing numbers of atoms"));
 
-      uint block_size = sizeof(internal::XDRReader::block_type);
-
       // Always update estimated timestep...
       if (h.step != 0)
 	timestep_ = h.time / h.step;
 
-      size_t offset = 0;
-      uint nbytes = 0;
-
-      if (natoms_ <= min_compressed_system_size) {
-	  nbytes = natoms_ * 3 * sizeof(float);
-	  uint dummy;
-	  xdr_file.read(dummy);
-	  if (dummy != natoms_)
-	    throw(FileOpenError(_filename, "XTC small system vector size is not what was expected"));
-      } else {
-	  offset = 9 * block_size;
-	  ifs->seekg(offset, std::ios_base::cur);
-	  xdr_file.read(nbytes);
-      }
-      
-      uint nblocks = nbytes / block_size;
-
-      if (nbytes % block_size != 0)
-        ++nblocks;   // round up
-      offset = nblocks * block_size;
-      ifs->seekg(offset, std::ios_base::cur);
+      skipFrameCoords(xdr_file, natoms_);
     }
 
     // Catch-all for I/O errors
@@ -477,6 +619,166 @@ namespace loos {
   }
 
 
+  // Scans the frames whose headers start within a range of bytes of
+  // the file.  The first frame in the range is found by searching
+  // for a word that looks like the start of a frame header (magic
+  // number followed by the number of atoms) and then checking that
+  // the frame it describes is followed by another frame (or the end
+  // of the file).
+  struct XTC::RangeScanner {
+    RangeScanner(const XTC* x, const size_t b, const size_t e, const size_t sz)
+      : xtc(x), begin(b), end(e), file_size(sz),
+        first(sz), next(sz), has_timestep(false), timestep(0), failed(false) { }
+
+    // Decodes an XDR (big-endian) int
+    static uint xdrWord(const unsigned char* p) {
+      return((static_cast<uint>(p[0]) << 24) | (static_cast<uint>(p[1]) << 16) | (static_cast<uint>(p[2]) << 8) | p[3]);
+    }
+
+    // True if the bytes at p (with n available) look like the start
+    // of a frame header
+    bool looksLikeFrame(const unsigned char* p, const size_t n) const {
+      size_t need = (xtc->natoms_ <= min_compressed_system_size) ? 8 : 56;
+      if (n < need)
+        return(false);
+      if (xdrWord(p) != static_cast<uint>(magic) || xdrWord(p+4) != xtc->natoms_)
+        return(false);
+      return(need == 8 || xdrWord(p+52) == xtc->natoms_);
+    }
+
+    bool looksLikeFrame(const size_t pos, std::istream& is) const {
+      unsigned char buf[56];
+      is.clear();
+      is.seekg(pos);
+      is.read(reinterpret_cast<char*>(buf), sizeof(buf));
+      return(looksLikeFrame(buf, is.gcount()));
+    }
+
+    // Searches for the first frame at or after begin.  The file is
+    // searched a block at a time, and candidate headers are confirmed
+    // by skipping over the frame and checking what follows it.
+    size_t resync(internal::XDRReader& xdr) {
+      static const size_t block_size = 1 << 20;
+      std::istream* is = xdr.get();
+      std::vector<unsigned char> buf(block_size + 56);
+      Header h;
+
+      for (size_t base = (begin + 3) & ~static_cast<size_t>(3); base < file_size; base += block_size) {
+        is->clear();
+        is->seekg(base);
+        is->read(reinterpret_cast<char*>(&buf[0]), buf.size());
+        size_t n = is->gcount();
+
+        for (size_t k = 0; k < block_size && k + 4 <= n; k += 4) {
+          if (!looksLikeFrame(&buf[k], n - k))
+            continue;
+
+          size_t pos = base + k;
+          try {
+            is->clear();
+            is->seekg(pos);
+            XTC::readFrameHeader(xdr, h, xtc->_filename);
+            xtc->skipFrameCoords(xdr, h.natoms);
+            if (is->fail())
+              continue;
+            size_t after = is->tellg();
+            if (after == file_size || looksLikeFrame(after, *is))
+              return(pos);
+          }
+          catch (LOOSError&) { }
+        }
+      }
+
+      return(file_size);
+    }
+
+    void operator()() {
+      try {
+        std::ifstream ifs(xtc->_filename.c_str(), std::ios_base::in | std::ios_base::binary);
+        internal::XDRReader xdr(&ifs);
+
+        first = (begin == 0) ? 0 : resync(xdr);
+        size_t pos = first;
+        Header h;
+
+        while (pos < end) {
+          ifs.clear();
+          ifs.seekg(pos);
+          if (!XTC::readFrameHeader(xdr, h, xtc->_filename))
+            break;
+          if (h.natoms != xtc->natoms_)
+            throw(FileOpenError(xtc->_filename, "XTC frames have differing numbers of atoms"));
+
+          starts.push_back(pos);
+          if (h.step != 0) {
+            has_timestep = true;
+            timestep = h.time / h.step;
+          }
+
+          xtc->skipFrameCoords(xdr, h.natoms);
+          if (ifs.fail())
+            throw(FileOpenError(xtc->_filename, "Problem scanning XTC trajectory to build frame indices"));
+          pos = ifs.tellg();
+        }
+
+        next = (pos < file_size) ? pos : file_size;
+      }
+      catch (...) {
+        failed = true;
+      }
+    }
+
+    const XTC* xtc;
+    size_t begin, end, file_size;
+    size_t first, next;
+    std::vector<size_t> starts;
+    bool has_timestep;
+    double timestep;
+    bool failed;
+  };
+
+
+  // The file is split into one range per thread.  A range's frames
+  // are only accepted if its first frame is where the preceding
+  // range left off; if not, the rest of the file is scanned serially
+  // from that point.
+  void XTC::scanInParallel(const size_t file_size, const uint nthreads) {
+    Header h;
+    if (!readFrameHeader(h)) {
+      rewindImpl();
+      return;
+    }
+    natoms_ = h.natoms;
+
+    std::vector<RangeScanner> scanners;
+    size_t chunk = file_size / nthreads;
+    for (uint i=0; i<nthreads; ++i)
+      scanners.push_back(RangeScanner(this, i * chunk, (i == nthreads-1) ? file_size : (i+1) * chunk, file_size));
+
+    std::vector<boost::thread*> threads(nthreads);
+    for (uint i=0; i<nthreads; ++i)
+      threads[i] = new boost::thread(boost::ref(scanners[i]));
+    for (uint i=0; i<nthreads; ++i) {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    size_t expected = 0;
+    for (uint i=0; i<nthreads; ++i) {
+      if (scanners[i].failed || scanners[i].first != expected) {
+        scanSerially(expected);
+        return;
+      }
+      frame_indices.insert(frame_indices.end(), scanners[i].starts.begin(), scanners[i].starts.end());
+      if (scanners[i].has_timestep)
+        timestep_ = scanners[i].timestep;
+      expected = scanners[i].next;
+    }
+
+    rewindImpl();
+  }
+
+
   void XTC::seekFrameImpl(const uint i) {
     if (i >= frame_indices.size())
       throw(FileError(_filename, "Requested XTC frame is out of range"));
@@ -485,5 +787,110 @@ namespace loos {
     ifs->seekg(frame_indices[i], std::ios_base::beg);
   }
 
+
+
+  // ----------------------------------------------------------
+  // Parallel decoding
+
+
+  void XTC::DecodePipeline::work() {
+    std::ifstream ifs(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+    internal::XDRReader xdr(&ifs);
+    Slot local;
+
+    boost::unique_lock<boost::mutex> lock(mtx);
+    while (!shutdown) {
+      if (next_claim >= offsets.size() || next_claim >= wanted + slots.size()) {
+        cond.wait(lock);
+        continue;
+      }
+
+      uint frame = next_claim++;
+      ulong gen = generation;
+      lock.unlock();
+
+      local.ok = false;
+      local.error.clear();
+      try {
+        if (!ifs.is_open())
+          throw(FileOpenError(filename));
+        ifs.clear();
+        ifs.seekg(offsets[frame]);
+        local.ok = XTC::readFrameData(xdr, filename, natoms, local.header, local.box, local.coords, local.precision);
+      }
+      catch (std::exception& e) {
+        local.error = e.what();
+      }
+
+      lock.lock();
+      if (gen == generation) {
+        Slot& slot = slots[frame % slots.size()];
+        slot.frame = frame;
+        slot.ok = local.ok;
+        slot.error.swap(local.error);
+        slot.header = local.header;
+        slot.box = local.box;
+        slot.precision = local.precision;
+        slot.coords.swap(local.coords);    // Recycles the slot's old buffer
+        slot.ready = true;
+        cond.notify_all();
+      }
+    }
+  }
+
+
+  bool XTC::DecodePipeline::fetch(XTC& xtc, const uint frame) {
+    if (frame >= offsets.size())
+      return(false);
+
+    boost::unique_lock<boost::mutex> lock(mtx);
+
+    // Out-of-order access, so discard anything that was read ahead
+    if (frame != wanted) {
+      ++generation;
+      for (uint i=0; i<slots.size(); ++i)
+        slots[i].ready = false;
+      wanted = next_claim = frame;
+      cond.notify_all();
+    }
+
+    Slot& slot = slots[frame % slots.size()];
+    while (!(slot.ready && slot.frame == frame))
+      cond.wait(lock);
+
+    slot.ready = false;
+    ++wanted;
+    cond.notify_all();
+
+    if (!slot.error.empty())
+      throw(LOOSError(slot.error));
+
+    xtc.current_header_ = slot.header;
+    xtc.box = slot.box;
+    if (natoms > min_compressed_system_size)
+      xtc.precision_ = slot.precision;
+    xtc.coords_.swap(slot.coords);
+
+    return(slot.ok);
+  }
+
+
+  void XTC::decodeInParallel(const uint nthreads, const uint depth) {
+    pipeline.reset();
+    if (nthreads <= 1)
+      return;
+
+    if (_filename == "istream")
+      throw(LOOSError("Parallel XTC decoding requires a file rather than a stream"));
+
+    uint n = (depth == 0) ? 2 * nthreads : std::max(depth, nthreads);
+    pipeline = boost::shared_ptr<DecodePipeline>(new DecodePipeline(*this, nthreads, n, _current_frame + 1));
+  }
+
+
+  uint XTC::decodeThreads(void) const {
+    return(pipeline ? pipeline->size() : 0);
+  }
+
 }
 
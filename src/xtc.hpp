@@ -42,8 +42,10 @@
 #include <xdr.hpp>
 #include <AtomicGroup.hpp>
 #include <Trajectory.hpp>
+#include <TrajectoryIndex.hpp>
 
 #include <boost/format.hpp>
+#include <boost/shared_ptr.hpp>
 
 namespace loos {
 
@@ -57,11 +59,27 @@ namespace loos {
    * frames.  This is done by reading only enough of each frame header
    * to permit building the index, so it should be a pretty fast
    * operation.
+   *
+   * For very large files, the scan is split into byte ranges that are
+   * scanned in parallel (see setParallelScanSize()).  The resulting
+   * index is saved in a sidecar file (see TrajectoryIndex) so later
+   * opens of the same trajectory do not have to scan it again.
+   *
+   * Decompressing XTC frames is CPU-bound.  When frames are read in
+   * order, they can be read ahead and decompressed by a pool of
+   * threads (see decodeInParallel()).  Frames are still delivered in
+   * order through readFrame() and updateGroupCoords().
    */
   class XTC : public Trajectory {
 
     // Systems with this size or smaller will not be compressed.
     static const uint min_compressed_system_size;
+
+    // Files this size or larger are scanned in parallel
+    static size_t parallel_scan_size;
+
+    // Decoding threads for newly opened XTCs
+    static uint default_decode_threads;
       
 
     // The frame header
@@ -82,14 +100,19 @@ namespace loos {
     typedef float    xtc_t;
 
   public:
-    explicit XTC(const std::string& s) : Trajectory(s), xdr_file(ifs.get()),natoms_(0) {
+    explicit XTC(const std::string& s) : Trajectory(s), xdr_file(ifs.get()), natoms_(0), timestep_(0) {
       init();
     }
 
-    explicit XTC(std::istream& is) : Trajectory(is), xdr_file(ifs.get()), natoms_(0) {
+    explicit XTC(std::istream& is) : Trajectory(is), xdr_file(ifs.get()), natoms_(0), timestep_(0) {
       init();
     }
 
+    //! Opens \a s using the frames found by an earlier open (see index()) instead of scanning it
+    XTC(const std::string& s, const TrajectoryIndex& index) : Trajectory(s), xdr_file(ifs.get()), natoms_(0), timestep_(0) {
+      init(&index);
+    }
+
     std::string description() const { return("Gromacs XTC (compressed trajectory)"); }
     static pTraj create(const std::string& fname, const AtomicGroup& model) {
       return(pTraj(new XTC(fname)));
@@ -110,14 +133,46 @@ namespace loos {
     //! Return the stored file's precision
     double precision(void) const { return(precision_); }
 
+    //! Frame offsets, number of atoms, and timestep found when the file was opened
+    TrajectoryIndex index(void) const { return(TrajectoryIndex(frame_indices, natoms_, timestep_)); }
+
+    //! Files at least this many bytes are scanned with multiple threads
+    static void setParallelScanSize(const size_t n) { parallel_scan_size = n; }
+
+    //! Read ahead and decompress frames using \a nthreads threads
+    /**
+     * Up to \a depth frames (by default, twice the number of threads)
+     * beyond the current one are decompressed in the background.
+     * Seeking to a frame other than the next one discards the
+     * read-ahead and starts over from the new frame.  Passing 0 or 1
+     * threads turns parallel decoding off.
+     *
+     * Each thread opens its own handle on the file, so this is not
+     * available for XTCs read from a stream.
+     */
+    void decodeInParallel(const uint nthreads, const uint depth = 0);
+
+    //! Number of threads used for decoding (0 if not decoding in parallel)
+    uint decodeThreads(void) const;
+
+    //! Decode all XTCs subsequently opened from a file with \a n threads
+    static void setDefaultDecodeThreads(const uint n) { default_decode_threads = n; }
+
   private:
 
-    void init(void) {
-      scanFrames();
+    void init(const TrajectoryIndex* index = 0) {
+      if (index) {
+        frame_indices = index->offsets();
+        natoms_ = index->natoms();
+        timestep_ = index->timestep();
+      } else
+        scanFrames();
       coords_.reserve(natoms_);
       if (!parseFrame())
         throw(FileReadError(_filename, "Unable to read in the first frame"));
       cached_first = true;
+      if (default_decode_threads > 1 && _filename != "istream")
+        decodeInParallel(default_decode_threads);
     }      
 
     internal::XDRReader xdr_file;
@@ -128,24 +183,36 @@ namespace loos {
     std::vector<GCoord> coords_;
     double timestep_;
     Header current_header_;
+
+    class DecodePipeline;
+    boost::shared_ptr<DecodePipeline> pipeline;
     
     bool parseFrame(void);
 
   private:
 
-    int sizeofint(int);
-    int sizeofints(uint*, const uint);
-    int decodebits(int*, uint);
-    void decodeints(int*, const int, int, uint*, int*);
+    static int sizeofint(int);
+    static int sizeofints(uint*, const uint);
+    static int decodebits(int*, uint);
+    static void decodeints(int*, const int, int, uint*, int*);
     bool readFrameHeader(Header&);
+    static bool readFrameHeader(internal::XDRReader&, Header&, const std::string&);
+    static bool readFrameData(internal::XDRReader&, const std::string&, const uint,
+                              Header&, GCoord&, std::vector<GCoord>&, double&);
+    void skipFrameCoords(internal::XDRReader&, const uint) const;
     void scanFrames(void);
+    void scanSerially(const size_t);
+    void scanInParallel(const size_t, const uint);
+
+    struct RangeScanner;
     
     void seekNextFrameImpl(void) { }
     void seekFrameImpl(uint);
     void rewindImpl(void) { ifs->clear(); ifs->seekg(0); }
     void updateGroupCoordsImpl(AtomicGroup& g);
-    bool readCompressedCoords(void);
-    bool readUncompressedCoords(void);
+    void updateGroupCoordsWithPlanImpl(AtomicGroup& g, const CoordinatePlan& plan);
+    static bool readCompressedCoords(internal::XDRReader&, std::vector<GCoord>&, double&);
+    static bool readUncompressedCoords(internal::XDRReader&, std::vector<GCoord>&, const std::string&);
   };
 
 }
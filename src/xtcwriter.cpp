@@ -20,6 +20,13 @@
 */
 
 
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 #include <xtcwriter.hpp>
 #include <xtc.hpp>
 
@@ -384,7 +391,8 @@ Library.
 
 
 
-  void XTCWriter::writeCompressedCoordsFloat(float* ptr, int size, float precision) 
+  void XTCWriter::writeCompressedCoordsFloat(internal::XDRWriter& xdr, int* buf1, int* buf2,
+                                             float* ptr, int size, float precision) const
   {
     int minint[3], maxint[3], mindiff, *lip, diff;
     int lint1, lint2, lint3, oldlint1, oldlint2, oldlint3, smallidx;
@@ -403,7 +411,6 @@ Library.
     bitsizeint[1] = 0;
     bitsizeint[2] = 0;
 
-    allocateBuffers(size);
     if (!xdr.write(size))
       throw(FileWriteError(_filename, "Could not write size to XTC file"));
 
@@ -677,7 +684,7 @@ Library.
 
 
   // Write a frame header
-  void XTCWriter::writeHeader(const int natoms, const int step, const float time) {
+  void XTCWriter::writeHeader(internal::XDRWriter& xdr, const int natoms, const int step, const float time) const {
     int magic = 1995;
 
     xdr.write(magic);
@@ -688,7 +695,7 @@ Library.
 
 
   // Write a periodic box, translating from A to nm
-  void XTCWriter::writeBox(const GCoord& box) {
+  void XTCWriter::writeBox(internal::XDRWriter& xdr, const GCoord& box) const {
     float outbox[DIM*DIM];
     for (uint i=0; i < DIM*DIM; ++i)
       outbox[i] = 0.0;
@@ -699,13 +706,239 @@ Library.
     xdr.write(outbox, DIM*DIM);
   }
 
+
+  // Write a complete frame.  The coords must already be in nm, and
+  // buf1/buf2 must be large enough for natoms (see allocateBuffers())
+  void XTCWriter::encodeFrame(internal::XDRWriter& xdr, int* buf1, int* buf2, const GCoord& box,
+                              float* crds, const int natoms, const int step, const float time) const {
+    writeHeader(xdr, natoms, step, time);
+    writeBox(xdr, box);
+    writeCompressedCoordsFloat(xdr, buf1, buf2, crds, natoms, precision_);
+  }
+
+
+
+  // Compresses frames on a pool of threads.  Frames are held in a ring
+  // of jobs and are numbered as they are submitted.  Workers take the
+  // next submitted frame and compress it into the job's own buffer.
+  // The thread calling writeFrame() writes finished jobs to the file in
+  // order, so only that thread ever touches the stream.
+  class XTCWriter::Compressor {
+    struct Job {
+      Job() : natoms(0), step(0), time(0.0), done(false) { }
+
+      std::vector<float> crds;
+      GCoord box;
+      int natoms;
+      int step;
+      float time;
+      std::string bytes;      // The compressed frame
+      std::string error;
+      bool done;
+    };
+
+  public:
+    Compressor(const XTCWriter& writer, const uint nthreads)
+      : _writer(writer), _jobs(2 * nthreads),
+        _submitted(0), _claimed(0), _written(0), _shutdown(false)
+    {
+      for (uint i=0; i<nthreads; ++i)
+        _threads.create_thread(boost::bind(&Compressor::work, this));
+    }
+
+    ~Compressor() {
+      {
+        boost::lock_guard<boost::mutex> lock(_mutex);
+        _shutdown = true;
+      }
+      _cond.notify_all();
+      _threads.join_all();
+    }
+
+    uint threads() const { return(_threads.size()); }
+
+
+    void submit(const AtomicGroup& model, const int step, const float time) {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      writeFinished(lock, false);
+      while (_submitted - _written == _jobs.size()) {
+        _cond.wait(lock);
+        writeFinished(lock, false);
+      }
+
+      // Workers only look at jobs that have been submitted, so this
+      // one can be filled in without holding the lock
+      Job& job = _jobs[_submitted % _jobs.size()];
+      lock.unlock();
+
+      uint n = model.size();
+      job.crds.resize(n * 3);
+      for (uint i=0,k=0; i<n; ++i) {
+        GCoord c = model[i]->coords();
+        job.crds[k++] = c.x() / 10.0;       // Convert to nm
+        job.crds[k++] = c.y() / 10.0;
+        job.crds[k++] = c.z() / 10.0;
+      }
+      job.box = model.periodicBox();
+      job.natoms = n;
+      job.step = step;
+      job.time = time;
+
+      lock.lock();
+      ++_submitted;
+      _cond.notify_all();
+    }
+
+
+    // Waits for and writes all submitted frames
+    void finish() {
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      writeFinished(lock, true);
+    }
+
+
+  private:
+
+    // Writes finished jobs, in order, until reaching one that isn't
+    // done (or, if wait is set, until every submitted job is written).
+    // The lock is released while writing.
+    void writeFinished(boost::unique_lock<boost::mutex>& lock, const bool wait) {
+      while (_written < _submitted) {
+        Job& job = _jobs[_written % _jobs.size()];
+        if (!job.done) {
+          if (!wait)
+            break;
+          _cond.wait(lock);
+          continue;
+        }
+
+        lock.unlock();
+        std::string error(job.error);
+        if (error.empty()) {
+          _writer.stream_->write(job.bytes.data(), job.bytes.size());
+          if (_writer.stream_->fail())
+            error = "Error while writing compressed frame to XTC file";
+        }
+        lock.lock();
+
+        job.done = false;
+        job.error.clear();
+        ++_written;
+        _cond.notify_all();
+
+        if (!error.empty())
+          throw(FileWriteError(_writer._filename, error));
+      }
+    }
+
+
+    void work() {
+      std::vector<int> buf1, buf2;
+      std::ostringstream os;
+      internal::XDRWriter xdr(&os);
+
+      boost::unique_lock<boost::mutex> lock(_mutex);
+      while (true) {
+        if (_claimed == _submitted) {
+          if (_shutdown)
+            break;
+          _cond.wait(lock);
+          continue;
+        }
+
+        Job& job = _jobs[_claimed++ % _jobs.size()];
+        lock.unlock();
+
+        std::string error;
+        try {
+          // Sized as allocateBuffers() would, but never empty
+          size_t size3 = job.natoms * 3;
+          if (size3 >= buf1.size()) {
+            buf1.resize(size3 + 1);
+            buf2.resize(static_cast<size_t>(size3 * 1.2) + 1);
+          }
+          float* crds = job.crds.empty() ? 0 : &job.crds[0];
+
+          os.str("");
+          _writer.encodeFrame(xdr, &buf1[0], &buf2[0], job.box, crds, job.natoms, job.step, job.time);
+          job.bytes = os.str();
+        }
+        catch (std::exception& e) {
+          error = e.what();
+        }
+
+        lock.lock();
+        job.error = error;
+        job.done = true;
+        _cond.notify_all();
+      }
+    }
+
+
+  private:
+    const XTCWriter& _writer;
+    std::vector<Job> _jobs;
+    unsigned long _submitted;       // Frames given to the compressor
+    unsigned long _claimed;         // Frames taken by a worker
+    unsigned long _written;         // Frames written to the file
+    bool _shutdown;
+
+    boost::thread_group _threads;
+    boost::mutex _mutex;
+    boost::condition_variable _cond;
+  };
+
+
+
+  // Frames still being compressed are written before the file is closed
+  XTCWriter::~XTCWriter() {
+    try {
+      flush();
+    }
+    catch (std::exception& e) {
+      std::cerr << "Warning- error while writing XTC trajectory: " << e.what() << std::endl;
+    }
+
+    delete[] buf1;
+    delete[] buf2;
+    delete[] crds_;
+  }
+
+
+  void XTCWriter::useThreads(const uint nthreads) {
+    uint n = nthreads;
+    if (n == 0)
+      n = boost::thread::hardware_concurrency();
+    if (n == 0)
+      n = 1;
+
+    flush();
+    compressor_ = boost::shared_ptr<Compressor>(new Compressor(*this, n));
+  }
+
+
+  uint XTCWriter::threads() const {
+    return(compressor_ ? compressor_->threads() : 0);
+  }
+
+
+  void XTCWriter::flush() {
+    if (compressor_)
+      compressor_->finish();
+    stream_->flush();
+  }
+
   
 
   // Write a frame, converting units from A to nm.  Will allocate a temp array to hold coords...
   void XTCWriter::writeFrame(const AtomicGroup& model, const uint step, const double time) {
 
-    writeHeader(model.size(), step, time);
-    writeBox(model.periodicBox());
+    if (compressor_) {
+      compressor_->submit(model, step, time);
+      ++current_;
+      return;
+    }
+
     uint n = model.size();
 
     if (n > crds_size_) {
@@ -720,7 +953,9 @@ Library.
       crds_[k++] = c.y() / 10.0;
       crds_[k++] = c.z() / 10.0;
     }
-    writeCompressedCoordsFloat(crds_, n, precision_);
+
+    allocateBuffers(n);
+    encodeFrame(xdr, buf1, buf2, model.periodicBox(), crds_, n, step, time);
 
     ++current_;
   }
@@ -28,6 +28,8 @@
 #include <stdexcept>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include <loos_defs.hpp>
 #include <AtomicGroup.hpp>
 #include <xdr.hpp>
@@ -46,6 +48,13 @@ namespace loos {
    * counters, so you should use on form of writeFrame() or the other
    * and not mix them.  If you must, use currentStep() to update the
    * internal step counter (and possibly timePerStep()).
+   *
+   * Compressing the coordinates is the expensive part of writing a
+   * frame.  After useThreads(), frames are compressed concurrently by
+   * a pool of threads while the caller goes on to the next frame, and
+   * the compressed frames are written in order by writeFrame() and
+   * flush().  The resulting file is identical to one written without
+   * threads.
    */
 
 
@@ -128,11 +137,7 @@ namespace loos {
 
 
 
-    ~XTCWriter() {
-      delete[] buf1;
-      delete[] buf2;
-      delete[] crds_;
-    }
+    ~XTCWriter();
 
 
     //! Get the time per step
@@ -160,20 +165,36 @@ namespace loos {
     //! Write a frame to the trajectory with explicit step and time metadata
     void writeFrame(const AtomicGroup& model, const uint step, const double time);
 
+    //! Frames given to the writer, including those still being compressed
     uint framesWritten() const { return(current_); }
 
+    //! Compress frames on \a nthreads threads (0 = one per core)
+    void useThreads(const uint nthreads = 0);
+
+    //! Number of compression threads (0 if frames are compressed by writeFrame())
+    uint threads() const;
+
+    //! Write any frames still being compressed
+    void flush();
+
   private:
+    class Compressor;
+
+
     int sizeofint(const int size) const;
     int sizeofints(const int num_of_bits, const unsigned int sizes[]) const;
     void encodebits(int* buf, int num_of_bits, const int num) const;
     void encodeints(int* buf, const int num_of_ints, const int num_of_bits,
 		    const unsigned int* sizes, const unsigned int* nums) const;
-    void writeCompressedCoordsFloat(float* ptr, int size, float precision);
+    void writeCompressedCoordsFloat(internal::XDRWriter& xdr, int* buf1, int* buf2,
+                                    float* ptr, int size, float precision) const;
        
     void allocateBuffers(const size_t size);
 
-    void writeHeader(const int natoms, const int step, const float time);
-    void writeBox(const GCoord& box);
+    void writeHeader(internal::XDRWriter& xdr, const int natoms, const int step, const float time) const;
+    void writeBox(internal::XDRWriter& xdr, const GCoord& box) const;
+    void encodeFrame(internal::XDRWriter& xdr, int* buf1, int* buf2, const GCoord& box,
+                     float* crds, const int natoms, const int step, const float time) const;
 
     void prepareToAppend();
     
@@ -191,6 +212,7 @@ namespace loos {
     float precision_;
 
     internal::XDRWriter xdr;
+    boost::shared_ptr<Compressor> compressor_;
   };
 
 